@@ -0,0 +1,387 @@
+#include <vector>
+#include <stdio.h>
+#include <string>
+#include <cstring>
+#include <cstddef>
+
+#include <sys/types.h>
+#include <sys/stat.h>
+
+#include <glm/glm.hpp>
+
+#include "cookedmesh.hpp"
+#include "objloader.hpp"
+#include "vboindexer.hpp"
+#include "tangentspace.hpp"
+#include "vertexcache.hpp"
+#include "profiler.hpp"
+
+// Layout of a cooked file :
+// - a CookedMeshHeader,
+// - each array, at the offset given in the header. Offsets are multiples of 16
+//   so that the arrays are well aligned once mapped (the mapping itself is page-aligned).
+// Everything is little-endian, which is what all the platforms we support use.
+
+#define COOKEDMESH_MAGIC   0x4853454D // "MESH"
+#define COOKEDMESH_VERSION 3 // 2 : triangles and vertices are reordered by vertexcache.cpp
+                             // 3 : tangents from computeTangentBasisIndexed
+#define COOKEDMESH_ALIGN   16
+
+struct CookedMeshHeader{
+	unsigned int magic;
+	unsigned int version;
+	unsigned int headerSize;     // sizeof(CookedMeshHeader), in case the compiler pads differently
+	unsigned int flags;          // 1 = has tangents and bitangents
+
+	// Cache key : the .obj this was cooked from
+	unsigned long long sourceSize;
+	unsigned long long sourceTime;
+	unsigned long long sourceHash;
+
+	unsigned int vertexCount;
+	unsigned int indexCount;
+	unsigned int indexSize;
+	unsigned int padding;
+
+	unsigned long long verticesOffset;
+	unsigned long long uvsOffset;
+	unsigned long long normalsOffset;
+	unsigned long long tangentsOffset;
+	unsigned long long bitangentsOffset;
+	unsigned long long indicesOffset;
+	unsigned long long fileSize;
+};
+
+#define COOKEDMESH_HAS_TANGENTS 1
+
+// 64-bit FNV-1a. Not cryptographic at all, but we only want to notice that the file changed.
+static unsigned long long hashBytes(const unsigned char * data, size_t size){
+	unsigned long long hash = 14695981039346656037ULL;
+	for (size_t i=0; i<size; i++){
+		hash ^= data[i];
+		hash *= 1099511628211ULL;
+	}
+	return hash;
+}
+
+static bool getFileInfo(const char * path, unsigned long long & size, unsigned long long & time){
+	struct stat st;
+	if (stat(path, &st) != 0)
+		return false;
+	size = (unsigned long long)st.st_size;
+	time = (unsigned long long)st.st_mtime;
+	return true;
+}
+
+static bool hashFile(const char * path, unsigned long long & hash){
+	MappedFile file;
+	if (!mapFile(path, file))
+		return false;
+	hash = hashBytes(file.data, file.size);
+	unmapFile(file);
+	return true;
+}
+
+// Changes the sourceTime of a cooked file which is up to date, but whose source was touched.
+// Not being able to (read-only directory, ...) only means that the source will be hashed again next time.
+static void stampCookedMesh(const char * cookedPath, unsigned long long sourceTime){
+	FILE * file = fopen(cookedPath, "r+b");
+	if (file == NULL)
+		return;
+	if (fseek(file, offsetof(CookedMeshHeader, sourceTime), SEEK_SET) == 0)
+		fwrite(&sourceTime, sizeof(sourceTime), 1, file);
+	fclose(file);
+}
+
+static unsigned long long alignOffset(unsigned long long offset){
+	return (offset + COOKEDMESH_ALIGN - 1) & ~(unsigned long long)(COOKEDMESH_ALIGN - 1);
+}
+
+// Writes zeros up to 'offset', then the data. 'position' is where we are in the file.
+static bool writeBlob(FILE * file, unsigned long long & position, unsigned long long offset, const void * data, size_t size){
+	static const unsigned char zeros[COOKEDMESH_ALIGN] = {0};
+	if (offset < position || offset - position > COOKEDMESH_ALIGN)
+		return false;
+	if (fwrite(zeros, 1, (size_t)(offset - position), file) != offset - position)
+		return false;
+	position = offset + size;
+	return size == 0 || fwrite(data, 1, size, file) == size;
+}
+
+// All the header of a cooked mesh but its source : where each array goes
+template <typename IndexType>
+static void layOutCookedMesh(CookedMeshHeader & header, const std::vector<IndexType> & indices, size_t vertexCount, bool hasTangents){
+	memset(&header, 0, sizeof(header));
+	header.magic       = COOKEDMESH_MAGIC;
+	header.version     = COOKEDMESH_VERSION;
+	header.headerSize  = sizeof(CookedMeshHeader);
+	header.flags       = hasTangents ? COOKEDMESH_HAS_TANGENTS : 0;
+	header.vertexCount = (unsigned int)vertexCount;
+	header.indexCount  = (unsigned int)indices.size();
+	header.indexSize   = sizeof(IndexType);
+
+	unsigned long long offset = alignOffset(sizeof(CookedMeshHeader));
+	header.verticesOffset = offset;   offset = alignOffset(offset + vertexCount * sizeof(glm::vec3));
+	header.uvsOffset      = offset;   offset = alignOffset(offset + vertexCount * sizeof(glm::vec2));
+	header.normalsOffset  = offset;   offset = alignOffset(offset + vertexCount * sizeof(glm::vec3));
+	if (hasTangents){
+		header.tangentsOffset   = offset;  offset = alignOffset(offset + vertexCount * sizeof(glm::vec3));
+		header.bitangentsOffset = offset;  offset = alignOffset(offset + vertexCount * sizeof(glm::vec3));
+	}
+	header.indicesOffset  = offset;   offset = offset + indices.size() * sizeof(IndexType);
+	header.fileSize       = offset;
+}
+
+static void clearCookedMesh(CookedMesh & mesh){
+	mesh.vertexCount = 0;
+	mesh.indexCount  = 0;
+	mesh.indexSize   = 0;
+	mesh.vertices    = NULL;
+	mesh.uvs         = NULL;
+	mesh.normals     = NULL;
+	mesh.tangents    = NULL;
+	mesh.bitangents  = NULL;
+	mesh.indices     = NULL;
+	memset(&mesh.file, 0, sizeof(mesh.file));
+	mesh.storage.clear();
+}
+
+// 'data' is laid out like a cooked file, whose header was checked
+static void setCookedMeshArrays(CookedMesh & mesh, const unsigned char * data, const CookedMeshHeader & header){
+	bool hasTangents = (header.flags & COOKEDMESH_HAS_TANGENTS) != 0;
+	mesh.vertexCount = header.vertexCount;
+	mesh.indexCount  = header.indexCount;
+	mesh.indexSize   = header.indexSize;
+	mesh.vertices    = (const glm::vec3 *)(data + header.verticesOffset);
+	mesh.uvs         = (const glm::vec2 *)(data + header.uvsOffset);
+	mesh.normals     = (const glm::vec3 *)(data + header.normalsOffset);
+	mesh.tangents    = hasTangents ? (const glm::vec3 *)(data + header.tangentsOffset)   : NULL;
+	mesh.bitangents  = hasTangents ? (const glm::vec3 *)(data + header.bitangentsOffset) : NULL;
+	mesh.indices     = data + header.indicesOffset;
+}
+
+template <typename T>
+static void copyArray(unsigned char * data, unsigned long long offset, const std::vector<T> & values){
+	if (!values.empty())
+		memcpy(data + offset, &values[0], values.size() * sizeof(T));
+}
+
+// What loadCookedMesh would give for the file that writeCookedMesh writes, but in mesh.storage
+template <typename IndexType>
+static void storeCookedMesh(
+	const std::vector<IndexType> & indices,
+	const std::vector<glm::vec3> & vertices,
+	const std::vector<glm::vec2> & uvs,
+	const std::vector<glm::vec3> & normals,
+	const std::vector<glm::vec3> * tangents,
+	const std::vector<glm::vec3> * bitangents,
+	CookedMesh & out_mesh
+){
+	bool hasTangents = tangents != NULL && bitangents != NULL;
+	CookedMeshHeader header;
+	layOutCookedMesh(header, indices, vertices.size(), hasTangents);
+	clearCookedMesh(out_mesh);
+	out_mesh.storage.assign((size_t)header.fileSize, 0);
+	unsigned char * data = &out_mesh.storage[0];
+	memcpy(data, &header, sizeof(header));
+	copyArray(data, header.verticesOffset, vertices);
+	copyArray(data, header.uvsOffset, uvs);
+	copyArray(data, header.normalsOffset, normals);
+	if (hasTangents){
+		copyArray(data, header.tangentsOffset, *tangents);
+		copyArray(data, header.bitangentsOffset, *bitangents);
+	}
+	copyArray(data, header.indicesOffset, indices);
+	setCookedMeshArrays(out_mesh, data, header);
+}
+
+template <typename IndexType>
+bool writeCookedMesh(
+	const char * cookedPath,
+	const char * sourcePath,
+	const std::vector<IndexType> & indices,
+	const std::vector<glm::vec3> & vertices,
+	const std::vector<glm::vec2> & uvs,
+	const std::vector<glm::vec3> & normals,
+	const std::vector<glm::vec3> * tangents,
+	const std::vector<glm::vec3> * bitangents
+){
+	bool hasTangents = tangents != NULL && bitangents != NULL;
+	if (uvs.size() != vertices.size() || normals.size() != vertices.size() ||
+	    (hasTangents && (tangents->size() != vertices.size() || bitangents->size() != vertices.size()))){
+		printf("writeCookedMesh : all the vertex arrays must have the same size\n");
+		return false;
+	}
+
+	CookedMeshHeader header;
+	layOutCookedMesh(header, indices, vertices.size(), hasTangents);
+	if (sourcePath != NULL){
+		if (!getFileInfo(sourcePath, header.sourceSize, header.sourceTime) || !hashFile(sourcePath, header.sourceHash)){
+			printf("writeCookedMesh : can't read %s\n", sourcePath);
+			return false;
+		}
+	}
+
+	// Write to a temporary file first, so that a crash never leaves a half-written cooked file behind
+	std::string tempPath = std::string(cookedPath) + ".tmp";
+	FILE * file = fopen(tempPath.c_str(), "wb");
+	if (file == NULL){
+		printf("writeCookedMesh : can't create %s\n", tempPath.c_str());
+		return false;
+	}
+	unsigned long long position = 0;
+	bool ok = writeBlob(file, position, 0, &header, sizeof(header));
+	ok = ok && writeBlob(file, position, header.verticesOffset, vertices.empty() ? NULL : &vertices[0], vertices.size() * sizeof(glm::vec3));
+	ok = ok && writeBlob(file, position, header.uvsOffset,      uvs.empty()      ? NULL : &uvs[0],      uvs.size()      * sizeof(glm::vec2));
+	ok = ok && writeBlob(file, position, header.normalsOffset,  normals.empty()  ? NULL : &normals[0],  normals.size()  * sizeof(glm::vec3));
+	if (hasTangents){
+		ok = ok && writeBlob(file, position, header.tangentsOffset,   tangents->empty()   ? NULL : &(*tangents)[0],   tangents->size()   * sizeof(glm::vec3));
+		ok = ok && writeBlob(file, position, header.bitangentsOffset, bitangents->empty() ? NULL : &(*bitangents)[0], bitangents->size() * sizeof(glm::vec3));
+	}
+	ok = ok && writeBlob(file, position, header.indicesOffset, indices.empty() ? NULL : &indices[0], indices.size() * sizeof(IndexType));
+	ok = (fclose(file) == 0) && ok;
+
+	if (ok){
+		remove(cookedPath); // rename() doesn't overwrite on Windows
+		ok = rename(tempPath.c_str(), cookedPath) == 0;
+	}
+	if (!ok){
+		printf("writeCookedMesh : can't write %s\n", cookedPath);
+		remove(tempPath.c_str());
+	}
+	return ok;
+}
+
+template bool writeCookedMesh<unsigned short>(const char *, const char *, const std::vector<unsigned short> &,
+	const std::vector<glm::vec3> &, const std::vector<glm::vec2> &, const std::vector<glm::vec3> &,
+	const std::vector<glm::vec3> *, const std::vector<glm::vec3> *);
+template bool writeCookedMesh<unsigned int>(const char *, const char *, const std::vector<unsigned int> &,
+	const std::vector<glm::vec3> &, const std::vector<glm::vec2> &, const std::vector<glm::vec3> &,
+	const std::vector<glm::vec3> *, const std::vector<glm::vec3> *);
+
+bool loadCookedMesh(const char * cookedPath, const char * sourcePath, CookedMesh & out_mesh){
+	clearCookedMesh(out_mesh);
+
+	// Don't print anything if the file doesn't exist : that's the normal "not cooked yet" case
+	unsigned long long cookedSize, cookedTime;
+	if (!getFileInfo(cookedPath, cookedSize, cookedTime))
+		return false;
+
+	MappedFile file;
+	if (!mapFile(cookedPath, file))
+		return false;
+
+	const CookedMeshHeader * header = (const CookedMeshHeader *)file.data;
+	if (file.size < sizeof(CookedMeshHeader) ||
+	    header->magic != COOKEDMESH_MAGIC ||
+	    header->version != COOKEDMESH_VERSION ||
+	    header->headerSize != sizeof(CookedMeshHeader) ||
+	    header->fileSize != file.size ||
+	    (header->indexSize != 2 && header->indexSize != 4)){
+		printf("%s is not a valid cooked mesh, or is from an older version\n", cookedPath);
+		unmapFile(file);
+		return false;
+	}
+
+	// Check that all the arrays are inside the file
+	unsigned long long vertexCount = header->vertexCount;
+	bool hasTangents = (header->flags & COOKEDMESH_HAS_TANGENTS) != 0;
+	if (header->verticesOffset + vertexCount * sizeof(glm::vec3) > file.size ||
+	    header->uvsOffset      + vertexCount * sizeof(glm::vec2) > file.size ||
+	    header->normalsOffset  + vertexCount * sizeof(glm::vec3) > file.size ||
+	    (hasTangents && header->tangentsOffset   + vertexCount * sizeof(glm::vec3) > file.size) ||
+	    (hasTangents && header->bitangentsOffset + vertexCount * sizeof(glm::vec3) > file.size) ||
+	    header->indicesOffset + (unsigned long long)header->indexCount * header->indexSize > file.size){
+		printf("%s is corrupted\n", cookedPath);
+		unmapFile(file);
+		return false;
+	}
+
+	// Is it up to date ?
+	if (sourcePath != NULL){
+		unsigned long long sourceSize, sourceTime;
+		if (!getFileInfo(sourcePath, sourceSize, sourceTime)){
+			// No source anymore : the cooked file is all we have, use it.
+		}else if (sourceSize != header->sourceSize){
+			unmapFile(file);
+			return false;
+		}else if (sourceTime != header->sourceTime){
+			// Touched (e.g. by a checkout), but maybe not modified : compare the contents
+			unsigned long long sourceHash;
+			if (!hashFile(sourcePath, sourceHash) || sourceHash != header->sourceHash){
+				unmapFile(file);
+				return false;
+			}
+			// Same contents : stamp the new time, or the whole source would be hashed on every load.
+			// The mapping is read-only (and on Windows, a mapped file can't be opened for writing) :
+			// unmap, stamp, and map again. The contents were checked, so no need to check them again.
+			unmapFile(file);
+			stampCookedMesh(cookedPath, sourceTime);
+			return loadCookedMesh(cookedPath, NULL, out_mesh);
+		}
+	}
+
+	setCookedMeshArrays(out_mesh, file.data, *header);
+	out_mesh.file = file;
+	return true;
+}
+
+void unloadCookedMesh(CookedMesh & mesh){
+	unmapFile(mesh.file);
+	clearCookedMesh(mesh);
+}
+
+bool loadOBJ_cooked(const char * objPath, bool withTangents, CookedMesh & out_mesh){
+	PROFILE_SCOPE("loadOBJ_cooked");
+	std::string cookedPath = std::string(objPath) + ".cooked";
+
+	if (loadCookedMesh(cookedPath.c_str(), objPath, out_mesh)){
+		if (!withTangents || out_mesh.tangents != NULL)
+			return true;
+		unloadCookedMesh(out_mesh); // cooked without tangents : cook it again
+	}
+
+	printf("Cooking %s...\n", objPath);
+
+	std::vector<glm::vec3> vertices;
+	std::vector<glm::vec2> uvs;
+	std::vector<glm::vec3> normals;
+	if (!loadOBJ_fast(objPath, vertices, uvs, normals, 0))
+		return false;
+
+	// Use 16-bit indices when the mesh is small enough, 32-bit ones otherwise
+	std::vector<unsigned int> indices32;
+	std::vector<unsigned short> indices;
+	std::vector<glm::vec3> indexed_vertices;
+	std::vector<glm::vec2> indexed_uvs;
+	std::vector<glm::vec3> indexed_normals;
+	indexVBO(vertices, uvs, normals, indices32, indexed_vertices, indexed_uvs, indexed_normals);
+	optimizeVertexCache(indices32, indexed_vertices.size());
+	std::vector<glm::vec3> indexed_tangents;
+	std::vector<glm::vec3> indexed_bitangents;
+	std::vector<glm::vec3> * tangents = NULL;
+	std::vector<glm::vec3> * bitangents = NULL;
+	if (withTangents){
+		// Computed on the indexed mesh : each vertex gets the tangents of all its triangles,
+		// weighted by their angles, instead of the sum that indexVBO_TBN would give.
+		computeTangentBasisIndexed(indices32, indexed_vertices, indexed_uvs, indexed_normals, indexed_tangents, indexed_bitangents);
+		tangents = &indexed_tangents;
+		bitangents = &indexed_bitangents;
+	}
+	optimizeVertexFetch(indices32, indexed_vertices, indexed_uvs, indexed_normals, tangents, bitangents);
+	bool narrow = narrowIndices(indices32, indices);
+	bool written;
+	if (narrow)
+		written = writeCookedMesh(cookedPath.c_str(), objPath, indices, indexed_vertices, indexed_uvs, indexed_normals, tangents, bitangents);
+	else
+		written = writeCookedMesh(cookedPath.c_str(), objPath, indices32, indexed_vertices, indexed_uvs, indexed_normals, tangents, bitangents);
+	if (written && loadCookedMesh(cookedPath.c_str(), objPath, out_mesh))
+		return true;
+
+	// Not cooked (read-only directory, ...) : the same arrays, but from memory. Cooking only makes the next loads faster.
+	if (narrow)
+		storeCookedMesh(indices, indexed_vertices, indexed_uvs, indexed_normals, tangents, bitangents, out_mesh);
+	else
+		storeCookedMesh(indices32, indexed_vertices, indexed_uvs, indexed_normals, tangents, bitangents, out_mesh);
+	return true;
+}
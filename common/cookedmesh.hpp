@@ -0,0 +1,56 @@
+#ifndef COOKEDMESH_HPP
+#define COOKEDMESH_HPP
+
+#include "mappedfile.hpp"
+
+// An indexed mesh stored in our own binary format : a header, and then the
+// arrays that loadOBJ + indexVBO (+ computeTangentBasisIndexed) would give, as-is.
+// Loading it is just mapping the file : all the pointers below point into the mapping
+// (or into 'storage', when loadOBJ_cooked couldn't write the cooked file).
+struct CookedMesh{
+	unsigned int vertexCount;
+	unsigned int indexCount;
+	unsigned int indexSize;         // in bytes : 2 (GL_UNSIGNED_SHORT) or 4 (GL_UNSIGNED_INT)
+
+	const glm::vec3 * vertices;
+	const glm::vec2 * uvs;
+	const glm::vec3 * normals;
+	const glm::vec3 * tangents;     // NULL if the mesh was cooked without tangents
+	const glm::vec3 * bitangents;   // NULL if the mesh was cooked without tangents
+	const void      * indices;
+
+	MappedFile file;
+	std::vector<unsigned char> storage;
+};
+
+// Writes an indexed mesh to cookedPath.
+// The size, modification time and hash of sourcePath are stored too, so that
+// loadCookedMesh can tell when the cooked file is out of date.
+// tangents and bitangents can be NULL. IndexType is unsigned short or unsigned int.
+template <typename IndexType>
+bool writeCookedMesh(
+	const char * cookedPath,
+	const char * sourcePath,
+	const std::vector<IndexType> & indices,
+	const std::vector<glm::vec3> & vertices,
+	const std::vector<glm::vec2> & uvs,
+	const std::vector<glm::vec3> & normals,
+	const std::vector<glm::vec3> * tangents,
+	const std::vector<glm::vec3> * bitangents
+);
+
+// Maps cookedPath. Fails if the file is missing, has another version of the format,
+// or (if sourcePath isn't NULL) was cooked from another version of sourcePath.
+// When only the modification time of sourcePath changed, its hash is compared, and if it
+// matches, the new time is written in the cooked file : the next loads don't hash it again.
+bool loadCookedMesh(const char * cookedPath, const char * sourcePath, CookedMesh & out_mesh);
+
+void unloadCookedMesh(CookedMesh & mesh);
+
+// Loads an .obj file and indexes it, going through a cooked file next to it ("file.obj.cooked").
+// The first time, the .obj is parsed, indexed (with tangents if withTangents is true)
+// and cooked; the next times, only the cooked file is mapped. If the cooked file can't be
+// written (read-only directory, ...), the mesh is still loaded, from memory : only the .obj can fail.
+bool loadOBJ_cooked(const char * objPath, bool withTangents, CookedMesh & out_mesh);
+
+#endif
@@ -0,0 +1,320 @@
+#include <vector>
+#include <string>
+#include <thread>
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+
+#include <sys/types.h>
+#include <sys/stat.h>
+
+#include <GL/glew.h>
+
+#include "textureimage.hpp"
+#include "texturecompressor.hpp"
+#include "distancefield.hpp"
+
+#define DISTANCE_INFINITY 1e20f   // squared distance to nothing
+#define ENVELOPE_INFINITY 1e30f   // bounds of the parabolas' ranges
+
+// One line of the distance transform : out[q] = min over p of (q-p)^2 + f[p].
+// The lower envelope of the parabolas is built left to right : v are the parabolas in it,
+// z the boundaries between them. v and z have room for n and n+1 entries.
+static void distanceTransform1D(const float * f, unsigned int n, float * out, unsigned int * v, float * z){
+	unsigned int k = 0;
+	v[0] = 0;
+	z[0] = -ENVELOPE_INFINITY;
+	z[1] = ENVELOPE_INFINITY;
+	for (unsigned int q=1; q<n; q++){
+		// Where the parabola of q gets below the last one of the envelope. Those it hides are removed.
+		// z[0] is far enough for the loop to stop there, even with DISTANCE_INFINITY in f.
+		float s;
+		for (;;){
+			float p = (float)v[k];
+			s = ((f[q] + (float)q*q) - (f[v[k]] + p*p)) / (2.0f*q - 2.0f*p);
+			if (s > z[k])
+				break;
+			k--;
+		}
+		k++;
+		v[k] = q;
+		z[k] = s;
+		z[k+1] = ENVELOPE_INFINITY;
+	}
+	k = 0;
+	for (unsigned int q=0; q<n; q++){
+		while (z[k+1] < (float)q)
+			k++;
+		float d = (float)q - (float)v[k];
+		out[q] = d*d + f[v[k]];
+	}
+}
+
+// The same transform is done twice : distances to the inside pixels, and distances to the outside ones
+struct DistancePass{
+	const unsigned char * coverage;
+	unsigned int width, height;
+	unsigned char threshold;
+	float * toInside;   // squared, after the rows; then signed distances
+	float * toOutside;  // squared
+};
+
+static void transformRows(const DistancePass * pass, unsigned int firstRow, unsigned int lastRow){
+	unsigned int n = pass->width;
+	std::vector<float> insideF(n), outsideF(n);
+	std::vector<unsigned int> v(n);
+	std::vector<float> z(n + 1);
+	for (unsigned int y=firstRow; y<lastRow; y++){
+		const unsigned char * row = pass->coverage + (size_t)y * n;
+		for (unsigned int x=0; x<n; x++){
+			bool inside = row[x] >= pass->threshold;
+			insideF[x]  = inside ? 0.0f : DISTANCE_INFINITY;
+			outsideF[x] = inside ? DISTANCE_INFINITY : 0.0f;
+		}
+		distanceTransform1D(&insideF[0],  n, pass->toInside  + (size_t)y * n, &v[0], &z[0]);
+		distanceTransform1D(&outsideF[0], n, pass->toOutside + (size_t)y * n, &v[0], &z[0]);
+	}
+}
+
+static void transformColumns(const DistancePass * pass, unsigned int firstColumn, unsigned int lastColumn){
+	unsigned int n = pass->height;
+	size_t stride = pass->width;
+	std::vector<float> insideF(n), outsideF(n), toInside(n), toOutside(n);
+	std::vector<unsigned int> v(n);
+	std::vector<float> z(n + 1);
+	for (unsigned int x=firstColumn; x<lastColumn; x++){
+		for (unsigned int y=0; y<n; y++){
+			insideF[y]  = pass->toInside [y * stride + x];
+			outsideF[y] = pass->toOutside[y * stride + x];
+		}
+		distanceTransform1D(&insideF[0],  n, &toInside[0],  &v[0], &z[0]);
+		distanceTransform1D(&outsideF[0], n, &toOutside[0], &v[0], &z[0]);
+
+		// The edge is half-way between the centers of an inside and an outside pixel
+		for (unsigned int y=0; y<n; y++){
+			bool inside = pass->coverage[y * stride + x] >= pass->threshold;
+			pass->toInside[y * stride + x] = inside ? 0.5f - sqrtf(toOutside[y]) : sqrtf(toInside[y]) - 0.5f;
+		}
+	}
+}
+
+static void runOnLines(void (*function)(const DistancePass *, unsigned int, unsigned int), const DistancePass * pass,
+	unsigned int lineCount, unsigned int threadCount){
+	// Not worth starting threads for small images
+	unsigned int maxThreads = (unsigned int)((size_t)pass->width * pass->height / 16384);
+	if (threadCount > maxThreads) threadCount = maxThreads;
+	if (threadCount < 1)          threadCount = 1;
+
+	std::vector<std::thread> threads;
+	for (unsigned int t=1; t<threadCount; t++)
+		threads.push_back(std::thread(function, pass, lineCount * t / threadCount, lineCount * (t+1) / threadCount));
+	function(pass, 0, lineCount / threadCount);
+	for (size_t t=0; t<threads.size(); t++)
+		threads[t].join();
+}
+
+void signedDistanceField(const unsigned char * coverage, unsigned int width, unsigned int height, unsigned char threshold,
+	float * out_distances, unsigned int threadCount){
+	if (width == 0 || height == 0)
+		return;
+	if (threadCount == 0)
+		threadCount = std::thread::hardware_concurrency();
+
+	std::vector<float> toOutside((size_t)width * height);
+	DistancePass pass;
+	pass.coverage = coverage;
+	pass.width = width;
+	pass.height = height;
+	pass.threshold = threshold;
+	pass.toInside = out_distances;
+	pass.toOutside = &toOutside[0];
+	runOnLines(transformRows, &pass, height, threadCount);
+	runOnLines(transformColumns, &pass, width, threadCount);
+}
+
+// Level 0 of the font, as one byte of coverage per pixel, top row first
+static bool loadFontCoverage(const char * fontpath, std::vector<unsigned char> & out_coverage,
+	unsigned int & out_width, unsigned int & out_height){
+	TextureImage image;
+	if (!loadTextureImage(fontpath, image))
+		return false;
+
+	const TextureLevel & level = getTextureLevel(image, 0, 0, 0);
+	unsigned int width = level.width, height = level.height;
+	size_t pixelCount = (size_t)width * height;
+	out_coverage.resize(pixelCount);
+	bool ok = true;
+	if (image.compressed){
+		std::vector<unsigned char> rgba(pixelCount * 4);
+		ok = decompressImage(level.data, width, height, image.internalFormat, &rgba[0]);
+		for (size_t i=0; i<pixelCount && ok; i++)
+			out_coverage[i] = rgba[i*4+3];
+	}else if (image.type == GL_UNSIGNED_BYTE && (image.format == GL_BGR || image.format == GL_BGRA ||
+	                                              image.format == GL_RGB || image.format == GL_RGBA)){
+		// DDS files are mapped, and their first row is the top one. BMP and TGA files are decoded bottom row first.
+		bool bottomFirst = image.file.data == NULL;
+		unsigned int bytesPerPixel = image.blockSize;
+		bool alpha = bytesPerPixel == 4 && image.internalFormat != GL_RGB8;
+		for (unsigned int y=0; y<height; y++){
+			const unsigned char * row = level.data + (size_t)(bottomFirst ? height - 1 - y : y) * width * bytesPerPixel;
+			for (unsigned int x=0; x<width; x++){
+				const unsigned char * in = row + x * bytesPerPixel;
+				out_coverage[(size_t)y * width + x] = alpha ? in[3] : (unsigned char)((in[0] + in[1] + in[2]) / 3);
+			}
+		}
+	}else{
+		ok = false;
+	}
+	if (!ok)
+		printf("buildSDFFont : the format of %s is not supported\n", fontpath);
+
+	out_width = width;
+	out_height = height;
+	unloadTextureImage(image);
+	return ok;
+}
+
+struct SDFFontJob{
+	const unsigned char * coverage;  // the whole source
+	unsigned int sourceCell;         // size of a glyph in the source
+	unsigned int cellSize;           // in the result
+	float spread;
+	unsigned char * out;             // level 0 of the result
+};
+
+// Glyphs first, first+step, ... : each thread has its own, and its own buffers
+static void buildSDFGlyphs(const SDFFontJob * job, unsigned int first, unsigned int step){
+	unsigned int s = job->sourceCell, c = job->cellSize, factor = s / c;
+	unsigned int sourceWidth = s * 16, width = c * 16;
+	std::vector<unsigned char> cell((size_t)s * s);
+	std::vector<float> distances((size_t)s * s);
+	for (unsigned int glyph=first; glyph<256; glyph+=step){
+		unsigned int gx = glyph % 16, gy = glyph / 16;
+		for (unsigned int y=0; y<s; y++)
+			memcpy(&cell[(size_t)y * s], job->coverage + ((size_t)(gy*s + y) * sourceWidth + gx*s), s);
+		signedDistanceField(&cell[0], s, s, 128, &distances[0], 1);
+
+		// Average factor x factor source pixels, and store 0.5 - distance/(2*spread), in result pixels
+		float scale = 1.0f / (factor * factor * factor * 2.0f * job->spread);
+		for (unsigned int y=0; y<c; y++){
+			for (unsigned int x=0; x<c; x++){
+				float sum = 0.0f;
+				for (unsigned int j=0; j<factor; j++)
+					for (unsigned int i=0; i<factor; i++)
+						sum += distances[(size_t)(y*factor + j) * s + x*factor + i];
+				float value = 0.5f - sum * scale;
+				value = value < 0.0f ? 0.0f : (value > 1.0f ? 1.0f : value);
+				job->out[(size_t)(gy*c + y) * width + gx*c + x] = (unsigned char)(value * 255.0f + 0.5f);
+			}
+		}
+	}
+}
+
+bool buildSDFFont(const char * fontpath, const SDFFontOptions & options, TextureImage & out_image){
+	std::vector<unsigned char> coverage;
+	unsigned int sourceWidth, sourceHeight;
+	if (!loadFontCoverage(fontpath, coverage, sourceWidth, sourceHeight))
+		return false;
+	unsigned int sourceCell = sourceWidth / 16;
+	unsigned int c = options.cellSize;
+	if (sourceWidth != sourceHeight || sourceWidth % 16 != 0 || c == 0 || sourceCell % c != 0){
+		printf("buildSDFFont : %s must be square, 16 glyphs wide, and its glyphs a multiple of %u pixels wide\n", fontpath, c);
+		return false;
+	}
+
+	// The levels : down to 8x8 glyphs, while the glyphs can still be halved exactly
+	unsigned int width = c * 16;
+	unsigned int levelCount = 1;
+	while ((c >> (levelCount-1)) % 2 == 0 && (c >> levelCount) >= 8)
+		levelCount++;
+	size_t totalSize = 0;
+	for (unsigned int level=0; level<levelCount; level++)
+		totalSize += (size_t)(width >> level) * (width >> level);
+
+	memset(&out_image.file, 0, sizeof(out_image.file));
+	out_image.width = width;
+	out_image.height = width;
+	out_image.levelCount = levelCount;
+	out_image.layerCount = 1;
+	out_image.faceCount = 1;
+	out_image.isArray = false;
+	out_image.compressed = false;
+	out_image.blockSize = 1;
+	out_image.internalFormat = GL_R8;
+	out_image.format = GL_RED;
+	out_image.type = GL_UNSIGNED_BYTE;
+	out_image.generateMipmaps = false;
+	out_image.pixels.resize(totalSize);
+	out_image.levels.resize(levelCount);
+
+	// The glyphs are shared between the threads
+	SDFFontJob job;
+	job.coverage = &coverage[0];
+	job.sourceCell = sourceCell;
+	job.cellSize = c;
+	job.spread = options.spread > 0.0f ? options.spread : 1.0f;
+	job.out = &out_image.pixels[0];
+	unsigned int threadCount = options.threadCount ? options.threadCount : std::thread::hardware_concurrency();
+	if (threadCount < 1)   threadCount = 1;
+	if (threadCount > 256) threadCount = 256;
+	std::vector<std::thread> threads;
+	for (unsigned int t=1; t<threadCount; t++)
+		threads.push_back(std::thread(buildSDFGlyphs, &job, t, threadCount));
+	buildSDFGlyphs(&job, 0, threadCount);
+	for (size_t t=0; t<threads.size(); t++)
+		threads[t].join();
+
+	// Each level is the average of 2x2 pixels of the previous one. Distances average well enough,
+	// and since the glyphs are halved exactly, they never mix.
+	size_t offset = 0;
+	for (unsigned int level=0; level<levelCount; level++){
+		TextureLevel & l = out_image.levels[level];
+		l.width = width >> level;
+		l.height = width >> level;
+		l.size = (size_t)l.width * l.height;
+		l.data = &out_image.pixels[offset];
+		if (level > 0){
+			const TextureLevel & previous = out_image.levels[level-1];
+			unsigned char * out = &out_image.pixels[offset];
+			for (unsigned int y=0; y<l.height; y++){
+				for (unsigned int x=0; x<l.width; x++){
+					const unsigned char * in = previous.data + (size_t)(y*2) * previous.width + x*2;
+					out[(size_t)y * l.width + x] = (unsigned char)((in[0] + in[1] + in[previous.width] + in[previous.width + 1] + 2) / 4);
+				}
+			}
+		}
+		offset += l.size;
+	}
+	return true;
+}
+
+// Modification time, or -1 if the file doesn't exist
+static long long fileTime(const char * path){
+	struct stat st;
+	if (stat(path, &st) != 0)
+		return -1;
+	return (long long)st.st_mtime;
+}
+
+bool cookSDFFont(const char * fontpath, const char * ddspath, const SDFFontOptions & options){
+	long long cookedTime = fileTime(ddspath);
+	if (cookedTime >= 0 && cookedTime >= fileTime(fontpath))
+		return true;
+
+	TextureImage image;
+	if (!buildSDFFont(fontpath, options, image))
+		return false;
+
+	// Write to a temporary file first, so that a crash never leaves a half-written file behind
+	std::string tempPath = std::string(ddspath) + ".tmp";
+	bool ok = writeDDSImage(tempPath.c_str(), image);
+	if (ok){
+		remove(ddspath); // rename() doesn't overwrite on Windows
+		ok = rename(tempPath.c_str(), ddspath) == 0;
+		if (!ok){
+			printf("cookSDFFont : can't write %s\n", ddspath);
+			remove(tempPath.c_str());
+		}
+	}
+	return ok;
+}
@@ -0,0 +1,33 @@
+#ifndef DISTANCEFIELD_HPP
+#define DISTANCEFIELD_HPP
+
+// Signed distance fields : instead of the coverage of each pixel, a texture keeps the distance to
+// the nearest edge of the shape. Bilinear filtering of distances stays a sharp edge when magnified,
+// so a small texture can draw text at any size (see initText2DSDF in text2D.hpp).
+
+// Exact Euclidean distance transform (Felzenszwalb & Huttenlocher's lower envelope of parabolas, one
+// pass on the rows, then one on the columns). The pixels with coverage >= threshold are inside.
+// out_distances[i] is, in pixels, the distance from pixel i to the edge : positive outside, negative inside.
+// The rows, then the columns, are shared between threadCount threads (0 = one per core).
+void signedDistanceField(const unsigned char * coverage, unsigned int width, unsigned int height, unsigned char threshold,
+	float * out_distances, unsigned int threadCount);
+
+struct SDFFontOptions{
+	unsigned int cellSize;    // size of each glyph in the result, in pixels. The source's must be a multiple of it
+	float spread;             // distance, in result pixels, at which the field saturates. Bigger allows
+	                          // outlines and shadows, smaller keeps more precision near the edge
+	unsigned int threadCount; // 0 = one per core
+};
+
+// Converts a bitmap font, 16x16 glyphs in a square texture with the coverage in its alpha channel
+// (like Holstein.DDS : .DDS, .BMP or .TGA, in which case the luminance is used), into a distance field
+// with the same layout, 16*cellSize wide, top row first like DDS files, so it is used with the same UVs.
+// Each glyph is computed separately, so that the neighbours don't leak into it.
+// The result is a single GL_R8 channel, 128 on the edge and more inside, with mipmaps down to 8x8 glyphs.
+struct TextureImage;
+bool buildSDFFont(const char * fontpath, const SDFFontOptions & options, TextureImage & out_image);
+
+// buildSDFFont, then writes the result in ddspath. Does nothing if ddspath is newer than fontpath.
+bool cookSDFFont(const char * fontpath, const char * ddspath, const SDFFontOptions & options);
+
+#endif
@@ -0,0 +1,202 @@
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+
+#include "jobpool.hpp"
+#include "profiler.hpp"
+
+// The batches in flight are counted in a ring : submitJobs waits when it comes back to a batch which isn't done
+#define JOBPOOL_MAX_BATCHES 64
+
+struct Job{
+	JobFunction function;
+	void * data;
+	unsigned int index;
+	unsigned int batch;
+};
+
+struct JobQueue{
+	std::mutex mutex;
+	std::deque<Job> jobs; // the owner takes from the back, the thieves from the front
+};
+
+struct JobPool{
+	std::vector<std::thread> workers;
+	std::vector<JobQueue *> queues;   // one per worker, then a last one for the other threads
+	std::atomic<unsigned int> nextQueue; // where the other threads queue their jobs
+
+	std::atomic<unsigned int> queued; // jobs in all the queues
+	std::atomic<unsigned int> nextBatch;
+	std::atomic<unsigned int> remaining[JOBPOOL_MAX_BATCHES];
+
+	// Threads with nothing to do wait for 'changed' : jobs queued, a batch done, or quitting
+	std::mutex mutex;
+	std::condition_variable changed;
+	bool quitting;
+};
+
+// The queue of the calling thread, if it is a worker of this pool
+static thread_local const JobPool * currentJobPool = NULL;
+static thread_local unsigned int currentJobQueue = 0;
+
+static unsigned int ownQueue(const JobPool * pool){
+	return currentJobPool == pool ? currentJobQueue : (unsigned int)pool->workers.size();
+}
+
+// From the back of our own queue, or else from the front of another one
+static bool takeJob(JobPool * pool, Job & out_job){
+	if (pool->queued.load() == 0)
+		return false;
+	unsigned int queueCount = (unsigned int)pool->queues.size();
+	unsigned int own = ownQueue(pool);
+	for (unsigned int q=0; q<queueCount; q++){
+		JobQueue * queue = pool->queues[(own + q) % queueCount];
+		std::lock_guard<std::mutex> lock(queue->mutex);
+		if (queue->jobs.empty())
+			continue;
+		if (q == 0){
+			out_job = queue->jobs.back();
+			queue->jobs.pop_back();
+		}else{
+			out_job = queue->jobs.front();
+			queue->jobs.pop_front();
+		}
+		pool->queued--;
+		return true;
+	}
+	return false;
+}
+
+static void runJob(JobPool * pool, const Job & job){
+	job.function(job.data, job.index);
+	if (pool->remaining[job.batch % JOBPOOL_MAX_BATCHES].fetch_sub(1) == 1){
+		std::lock_guard<std::mutex> lock(pool->mutex);
+		pool->changed.notify_all();
+	}
+}
+
+static void jobWorker(JobPool * pool, unsigned int index){
+	setProfilerThreadName("job worker");
+	currentJobPool = pool;
+	currentJobQueue = index;
+	while (true){
+		Job job;
+		if (takeJob(pool, job)){
+			runJob(pool, job);
+			continue;
+		}
+		std::unique_lock<std::mutex> lock(pool->mutex);
+		while (!pool->quitting && pool->queued.load() == 0)
+			pool->changed.wait(lock);
+		if (pool->quitting && pool->queued.load() == 0)
+			return;
+	}
+}
+
+JobPool * createJobPool(unsigned int threadCount){
+	if (threadCount == 0){
+		threadCount = std::thread::hardware_concurrency();
+		threadCount = threadCount > 1 ? threadCount - 1 : 1;
+	}
+
+	JobPool * pool = new JobPool;
+	pool->nextQueue = 0;
+	pool->queued = 0;
+	pool->nextBatch = 0;
+	for (unsigned int b=0; b<JOBPOOL_MAX_BATCHES; b++)
+		pool->remaining[b] = 0;
+	pool->quitting = false;
+	for (unsigned int t=0; t<=threadCount; t++)
+		pool->queues.push_back(new JobQueue);
+	for (unsigned int t=0; t<threadCount; t++)
+		pool->workers.push_back(std::thread(jobWorker, pool, t));
+	return pool;
+}
+
+void destroyJobPool(JobPool * pool){
+	if (!pool)
+		return;
+	{
+		std::lock_guard<std::mutex> lock(pool->mutex);
+		pool->quitting = true;
+		pool->changed.notify_all();
+	}
+	for (size_t t=0; t<pool->workers.size(); t++)
+		pool->workers[t].join();
+	for (size_t q=0; q<pool->queues.size(); q++)
+		delete pool->queues[q];
+	delete pool;
+}
+
+unsigned int jobPoolThreadCount(const JobPool * pool){
+	return pool ? (unsigned int)pool->workers.size() : 0;
+}
+
+unsigned int submitJobs(JobPool * pool, JobFunction function, void * data, unsigned int count){
+	if (!pool){
+		for (unsigned int i=0; i<count; i++)
+			function(data, i);
+		return 0;
+	}
+
+	unsigned int batch = pool->nextBatch++;
+	waitForJobs(pool, batch - JOBPOOL_MAX_BATCHES); // the previous batch in the same slot
+	if (count == 0)
+		return batch;
+	pool->remaining[batch % JOBPOOL_MAX_BATCHES] = count;
+
+	// A worker keeps the jobs it queues, and the others steal them if they have nothing to do.
+	// Jobs queued by other threads are spread between the workers.
+	Job job;
+	job.function = function;
+	job.data = data;
+	job.batch = batch;
+	unsigned int workerCount = (unsigned int)pool->workers.size();
+	unsigned int own = ownQueue(pool);
+	pool->queued += count; // before the jobs are there, so that the count never goes below 0
+	if (own < workerCount || workerCount == 0){
+		JobQueue * queue = pool->queues[own];
+		std::lock_guard<std::mutex> lock(queue->mutex);
+		for (unsigned int i=0; i<count; i++){
+			job.index = i;
+			queue->jobs.push_back(job);
+		}
+	}else{
+		// Backwards, so that the workers, which take the last one first, start with the first jobs
+		unsigned int first = pool->nextQueue.fetch_add(count);
+		for (unsigned int i=count; i-- > 0; ){
+			JobQueue * queue = pool->queues[(first + i) % workerCount];
+			std::lock_guard<std::mutex> lock(queue->mutex);
+			job.index = i;
+			queue->jobs.push_back(job);
+		}
+	}
+
+	std::lock_guard<std::mutex> lock(pool->mutex);
+	pool->changed.notify_all();
+	return batch;
+}
+
+void waitForJobs(JobPool * pool, unsigned int batch){
+	if (!pool)
+		return;
+	std::atomic<unsigned int> & remaining = pool->remaining[batch % JOBPOOL_MAX_BATCHES];
+	while (remaining.load() != 0){
+		Job job;
+		if (takeJob(pool, job)){
+			runJob(pool, job);
+			continue;
+		}
+		// The last jobs of the batch are running on other threads
+		std::unique_lock<std::mutex> lock(pool->mutex);
+		while (remaining.load() != 0 && pool->queued.load() == 0)
+			pool->changed.wait(lock);
+	}
+}
+
+void runJobs(JobPool * pool, JobFunction function, void * data, unsigned int count){
+	waitForJobs(pool, submitJobs(pool, function, data, count));
+}
@@ -0,0 +1,34 @@
+#ifndef JOBPOOL_HPP
+#define JOBPOOL_HPP
+
+// A pool of worker threads which run small jobs : function(data, index) for index in [0, count).
+// Each worker has its own queue : it takes the jobs it queued itself last-in first-out, and when it has
+// none left, it steals the oldest jobs of the others. So the jobs which a job queues (see waitForJobs)
+// mostly stay on the same thread, and the threads only meet when one of them runs out of work.
+// This part doesn't use OpenGL.
+
+struct JobPool;
+
+typedef void (*JobFunction)(void * data, unsigned int index);
+
+// threadCount = 0 means one thread per core, minus one for the calling thread, which runs jobs in waitForJobs
+JobPool * createJobPool(unsigned int threadCount);
+
+// Waits for the workers to finish the jobs already queued
+void destroyJobPool(JobPool * pool);
+
+unsigned int jobPoolThreadCount(const JobPool * pool);
+
+// Queues 'count' jobs, and returns immediately. The returned batch is for waitForJobs.
+// With a NULL pool, runs them right away, in order.
+// The jobs of a batch can run in any order, on any thread, at the same time : they must not write to the same memory.
+unsigned int submitJobs(JobPool * pool, JobFunction function, void * data, unsigned int count);
+
+// Returns when all the jobs of the batch are done. Meanwhile, the calling thread runs queued jobs too,
+// of any batch : a job can submit jobs and wait for them, without taking a worker away.
+void waitForJobs(JobPool * pool, unsigned int batch);
+
+// submitJobs then waitForJobs
+void runJobs(JobPool * pool, JobFunction function, void * data, unsigned int count);
+
+#endif
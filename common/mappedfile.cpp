@@ -0,0 +1,116 @@
+#include <stdio.h>
+#include <stddef.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+#include "mappedfile.hpp"
+
+#ifdef _WIN32
+
+bool mapFile(const char * path, MappedFile & out_file){
+	out_file.data = NULL;
+	out_file.size = 0;
+	out_file.fileHandle = NULL;
+	out_file.mappingHandle = NULL;
+
+	HANDLE file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+	if (file == INVALID_HANDLE_VALUE){
+		printf("%s could not be opened. Are you in the right directory ? Don't forget to read the FAQ !\n", path);
+		return false;
+	}
+
+	LARGE_INTEGER size;
+	if (!GetFileSizeEx(file, &size)){
+		CloseHandle(file);
+		return false;
+	}
+	out_file.fileHandle = file;
+	if (size.QuadPart == 0)
+		return true; // CreateFileMapping refuses empty files
+
+	HANDLE mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+	if (mapping == NULL){
+		printf("%s could not be mapped in memory\n", path);
+		CloseHandle(file);
+		out_file.fileHandle = NULL;
+		return false;
+	}
+	void * view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+	if (view == NULL){
+		printf("%s could not be mapped in memory\n", path);
+		CloseHandle(mapping);
+		CloseHandle(file);
+		out_file.fileHandle = NULL;
+		return false;
+	}
+
+	out_file.data = (const unsigned char *)view;
+	out_file.size = (size_t)size.QuadPart;
+	out_file.mappingHandle = mapping;
+	return true;
+}
+
+void unmapFile(MappedFile & file){
+	if (file.data)          UnmapViewOfFile(file.data);
+	if (file.mappingHandle) CloseHandle((HANDLE)file.mappingHandle);
+	if (file.fileHandle)    CloseHandle((HANDLE)file.fileHandle);
+	file.data = NULL;
+	file.size = 0;
+	file.fileHandle = NULL;
+	file.mappingHandle = NULL;
+}
+
+#else
+
+bool mapFile(const char * path, MappedFile & out_file){
+	out_file.data = NULL;
+	out_file.size = 0;
+	out_file.fileHandle = NULL;
+	out_file.mappingHandle = NULL;
+
+	int fd = open(path, O_RDONLY);
+	if (fd < 0){
+		printf("%s could not be opened. Are you in the right directory ? Don't forget to read the FAQ !\n", path);
+		return false;
+	}
+
+	struct stat st;
+	if (fstat(fd, &st) != 0){
+		close(fd);
+		return false;
+	}
+	if (st.st_size == 0){
+		close(fd);
+		return true; // mmap refuses empty files
+	}
+
+	void * view = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	// The mapping keeps its own reference to the file
+	close(fd);
+	if (view == MAP_FAILED){
+		printf("%s could not be mapped in memory\n", path);
+		return false;
+	}
+	// We will read everything front to back
+	madvise(view, (size_t)st.st_size, MADV_SEQUENTIAL);
+
+	out_file.data = (const unsigned char *)view;
+	out_file.size = (size_t)st.st_size;
+	return true;
+}
+
+void unmapFile(MappedFile & file){
+	if (file.data)
+		munmap((void *)file.data, file.size);
+	file.data = NULL;
+	file.size = 0;
+}
+
+#endif
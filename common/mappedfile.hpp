@@ -0,0 +1,21 @@
+#ifndef MAPPEDFILE_HPP
+#define MAPPEDFILE_HPP
+
+// A read-only view of a whole file, mapped in memory by the OS.
+// Nothing is copied : the pages are loaded lazily when they are first touched.
+struct MappedFile{
+	const unsigned char * data;
+	size_t size;
+	// Platform-specific handles. Don't touch.
+	void * fileHandle;
+	void * mappingHandle;
+};
+
+// Maps the file at 'path'. Returns false (and prints why) if it can't be opened.
+// An empty file is mapped successfully with data == NULL and size == 0.
+bool mapFile(const char * path, MappedFile & out_file);
+
+// Releases the mapping. Pointers into out_file.data are invalid afterwards.
+void unmapFile(MappedFile & file);
+
+#endif
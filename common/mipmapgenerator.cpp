@@ -0,0 +1,318 @@
+#include <vector>
+#include <thread>
+#include <string.h>
+#include <math.h>
+
+#include <GL/glew.h>
+
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#define MIPMAPGENERATOR_SSE
+#include <xmmintrin.h>
+#endif
+
+#include "textureimage.hpp"
+#include "mipmapgenerator.hpp"
+
+// Each level is computed from the previous one, in floating point, with a separable filter :
+// first horizontally (in -> temp), then vertically (temp -> out).
+// The pixels are kept as 4 floats (linear RGBA, or XYZA for normal maps), so that
+// nothing is lost to 8-bit rounding between the levels.
+
+#define KAISER_ALPHA 4.0f
+
+static float sinc(float x){
+	if (fabsf(x) < 1e-5f)
+		return 1.0f;
+	x *= 3.14159265f;
+	return sinf(x) / x;
+}
+
+// Modified Bessel function of the first kind, order 0
+static float besselI0(float x){
+	float sum = 1.0f, term = 1.0f;
+	for (int k=1; k<32; k++){
+		term *= (x / (2.0f * k)) * (x / (2.0f * k));
+		sum += term;
+		if (term < sum * 1e-7f)
+			break;
+	}
+	return sum;
+}
+
+static float filterRadius(MipmapFilter filter){
+	return filter == MIPMAP_BOX ? 0.5f : 3.0f;
+}
+
+// x is in destination pixels
+static float filterWeight(MipmapFilter filter, float x){
+	x = fabsf(x);
+	switch (filter){
+	case MIPMAP_BOX:
+		return x < 0.5f ? 1.0f : (x == 0.5f ? 0.5f : 0.0f);
+	case MIPMAP_KAISER:
+		if (x >= 3.0f) return 0.0f;
+		return sinc(x) * besselI0(KAISER_ALPHA * sqrtf(1.0f - (x/3.0f) * (x/3.0f))) / besselI0(KAISER_ALPHA);
+	case MIPMAP_LANCZOS:
+		if (x >= 3.0f) return 0.0f;
+		return sinc(x) * sinc(x / 3.0f);
+	}
+	return 0.0f;
+}
+
+// Which source pixels, with which weights, make each destination pixel along one axis
+struct FilterTaps{
+	std::vector<unsigned int> first;   // per destination pixel : index of its first tap
+	std::vector<unsigned int> source;  // per tap
+	std::vector<float> weight;         // per tap
+};
+
+static void buildFilterTaps(unsigned int inSize, unsigned int outSize, const MipmapOptions & options, FilterTaps & out_taps){
+	float scale = (float)inSize / outSize;
+	float radius = filterRadius(options.filter) * scale;
+	out_taps.first.resize(outSize + 1);
+	out_taps.source.clear();
+	out_taps.weight.clear();
+	for (unsigned int i=0; i<outSize; i++){
+		out_taps.first[i] = (unsigned int)out_taps.source.size();
+		float center = (i + 0.5f) * scale;
+		int j0 = (int)floorf(center - radius), j1 = (int)ceilf(center + radius);
+		float sum = 0.0f;
+		for (int j=j0; j<=j1; j++){
+			float w = filterWeight(options.filter, (j + 0.5f - center) / scale);
+			if (w == 0.0f)
+				continue;
+			int s = j;
+			if (options.wrap){
+				s %= (int)inSize;
+				if (s < 0) s += inSize;
+			}else{
+				s = s < 0 ? 0 : (s >= (int)inSize ? inSize - 1 : s);
+			}
+			out_taps.source.push_back((unsigned int)s);
+			out_taps.weight.push_back(w);
+			sum += w;
+		}
+		for (size_t t=out_taps.first[i]; t<out_taps.source.size(); t++)
+			out_taps.weight[t] /= sum;
+	}
+	out_taps.first[outSize] = (unsigned int)out_taps.source.size();
+}
+
+// out = sum of weight[t] * in[source[t] * stride], for 4 floats
+static inline void filterPixel(const float * in, size_t stride, const FilterTaps & taps, unsigned int i, float * out){
+#ifdef MIPMAPGENERATOR_SSE
+	__m128 sum = _mm_setzero_ps();
+	for (unsigned int t=taps.first[i]; t<taps.first[i+1]; t++)
+		sum = _mm_add_ps(sum, _mm_mul_ps(_mm_set1_ps(taps.weight[t]), _mm_loadu_ps(in + taps.source[t] * stride)));
+	_mm_storeu_ps(out, sum);
+#else
+	float sum[4] = { 0, 0, 0, 0 };
+	for (unsigned int t=taps.first[i]; t<taps.first[i+1]; t++){
+		const float * p = in + taps.source[t] * stride;
+		for (int c=0; c<4; c++)
+			sum[c] += taps.weight[t] * p[c];
+	}
+	memcpy(out, sum, sizeof(sum));
+#endif
+}
+
+struct MipmapPass{
+	const float * in;
+	float * temp;
+	float * out;
+	unsigned int inWidth, inHeight, outWidth, outHeight;
+	const FilterTaps * horizontal;
+	const FilterTaps * vertical;
+	bool normalMap;
+};
+
+static void filterRowsHorizontally(const MipmapPass * pass, unsigned int firstRow, unsigned int lastRow){
+	for (unsigned int y=firstRow; y<lastRow; y++){
+		const float * in = pass->in + (size_t)y * pass->inWidth * 4;
+		float * out = pass->temp + (size_t)y * pass->outWidth * 4;
+		for (unsigned int x=0; x<pass->outWidth; x++)
+			filterPixel(in, 4, *pass->horizontal, x, out + x*4);
+	}
+}
+
+static void filterRowsVertically(const MipmapPass * pass, unsigned int firstRow, unsigned int lastRow){
+	size_t stride = (size_t)pass->outWidth * 4;
+	for (unsigned int y=firstRow; y<lastRow; y++){
+		for (unsigned int x=0; x<pass->outWidth; x++){
+			float * p = pass->out + y * stride + x*4;
+			filterPixel(pass->temp + x*4, stride, *pass->vertical, y, p);
+
+			// Sharp filters overshoot a bit
+			float lo = pass->normalMap ? -1.0f : 0.0f;
+			for (int c=0; c<4; c++){
+				float l = c == 3 ? 0.0f : lo;
+				p[c] = p[c] < l ? l : (p[c] > 1.0f ? 1.0f : p[c]);
+			}
+			if (pass->normalMap){
+				float length = sqrtf(p[0]*p[0] + p[1]*p[1] + p[2]*p[2]);
+				if (length > 1e-6f){
+					p[0] /= length; p[1] /= length; p[2] /= length;
+				}else{
+					p[0] = 0.0f; p[1] = 0.0f; p[2] = 1.0f;
+				}
+			}
+		}
+	}
+}
+
+static void runOnRows(void (*function)(const MipmapPass *, unsigned int, unsigned int), const MipmapPass * pass,
+	unsigned int rowCount, unsigned int threadCount){
+	// Not worth starting threads for the small levels
+	unsigned int maxThreads = (unsigned int)((size_t)rowCount * pass->outWidth / 4096);
+	if (threadCount > maxThreads) threadCount = maxThreads;
+	if (threadCount < 1)          threadCount = 1;
+
+	std::vector<std::thread> threads;
+	for (unsigned int t=1; t<threadCount; t++)
+		threads.push_back(std::thread(function, pass, rowCount * t / threadCount, rowCount * (t+1) / threadCount));
+	function(pass, 0, rowCount / threadCount);
+	for (size_t t=0; t<threads.size(); t++)
+		threads[t].join();
+}
+
+#define LINEAR_TO_SRGB_SIZE 4096
+
+// Built once, the first time they are needed (C++11 makes this thread safe)
+struct SRGBTables{
+	float toLinear[256];
+	unsigned char fromLinear[LINEAR_TO_SRGB_SIZE];
+
+	SRGBTables(){
+		for (int i=0; i<256; i++){
+			float c = i / 255.0f;
+			toLinear[i] = c <= 0.04045f ? c / 12.92f : powf((c + 0.055f) / 1.055f, 2.4f);
+		}
+		for (int i=0; i<LINEAR_TO_SRGB_SIZE; i++){
+			float l = (float)i / (LINEAR_TO_SRGB_SIZE - 1);
+			float c = l <= 0.0031308f ? l * 12.92f : 1.055f * powf(l, 1.0f / 2.4f) - 0.055f;
+			fromLinear[i] = (unsigned char)(c * 255.0f + 0.5f);
+		}
+	}
+};
+
+static const SRGBTables & srgbTables(){
+	static SRGBTables tables;
+	return tables;
+}
+
+static void bytesToFloats(const unsigned char * in, size_t pixelCount, const MipmapOptions & options, float * out){
+	const float * srgbToLinear = srgbTables().toLinear;
+	for (size_t i=0; i<pixelCount*4; i++){
+		if (i % 4 == 3)
+			out[i] = in[i] / 255.0f;
+		else if (options.normalMap)
+			out[i] = in[i] / 127.5f - 1.0f;
+		else if (options.srgb)
+			out[i] = srgbToLinear[in[i]];
+		else
+			out[i] = in[i] / 255.0f;
+	}
+}
+
+static void floatsToBytes(const float * in, size_t pixelCount, const MipmapOptions & options, unsigned char * out){
+	const unsigned char * linearToSRGB = srgbTables().fromLinear;
+	for (size_t i=0; i<pixelCount*4; i++){
+		if (i % 4 == 3)
+			out[i] = (unsigned char)(in[i] * 255.0f + 0.5f);
+		else if (options.normalMap)
+			out[i] = (unsigned char)((in[i] + 1.0f) * 127.5f + 0.5f);
+		else if (options.srgb)
+			out[i] = linearToSRGB[(int)(in[i] * (LINEAR_TO_SRGB_SIZE - 1) + 0.5f)];
+		else
+			out[i] = (unsigned char)(in[i] * 255.0f + 0.5f);
+	}
+}
+
+void generateMipmapChain(
+	const unsigned char * pixels, unsigned int width, unsigned int height,
+	const MipmapOptions & options,
+	std::vector<std::vector<unsigned char> > & out_levels
+){
+	out_levels.clear();
+	if (width == 0 || height == 0)
+		return;
+	unsigned int threadCount = options.threadCount ? options.threadCount : std::thread::hardware_concurrency();
+
+	out_levels.push_back(std::vector<unsigned char>(pixels, pixels + (size_t)width * height * 4));
+
+	std::vector<float> current((size_t)width * height * 4), temp, next;
+	bytesToFloats(pixels, (size_t)width * height, options, &current[0]);
+
+	FilterTaps horizontal, vertical;
+	while (width > 1 || height > 1){
+		unsigned int outWidth  = width  > 1 ? width  / 2 : 1;
+		unsigned int outHeight = height > 1 ? height / 2 : 1;
+		buildFilterTaps(width, outWidth, options, horizontal);
+		buildFilterTaps(height, outHeight, options, vertical);
+		temp.resize((size_t)outWidth * height * 4);
+		next.resize((size_t)outWidth * outHeight * 4);
+
+		MipmapPass pass;
+		pass.in = &current[0];
+		pass.temp = &temp[0];
+		pass.out = &next[0];
+		pass.inWidth = width;
+		pass.inHeight = height;
+		pass.outWidth = outWidth;
+		pass.outHeight = outHeight;
+		pass.horizontal = &horizontal;
+		pass.vertical = &vertical;
+		pass.normalMap = options.normalMap;
+		runOnRows(filterRowsHorizontally, &pass, height, threadCount);
+		runOnRows(filterRowsVertically, &pass, outHeight, threadCount);
+
+		out_levels.push_back(std::vector<unsigned char>((size_t)outWidth * outHeight * 4));
+		floatsToBytes(&next[0], (size_t)outWidth * outHeight, options, &out_levels.back()[0]);
+
+		current.swap(next);
+		width = outWidth;
+		height = outHeight;
+	}
+}
+
+bool generateTextureMipmaps(TextureImage & image, const MipmapOptions & options){
+	if (image.compressed || image.levels.size() != 1 || image.type != GL_UNSIGNED_BYTE ||
+	    (image.format != GL_BGR && image.format != GL_BGRA))
+		return false;
+
+	// To 4 channels
+	unsigned int bytesPerPixel = image.blockSize;
+	size_t pixelCount = (size_t)image.width * image.height;
+	std::vector<unsigned char> bgra(pixelCount * 4);
+	const unsigned char * in = image.levels[0].data;
+	for (size_t i=0; i<pixelCount; i++){
+		bgra[i*4+0] = in[i*bytesPerPixel+0];
+		bgra[i*4+1] = in[i*bytesPerPixel+1];
+		bgra[i*4+2] = in[i*bytesPerPixel+2];
+		bgra[i*4+3] = bytesPerPixel == 4 ? in[i*bytesPerPixel+3] : 255;
+	}
+
+	std::vector<std::vector<unsigned char> > levels;
+	generateMipmapChain(pixelCount ? &bgra[0] : NULL, image.width, image.height, options, levels);
+
+	size_t totalSize = 0;
+	for (size_t l=0; l<levels.size(); l++)
+		totalSize += levels[l].size();
+	image.pixels.resize(totalSize);
+	image.levels.resize(levels.size());
+	size_t offset = 0;
+	for (size_t l=0; l<levels.size(); l++){
+		TextureLevel & level = image.levels[l];
+		level.width  = image.width  >> l; if (level.width  < 1) level.width  = 1;
+		level.height = image.height >> l; if (level.height < 1) level.height = 1;
+		level.size = levels[l].size();
+		level.data = &image.pixels[offset];
+		memcpy(&image.pixels[offset], &levels[l][0], level.size);
+		offset += level.size;
+	}
+	image.levelCount = (unsigned int)levels.size();
+	image.blockSize = 4;
+	image.format = GL_BGRA;
+	image.generateMipmaps = false;
+	return true;
+}
@@ -0,0 +1,34 @@
+#ifndef MIPMAPGENERATOR_HPP
+#define MIPMAPGENERATOR_HPP
+
+// Builds the mipmaps of an image on the CPU, rather than with glGenerateMipmap,
+// whose filter depends on the driver and which stalls the GL thread.
+
+enum MipmapFilter{
+	MIPMAP_BOX,      // average of 2x2 pixels. Fast, but a bit blurry and aliased
+	MIPMAP_KAISER,   // Kaiser-windowed sinc over 6 pixels. Sharp, little ringing. The best default
+	MIPMAP_LANCZOS   // Lanczos-3. Sharper than Kaiser, but more ringing
+};
+
+struct MipmapOptions{
+	MipmapFilter filter;
+	bool srgb;                // the colors are sRGB-encoded (most photos and paintings) : average them in linear space
+	bool normalMap;           // RGB is a normal, mapped from [-1,1] to [0,255] : renormalize each level. srgb is ignored
+	bool wrap;                // the texture repeats (GL_REPEAT) : filter across the edges. Otherwise the edges are clamped
+	unsigned int threadCount; // the rows of each level are shared between threadCount threads (0 = one per core)
+};
+
+// Computes all the levels of an image with 4 8-bit channels (alpha last, the order of the others
+// doesn't matter), down to 1x1. out_levels[0] is a copy of the input.
+// Level n is max(1, width >> n) x max(1, height >> n), like OpenGL expects.
+void generateMipmapChain(
+	const unsigned char * pixels, unsigned int width, unsigned int height,
+	const MipmapOptions & options,
+	std::vector<std::vector<unsigned char> > & out_levels
+);
+
+// Replaces the single level of a decoded BMP or TGA image (see textureimage.hpp)
+// by a full mip chain in BGRA, ready for uploadTextureImage or writeDDSImage.
+bool generateTextureMipmaps(TextureImage & image, const MipmapOptions & options);
+
+#endif
\ No newline at end of file
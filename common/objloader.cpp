@@ -2,10 +2,15 @@
 #include <stdio.h>
 #include <string>
 #include <cstring>
+#include <cmath>
+#include <thread>
+#include <functional>
 
 #include <glm/glm.hpp>
 
 #include "objloader.hpp"
+#include "mappedfile.hpp"
+#include "profiler.hpp"
 
 // Very, VERY simple OBJ loader.
 // Here is a short list of features a real function would provide : 
@@ -23,6 +28,7 @@ bool loadOBJ(
 	std::vector<glm::vec2> & out_uvs,
 	std::vector<glm::vec3> & out_normals
 ){
+	PROFILE_SCOPE("loadOBJ");
 	printf("Loading OBJ file %s...\n", path);
 
 	std::vector<unsigned int> vertexIndices, uvIndices, normalIndices;
@@ -111,6 +117,427 @@ bool loadOBJ(
 }
 
 
+// Faster OBJ loader.
+// Same output as loadOBJ(), but the file is mapped in memory instead of being read
+// with fscanf(), and numbers are parsed by hand directly in the mapped bytes.
+// Also accepts every face format ("v", "v/vt", "v//vn", "v/vt/vn"), negative
+// (relative) indices and polygons with more than 3 vertices (they are triangulated as fans).
+// Missing UVs and normals are set to 0.
+// Big files are split in chunks (at line boundaries) which are parsed in parallel;
+// the result doesn't depend on the number of threads.
+
+static inline bool isBlank(char c){
+	return c == ' ' || c == '\t' || c == '\r';
+}
+
+static inline const char * skipBlanks(const char * p, const char * end){
+	while (p < end && isBlank(*p))
+		p++;
+	return p;
+}
+
+static inline const char * skipLine(const char * p, const char * end){
+	const char * eol = (const char *)memchr(p, '\n', end - p);
+	return eol ? eol + 1 : end;
+}
+
+// Exact powers of ten as doubles. Beyond 1e22 they can't be represented exactly anyway.
+static const double powersOf10[] = {
+	1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,  1e8,  1e9,  1e10, 1e11,
+	1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+};
+
+// Parses a float like "-1.5", "3", ".25" or "1.0e-3" at p.
+// Returns a pointer after the number, or NULL if there is no number there.
+static const char * parseFloat(const char * p, const char * end, float & out){
+	p = skipBlanks(p, end);
+
+	bool negative = false;
+	if (p < end && (*p == '-' || *p == '+')){
+		negative = (*p == '-');
+		p++;
+	}
+
+	unsigned long long mantissa = 0;
+	int exponent = 0;
+	int digits = 0;
+	bool any = false;
+
+	// Integer part. After 19 digits the mantissa would overflow : only keep the magnitude.
+	while (p < end && *p >= '0' && *p <= '9'){
+		if (digits < 19){
+			mantissa = mantissa * 10 + (*p - '0');
+			if (mantissa) digits++;
+		}else{
+			exponent++;
+		}
+		any = true;
+		p++;
+	}
+	// Fractional part
+	if (p < end && *p == '.'){
+		p++;
+		while (p < end && *p >= '0' && *p <= '9'){
+			if (digits < 19){
+				mantissa = mantissa * 10 + (*p - '0');
+				if (mantissa) digits++;
+				exponent--;
+			}
+			any = true;
+			p++;
+		}
+	}
+	if (!any)
+		return NULL;
+
+	// Exponent
+	if (p < end && (*p == 'e' || *p == 'E')){
+		const char * q = p + 1;
+		bool negativeExponent = false;
+		if (q < end && (*q == '-' || *q == '+')){
+			negativeExponent = (*q == '-');
+			q++;
+		}
+		if (q < end && *q >= '0' && *q <= '9'){
+			int e = 0;
+			while (q < end && *q >= '0' && *q <= '9'){
+				if (e < 10000) e = e * 10 + (*q - '0');
+				q++;
+			}
+			exponent += negativeExponent ? -e : e;
+			p = q;
+		}
+	}
+
+	double value = (double)mantissa;
+	if (mantissa != 0 && exponent != 0){
+		if (exponent > 0)
+			value *= exponent <= 22 ? powersOf10[exponent] : pow(10.0, exponent);
+		else
+			value /= exponent >= -22 ? powersOf10[-exponent] : pow(10.0, -exponent);
+	}
+	out = (float)(negative ? -value : value);
+	return p;
+}
+
+// Parses a (possibly negative) integer at p. Doesn't skip blanks.
+static const char * parseInt(const char * p, const char * end, int & out){
+	bool negative = false;
+	if (p < end && (*p == '-' || *p == '+')){
+		negative = (*p == '-');
+		p++;
+	}
+	if (p >= end || *p < '0' || *p > '9')
+		return NULL;
+	int value = 0;
+	while (p < end && *p >= '0' && *p <= '9'){
+		value = value * 10 + (*p - '0');
+		p++;
+	}
+	out = negative ? -value : value;
+	return p;
+}
+
+// Parses one face corner : "v", "v/vt", "v//vn" or "v/vt/vn".
+// Indices which are not present are set to 0.
+static const char * parseFaceCorner(const char * p, const char * end, int & v, int & vt, int & vn){
+	v = vt = vn = 0;
+	p = parseInt(p, end, v);
+	if (!p)
+		return NULL;
+	if (p < end && *p == '/'){
+		p++;
+		if (p < end && *p != '/'){
+			p = parseInt(p, end, vt);
+			if (!p)
+				return NULL;
+		}
+		if (p < end && *p == '/'){
+			p++;
+			p = parseInt(p, end, vn);
+			if (!p)
+				return NULL;
+		}
+	}
+	return p;
+}
+
+// Everything parsed from a range of lines of the file.
+// The file can be split in several chunks, parsed independently, and merged afterwards.
+struct OBJChunk{
+	std::vector<glm::vec3> vertices;
+	std::vector<glm::vec2> uvs;
+	std::vector<glm::vec3> normals;
+
+	// 3 ints (vertex, uv and normal index) per triangle corner.
+	// - positive 1-based indices are absolute and stored as 0-based indices,
+	// - negative indices are relative to what was parsed before. We don't know yet how many
+	//   vertices the previous chunks contain, so they are stored relative to the beginning
+	//   of this chunk (they can be < 0 if they point into a previous chunk), and the 
+	//   corresponding bit is set in relativeMask,
+	// - absent indices are -1.
+	std::vector<int> corners;
+	std::vector<unsigned char> relativeMask; // one per corner
+
+	unsigned int lineCount;
+	unsigned int errorLine; // 0 if OK
+};
+
+static inline void storeIndex(int index, size_t localCount, int bit, int & out, unsigned char & mask){
+	if (index > 0){
+		out = index - 1;
+	}else if (index < 0){
+		out = (int)localCount + index;
+		mask |= bit;
+	}else{
+		out = -1;
+	}
+}
+
+static void parseOBJChunk(const char * p, const char * end, OBJChunk & chunk){
+	chunk.lineCount = 0;
+	chunk.errorLine = 0;
+
+	while (p < end){
+		chunk.lineCount++;
+		p = skipBlanks(p, end);
+		if (p >= end)
+			break;
+
+		bool ok = true;
+		if (p[0] == 'v' && p+1 < end && isBlank(p[1])){
+			glm::vec3 vertex;
+			p = parseFloat(p+1, end, vertex.x);
+			if (p) p = parseFloat(p, end, vertex.y);
+			if (p) p = parseFloat(p, end, vertex.z);
+			if (p) chunk.vertices.push_back(vertex);
+			ok = (p != NULL);
+		}else if (p[0] == 'v' && p+2 < end && p[1] == 't' && isBlank(p[2])){
+			glm::vec2 uv;
+			p = parseFloat(p+2, end, uv.x);
+			if (p) p = parseFloat(p, end, uv.y);
+			uv.y = -uv.y; // Same as loadOBJ() : we only use DDS textures, which are inverted.
+			if (p) chunk.uvs.push_back(uv);
+			ok = (p != NULL);
+		}else if (p[0] == 'v' && p+2 < end && p[1] == 'n' && isBlank(p[2])){
+			glm::vec3 normal;
+			p = parseFloat(p+2, end, normal.x);
+			if (p) p = parseFloat(p, end, normal.y);
+			if (p) p = parseFloat(p, end, normal.z);
+			if (p) chunk.normals.push_back(normal);
+			ok = (p != NULL);
+		}else if (p[0] == 'f' && p+1 < end && isBlank(p[1])){
+			p++;
+			int first[3], previous[3];
+			unsigned char firstMask = 0, previousMask = 0;
+			int count = 0;
+			while (1){
+				p = skipBlanks(p, end);
+				if (p >= end || *p == '\n' || *p == '#')
+					break;
+				int v, vt, vn;
+				p = parseFaceCorner(p, end, v, vt, vn);
+				if (!p)
+					break;
+				int current[3];
+				unsigned char currentMask = 0;
+				storeIndex(v,  chunk.vertices.size(), 1, current[0], currentMask);
+				storeIndex(vt, chunk.uvs     .size(), 2, current[1], currentMask);
+				storeIndex(vn, chunk.normals .size(), 4, current[2], currentMask);
+				if (count >= 2){
+					// Fan triangulation : (0, i-1, i)
+					chunk.corners.insert(chunk.corners.end(), first,    first+3);
+					chunk.corners.insert(chunk.corners.end(), previous, previous+3);
+					chunk.corners.insert(chunk.corners.end(), current,  current+3);
+					chunk.relativeMask.push_back(firstMask);
+					chunk.relativeMask.push_back(previousMask);
+					chunk.relativeMask.push_back(currentMask);
+				}
+				if (count == 0){
+					memcpy(first, current, sizeof(first));
+					firstMask = currentMask;
+				}
+				memcpy(previous, current, sizeof(previous));
+				previousMask = currentMask;
+				count++;
+			}
+			ok = (p != NULL && count >= 3);
+		}
+		if (!ok){
+			chunk.errorLine = chunk.lineCount;
+			return;
+		}
+		// Anything else (comments, groups, materials, ...) is ignored.
+		// This also eats the rest of the lines we just parsed.
+		p = skipLine(p, end);
+	}
+}
+
+// Writes the triangle corners of one chunk at their final place in the output arrays.
+// baseXXX = number of vertices/uvs/normals in all the previous chunks.
+// Returns false if a face references something which doesn't exist.
+static bool expandOBJChunk(
+	const OBJChunk & chunk,
+	int baseVertex, int baseUV, int baseNormal,
+	const std::vector<glm::vec3> & all_vertices,
+	const std::vector<glm::vec2> & all_uvs,
+	const std::vector<glm::vec3> & all_normals,
+	glm::vec3 * out_vertices,
+	glm::vec2 * out_uvs,
+	glm::vec3 * out_normals
+){
+	for (size_t i=0; i<chunk.relativeMask.size(); i++){
+		int vertexIndex = chunk.corners[3*i+0];
+		int uvIndex     = chunk.corners[3*i+1];
+		int normalIndex = chunk.corners[3*i+2];
+		unsigned char mask = chunk.relativeMask[i];
+		if (mask & 1) vertexIndex += baseVertex;
+		if (mask & 2) uvIndex     += baseUV;
+		if (mask & 4) normalIndex += baseNormal;
+
+		// A relative index can't point to something absent : make sure it doesn't end up at -1.
+		if (vertexIndex < 0 || vertexIndex >= (int)all_vertices.size() ||
+		    uvIndex < ((mask & 2) ? 0 : -1) || uvIndex >= (int)all_uvs.size() ||
+		    normalIndex < ((mask & 4) ? 0 : -1) || normalIndex >= (int)all_normals.size())
+			return false;
+
+		out_vertices[i] = all_vertices[vertexIndex];
+		out_uvs     [i] = uvIndex     >= 0 ? all_uvs    [uvIndex]     : glm::vec2(0.0f);
+		out_normals [i] = normalIndex >= 0 ? all_normals[normalIndex] : glm::vec3(0.0f);
+	}
+	return true;
+}
+
+bool loadOBJ_fast(
+	const char * path, 
+	std::vector<glm::vec3> & out_vertices, 
+	std::vector<glm::vec2> & out_uvs,
+	std::vector<glm::vec3> & out_normals,
+	unsigned int threadCount
+){
+	PROFILE_SCOPE("loadOBJ_fast");
+	printf("Loading OBJ file %s...\n", path);
+
+	MappedFile file;
+	if (!mapFile(path, file)){
+		printf("Impossible to open the file ! Are you in the right path ? See Tutorial 1 for details\n");
+		getchar();
+		return false;
+	}
+
+	const char * begin = (const char *)file.data;
+	const char * end   = begin + file.size;
+
+	if (threadCount == 0)
+		threadCount = std::thread::hardware_concurrency();
+	// Not worth starting threads for small files
+	const size_t minChunkSize = 1 << 20;
+	if (threadCount > file.size / minChunkSize)
+		threadCount = (unsigned int)(file.size / minChunkSize);
+	if (threadCount < 1)
+		threadCount = 1;
+
+	// Split the file in threadCount chunks of roughly equal size, at line boundaries
+	std::vector<const char *> boundaries(threadCount + 1);
+	boundaries[0] = begin;
+	boundaries[threadCount] = end;
+	for (unsigned int i=1; i<threadCount; i++){
+		const char * p = begin + file.size / threadCount * i;
+		if (p < boundaries[i-1])
+			p = boundaries[i-1];
+		boundaries[i] = skipLine(p, end);
+	}
+
+	// Parse each chunk in its own thread. The calling thread parses the first one.
+	std::vector<OBJChunk> chunks(threadCount);
+	std::vector<std::thread> threads;
+	for (unsigned int i=1; i<threadCount; i++)
+		threads.push_back(std::thread(parseOBJChunk, boundaries[i], boundaries[i+1], std::ref(chunks[i])));
+	parseOBJChunk(boundaries[0], boundaries[1], chunks[0]);
+	for (size_t i=0; i<threads.size(); i++)
+		threads[i].join();
+	threads.clear();
+
+	unmapFile(file);
+
+	// Prefix sums : where the data of each chunk begins in the merged arrays
+	std::vector<int> baseVertex(threadCount), baseUV(threadCount), baseNormal(threadCount);
+	std::vector<size_t> baseCorner(threadCount);
+	size_t vertexCount = 0, uvCount = 0, normalCount = 0, cornerCount = 0;
+	unsigned int lineCount = 0;
+	for (unsigned int i=0; i<threadCount; i++){
+		if (chunks[i].errorLine != 0){
+			printf("%s, line %u : can't be read by our parser :-(\n", path, lineCount + chunks[i].errorLine);
+			return false;
+		}
+		lineCount += chunks[i].lineCount;
+
+		baseVertex[i] = (int)vertexCount;
+		baseUV    [i] = (int)uvCount;
+		baseNormal[i] = (int)normalCount;
+		baseCorner[i] = cornerCount;
+		vertexCount += chunks[i].vertices.size();
+		uvCount     += chunks[i].uvs     .size();
+		normalCount += chunks[i].normals .size();
+		cornerCount += chunks[i].relativeMask.size();
+	}
+
+	// Merge the attributes, in file order
+	std::vector<glm::vec3> temp_vertices; 
+	std::vector<glm::vec2> temp_uvs;
+	std::vector<glm::vec3> temp_normals;
+	temp_vertices.reserve(vertexCount);
+	temp_uvs     .reserve(uvCount);
+	temp_normals .reserve(normalCount);
+	for (unsigned int i=0; i<threadCount; i++){
+		temp_vertices.insert(temp_vertices.end(), chunks[i].vertices.begin(), chunks[i].vertices.end());
+		temp_uvs     .insert(temp_uvs     .end(), chunks[i].uvs     .begin(), chunks[i].uvs     .end());
+		temp_normals .insert(temp_normals .end(), chunks[i].normals .begin(), chunks[i].normals .end());
+		// Not needed anymore
+		std::vector<glm::vec3>().swap(chunks[i].vertices);
+		std::vector<glm::vec2>().swap(chunks[i].uvs);
+		std::vector<glm::vec3>().swap(chunks[i].normals);
+	}
+
+	// For each vertex of each triangle, fetch its attributes.
+	// Each chunk writes to its own part of the output, so this can be done in parallel too.
+	size_t outBase = out_vertices.size();
+	out_vertices.resize(outBase + cornerCount);
+	out_uvs     .resize(outBase + cornerCount);
+	out_normals .resize(outBase + cornerCount);
+	std::vector<char> expanded(threadCount);
+	for (unsigned int i=0; i<threadCount; i++){
+		size_t o = outBase + baseCorner[i];
+		if (chunks[i].relativeMask.empty()){
+			expanded[i] = true;
+			continue;
+		}
+		if (i+1 == threadCount || threadCount == 1){
+			expanded[i] = expandOBJChunk(chunks[i], baseVertex[i], baseUV[i], baseNormal[i],
+				temp_vertices, temp_uvs, temp_normals, &out_vertices[o], &out_uvs[o], &out_normals[o]);
+		}else{
+			threads.push_back(std::thread([&, i, o](){
+				expanded[i] = expandOBJChunk(chunks[i], baseVertex[i], baseUV[i], baseNormal[i],
+					temp_vertices, temp_uvs, temp_normals, &out_vertices[o], &out_uvs[o], &out_normals[o]);
+			}));
+		}
+	}
+	for (size_t i=0; i<threads.size(); i++)
+		threads[i].join();
+
+	for (unsigned int i=0; i<threadCount; i++){
+		if (!expanded[i]){
+			printf("%s : a face references a vertex which doesn't exist\n", path);
+			out_vertices.resize(outBase);
+			out_uvs     .resize(outBase);
+			out_normals .resize(outBase);
+			return false;
+		}
+	}
+	return true;
+}
+
+
 #ifdef USE_ASSIMP // don't use this #define, it's only for me (it AssImp fails to compile on your machine, at least all the other tutorials still work)
 
 // Include AssImp
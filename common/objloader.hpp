@@ -8,6 +8,17 @@ bool loadOBJ(
 	std::vector<glm::vec3> & out_normals
 );
 
+// Same as loadOBJ, but much faster on big files, and understands more of the OBJ format
+// (all face formats, negative indices, polygons).
+// threadCount : how many threads can be used to parse the file. 0 means one per core.
+// The output is exactly the same whatever the number of threads.
+bool loadOBJ_fast(
+	const char * path, 
+	std::vector<glm::vec3> & out_vertices, 
+	std::vector<glm::vec2> & out_uvs, 
+	std::vector<glm::vec3> & out_normals,
+	unsigned int threadCount = 1
+);
 
 
 bool loadAssImp(
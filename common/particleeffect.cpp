@@ -0,0 +1,218 @@
+#include <vector>
+#include <algorithm>
+
+#include <glm/glm.hpp>
+#include <glm/gtx/norm.hpp>
+
+#include "particlesystem.hpp"
+#include "particleeffect.hpp"
+#include "jobpool.hpp"
+#include "profiler.hpp"
+
+// The same sequence for a given seed, on all platforms
+static unsigned int nextEffectRandom(unsigned int & state){
+	state = state * 1664525u + 1013904223u;
+	return state >> 8;
+}
+
+// A different sequence for each emitter of each seed
+static unsigned int emitterRandomState(unsigned int seed, unsigned int emitter){
+	unsigned int x = seed ^ (emitter * 0x9E3779B9u);
+	x ^= x >> 16;
+	x *= 0x85EBCA6Bu;
+	x ^= x >> 13;
+	x *= 0xC2B2AE35u;
+	x ^= x >> 16;
+	return x;
+}
+
+void initParticleEffect(ParticleEffect & effect, JobPool * pool, unsigned int seed){
+	effect.emitters.clear();
+	effect.pool = pool;
+	effect.chunkSize = 16384;
+	effect.seed = seed;
+	for (int b=0; b<2; b++){
+		effect.positionSize[b].clear();
+		effect.color[b].clear();
+		effect.vertexCount[b] = 0;
+	}
+	effect.writeBuffer = 0;
+	effect.writePositionSize = NULL;
+	effect.writeColor = NULL;
+	effect.drawPositionSize = NULL;
+	effect.drawColor = NULL;
+	effect.running = false;
+	effect.batch = 0;
+	effect.delta = 0.0f;
+	effect.cameraPosition = glm::vec3(0.0f);
+}
+
+unsigned int addParticleEmitter(ParticleEffect & effect, const ParticleEmitterSettings & settings){
+	unsigned int index = (unsigned int)effect.emitters.size();
+	effect.emitters.push_back(ParticleEmitter());
+	ParticleEmitter & emitter = effect.emitters.back();
+	emitter.settings = settings;
+	initParticleSystem(emitter.particles, settings.capacity);
+	emitter.particles.pool = effect.pool; // sortEmitterJob waits for the slices of the radix sort on the same pool
+	emitter.randomState = emitterRandomState(effect.seed, index);
+	emitter.spawnDebt = 0.0f;
+	emitter.cameraDistance = 0.0f;
+	emitter.firstVertex = 0;
+	return index;
+}
+
+unsigned int particleEffectCapacity(const ParticleEffect & effect){
+	unsigned int capacity = 0;
+	for (size_t e=0; e<effect.emitters.size(); e++)
+		capacity += effect.emitters[e].settings.capacity;
+	return capacity;
+}
+
+// The emission of tutorial18_particles, with the settings of the emitter
+static void spawnEmitterJob(void * data, unsigned int e){
+	ParticleEffect & effect = *(ParticleEffect *)data;
+	ParticleEmitter & emitter = effect.emitters[e];
+	const ParticleEmitterSettings & settings = emitter.settings;
+
+	emitter.spawnDebt += settings.particlesPerSecond * std::min(effect.delta, 0.016f);
+	unsigned int count = (unsigned int)emitter.spawnDebt;
+	emitter.spawnDebt -= count;
+	unsigned int & state = emitter.randomState;
+	for (unsigned int i=0; i<count; i++){
+		glm::vec3 randomdir = glm::vec3(
+			(nextEffectRandom(state)%2000 - 1000.0f)/1000.0f,
+			(nextEffectRandom(state)%2000 - 1000.0f)/1000.0f,
+			(nextEffectRandom(state)%2000 - 1000.0f)/1000.0f
+		);
+		unsigned char color[4];
+		color[0] = nextEffectRandom(state) % 256;
+		color[1] = nextEffectRandom(state) % 256;
+		color[2] = nextEffectRandom(state) % 256;
+		color[3] = (nextEffectRandom(state) % 256) / 3;
+		float size = settings.minSize + (settings.maxSize - settings.minSize) * (nextEffectRandom(state)%1000)/1000.0f;
+		spawnParticle(emitter.particles, settings.position, settings.direction + randomdir * settings.spread, settings.life, size, color);
+	}
+}
+
+static void simulateChunkJob(void * data, unsigned int c){
+	ParticleEffect & effect = *(ParticleEffect *)data;
+	const ParticleChunk & chunk = effect.chunks[c];
+	simulateParticles(effect.emitters[chunk.emitter].particles, chunk.begin, chunk.end, effect.delta, effect.cameraPosition);
+}
+
+static void sortEmitterJob(void * data, unsigned int e){
+	ParticleEffect & effect = *(ParticleEffect *)data;
+	removeDeadParticles(effect.emitters[e].particles);
+	sortParticles(effect.emitters[e].particles);
+}
+
+static void writeChunkJob(void * data, unsigned int c){
+	ParticleEffect & effect = *(ParticleEffect *)data;
+	const ParticleChunk & chunk = effect.chunks[c];
+	const ParticleEmitter & emitter = effect.emitters[chunk.emitter];
+	size_t vertex = emitter.firstVertex + chunk.begin;
+	writeParticleVertexRange(emitter.particles, chunk.begin, chunk.end,
+		effect.writePositionSize + 4 * vertex, effect.writeColor + 4 * vertex);
+}
+
+static void splitIntoChunks(ParticleEffect & effect){
+	effect.chunks.clear();
+	for (unsigned int e=0; e<effect.emitters.size(); e++){
+		unsigned int count = effect.emitters[e].particles.aliveCount;
+		for (unsigned int begin=0; begin<count; begin+=effect.chunkSize){
+			ParticleChunk chunk;
+			chunk.emitter = e;
+			chunk.begin = begin;
+			chunk.end = std::min(begin + effect.chunkSize, count);
+			effect.chunks.push_back(chunk);
+		}
+	}
+}
+
+// Far emitters first, and the first added first when they are as far : the same order on all the threads
+struct FartherEmitter{
+	const ParticleEffect * effect;
+	bool operator()(unsigned int a, unsigned int b) const {
+		float distanceA = effect->emitters[a].cameraDistance;
+		float distanceB = effect->emitters[b].cameraDistance;
+		return distanceA != distanceB ? distanceA > distanceB : a < b;
+	}
+};
+
+// The whole frame, as a job : the calling thread doesn't wait for it
+static void runParticleFrame(void * data, unsigned int){
+	PROFILE_SCOPE("particle frame");
+	ParticleEffect & effect = *(ParticleEffect *)data;
+	unsigned int emitterCount = (unsigned int)effect.emitters.size();
+
+	runJobs(effect.pool, spawnEmitterJob, &effect, emitterCount);
+	splitIntoChunks(effect);
+	runJobs(effect.pool, simulateChunkJob, &effect, (unsigned int)effect.chunks.size());
+	runJobs(effect.pool, sortEmitterJob, &effect, emitterCount);
+
+	// Each emitter is drawn after those behind it. The particles of emitters which overlap
+	// aren't blended in the right order, but there are no seams between chunks.
+	effect.order.resize(emitterCount);
+	for (unsigned int e=0; e<emitterCount; e++){
+		effect.emitters[e].cameraDistance = glm::length2(effect.emitters[e].settings.position - effect.cameraPosition);
+		effect.order[e] = e;
+	}
+	FartherEmitter farther;
+	farther.effect = &effect;
+	std::sort(effect.order.begin(), effect.order.end(), farther);
+	unsigned int vertexCount = 0;
+	for (unsigned int k=0; k<emitterCount; k++){
+		ParticleEmitter & emitter = effect.emitters[effect.order[k]];
+		emitter.firstVertex = vertexCount;
+		vertexCount += emitter.particles.aliveCount;
+	}
+	effect.vertexCount[effect.writeBuffer] = vertexCount;
+
+	splitIntoChunks(effect);
+	runJobs(effect.pool, writeChunkJob, &effect, (unsigned int)effect.chunks.size());
+}
+
+void beginParticleFrameInto(ParticleEffect & effect, float delta, const glm::vec3 & cameraPosition,
+	float * out_positionSize, unsigned char * out_color){
+	if (effect.running)
+		finishParticleFrame(effect, NULL, NULL);
+	effect.writePositionSize = out_positionSize;
+	effect.writeColor = out_color;
+	effect.delta = delta;
+	effect.cameraPosition = cameraPosition;
+	effect.running = true;
+	if (effect.pool)
+		effect.batch = submitJobs(effect.pool, runParticleFrame, &effect, 1);
+	else
+		runParticleFrame(&effect, 0);
+}
+
+void beginParticleFrame(ParticleEffect & effect, float delta, const glm::vec3 & cameraPosition){
+	// Room for all the particles of all the emitters. The other buffer may still be drawn.
+	std::vector<float> & positionSize = effect.positionSize[effect.writeBuffer];
+	std::vector<unsigned char> & color = effect.color[effect.writeBuffer];
+	size_t capacity = particleEffectCapacity(effect);
+	if (positionSize.size() < 4 * capacity){
+		positionSize.resize(4 * capacity);
+		color.resize(4 * capacity);
+	}
+	beginParticleFrameInto(effect, delta, cameraPosition,
+		positionSize.empty() ? NULL : &positionSize[0], color.empty() ? NULL : &color[0]);
+}
+
+unsigned int finishParticleFrame(ParticleEffect & effect, const float ** out_positionSize, const unsigned char ** out_color){
+	if (effect.running){
+		PROFILE_SCOPE("wait for particles");
+		waitForJobs(effect.pool, effect.batch);
+		effect.running = false;
+		effect.writeBuffer ^= 1;
+		effect.drawPositionSize = effect.writePositionSize;
+		effect.drawColor = effect.writeColor;
+	}
+	// The last frame : NULL before the first one
+	if (out_positionSize)
+		*out_positionSize = effect.drawPositionSize;
+	if (out_color)
+		*out_color = effect.drawColor;
+	return effect.vertexCount[effect.writeBuffer ^ 1];
+}
@@ -0,0 +1,98 @@
+#ifndef PARTICLEEFFECT_HPP
+#define PARTICLEEFFECT_HPP
+
+// An effect made of several emitters, each with its own ParticleSystem (see particlesystem.hpp),
+// updated by jobs on a JobPool (see jobpool.hpp) while the GL thread draws the previous frame :
+//
+//     finishParticleFrame  : waits for the frame which was simulating, and gives its vertices
+//     beginParticleFrame   : starts simulating the next one, and returns immediately
+//     glBufferSubData, draw the vertices given by finishParticleFrame
+//
+// or, with beginParticleFrameInto, the jobs write the vertices right into a mapped vertex buffer (see streambuffer.hpp).
+//
+// Each frame, one job per emitter spawns its new particles, then jobs of at most chunkSize particles
+// simulate them, one job per emitter removes the dead ones and sorts the others, and jobs of chunkSize
+// particles write them into a single vertex buffer, emitters far ones first. The place of each chunk in
+// the buffer is known beforehand (the sum of the particles before it), so the jobs write without any lock.
+// The results only depend on the seed and on the calls, not on the number of threads, nor on which
+// thread runs which job : each emitter has its own random numbers, and the chunks don't depend on the threads.
+
+struct JobPool;
+
+struct ParticleEmitterSettings{
+	glm::vec3 position;
+	glm::vec3 direction;      // speed of the new particles...
+	float spread;             // ...plus up to 'spread' on each axis, at random
+	float particlesPerSecond;
+	float life;               // in seconds
+	float minSize, maxSize;   // the size of each particle is random, between these two
+	unsigned int capacity;    // at most 'capacity' particles alive : the others aren't spawned
+};
+
+struct ParticleEmitter{
+	ParticleEmitterSettings settings;
+	ParticleSystem particles;
+	unsigned int randomState;
+	float spawnDebt;          // fraction of particle not spawned yet
+	float cameraDistance;     // squared, for the order of the emitters
+	unsigned int firstVertex; // where its particles go in the vertex buffer, this frame
+};
+
+// particles [begin, end) of an emitter
+struct ParticleChunk{
+	unsigned int emitter;
+	unsigned int begin, end;
+};
+
+struct ParticleEffect{
+	std::vector<ParticleEmitter> emitters;
+	JobPool * pool;           // NULL : beginParticleFrame does all the work, on the calling thread
+	unsigned int chunkSize;   // a multiple of 4, for SSE
+	unsigned int seed;
+
+	// x, y, z, size and R, G, B, A of each particle : one frame writes in one buffer while the other one is drawn.
+	// Only allocated by beginParticleFrame : beginParticleFrameInto writes elsewhere.
+	std::vector<float> positionSize[2];
+	std::vector<unsigned char> color[2];
+	unsigned int vertexCount[2];
+	unsigned int writeBuffer;
+	float * writePositionSize;          // where the frame being simulated writes
+	unsigned char * writeColor;
+	const float * drawPositionSize;     // what the last finished frame wrote
+	const unsigned char * drawColor;
+
+	// The frame being simulated
+	bool running;
+	unsigned int batch;
+	float delta;
+	glm::vec3 cameraPosition;
+	std::vector<unsigned int> order;   // of the emitters, far ones first
+	std::vector<ParticleChunk> chunks;
+};
+
+void initParticleEffect(ParticleEffect & effect, JobPool * pool, unsigned int seed);
+
+// Returns the index of the emitter. Not while a frame is running.
+unsigned int addParticleEmitter(ParticleEffect & effect, const ParticleEmitterSettings & settings);
+
+// Starts a frame of delta seconds : spawns, moves, sorts and writes the particles. Like tutorial18_particles,
+// at most 16 ms of particles are spawned, so that a long frame doesn't make the next one even longer.
+// The emitters must not be changed until finishParticleFrame.
+void beginParticleFrame(ParticleEffect & effect, float delta, const glm::vec3 & cameraPosition);
+
+// The same, but the vertices are written to out_positionSize (4 floats per particle) and out_color (4 bytes per particle),
+// which must have room for particleEffectCapacity particles, and stay valid until finishParticleFrame.
+// The worker threads write them : they can be a mapped buffer, not any other GL call.
+void beginParticleFrameInto(ParticleEffect & effect, float delta, const glm::vec3 & cameraPosition,
+	float * out_positionSize, unsigned char * out_color);
+
+// The sum of the capacities of the emitters
+unsigned int particleEffectCapacity(const ParticleEffect & effect);
+
+// Waits for the frame started by beginParticleFrame, and returns its number of particles.
+// Their vertices, 4 floats and 4 bytes per particle, stay valid until the next finishParticleFrame
+// (or, for beginParticleFrameInto, as long as the memory it was given).
+// Must be called before the effect is destroyed.
+unsigned int finishParticleFrame(ParticleEffect & effect, const float ** out_positionSize, const unsigned char ** out_color);
+
+#endif
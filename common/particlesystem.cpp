@@ -0,0 +1,433 @@
+#include <vector>
+#include <algorithm>
+#include <string.h>
+
+#include <glm/glm.hpp>
+#include <glm/gtx/norm.hpp>
+
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#define PARTICLESYSTEM_SSE
+#include <xmmintrin.h>
+#endif
+
+#include "particlesystem.hpp"
+#include "jobpool.hpp"
+
+void initParticleSystem(ParticleSystem & system, unsigned int capacity){
+	system.capacity = capacity;
+	system.positionX.assign(capacity, 0.0f);
+	system.positionY.assign(capacity, 0.0f);
+	system.positionZ.assign(capacity, 0.0f);
+	system.speedX.assign(capacity, 0.0f);
+	system.speedY.assign(capacity, 0.0f);
+	system.speedZ.assign(capacity, 0.0f);
+	system.life.assign(capacity, -1.0f);
+	system.size.assign(capacity, 0.0f);
+	system.color.assign(capacity, 0);
+	system.cameraDistance.assign(capacity, -1.0f);
+	system.aliveCount = 0;
+	system.droppedCount = 0;
+	system.gravity = glm::vec3(0.0f, -9.81f, 0.0f);
+	system.sortMode = PARTICLE_SORT_INCREMENTAL;
+	system.sortFallbacks = 0;
+	system.sortRadixFrames = 0;
+	system.pool = NULL;
+}
+
+unsigned int spawnParticle(ParticleSystem & system, const glm::vec3 & position, const glm::vec3 & speed, float life, float size, const unsigned char color[4]){
+	if (system.aliveCount == system.capacity){
+		system.droppedCount++;
+		return system.capacity;
+	}
+	unsigned int i = system.aliveCount++;
+	system.positionX[i] = position.x;
+	system.positionY[i] = position.y;
+	system.positionZ[i] = position.z;
+	system.speedX[i] = speed.x;
+	system.speedY[i] = speed.y;
+	system.speedZ[i] = speed.z;
+	system.life[i] = life;
+	system.size[i] = size;
+	memcpy(&system.color[i], color, 4);
+	system.cameraDistance[i] = 0.0f;
+	return i;
+}
+
+// The same computations as the SSE version, for particle i
+static void updateParticle(ParticleSystem & system, unsigned int i, float delta, const glm::vec3 & speedDelta, const glm::vec3 & cameraPosition){
+	system.life[i] -= delta;
+
+	// Simulate simple physics : gravity only, no collisions.
+	// Particles which just died move too : it's simpler, and they are removed right after.
+	glm::vec3 speed = glm::vec3(system.speedX[i], system.speedY[i], system.speedZ[i]) + speedDelta;
+	glm::vec3 position = glm::vec3(system.positionX[i], system.positionY[i], system.positionZ[i]) + speed * delta;
+	system.speedX[i] = speed.x;
+	system.speedY[i] = speed.y;
+	system.speedZ[i] = speed.z;
+	system.positionX[i] = position.x;
+	system.positionY[i] = position.y;
+	system.positionZ[i] = position.z;
+	system.cameraDistance[i] = glm::length2(position - cameraPosition);
+}
+
+// Replaces particle i by the last one
+static void removeParticle(ParticleSystem & system, unsigned int i){
+	unsigned int last = --system.aliveCount;
+	system.positionX[i] = system.positionX[last];
+	system.positionY[i] = system.positionY[last];
+	system.positionZ[i] = system.positionZ[last];
+	system.speedX[i] = system.speedX[last];
+	system.speedY[i] = system.speedY[last];
+	system.speedZ[i] = system.speedZ[last];
+	system.life[i] = system.life[last];
+	system.size[i] = system.size[last];
+	system.color[i] = system.color[last];
+	system.cameraDistance[i] = system.cameraDistance[last];
+}
+
+void simulateParticles(ParticleSystem & system, unsigned int begin, unsigned int end, float delta, const glm::vec3 & cameraPosition){
+	glm::vec3 speedDelta = system.gravity * delta * 0.5f;
+
+	unsigned int i = begin;
+#ifdef PARTICLESYSTEM_SSE
+	__m128 delta4 = _mm_set1_ps(delta);
+	__m128 speedDeltaX = _mm_set1_ps(speedDelta.x), speedDeltaY = _mm_set1_ps(speedDelta.y), speedDeltaZ = _mm_set1_ps(speedDelta.z);
+	__m128 cameraX = _mm_set1_ps(cameraPosition.x), cameraY = _mm_set1_ps(cameraPosition.y), cameraZ = _mm_set1_ps(cameraPosition.z);
+	for ( ; i+4<=end; i+=4){
+		_mm_storeu_ps(&system.life[i], _mm_sub_ps(_mm_loadu_ps(&system.life[i]), delta4));
+
+		__m128 speedX = _mm_add_ps(_mm_loadu_ps(&system.speedX[i]), speedDeltaX);
+		__m128 speedY = _mm_add_ps(_mm_loadu_ps(&system.speedY[i]), speedDeltaY);
+		__m128 speedZ = _mm_add_ps(_mm_loadu_ps(&system.speedZ[i]), speedDeltaZ);
+		__m128 positionX = _mm_add_ps(_mm_loadu_ps(&system.positionX[i]), _mm_mul_ps(speedX, delta4));
+		__m128 positionY = _mm_add_ps(_mm_loadu_ps(&system.positionY[i]), _mm_mul_ps(speedY, delta4));
+		__m128 positionZ = _mm_add_ps(_mm_loadu_ps(&system.positionZ[i]), _mm_mul_ps(speedZ, delta4));
+		_mm_storeu_ps(&system.speedX[i], speedX);
+		_mm_storeu_ps(&system.speedY[i], speedY);
+		_mm_storeu_ps(&system.speedZ[i], speedZ);
+		_mm_storeu_ps(&system.positionX[i], positionX);
+		_mm_storeu_ps(&system.positionY[i], positionY);
+		_mm_storeu_ps(&system.positionZ[i], positionZ);
+
+		__m128 dx = _mm_sub_ps(positionX, cameraX);
+		__m128 dy = _mm_sub_ps(positionY, cameraY);
+		__m128 dz = _mm_sub_ps(positionZ, cameraZ);
+		_mm_storeu_ps(&system.cameraDistance[i], _mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)), _mm_mul_ps(dz, dz)));
+	}
+#endif
+	for ( ; i<end; i++)
+		updateParticle(system, i, delta, speedDelta, cameraPosition);
+}
+
+void removeDeadParticles(ParticleSystem & system){
+	// The last particle, which replaces a dead one, must be checked too
+	unsigned int i = 0;
+	while (i < system.aliveCount){
+		if (system.life[i] > 0.0f)
+			i++;
+		else
+			removeParticle(system, i);
+	}
+}
+
+void updateParticles(ParticleSystem & system, float delta, const glm::vec3 & cameraPosition){
+	simulateParticles(system, 0, system.aliveCount, delta, cameraPosition);
+	removeDeadParticles(system);
+}
+
+// Flips the bits of the float so that the unsigned ints are in the same order as the floats (the sign bit of
+// positive floats, all the bits of negative ones), then all of them, so that far particles come first.
+static unsigned int depthKey(float distance){
+	unsigned int bits;
+	memcpy(&bits, &distance, 4);
+	bits ^= (bits & 0x80000000u) ? 0xFFFFFFFFu : 0x80000000u;
+	return ~bits;
+}
+
+static bool smallerKey(const ParticleDepth & a, const ParticleDepth & b){
+	return a.key < b.key;
+}
+
+// The radix sort splits the keys between the threads of the pool in slices of at least this many keys
+static const size_t MinRadixSliceKeys = 16384;
+static const unsigned int MaxRadixSlices = 16;
+
+// One pass of radixSortDepths, on the keys [count * s / sliceCount, count * (s+1) / sliceCount) for slice s.
+// histograms has 4 histograms of 256 counts per slice, one for each byte of the keys.
+struct RadixPass{
+	const ParticleDepth * from;
+	ParticleDepth * to;
+	size_t count;
+	unsigned int sliceCount;
+	int pass;
+	unsigned int * histograms;
+};
+
+static void radixSlice(const RadixPass & radix, unsigned int s, size_t & begin, size_t & end, unsigned int *& histograms){
+	begin = radix.count * s / radix.sliceCount;
+	end = radix.count * (s+1) / radix.sliceCount;
+	histograms = &radix.histograms[s * 4 * 256];
+}
+
+// Pass 0 counts the 4 bytes of the keys of the slice at once. After it, the keys have moved to other
+// slices : the later passes count their own byte again, unless there is a single slice.
+static void countRadixSliceJob(void * data, unsigned int s){
+	const RadixPass & radix = *(const RadixPass *)data;
+	size_t begin, end;
+	unsigned int * histograms;
+	radixSlice(radix, s, begin, end, histograms);
+	if (radix.pass == 0){
+		memset(histograms, 0, 4 * 256 * sizeof(unsigned int));
+		for (size_t k=begin; k<end; k++){
+			unsigned int key = radix.from[k].key;
+			histograms[key & 0xFF]++;
+			histograms[256 + ((key >> 8) & 0xFF)]++;
+			histograms[512 + ((key >> 16) & 0xFF)]++;
+			histograms[768 + (key >> 24)]++;
+		}
+	}else{
+		unsigned int * histogram = &histograms[radix.pass * 256];
+		unsigned int shift = 8 * radix.pass;
+		memset(histogram, 0, 256 * sizeof(unsigned int));
+		for (size_t k=begin; k<end; k++)
+			histogram[(radix.from[k].key >> shift) & 0xFF]++;
+	}
+}
+
+// The histogram of the pass holds where the slice writes its first key of each byte
+static void scatterRadixSliceJob(void * data, unsigned int s){
+	const RadixPass & radix = *(const RadixPass *)data;
+	size_t begin, end;
+	unsigned int * histograms;
+	radixSlice(radix, s, begin, end, histograms);
+	unsigned int * offsets = &histograms[radix.pass * 256];
+	unsigned int shift = 8 * radix.pass;
+	for (size_t k=begin; k<end; k++)
+		radix.to[offsets[(radix.from[k].key >> shift) & 0xFF]++] = radix.from[k];
+}
+
+// Stable, 4 passes of 8 bits, from the lowest ones. The histograms of the 4 passes are counted in a single
+// read of the keys, and a pass is skipped when all the keys have the same byte (often the highest one :
+// the distances are of the same order).
+// With a pool and enough keys, each slice of the keys has its own histograms, on its own thread. The slices
+// of a byte write one after the other, in the order of the slices, so the sort stays stable.
+static void radixSortDepths(std::vector<ParticleDepth> & depths, std::vector<ParticleDepth> & scratch,
+	JobPool * pool, std::vector<unsigned int> & sliceHistograms){
+	size_t count = depths.size();
+	if (count < 2)
+		return;
+	scratch.resize(count);
+
+	unsigned int sliceCount = 1;
+	if (pool){
+		size_t slices = count / MinRadixSliceKeys;
+		unsigned int threads = jobPoolThreadCount(pool) + 1; // the calling thread runs jobs too
+		sliceCount = (unsigned int)std::min(slices, (size_t)std::min(threads, MaxRadixSlices));
+		sliceCount = std::max(sliceCount, 1u);
+	}
+	if (sliceCount == 1)
+		pool = NULL; // no need to wake the workers
+	sliceHistograms.resize(sliceCount * 4 * 256);
+
+	RadixPass radix;
+	radix.from = depths.data();
+	radix.to = scratch.data();
+	radix.count = count;
+	radix.sliceCount = sliceCount;
+	radix.pass = 0;
+	radix.histograms = sliceHistograms.data();
+	runJobs(pool, countRadixSliceJob, &radix, sliceCount);
+
+	// The whole histograms, only to know which passes to skip
+	unsigned int histograms[4][256];
+	memset(histograms, 0, sizeof(histograms));
+	for (unsigned int s=0; s<sliceCount; s++)
+		for (int b=0; b<4 * 256; b++)
+			histograms[b / 256][b % 256] += sliceHistograms[s * 4 * 256 + b];
+
+	ParticleDepth * from = depths.data();
+	ParticleDepth * to = scratch.data();
+	bool counted = true; // the histograms of the slices are those of 'from'
+	for (int pass=0; pass<4; pass++){
+		unsigned int shift = 8 * pass;
+		if (histograms[pass][(from[0].key >> shift) & 0xFF] == count)
+			continue;
+
+		radix.from = from;
+		radix.to = to;
+		radix.pass = pass;
+		if (!counted)
+			runJobs(pool, countRadixSliceJob, &radix, sliceCount);
+		unsigned int offset = 0;
+		for (int b=0; b<256; b++){
+			for (unsigned int s=0; s<sliceCount; s++){
+				unsigned int & histogram = sliceHistograms[(s * 4 + pass) * 256 + b];
+				unsigned int keys = histogram;
+				histogram = offset;
+				offset += keys;
+			}
+		}
+		runJobs(pool, scatterRadixSliceJob, &radix, sliceCount);
+		std::swap(from, to);
+		counted = (sliceCount == 1);
+	}
+	if (from != depths.data())
+		depths.swap(scratch);
+}
+
+// When the particles move little relative to each other from one frame to the next, 'depths' is almost in the
+// order of the previous frame : an insertion sort moves each particle back the few slots it needs. Except
+// the particles which updateParticles moved into the slot of a dead one, and the new ones at the end, which
+// can be anywhere : these are taken out, sorted on their own, and merged back all at once, rather than moving
+// half the array for each one.
+// Returns false if this costs more than 'maxWork' moves : then 'depths' has the same particles, in some order.
+static bool sortAlmostSortedDepths(std::vector<ParticleDepth> & depths, std::vector<ParticleDepth> & scratch, size_t maxWork, bool & out_changed){
+	const size_t maxInsertionDistance = 8;
+	const size_t takeOutCost = 4; // the sort and the merge
+	size_t count = depths.size();
+	scratch.resize(count);
+
+	// depths[0, kept) are sorted. Those taken out are written from the end of scratch
+	size_t kept = 0, outOfOrder = 0, work = 0;
+	for (size_t k=0; k<count; k++){
+		ParticleDepth d = depths[k];
+		bool afterLast = (kept == 0 || depths[kept-1].key <= d.key);
+		if (afterLast && (k+1 == count || d.key <= depths[k+1].key)){
+			depths[kept++] = d; // the usual case : in order
+			continue;
+		}
+
+		// Farther than the next two : far out of place, rather than swapped with a neighbour
+		bool takeOut = k+2 < count && d.key > depths[k+1].key && d.key > depths[k+2].key;
+		size_t j = kept;
+		if (!takeOut){
+			while (j > 0 && kept - j <= maxInsertionDistance && depths[j-1].key > d.key)
+				j--;
+			takeOut = (kept - j > maxInsertionDistance);
+		}
+
+		if (takeOut){
+			outOfOrder++;
+			work += takeOutCost;
+			scratch[count - outOfOrder] = d;
+		}else{
+			// k >= kept : shifting [j, kept) up doesn't overwrite what's still to be sorted
+			memmove(&depths[j+1], &depths[j], (kept - j) * sizeof(ParticleDepth));
+			depths[j] = d;
+			work += kept - j;
+			kept++;
+		}
+
+		if (work > maxWork){
+			// Put those taken out back between the ones kept and the rest, [kept, k]
+			for (size_t o=0; o<outOfOrder; o++)
+				depths[kept + o] = scratch[count-1-o];
+			return false;
+		}
+	}
+	out_changed = (work != 0);
+	if (outOfOrder == 0)
+		return true;
+
+	ParticleDepth * taken = &scratch[count - outOfOrder];
+	std::stable_sort(taken, taken + outOfOrder, smallerKey);
+	// Merge from the end, so that the result can be written in place in 'depths'
+	size_t a = kept, b = outOfOrder, out = count;
+	while (b > 0){
+		if (a > 0 && depths[a-1].key > taken[b-1].key)
+			depths[--out] = depths[--a];
+		else
+			depths[--out] = taken[--b];
+	}
+	return true;
+}
+
+// values[k] = values[depths[k].index] for all k. The rest, after the live particles, is left undefined
+template <typename T>
+static void permuteParticles(std::vector<T> & values, const std::vector<ParticleDepth> & depths, std::vector<T> & scratch){
+	scratch.resize(values.size());
+	for (size_t k=0; k<depths.size(); k++)
+		scratch[k] = values[depths[k].index];
+	values.swap(scratch);
+}
+
+void sortParticles(ParticleSystem & system){
+	std::vector<ParticleDepth> & depths = system.depths;
+	depths.resize(system.aliveCount);
+	for (unsigned int i=0; i<system.aliveCount; i++){
+		depths[i].key = depthKey(system.cameraDistance[i]);
+		depths[i].index = i;
+	}
+
+	switch (system.sortMode){
+	case PARTICLE_SORT_STD:
+		std::sort(depths.begin(), depths.end(), smallerKey);
+		break;
+	case PARTICLE_SORT_RADIX:
+		radixSortDepths(depths, system.scratchDepths, system.pool, system.sliceHistograms);
+		break;
+	case PARTICLE_SORT_INCREMENTAL: {
+		// Past about one move per particle, the radix sort is faster. When the particles move too much
+		// for this, they usually still do in the next frames : don't spend the time to find out every frame.
+		bool changed = true;
+		if (system.sortRadixFrames > 0){
+			system.sortRadixFrames--;
+			radixSortDepths(depths, system.scratchDepths, system.pool, system.sliceHistograms);
+		}else if (!sortAlmostSortedDepths(depths, system.scratchDepths, depths.size() + 64, changed)){
+			system.sortFallbacks++;
+			system.sortRadixFrames = 8;
+			radixSortDepths(depths, system.scratchDepths, system.pool, system.sliceHistograms);
+		}else if (!changed){
+			return; // Already in order : nothing to move
+		}
+		break;
+	}
+	}
+
+	permuteParticles(system.positionX, depths, system.scratch);
+	permuteParticles(system.positionY, depths, system.scratch);
+	permuteParticles(system.positionZ, depths, system.scratch);
+	permuteParticles(system.speedX, depths, system.scratch);
+	permuteParticles(system.speedY, depths, system.scratch);
+	permuteParticles(system.speedZ, depths, system.scratch);
+	permuteParticles(system.life, depths, system.scratch);
+	permuteParticles(system.size, depths, system.scratch);
+	permuteParticles(system.cameraDistance, depths, system.scratch);
+	permuteParticles(system.color, depths, system.scratchColor);
+}
+
+void writeParticleVertexRange(const ParticleSystem & system, unsigned int begin, unsigned int end, float * out_positionSize, unsigned char * out_color){
+	unsigned int count = end - begin;
+	const float * positionX = &system.positionX[begin];
+	const float * positionY = &system.positionY[begin];
+	const float * positionZ = &system.positionZ[begin];
+	const float * size = &system.size[begin];
+	unsigned int i = 0;
+#ifdef PARTICLESYSTEM_SSE
+	for ( ; i+4<=count; i+=4){
+		// x, y, z and size of 4 particles -> x, y, z, size of each particle
+		__m128 x = _mm_loadu_ps(&positionX[i]);
+		__m128 y = _mm_loadu_ps(&positionY[i]);
+		__m128 z = _mm_loadu_ps(&positionZ[i]);
+		__m128 s = _mm_loadu_ps(&size[i]);
+		_MM_TRANSPOSE4_PS(x, y, z, s);
+		_mm_storeu_ps(&out_positionSize[4*i+ 0], x);
+		_mm_storeu_ps(&out_positionSize[4*i+ 4], y);
+		_mm_storeu_ps(&out_positionSize[4*i+ 8], z);
+		_mm_storeu_ps(&out_positionSize[4*i+12], s);
+	}
+#endif
+	for ( ; i<count; i++){
+		out_positionSize[4*i+0] = positionX[i];
+		out_positionSize[4*i+1] = positionY[i];
+		out_positionSize[4*i+2] = positionZ[i];
+		out_positionSize[4*i+3] = size[i];
+	}
+	if (count > 0)
+		memcpy(out_color, &system.color[begin], count * 4);
+}
+
+unsigned int writeParticleVertices(const ParticleSystem & system, float * out_positionSize, unsigned char * out_color){
+	writeParticleVertexRange(system, 0, system.aliveCount, out_positionSize, out_color);
+	return system.aliveCount;
+}
@@ -0,0 +1,80 @@
+#ifndef PARTICLESYSTEM_HPP
+#define PARTICLESYSTEM_HPP
+
+// The particles of tutorial18_particles, stored as one array per attribute ("SoA") rather than
+// one struct per particle : updateParticles only reads and writes what the physics needs
+// (position, speed, life), 4 particles at a time with SSE when available.
+// The live particles are always [0, aliveCount) : a new particle goes at the end, and a dead one is
+// replaced by the last one, so that nothing ever looks at the dead ones.
+// Each frame : spawnParticle for the new ones, updateParticles, sortParticles, writeParticleVertices.
+
+enum ParticleSort{
+	PARTICLE_SORT_STD,         // std::sort. For comparison
+	PARTICLE_SORT_RADIX,       // LSD radix sort, 8 bits per pass : O(n) whatever the order
+	PARTICLE_SORT_INCREMENTAL  // starts from the order of the previous frame, in which only a few particles
+	                           // moved : sorts these ones and merges them back. Falls back to the radix sort
+	                           // when too many particles are out of order, and then for the next few frames
+};
+
+struct JobPool;
+
+// The distance of a particle to the camera, for sortParticles
+struct ParticleDepth{
+	unsigned int key;   // cameraDistance as an integer, smaller for far particles : sorting the keys sorts the floats
+	unsigned int index;
+};
+
+struct ParticleSystem{
+	unsigned int capacity;
+
+	std::vector<float> positionX, positionY, positionZ;
+	std::vector<float> speedX, speedY, speedZ;
+	std::vector<float> life;           // remaining seconds
+	std::vector<float> size;
+	std::vector<unsigned int> color;   // R, G, B, A bytes, in this order in memory
+	std::vector<float> cameraDistance; // *squared* distance to the camera, set by updateParticles
+
+	// After sortParticles, the particles are far ones first.
+	// The order hardly changes from one frame to the next, so the arrays are mostly moved in place.
+	unsigned int aliveCount;
+	unsigned int droppedCount;         // spawnParticle calls which found no room, since initParticleSystem
+	glm::vec3 gravity;
+
+	ParticleSort sortMode;             // PARTICLE_SORT_INCREMENTAL by default
+	unsigned int sortFallbacks;        // PARTICLE_SORT_INCREMENTAL frames which needed the radix sort
+	unsigned int sortRadixFrames;      // after a fallback, the next frames use the radix sort without trying
+
+	JobPool * pool;                    // NULL by default. Else the radix sort of many particles runs on its threads
+	std::vector<ParticleDepth> depths; // for sortParticles
+	std::vector<ParticleDepth> scratchDepths;
+	std::vector<unsigned int> sliceHistograms; // for the radix sort, 4 x 256 per slice of the particles
+	std::vector<float> scratch;
+	std::vector<unsigned int> scratchColor;
+};
+
+void initParticleSystem(ParticleSystem & system, unsigned int capacity);
+
+// Returns the index of the new particle, or 'capacity' if all the particles are alive : then nothing is spawned.
+unsigned int spawnParticle(ParticleSystem & system, const glm::vec3 & position, const glm::vec3 & speed, float life, float size, const unsigned char color[4]);
+
+// Ages and moves all the particles by delta seconds, computes their distance to the camera,
+// and removes those which died
+void updateParticles(ParticleSystem & system, float delta, const glm::vec3 & cameraPosition);
+
+// The two halves of updateParticles. simulateParticles only changes the particles [begin, end) :
+// different ranges can be simulated at the same time, on different threads. Then removeDeadParticles.
+void simulateParticles(ParticleSystem & system, unsigned int begin, unsigned int end, float delta, const glm::vec3 & cameraPosition);
+void removeDeadParticles(ParticleSystem & system);
+
+// Orders the particles far ones first, so that they are blended correctly, with system.sortMode
+void sortParticles(ParticleSystem & system);
+
+// Writes the particles, in their order : x, y, z, size for each one in out_positionSize,
+// and R, G, B, A in out_color. Both must have room for 4 values per live particle.
+// Returns the number of particles written.
+unsigned int writeParticleVertices(const ParticleSystem & system, float * out_positionSize, unsigned char * out_color);
+
+// The same, for the particles [begin, end) only : particle 'begin' is written at out_positionSize[0] and out_color[0]
+void writeParticleVertexRange(const ParticleSystem & system, unsigned int begin, unsigned int end, float * out_positionSize, unsigned char * out_color);
+
+#endif
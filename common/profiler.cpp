@@ -0,0 +1,381 @@
+#include <vector>
+#include <string>
+#include <map>
+#include <deque>
+#include <algorithm>
+#include <atomic>
+#include <mutex>
+#include <chrono>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <GL/glew.h>
+
+// The CPU scopes are timed with the time stamp counter when there is one : it is read
+// faster than steady_clock, and converted to nanoseconds only when the trace is written.
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#include <intrin.h>
+#define PROFILER_RDTSC
+#elif defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define PROFILER_RDTSC
+#endif
+
+#include "profiler.hpp"
+
+#define PROFILER_MAX_DEPTH   64
+#define PROFILER_GPU_QUERIES 64    // GPU scopes waiting for their result, at most
+
+struct ProfileEvent{
+	const char * name;
+	long long begin;      // ticks (see profilerTicks) for the CPU, nanoseconds since the program started for the GPU
+	long long end;
+};
+
+// The scopes of one thread. Only this thread writes in it; 'written' tells the others how far it got.
+struct ProfileThread{
+	std::vector<ProfileEvent> events;        // a ring of PROFILER_RING_SIZE
+	std::atomic<unsigned long long> written; // all the events so far, including the overwritten ones
+	unsigned int id;
+	std::string name;
+	bool gpu;
+
+	// The scopes which have begun but not ended yet
+	const char * openNames[PROFILER_MAX_DEPTH];
+	long long openBegins[PROFILER_MAX_DEPTH];
+	unsigned int depth;
+};
+
+static std::atomic<bool> profilerEnabled(false);
+static std::mutex profilerThreadsMutex;              // only to add threads and to rename them
+static std::vector<ProfileThread *> profilerThreads; // never deleted : the scopes of finished threads stay in the trace
+static thread_local ProfileThread * currentProfileThread = NULL; // created by the first scope of the thread
+static thread_local const char * currentThreadName = NULL;
+
+static long long steadyNanoseconds(){
+	return (long long)std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+#ifdef PROFILER_RDTSC
+static long long profilerTicks(){
+	return (long long)__rdtsc();
+}
+#else
+static long long profilerTicks(){
+	return steadyNanoseconds();
+}
+#endif
+
+// Both clocks when the program started : the duration of a tick is measured from there
+static const long long epochNanoseconds = steadyNanoseconds();
+static const long long epochTicks = profilerTicks();
+
+static double nanosecondsPerTick(){
+	long long ticks = profilerTicks() - epochTicks;
+	long long nanoseconds = steadyNanoseconds() - epochNanoseconds;
+	return ticks > 0 ? (double)nanoseconds / ticks : 1.0;
+}
+
+static long long ticksToNanoseconds(long long ticks, double scale){
+	return (long long)((ticks - epochTicks) * scale);
+}
+
+static ProfileThread * newProfileThread(const char * name, bool gpu){
+	ProfileThread * thread = new ProfileThread;
+	thread->events.resize(PROFILER_RING_SIZE);
+	thread->written = 0;
+	thread->gpu = gpu;
+	thread->depth = 0;
+	std::lock_guard<std::mutex> lock(profilerThreadsMutex);
+	thread->id = (unsigned int)profilerThreads.size();
+	if (name != NULL){
+		thread->name = name;
+	}else{
+		char defaultName[32];
+		sprintf(defaultName, "thread %u", thread->id);
+		thread->name = defaultName;
+	}
+	profilerThreads.push_back(thread);
+	return thread;
+}
+
+static ProfileThread * profileThread(){
+	if (currentProfileThread == NULL)
+		currentProfileThread = newProfileThread(currentThreadName, false);
+	return currentProfileThread;
+}
+
+static void recordEvent(ProfileThread * thread, const char * name, long long begin, long long end){
+	unsigned long long n = thread->written.load(std::memory_order_relaxed);
+	ProfileEvent & event = thread->events[n % PROFILER_RING_SIZE];
+	event.name = name;
+	event.begin = begin;
+	event.end = end;
+	thread->written.store(n + 1, std::memory_order_release);
+}
+
+void setProfilerThreadName(const char * name){
+	currentThreadName = name;
+	if (currentProfileThread != NULL){
+		std::lock_guard<std::mutex> lock(profilerThreadsMutex);
+		currentProfileThread->name = name;
+	}
+}
+
+static long long frameBegin = -1;
+static ProfileThread * frameProfileThread = NULL;
+
+void setProfilerEnabled(bool enabled){
+	if (enabled && currentThreadName == NULL)
+		setProfilerThreadName("main");
+	frameBegin = -1;
+	profilerEnabled.store(enabled);
+}
+
+bool isProfilerEnabled(){
+	return profilerEnabled.load(std::memory_order_relaxed);
+}
+
+bool enableProfilerFromEnvironment(){
+	const char * value = getenv("TUTORIAL_PROFILE");
+	if (value != NULL && value[0] != '\0' && strcmp(value, "0") != 0)
+		setProfilerEnabled(true);
+	return isProfilerEnabled();
+}
+
+bool beginProfileScope(const char * name){
+	if (!profilerEnabled.load(std::memory_order_relaxed))
+		return false;
+	ProfileThread * thread = profileThread();
+	if (thread->depth >= PROFILER_MAX_DEPTH)
+		return false;
+	thread->openNames[thread->depth] = name;
+	thread->openBegins[thread->depth] = profilerTicks();
+	thread->depth++;
+	return true;
+}
+
+void endProfileScope(){
+	ProfileThread * thread = currentProfileThread;
+	if (thread == NULL || thread->depth == 0)
+		return;
+	long long end = profilerTicks();
+	thread->depth--;
+	recordEvent(thread, thread->openNames[thread->depth], thread->openBegins[thread->depth], end);
+}
+
+// The GPU scopes, all on the GL thread
+struct GPUProfileQuery{
+	GLuint query;         // 0 if there were too many queries pending
+	const char * name;
+	long long begin;      // CPU ticks when the scope began
+};
+static std::vector<GLuint> freeGPUQueries;
+static std::deque<GPUProfileQuery> pendingGPUQueries;
+static GPUProfileQuery openGPUQuery;
+static unsigned int gpuScopeDepth = 0;  // including the nested scopes, which are ignored
+static long long lastGPUEnd = 0;
+static ProfileThread * gpuProfileThread = NULL;
+
+bool beginGPUProfileScope(const char * name){
+	if (!profilerEnabled.load(std::memory_order_relaxed))
+		return false;
+	if (gpuScopeDepth++ > 0)
+		return true;
+
+	openGPUQuery.query = 0;
+	openGPUQuery.name = name;
+	openGPUQuery.begin = profilerTicks();
+	if (pendingGPUQueries.size() >= PROFILER_GPU_QUERIES)
+		return true; // profileFrame isn't called : lose this one
+	if (freeGPUQueries.empty()){
+		glGenQueries(1, &openGPUQuery.query);
+	}else{
+		openGPUQuery.query = freeGPUQueries.back();
+		freeGPUQueries.pop_back();
+	}
+	glBeginQuery(GL_TIME_ELAPSED, openGPUQuery.query);
+	return true;
+}
+
+void endGPUProfileScope(){
+	if (gpuScopeDepth == 0 || --gpuScopeDepth > 0)
+		return;
+	if (openGPUQuery.query == 0)
+		return;
+	glEndQuery(GL_TIME_ELAPSED);
+	pendingGPUQueries.push_back(openGPUQuery);
+}
+
+// Records the GPU scopes which are finished, in order.
+// Only the durations are known : each scope is shown when it was submitted, or after the previous one
+// if the GPU was still busy with it.
+static void collectGPUQueries(){
+	double scale = nanosecondsPerTick();
+	long long now = ticksToNanoseconds(profilerTicks(), scale);
+	while (!pendingGPUQueries.empty()){
+		const GPUProfileQuery & query = pendingGPUQueries.front();
+		GLint available = 0;
+		glGetQueryObjectiv(query.query, GL_QUERY_RESULT_AVAILABLE, &available);
+		if (!available)
+			break;
+		GLuint64 elapsed = 0;
+		glGetQueryObjectui64v(query.query, GL_QUERY_RESULT, &elapsed);
+		long long submitted = ticksToNanoseconds(query.begin, scale);
+
+		// Some drivers return garbage for their very first query : longer than it has existed
+		if ((long long)elapsed <= now - submitted){
+			if (gpuProfileThread == NULL)
+				gpuProfileThread = newProfileThread("GPU", true);
+			long long begin = std::max(submitted, lastGPUEnd);
+			lastGPUEnd = begin + (long long)elapsed;
+			recordEvent(gpuProfileThread, query.name, begin, lastGPUEnd);
+		}
+		freeGPUQueries.push_back(query.query);
+		pendingGPUQueries.pop_front();
+	}
+}
+
+void profileFrame(){
+	collectGPUQueries();
+	if (!profilerEnabled.load(std::memory_order_relaxed))
+		return;
+
+	// The frames have their own line in the trace, so that they don't have to nest with the scopes
+	long long now = profilerTicks();
+	if (frameBegin >= 0){
+		if (frameProfileThread == NULL)
+			frameProfileThread = newProfileThread("frames", false);
+		recordEvent(frameProfileThread, "frame", frameBegin, now);
+	}
+	frameBegin = now;
+}
+
+static void writeJSONString(FILE * file, const char * s){
+	fputc('"', file);
+	for (; *s; s++){
+		if (*s == '"' || *s == '\\')
+			fprintf(file, "\\%c", *s);
+		else if ((unsigned char)*s < 0x20)
+			fprintf(file, "\\u%04x", (unsigned int)(unsigned char)*s);
+		else
+			fputc(*s, file);
+	}
+	fputc('"', file);
+}
+
+// The events of a thread which are still in its ring
+static void getProfileEvents(ProfileThread * thread, unsigned long long & out_first, unsigned long long & out_last){
+	out_last = thread->written.load(std::memory_order_acquire);
+	out_first = out_last > PROFILER_RING_SIZE ? out_last - PROFILER_RING_SIZE : 0;
+}
+
+// In nanoseconds since the program started
+static void getEventTimes(const ProfileThread * thread, const ProfileEvent & event, double scale, long long & out_begin, long long & out_end){
+	if (thread->gpu){
+		out_begin = event.begin;
+		out_end = event.end;
+	}else{
+		out_begin = ticksToNanoseconds(event.begin, scale);
+		out_end = ticksToNanoseconds(event.end, scale);
+	}
+}
+
+bool writeProfileTrace(const char * path){
+	FILE * file = fopen(path, "w");
+	if (file == NULL){
+		printf("writeProfileTrace : can't create %s\n", path);
+		return false;
+	}
+
+	std::vector<ProfileThread *> threads;
+	std::vector<std::string> names;
+	{
+		std::lock_guard<std::mutex> lock(profilerThreadsMutex);
+		threads = profilerThreads;
+		for (size_t t=0; t<threads.size(); t++)
+			names.push_back(threads[t]->name);
+	}
+
+	// Complete ("X") events, in microseconds, one tid per thread
+	double scale = nanosecondsPerTick();
+	fprintf(file, "{\"traceEvents\":[\n");
+	bool first = true;
+	for (size_t t=0; t<threads.size(); t++){
+		ProfileThread * thread = threads[t];
+		fprintf(file, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%u,\"args\":{\"name\":", first ? "" : ",\n", thread->id);
+		writeJSONString(file, names[t].c_str());
+		fprintf(file, "}}");
+		first = false;
+
+		unsigned long long e0, e1;
+		getProfileEvents(thread, e0, e1);
+		for (unsigned long long e=e0; e<e1; e++){
+			const ProfileEvent & event = thread->events[e % PROFILER_RING_SIZE];
+			long long begin, end;
+			getEventTimes(thread, event, scale, begin, end);
+			fprintf(file, ",\n{\"name\":");
+			writeJSONString(file, event.name);
+			fprintf(file, ",\"cat\":\"%s\",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,\"pid\":1,\"tid\":%u}",
+				thread->gpu ? "gpu" : "cpu", begin / 1000.0, (end - begin) / 1000.0, thread->id);
+		}
+	}
+	fprintf(file, "\n],\"displayTimeUnit\":\"ms\"}\n");
+
+	bool ok = ferror(file) == 0;
+	ok = (fclose(file) == 0) && ok;
+	if (!ok)
+		printf("writeProfileTrace : can't write %s\n", path);
+	return ok;
+}
+
+struct ProfileSummary{
+	std::string name;
+	unsigned long long count;
+	long long total;
+	long long max;
+};
+
+static bool slowerSummary(const ProfileSummary & a, const ProfileSummary & b){
+	return a.total > b.total;
+}
+
+void printProfileSummary(){
+	std::vector<ProfileThread *> threads;
+	{
+		std::lock_guard<std::mutex> lock(profilerThreadsMutex);
+		threads = profilerThreads;
+	}
+
+	double scale = nanosecondsPerTick();
+	std::map<std::string, ProfileSummary> summaries;
+	for (size_t t=0; t<threads.size(); t++){
+		unsigned long long e0, e1;
+		getProfileEvents(threads[t], e0, e1);
+		for (unsigned long long e=e0; e<e1; e++){
+			const ProfileEvent & event = threads[t]->events[e % PROFILER_RING_SIZE];
+			std::string name = threads[t]->gpu ? std::string(event.name) + " (GPU)" : std::string(event.name);
+			ProfileSummary & summary = summaries[name];
+			long long begin, end;
+			getEventTimes(threads[t], event, scale, begin, end);
+			long long duration = end - begin;
+			summary.name = name;
+			summary.count++;
+			summary.total += duration;
+			summary.max = std::max(summary.max, duration);
+		}
+	}
+
+	std::vector<ProfileSummary> sorted;
+	for (std::map<std::string, ProfileSummary>::const_iterator it = summaries.begin(); it != summaries.end(); ++it)
+		sorted.push_back(it->second);
+	std::sort(sorted.begin(), sorted.end(), slowerSummary);
+
+	printf("%-36s %8s %12s %10s %10s\n", "Scope", "Count", "Total (ms)", "Avg (ms)", "Max (ms)");
+	for (size_t i=0; i<sorted.size(); i++){
+		const ProfileSummary & s = sorted[i];
+		printf("%-36s %8llu %12.3f %10.3f %10.3f\n", s.name.c_str(), s.count,
+			s.total / 1e6, s.total / 1e6 / s.count, s.max / 1e6);
+	}
+}
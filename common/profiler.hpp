@@ -0,0 +1,70 @@
+#ifndef PROFILER_HPP
+#define PROFILER_HPP
+
+// A small frame profiler : named scopes, which can be nested, timed on the CPU and on the GPU.
+// Each thread records its scopes in its own ring buffer, without any lock; the GPU scopes are
+// GL_TIME_ELAPSED queries, read a few frames later so that nothing waits for the GPU.
+// writeProfileTrace saves everything as a Chrome trace : open it in chrome://tracing or ui.perfetto.dev.
+//
+// Nothing is recorded until setProfilerEnabled(true) : a disabled scope only costs a test.
+// Define NO_PROFILER to remove the PROFILE_* scopes completely.
+
+#define PROFILER_RING_SIZE 16384 // scopes kept per thread; the oldest are overwritten
+
+void setProfilerEnabled(bool enabled);
+bool isProfilerEnabled();
+
+// What the tutorials call : enables the profiler only if the environment variable TUTORIAL_PROFILE
+// is set, and not to 0 ("TUTORIAL_PROFILE=1 ./tutorial16"). Returns isProfilerEnabled().
+bool enableProfilerFromEnvironment();
+
+// The names are kept as pointers, until the trace is written : use string literals.
+// Returns false if nothing was recorded (disabled, or too many nested scopes) : don't call endProfileScope then.
+bool beginProfileScope(const char * name);
+void endProfileScope();
+
+// The same, on the GPU : the time the GPU spends on the commands in between. GL thread only.
+// GPU scopes can't overlap : the nested ones are ignored.
+bool beginGPUProfileScope(const char * name);
+void endGPUProfileScope();
+
+// Call it once per frame, on the GL thread, for instance just before glfwSwapBuffers :
+// records the frame, and collects the GPU scopes whose results are there.
+void profileFrame();
+
+// The name of the calling thread in the trace (a string literal). The thread which enables the profiler is "main".
+// Threads only get a buffer when they record their first scope.
+void setProfilerThreadName(const char * name);
+
+// Writes the scopes still in the buffers (the last PROFILER_RING_SIZE of each thread).
+// Call it between frames : the scopes which other threads record meanwhile may be missing.
+bool writeProfileTrace(const char * path);
+
+// For each scope name : count, total and average time, in the buffers
+void printProfileSummary();
+
+struct ProfileScope{
+	bool recorded;
+	ProfileScope(const char * name) : recorded(beginProfileScope(name)) {}
+	~ProfileScope(){ if (recorded) endProfileScope(); }
+};
+
+struct GPUProfileScope{
+	bool recorded;
+	GPUProfileScope(const char * name) : recorded(beginGPUProfileScope(name)) {}
+	~GPUProfileScope(){ if (recorded) endGPUProfileScope(); }
+};
+
+#define PROFILE_CONCATENATE2(a, b) a##b
+#define PROFILE_CONCATENATE(a, b) PROFILE_CONCATENATE2(a, b)
+
+// Times the rest of the block
+#ifdef NO_PROFILER
+#define PROFILE_SCOPE(name)
+#define PROFILE_GPU_SCOPE(name)
+#else
+#define PROFILE_SCOPE(name)     ProfileScope    PROFILE_CONCATENATE(profileScope, __LINE__)(name)
+#define PROFILE_GPU_SCOPE(name) GPUProfileScope PROFILE_CONCATENATE(gpuProfileScope, __LINE__)(name)
+#endif
+
+#endif
@@ -1,3 +1,16 @@
+#include <vector>
+#include <chrono>
+#include <algorithm>
+#include <math.h>
+#include <float.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#define QUATERNION_UTILS_SSE
+#include <xmmintrin.h>
+#endif
+
 #include <glm/gtc/quaternion.hpp>
 #include <glm/gtx/quaternion.hpp>
 #include <glm/gtx/euler_angles.hpp>
@@ -118,6 +131,464 @@ quat RotateTowards(quat q1, quat q2, float maxAngle){
 
 
 
+quat Nlerp(quat q1, quat q2, float t){
+	// Avoid taking the long path around the sphere
+	if (dot(q1, q2) < 0)
+		q2 = q2*-1.0f;
+	return normalize(q1*(1.0f - t) + q2*t);
+}
+
+
+
+#ifdef QUATERNION_UTILS_SSE
+
+// 4 vec3s or 4 quats, one per lane
+struct Vec3x4{
+	__m128 x, y, z;
+};
+struct Quatx4{
+	__m128 x, y, z, w;
+};
+
+static inline Vec3x4 load4(const Vec3Array & v, size_t i){
+	Vec3x4 r = { _mm_loadu_ps(&v.x[i]), _mm_loadu_ps(&v.y[i]), _mm_loadu_ps(&v.z[i]) };
+	return r;
+}
+
+static inline Quatx4 load4(const QuatArray & q, size_t i){
+	Quatx4 r = { _mm_loadu_ps(&q.x[i]), _mm_loadu_ps(&q.y[i]), _mm_loadu_ps(&q.z[i]), _mm_loadu_ps(&q.w[i]) };
+	return r;
+}
+
+static inline void store4(const Quatx4 & q, QuatArray & out, size_t i){
+	_mm_storeu_ps(&out.x[i], q.x);
+	_mm_storeu_ps(&out.y[i], q.y);
+	_mm_storeu_ps(&out.z[i], q.z);
+	_mm_storeu_ps(&out.w[i], q.w);
+}
+
+static inline Vec3x4 set4(vec3 v){
+	Vec3x4 r = { _mm_set1_ps(v.x), _mm_set1_ps(v.y), _mm_set1_ps(v.z) };
+	return r;
+}
+
+static inline __m128 dot4(const Vec3x4 & a, const Vec3x4 & b){
+	return _mm_add_ps(_mm_add_ps(_mm_mul_ps(a.x, b.x), _mm_mul_ps(a.y, b.y)), _mm_mul_ps(a.z, b.z));
+}
+
+static inline __m128 dot4(const Quatx4 & a, const Quatx4 & b){
+	return _mm_add_ps(_mm_add_ps(_mm_mul_ps(a.x, b.x), _mm_mul_ps(a.y, b.y)), _mm_add_ps(_mm_mul_ps(a.z, b.z), _mm_mul_ps(a.w, b.w)));
+}
+
+static inline Vec3x4 cross4(const Vec3x4 & a, const Vec3x4 & b){
+	Vec3x4 r;
+	r.x = _mm_sub_ps(_mm_mul_ps(a.y, b.z), _mm_mul_ps(a.z, b.y));
+	r.y = _mm_sub_ps(_mm_mul_ps(a.z, b.x), _mm_mul_ps(a.x, b.z));
+	r.z = _mm_sub_ps(_mm_mul_ps(a.x, b.y), _mm_mul_ps(a.y, b.x));
+	return r;
+}
+
+static inline Vec3x4 scale4(const Vec3x4 & v, __m128 s){
+	Vec3x4 r = { _mm_mul_ps(v.x, s), _mm_mul_ps(v.y, s), _mm_mul_ps(v.z, s) };
+	return r;
+}
+
+static inline Vec3x4 normalize4(const Vec3x4 & v){
+	return scale4(v, _mm_div_ps(_mm_set1_ps(1.0f), _mm_sqrt_ps(dot4(v, v))));
+}
+
+static inline Quatx4 normalize4(const Quatx4 & q){
+	__m128 s = _mm_div_ps(_mm_set1_ps(1.0f), _mm_sqrt_ps(dot4(q, q)));
+	Quatx4 r = { _mm_mul_ps(q.x, s), _mm_mul_ps(q.y, s), _mm_mul_ps(q.z, s), _mm_mul_ps(q.w, s) };
+	return r;
+}
+
+// a*sa + b*sb
+static inline Quatx4 blend4(const Quatx4 & a, __m128 sa, const Quatx4 & b, __m128 sb){
+	Quatx4 r;
+	r.x = _mm_add_ps(_mm_mul_ps(a.x, sa), _mm_mul_ps(b.x, sb));
+	r.y = _mm_add_ps(_mm_mul_ps(a.y, sa), _mm_mul_ps(b.y, sb));
+	r.z = _mm_add_ps(_mm_mul_ps(a.z, sa), _mm_mul_ps(b.z, sb));
+	r.w = _mm_add_ps(_mm_mul_ps(a.w, sa), _mm_mul_ps(b.w, sb));
+	return r;
+}
+
+// Lanes of a where mask is set, of b elsewhere
+static inline __m128 select4(__m128 mask, __m128 a, __m128 b){
+	return _mm_or_ps(_mm_and_ps(mask, a), _mm_andnot_ps(mask, b));
+}
+
+static inline Quatx4 select4(__m128 mask, const Quatx4 & a, const Quatx4 & b){
+	Quatx4 r = { select4(mask, a.x, b.x), select4(mask, a.y, b.y), select4(mask, a.z, b.z), select4(mask, a.w, b.w) };
+	return r;
+}
+
+static inline Quatx4 negate4(const Quatx4 & q, __m128 mask){
+	__m128 sign = _mm_and_ps(mask, _mm_set1_ps(-0.0f));
+	Quatx4 r = { _mm_xor_ps(q.x, sign), _mm_xor_ps(q.y, sign), _mm_xor_ps(q.z, sign), _mm_xor_ps(q.w, sign) };
+	return r;
+}
+
+// p*q
+static inline Quatx4 multiply4(const Quatx4 & p, const Quatx4 & q){
+	Quatx4 r;
+	r.w = _mm_sub_ps(_mm_sub_ps(_mm_mul_ps(p.w, q.w), _mm_mul_ps(p.x, q.x)), _mm_add_ps(_mm_mul_ps(p.y, q.y), _mm_mul_ps(p.z, q.z)));
+	r.x = _mm_add_ps(_mm_add_ps(_mm_mul_ps(p.w, q.x), _mm_mul_ps(p.x, q.w)), _mm_sub_ps(_mm_mul_ps(p.y, q.z), _mm_mul_ps(p.z, q.y)));
+	r.y = _mm_add_ps(_mm_add_ps(_mm_mul_ps(p.w, q.y), _mm_mul_ps(p.y, q.w)), _mm_sub_ps(_mm_mul_ps(p.z, q.x), _mm_mul_ps(p.x, q.z)));
+	r.z = _mm_add_ps(_mm_add_ps(_mm_mul_ps(p.w, q.z), _mm_mul_ps(p.z, q.w)), _mm_sub_ps(_mm_mul_ps(p.x, q.y), _mm_mul_ps(p.y, q.x)));
+	return r;
+}
+
+// q*v, the same way as glm
+static inline Vec3x4 rotate4(const Quatx4 & q, const Vec3x4 & v){
+	Vec3x4 u = { q.x, q.y, q.z };
+	Vec3x4 uv = cross4(u, v);
+	Vec3x4 uuv = cross4(u, uv);
+	__m128 two = _mm_set1_ps(2.0f);
+	Vec3x4 r;
+	r.x = _mm_add_ps(v.x, _mm_mul_ps(_mm_add_ps(_mm_mul_ps(uv.x, q.w), uuv.x), two));
+	r.y = _mm_add_ps(v.y, _mm_mul_ps(_mm_add_ps(_mm_mul_ps(uv.y, q.w), uuv.y), two));
+	r.z = _mm_add_ps(v.z, _mm_mul_ps(_mm_add_ps(_mm_mul_ps(uv.z, q.w), uuv.z), two));
+	return r;
+}
+
+// For 0 <= x <= 1. Abramowitz & Stegun 4.4.46, error < 2e-8
+static inline __m128 acos4(__m128 x){
+	__m128 p = _mm_set1_ps(-0.0012624911f);
+	p = _mm_add_ps(_mm_mul_ps(p, x), _mm_set1_ps( 0.0066700901f));
+	p = _mm_add_ps(_mm_mul_ps(p, x), _mm_set1_ps(-0.0170881256f));
+	p = _mm_add_ps(_mm_mul_ps(p, x), _mm_set1_ps( 0.0308918810f));
+	p = _mm_add_ps(_mm_mul_ps(p, x), _mm_set1_ps(-0.0501743046f));
+	p = _mm_add_ps(_mm_mul_ps(p, x), _mm_set1_ps( 0.0889789874f));
+	p = _mm_add_ps(_mm_mul_ps(p, x), _mm_set1_ps(-0.2145988016f));
+	p = _mm_add_ps(_mm_mul_ps(p, x), _mm_set1_ps( 1.5707963050f));
+	return _mm_mul_ps(p, _mm_sqrt_ps(_mm_sub_ps(_mm_set1_ps(1.0f), x)));
+}
+
+// For 0 <= x <= pi/2. Taylor series up to x^11, error < 1e-8
+static inline __m128 sin4(__m128 x){
+	__m128 x2 = _mm_mul_ps(x, x);
+	__m128 p = _mm_set1_ps(-1.0f / 39916800.0f);
+	p = _mm_add_ps(_mm_mul_ps(p, x2), _mm_set1_ps( 1.0f / 362880.0f));
+	p = _mm_add_ps(_mm_mul_ps(p, x2), _mm_set1_ps(-1.0f / 5040.0f));
+	p = _mm_add_ps(_mm_mul_ps(p, x2), _mm_set1_ps( 1.0f / 120.0f));
+	p = _mm_add_ps(_mm_mul_ps(p, x2), _mm_set1_ps(-1.0f / 6.0f));
+	p = _mm_add_ps(_mm_mul_ps(p, x2), _mm_set1_ps( 1.0f));
+	return _mm_mul_ps(p, x);
+}
+
+// RotationBetweenVectors for 4 pairs. Returns a bit per lane for which the vectors
+// were opposite : those must be done by the scalar version.
+static inline int rotationBetweenVectors4(Vec3x4 start, Vec3x4 dest, Quatx4 & out){
+	start = normalize4(start);
+	dest = normalize4(dest);
+
+	__m128 cosTheta = dot4(start, dest);
+	int opposite = _mm_movemask_ps(_mm_cmplt_ps(cosTheta, _mm_set1_ps(-1 + 0.001f)));
+
+	Vec3x4 rotationAxis = cross4(start, dest);
+	__m128 s = _mm_sqrt_ps(_mm_mul_ps(_mm_add_ps(_mm_set1_ps(1.0f), cosTheta), _mm_set1_ps(2.0f)));
+	__m128 invs = _mm_div_ps(_mm_set1_ps(1.0f), s);
+	out.x = _mm_mul_ps(rotationAxis.x, invs);
+	out.y = _mm_mul_ps(rotationAxis.y, invs);
+	out.z = _mm_mul_ps(rotationAxis.z, invs);
+	out.w = _mm_mul_ps(s, _mm_set1_ps(0.5f));
+	return opposite;
+}
+
+#endif
+
+void RotationBetweenVectors(const Vec3Array & start, const Vec3Array & dest, QuatArray & out){
+	out.resize(start.size());
+	size_t i = 0;
+#ifdef QUATERNION_UTILS_SSE
+	for ( ; i+4<=start.size(); i+=4){
+		Quatx4 q;
+		int opposite = rotationBetweenVectors4(load4(start, i), load4(dest, i), q);
+		store4(q, out, i);
+		// Rare : let the scalar version guess an axis
+		for (int k=0; k<4; k++)
+			if (opposite & (1 << k))
+				out.set(i+k, RotationBetweenVectors(start.get(i+k), dest.get(i+k)));
+	}
+#endif
+	for ( ; i<start.size(); i++)
+		out.set(i, RotationBetweenVectors(start.get(i), dest.get(i)));
+}
+
+void LookAt(const Vec3Array & direction, vec3 desiredUp, QuatArray & out){
+	out.resize(direction.size());
+	size_t i = 0;
+#ifdef QUATERNION_UTILS_SSE
+	Vec3x4 up = set4(desiredUp);
+	Vec3x4 front = set4(vec3(0.0f, 0.0f, 1.0f));
+	Vec3x4 top = set4(vec3(0.0f, 1.0f, 0.0f));
+	Quatx4 identity = { _mm_setzero_ps(), _mm_setzero_ps(), _mm_setzero_ps(), _mm_set1_ps(1.0f) };
+	for ( ; i+4<=direction.size(); i+=4){
+		Vec3x4 d = load4(direction, i);
+		__m128 valid = _mm_cmpge_ps(dot4(d, d), _mm_set1_ps(0.0001f));
+
+		// The same steps as LookAt
+		Vec3x4 right = cross4(d, up);
+		Vec3x4 perpendicularUp = cross4(right, d);
+		Quatx4 rot1, rot2;
+		int opposite = rotationBetweenVectors4(front, d, rot1);
+		Vec3x4 newUp = rotate4(rot1, top);
+		opposite |= rotationBetweenVectors4(newUp, perpendicularUp, rot2);
+
+		store4(select4(valid, multiply4(rot2, rot1), identity), out, i);
+		opposite &= _mm_movemask_ps(valid);
+		for (int k=0; k<4; k++)
+			if (opposite & (1 << k))
+				out.set(i+k, LookAt(direction.get(i+k), desiredUp));
+	}
+#endif
+	for ( ; i<direction.size(); i++)
+		out.set(i, LookAt(direction.get(i), desiredUp));
+}
+
+void RotateTowards(const QuatArray & q1, const QuatArray & q2, float maxAngle, QuatArray & out){
+	out.resize(q1.size());
+	size_t i = 0;
+#ifdef QUATERNION_UTILS_SSE
+	if (maxAngle >= 0.001f){
+		// The same weights as the scalar version : sin((1-t) * maxAngle) and sin(t * maxAngle), with
+		// t = maxAngle / angle. angle is at most pi/2 on the shortest path, so both are in the range of sin4.
+		__m128 max4 = _mm_set1_ps(maxAngle);
+		for ( ; i+4<=q1.size(); i+=4){
+			Quatx4 a = load4(q1, i);
+			Quatx4 b = load4(q2, i);
+			__m128 cosTheta = dot4(a, b);
+			__m128 equal = _mm_cmpgt_ps(cosTheta, _mm_set1_ps(0.9999f));
+
+			// Avoid taking the long path around the sphere
+			__m128 negative = _mm_cmplt_ps(cosTheta, _mm_setzero_ps());
+			a = negate4(a, negative);
+			cosTheta = _mm_andnot_ps(_mm_set1_ps(-0.0f), cosTheta);
+
+			__m128 angle = acos4(_mm_min_ps(cosTheta, _mm_set1_ps(1.0f)));
+			__m128 arrived = _mm_or_ps(equal, _mm_cmplt_ps(angle, max4));
+
+			// The lanes which arrived don't use t : keep it finite for them
+			__m128 t = _mm_div_ps(max4, _mm_max_ps(angle, max4));
+			Quatx4 res = normalize4(blend4(
+				a, sin4(_mm_mul_ps(_mm_sub_ps(_mm_set1_ps(1.0f), t), max4)),
+				b, sin4(_mm_mul_ps(t, max4))
+			));
+			store4(select4(arrived, b, res), out, i);
+		}
+	}
+#endif
+	for ( ; i<q1.size(); i++)
+		out.set(i, RotateTowards(q1.get(i), q2.get(i), maxAngle));
+}
+
+void Slerp(const QuatArray & q1, const QuatArray & q2, float t, QuatArray & out){
+	out.resize(q1.size());
+	size_t i = 0;
+#ifdef QUATERNION_UTILS_SSE
+	if (t >= 0.0f && t <= 1.0f){ // else sin4 would be out of its range
+		__m128 t4 = _mm_set1_ps(t);
+		__m128 oneMinusT = _mm_set1_ps(1.0f - t);
+		for ( ; i+4<=q1.size(); i+=4){
+			Quatx4 a = load4(q1, i);
+			Quatx4 b = load4(q2, i);
+			__m128 cosTheta = dot4(a, b);
+
+			// Avoid taking the long path around the sphere
+			b = negate4(b, _mm_cmplt_ps(cosTheta, _mm_setzero_ps()));
+			cosTheta = _mm_andnot_ps(_mm_set1_ps(-0.0f), cosTheta);
+
+			// Linear interpolation when sin(angle) is almost 0, like glm
+			__m128 close = _mm_cmpgt_ps(cosTheta, _mm_set1_ps(1.0f - FLT_EPSILON));
+			__m128 angle = acos4(_mm_min_ps(cosTheta, _mm_set1_ps(1.0f)));
+			__m128 invSin = _mm_div_ps(_mm_set1_ps(1.0f), sin4(angle));
+			Quatx4 res = blend4(
+				a, _mm_mul_ps(sin4(_mm_mul_ps(oneMinusT, angle)), invSin),
+				b, _mm_mul_ps(sin4(_mm_mul_ps(t4, angle)), invSin)
+			);
+			store4(select4(close, blend4(a, oneMinusT, b, t4), res), out, i);
+		}
+	}
+#endif
+	for ( ; i<q1.size(); i++)
+		out.set(i, slerp(q1.get(i), q2.get(i), t));
+}
+
+void Nlerp(const QuatArray & q1, const QuatArray & q2, float t, QuatArray & out){
+	out.resize(q1.size());
+	size_t i = 0;
+#ifdef QUATERNION_UTILS_SSE
+	__m128 t4 = _mm_set1_ps(t);
+	__m128 oneMinusT = _mm_set1_ps(1.0f - t);
+	for ( ; i+4<=q1.size(); i+=4){
+		Quatx4 a = load4(q1, i);
+		Quatx4 b = load4(q2, i);
+		b = negate4(b, _mm_cmplt_ps(dot4(a, b), _mm_setzero_ps()));
+		store4(normalize4(blend4(a, oneMinusT, b, t4)), out, i);
+	}
+#endif
+	for ( ; i<q1.size(); i++)
+		out.set(i, Nlerp(q1.get(i), q2.get(i), t));
+}
+
+void QuatToMat4(const QuatArray & q, std::vector<mat4> & out){
+	out.resize(q.size());
+	size_t i = 0;
+#ifdef QUATERNION_UTILS_SSE
+	__m128 one = _mm_set1_ps(1.0f);
+	__m128 two = _mm_set1_ps(2.0f);
+	for ( ; i+4<=q.size(); i+=4){
+		Quatx4 r = load4(q, i);
+		__m128 xx = _mm_mul_ps(r.x, r.x), yy = _mm_mul_ps(r.y, r.y), zz = _mm_mul_ps(r.z, r.z);
+		__m128 xz = _mm_mul_ps(r.x, r.z), xy = _mm_mul_ps(r.x, r.y), yz = _mm_mul_ps(r.y, r.z);
+		__m128 wx = _mm_mul_ps(r.w, r.x), wy = _mm_mul_ps(r.w, r.y), wz = _mm_mul_ps(r.w, r.z);
+
+		// columns[c][row] : the same elements as glm::mat4_cast, for the 4 matrices
+		__m128 columns[3][4];
+		columns[0][0] = _mm_sub_ps(one, _mm_mul_ps(two, _mm_add_ps(yy, zz)));
+		columns[0][1] = _mm_mul_ps(two, _mm_add_ps(xy, wz));
+		columns[0][2] = _mm_mul_ps(two, _mm_sub_ps(xz, wy));
+		columns[1][0] = _mm_mul_ps(two, _mm_sub_ps(xy, wz));
+		columns[1][1] = _mm_sub_ps(one, _mm_mul_ps(two, _mm_add_ps(xx, zz)));
+		columns[1][2] = _mm_mul_ps(two, _mm_add_ps(yz, wx));
+		columns[2][0] = _mm_mul_ps(two, _mm_add_ps(xz, wy));
+		columns[2][1] = _mm_mul_ps(two, _mm_sub_ps(yz, wx));
+		columns[2][2] = _mm_sub_ps(one, _mm_mul_ps(two, _mm_add_ps(xx, yy)));
+
+		for (int c=0; c<3; c++){
+			// After the transpose, row k is column c of matrix k
+			columns[c][3] = _mm_setzero_ps();
+			_MM_TRANSPOSE4_PS(columns[c][0], columns[c][1], columns[c][2], columns[c][3]);
+			for (int k=0; k<4; k++)
+				_mm_storeu_ps(&out[i+k][c][0], columns[c][k]);
+		}
+		for (int k=0; k<4; k++)
+			out[i+k][3] = vec4(0.0f, 0.0f, 0.0f, 1.0f);
+	}
+#endif
+	for ( ; i<q.size(); i++)
+		out[i] = mat4_cast(q.get(i));
+}
+
+
+
+static float randomFloat(){
+	return rand() / (float)RAND_MAX * 2.0f - 1.0f;
+}
+
+static vec3 randomVec3(){
+	return vec3(randomFloat(), randomFloat(), randomFloat());
+}
+
+static quat randomQuat(){
+	return normalize(quat(randomFloat(), randomFloat(), randomFloat(), randomFloat()));
+}
+
+static double millisecondsSince(std::chrono::high_resolution_clock::time_point start){
+	return std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+}
+
+static float maxDifference(const QuatArray & batch, const std::vector<quat> & scalar, float & worst){
+	float difference = 0.0f;
+	for (size_t i=0; i<scalar.size(); i++){
+		quat d = batch.get(i) + (-scalar[i]);
+		difference = std::max(difference, std::max(std::max(fabsf(d.x), fabsf(d.y)), std::max(fabsf(d.z), fabsf(d.w))));
+	}
+	worst = std::max(worst, difference);
+	return difference;
+}
+
+static void printComparison(const char * name, float difference, double scalarMilliseconds, double batchMilliseconds, size_t count){
+	printf("%-24s max difference %.2e   scalar %6.1f ns   batch %6.1f ns   (x%.1f)\n", name, difference,
+		scalarMilliseconds * 1e6 / count, batchMilliseconds * 1e6 / count, scalarMilliseconds / batchMilliseconds);
+}
+
+float compareQuaternionBatches(size_t count){
+	Vec3Array vectors1, vectors2;
+	QuatArray quats1, quats2, batch;
+	vectors1.resize(count);
+	vectors2.resize(count);
+	quats1.resize(count);
+	quats2.resize(count);
+	for (size_t i=0; i<count; i++){
+		vectors1.set(i, randomVec3());
+		vectors2.set(i, randomVec3());
+		quats1.set(i, randomQuat());
+		quats2.set(i, randomQuat());
+	}
+	// Some opposite vectors, and some quaternions which are almost equal
+	for (size_t i=0; i<count; i+=97){
+		vectors2.set(i, -vectors1.get(i));
+		quats2.set(i, normalize(quats1.get(i) + quat(0.0f, 1e-4f, 0.0f, 0.0f)));
+	}
+	// The outputs are allocated before, so that only the computations are timed
+	batch.resize(count);
+	std::vector<quat> scalar(count);
+	std::chrono::high_resolution_clock::time_point start;
+	double scalarMilliseconds;
+	float worst = 0.0f;
+
+	start = std::chrono::high_resolution_clock::now();
+	for (size_t i=0; i<count; i++)
+		scalar[i] = RotationBetweenVectors(vectors1.get(i), vectors2.get(i));
+	scalarMilliseconds = millisecondsSince(start);
+	start = std::chrono::high_resolution_clock::now();
+	RotationBetweenVectors(vectors1, vectors2, batch);
+	printComparison("RotationBetweenVectors", maxDifference(batch, scalar, worst), scalarMilliseconds, millisecondsSince(start), count);
+
+	vec3 up(0.0f, 1.0f, 0.0f);
+	start = std::chrono::high_resolution_clock::now();
+	for (size_t i=0; i<count; i++)
+		scalar[i] = LookAt(vectors1.get(i), up);
+	scalarMilliseconds = millisecondsSince(start);
+	start = std::chrono::high_resolution_clock::now();
+	LookAt(vectors1, up, batch);
+	printComparison("LookAt", maxDifference(batch, scalar, worst), scalarMilliseconds, millisecondsSince(start), count);
+
+	start = std::chrono::high_resolution_clock::now();
+	for (size_t i=0; i<count; i++)
+		scalar[i] = RotateTowards(quats1.get(i), quats2.get(i), 0.5f);
+	scalarMilliseconds = millisecondsSince(start);
+	start = std::chrono::high_resolution_clock::now();
+	RotateTowards(quats1, quats2, 0.5f, batch);
+	printComparison("RotateTowards", maxDifference(batch, scalar, worst), scalarMilliseconds, millisecondsSince(start), count);
+
+	start = std::chrono::high_resolution_clock::now();
+	for (size_t i=0; i<count; i++)
+		scalar[i] = slerp(quats1.get(i), quats2.get(i), 0.3f);
+	scalarMilliseconds = millisecondsSince(start);
+	start = std::chrono::high_resolution_clock::now();
+	Slerp(quats1, quats2, 0.3f, batch);
+	printComparison("Slerp", maxDifference(batch, scalar, worst), scalarMilliseconds, millisecondsSince(start), count);
+
+	start = std::chrono::high_resolution_clock::now();
+	for (size_t i=0; i<count; i++)
+		scalar[i] = Nlerp(quats1.get(i), quats2.get(i), 0.3f);
+	scalarMilliseconds = millisecondsSince(start);
+	start = std::chrono::high_resolution_clock::now();
+	Nlerp(quats1, quats2, 0.3f, batch);
+	printComparison("Nlerp", maxDifference(batch, scalar, worst), scalarMilliseconds, millisecondsSince(start), count);
+
+	std::vector<mat4> scalarMatrices(count), batchMatrices(count);
+	start = std::chrono::high_resolution_clock::now();
+	for (size_t i=0; i<count; i++)
+		scalarMatrices[i] = mat4_cast(quats1.get(i));
+	scalarMilliseconds = millisecondsSince(start);
+	start = std::chrono::high_resolution_clock::now();
+	QuatToMat4(quats1, batchMatrices);
+	double batchMilliseconds = millisecondsSince(start);
+	float difference = 0.0f;
+	for (size_t i=0; i<count; i++)
+		for (int c=0; c<4; c++)
+			for (int r=0; r<4; r++)
+				difference = std::max(difference, fabsf(batchMatrices[i][c][r] - scalarMatrices[i][c][r]));
+	printComparison("QuatToMat4", difference, scalarMilliseconds, batchMilliseconds, count);
+	return std::max(worst, difference);
+}
+
+
+
 
 
 
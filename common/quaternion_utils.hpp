@@ -7,5 +7,52 @@ quat LookAt(vec3 direction, vec3 desiredUp);
 
 quat RotateTowards(quat q1, quat q2, float maxAngle);
 
+// Normalized linear interpolation, on the shortest path. Cheaper than slerp, but not at constant speed.
+quat Nlerp(quat q1, quat q2, float t);
+
+
+// The same functions for many quaternions at once : one array per component, so that
+// they are processed 4 at a time with SSE when available.
+// The outputs are resized to the size of the inputs, and can be one of the inputs.
+
+struct Vec3Array{
+	std::vector<float> x, y, z;
+
+	size_t size() const { return x.size(); }
+	void resize(size_t n){ x.resize(n); y.resize(n); z.resize(n); }
+	vec3 get(size_t i) const { return vec3(x[i], y[i], z[i]); }
+	void set(size_t i, vec3 v){ x[i] = v.x; y[i] = v.y; z[i] = v.z; }
+};
+
+struct QuatArray{
+	std::vector<float> x, y, z, w;
+
+	size_t size() const { return x.size(); }
+	void resize(size_t n){ x.resize(n); y.resize(n); z.resize(n); w.resize(n); }
+	quat get(size_t i) const { return quat(w[i], x[i], y[i], z[i]); }
+	void set(size_t i, quat q){ x[i] = q.x; y[i] = q.y; z[i] = q.z; w[i] = q.w; }
+};
+
+void RotationBetweenVectors(const Vec3Array & start, const Vec3Array & dest, QuatArray & out);
+
+// The same desiredUp for all the directions
+void LookAt(const Vec3Array & direction, vec3 desiredUp, QuatArray & out);
+
+// The same maxAngle for all the pairs
+void RotateTowards(const QuatArray & q1, const QuatArray & q2, float maxAngle, QuatArray & out);
+
+// Like glm::slerp. For 0 <= t <= 1, acos and sin are approximated by polynomials : within 1e-6 of glm::slerp
+void Slerp(const QuatArray & q1, const QuatArray & q2, float t, QuatArray & out);
+
+void Nlerp(const QuatArray & q1, const QuatArray & q2, float t, QuatArray & out);
+
+// Like glm::mat4_cast; the quaternions must be normalized
+void QuatToMat4(const QuatArray & q, std::vector<mat4> & out);
+
+// Checks the batch functions against the scalar ones on 'count' random inputs,
+// and prints the largest differences and the time per quaternion of both.
+// Returns the largest difference of all (see tests/quaternion_benchmark.cpp).
+float compareQuaternionBatches(size_t count);
+
 
 #endif // QUATERNION_UTILS_H
\ No newline at end of file
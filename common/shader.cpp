@@ -5,108 +5,468 @@
 #include <fstream>
 #include <algorithm>
 #include <sstream>
+#include <map>
 using namespace std;
 
 #include <stdlib.h>
 #include <string.h>
+#include <chrono>
+
+#include <sys/types.h>
+#include <sys/stat.h>
+#ifdef _WIN32
+#include <direct.h>
+#endif
 
 #include <GL/glew.h>
 
+#include <GLFW/glfw3.h>
+
+#include "shaderpreprocessor.hpp"
 #include "shader.hpp"
+#include "profiler.hpp"
 
-GLuint LoadShaders(const char* vertex_file_path, const char* fragment_file_path) {
+// The program cache : after a program has been linked, its binary (glGetProgramBinary) is saved in
+// shaderCacheDirectory, under a hash of the sources and of the driver. The next runs give it back to
+// glProgramBinary instead of compiling the shaders. A new driver or a modified shader changes the hash,
+// so the old binary is simply not used anymore; a binary which the driver rejects is compiled again.
 
-	// Create the shaders
-	GLuint VertexShaderID = glCreateShader(GL_VERTEX_SHADER);
-	GLuint FragmentShaderID = glCreateShader(GL_FRAGMENT_SHADER);
-
-	// Read the Vertex Shader code from the file
-	std::string VertexShaderCode;
-	std::ifstream VertexShaderStream(vertex_file_path, std::ios::in);
-	if (VertexShaderStream.is_open()) {
-		std::stringstream sstr;
-		sstr << VertexShaderStream.rdbuf();
-		VertexShaderCode = sstr.str();
-		VertexShaderStream.close();
+static std::string shaderCacheDirectory = "shadercache";
+static ShaderLoadStats shaderLoadStats = { 0, 0, 0.0 };
+
+#define PROGRAM_CACHE_MAGIC   0x42505247 // "GRPB"
+#define PROGRAM_CACHE_VERSION 1
+
+void setShaderCacheDirectory(const char * path){
+	shaderCacheDirectory = path ? path : "";
+}
+
+const ShaderLoadStats & getShaderLoadStats(){
+	return shaderLoadStats;
+}
+
+void printShaderLoadStats(){
+	printf("%u programs loaded in %.1f ms, %u from the cache\n",
+		shaderLoadStats.programCount, shaderLoadStats.seconds * 1000.0, shaderLoadStats.cacheHits);
+}
+
+// 64-bit FNV-1a
+static unsigned long long hashString(unsigned long long hash, const char * s){
+	// Include the terminating 0, so that "ab"+"c" and "a"+"bc" are different
+	do{
+		hash ^= (unsigned char)*s;
+		hash *= 1099511628211ULL;
+	}while (*s++);
+	return hash;
+}
+
+static unsigned long long programCacheKey(const std::string & VertexShaderCode, const std::string & FragmentShaderCode){
+	unsigned long long hash = 14695981039346656037ULL;
+	hash = hashString(hash, VertexShaderCode.c_str());
+	hash = hashString(hash, FragmentShaderCode.c_str());
+	GLenum strings[4] = { GL_VENDOR, GL_RENDERER, GL_VERSION, GL_SHADING_LANGUAGE_VERSION };
+	for (int i=0; i<4; i++){
+		const char * s = (const char *)glGetString(strings[i]);
+		hash = hashString(hash, s ? s : "");
 	}
-	else {
-		printf("Impossible to open %s. Are you in the right directory ? Don't forget to read the FAQ !\n", vertex_file_path);
-		getchar();
+	return hash;
+}
+
+static bool programBinariesSupported(){
+	if (shaderCacheDirectory.empty() || !(GLEW_VERSION_4_1 || GLEW_ARB_get_program_binary))
+		return false;
+	GLint formatCount = 0;
+	glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formatCount);
+	return formatCount > 0;
+}
+
+static std::string programCachePath(unsigned long long key){
+	char name[32];
+	sprintf(name, "/%016llx.bin", key);
+	return shaderCacheDirectory + name;
+}
+
+// Returns a linked program, or 0 if the binary isn't in the cache or the driver doesn't take it anymore
+static GLuint loadCachedProgram(unsigned long long key){
+	std::string path = programCachePath(key);
+	FILE * file = fopen(path.c_str(), "rb");
+	if (file == NULL)
 		return 0;
-	}
 
-	// Read the Fragment Shader code from the file
-	std::string FragmentShaderCode;
-	std::ifstream FragmentShaderStream(fragment_file_path, std::ios::in);
-	if (FragmentShaderStream.is_open()) {
-		std::stringstream sstr;
-		sstr << FragmentShaderStream.rdbuf();
-		FragmentShaderCode = sstr.str();
-		FragmentShaderStream.close();
+	unsigned int header[4]; // magic, version, binary format, binary length
+	unsigned long long fileKey = 0;
+	std::vector<char> binary;
+	// The binary length must be what is left in the file : a corrupt one could ask for gigabytes, or not fit in a GLsizei
+	long fileSize = fseek(file, 0, SEEK_END) == 0 ? ftell(file) : -1;
+	const long binaryStart = sizeof(header) + sizeof(fileKey);
+	bool ok = fileSize > binaryStart && fseek(file, 0, SEEK_SET) == 0 &&
+	          fread(header, sizeof(header), 1, file) == 1 && fread(&fileKey, sizeof(fileKey), 1, file) == 1 &&
+	          header[0] == PROGRAM_CACHE_MAGIC && header[1] == PROGRAM_CACHE_VERSION && fileKey == key &&
+	          (unsigned long)header[3] == (unsigned long)(fileSize - binaryStart) && header[3] <= 0x7FFFFFFF;
+	if (ok){
+		binary.resize(header[3]);
+		ok = fread(&binary[0], binary.size(), 1, file) == 1;
+	}
+	fclose(file);
+	if (!ok){
+		printf("Ignoring the invalid cached program %s\n", path.c_str());
+		remove(path.c_str());
+		return 0;
 	}
 
+	GLuint ProgramID = glCreateProgram();
+	glProgramParameteri(ProgramID, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+	glProgramBinary(ProgramID, header[2], &binary[0], (GLsizei)binary.size());
 	GLint Result = GL_FALSE;
-	int InfoLogLength;
+	glGetProgramiv(ProgramID, GL_LINK_STATUS, &Result);
+	if (Result != GL_TRUE){
+		// Typically, the driver has been updated without changing its version string
+		printf("The driver rejected the cached program %s; compiling it again\n", path.c_str());
+		glDeleteProgram(ProgramID);
+		remove(path.c_str());
+		return 0;
+	}
+	return ProgramID;
+}
 
+static void saveCachedProgram(unsigned long long key, GLuint ProgramID){
+	GLint length = 0;
+	glGetProgramiv(ProgramID, GL_PROGRAM_BINARY_LENGTH, &length);
+	if (length <= 0)
+		return;
+	std::vector<char> binary(length);
+	GLenum format = 0;
+	glGetProgramBinary(ProgramID, length, &length, &format, &binary[0]);
+	if (length <= 0)
+		return;
 
-	// Compile Vertex Shader
-	printf("Compiling shader : %s\n", vertex_file_path);
-	char const* VertexSourcePointer = VertexShaderCode.c_str();
-	glShaderSource(VertexShaderID, 1, &VertexSourcePointer, NULL);
-	glCompileShader(VertexShaderID);
+#ifdef _WIN32
+	_mkdir(shaderCacheDirectory.c_str());
+#else
+	mkdir(shaderCacheDirectory.c_str(), 0755);
+#endif
 
-	// Check Vertex Shader
-	glGetShaderiv(VertexShaderID, GL_COMPILE_STATUS, &Result);
-	glGetShaderiv(VertexShaderID, GL_INFO_LOG_LENGTH, &InfoLogLength);
-	if (InfoLogLength > 0) {
-		std::vector<char> VertexShaderErrorMessage(InfoLogLength + 1);
-		glGetShaderInfoLog(VertexShaderID, InfoLogLength, NULL, &VertexShaderErrorMessage[0]);
-		printf("%s\n", &VertexShaderErrorMessage[0]);
+	// Write to a temporary file first, so that a crash never leaves a half-written binary behind
+	std::string path = programCachePath(key);
+	std::string tempPath = path + ".tmp";
+	FILE * file = fopen(tempPath.c_str(), "wb");
+	if (file == NULL){
+		printf("Can't write %s : the program won't be cached\n", tempPath.c_str());
+		return;
 	}
+	unsigned int header[4] = { PROGRAM_CACHE_MAGIC, PROGRAM_CACHE_VERSION, format, (unsigned int)length };
+	bool ok = fwrite(header, sizeof(header), 1, file) == 1 && fwrite(&key, sizeof(key), 1, file) == 1 &&
+	          fwrite(&binary[0], length, 1, file) == 1;
+	ok = fclose(file) == 0 && ok;
+	remove(path.c_str()); // rename() doesn't overwrite on Windows
+	if (!ok || rename(tempPath.c_str(), path.c_str()) != 0)
+		remove(tempPath.c_str());
+}
+
+// Programs submitted by LoadShadersAsync, whose status hasn't been checked yet
+struct PendingProgram{
+	GLuint ProgramID;
+	GLuint VertexShaderID;
+	GLuint FragmentShaderID;
+	std::string vertex_file_path;
+	std::string fragment_file_path;
+	bool useCache;
+	unsigned long long cacheKey;
+	std::chrono::high_resolution_clock::time_point submitTime;
+	std::chrono::high_resolution_clock::time_point completionTime; // when GL_COMPLETION_STATUS became true
+	bool completed;
+};
 
+static std::vector<PendingProgram> pendingPrograms;
+static ShaderTimingFunction shaderTimingFunction = NULL;
+static bool parallelCompileChecked = false;
+static bool parallelCompileSupported = false;
+
+void setShaderTimingFunction(ShaderTimingFunction function){
+	shaderTimingFunction = function;
+}
+
+static bool hasExtension(const char * name){
+	GLint count = 0;
+	glGetIntegerv(GL_NUM_EXTENSIONS, &count);
+	for (GLint i=0; i<count; i++){
+		const char * extension = (const char *)glGetStringi(GL_EXTENSIONS, i);
+		if (extension && strcmp(extension, name) == 0)
+			return true;
+	}
+	return false;
+}
+
+// With KHR_parallel_shader_compile (or its ARB version), glCompileShader and glLinkProgram return
+// immediately and the driver compiles on its own threads, as long as nobody asks for the status.
+static void enableParallelShaderCompile(){
+	if (parallelCompileChecked)
+		return;
+	parallelCompileChecked = true;
+
+	typedef void (APIENTRY * MaxShaderCompilerThreadsFunction)(GLuint count);
+	MaxShaderCompilerThreadsFunction maxShaderCompilerThreads = NULL;
+	if (hasExtension("GL_KHR_parallel_shader_compile"))
+		maxShaderCompilerThreads = (MaxShaderCompilerThreadsFunction)glfwGetProcAddress("glMaxShaderCompilerThreadsKHR");
+	else if (GLEW_ARB_parallel_shader_compile)
+		maxShaderCompilerThreads = (MaxShaderCompilerThreadsFunction)glMaxShaderCompilerThreadsARB;
+	if (maxShaderCompilerThreads == NULL)
+		return;
+
+	// As many threads as the driver wants
+	maxShaderCompilerThreads(0xFFFFFFFF);
+	parallelCompileSupported = true;
+}
+
+static void reportShaderTime(const char * vertex_file_path, const char * fragment_file_path,
+	std::chrono::high_resolution_clock::time_point start, std::chrono::high_resolution_clock::time_point end, bool fromCache){
+	if (shaderTimingFunction)
+		shaderTimingFunction(vertex_file_path, fragment_file_path, std::chrono::duration<double, std::milli>(end - start).count(), fromCache);
+}
+
+// Reads, compiles and links, but doesn't wait for the driver : nothing is checked here.
+// Returns false if the vertex shader can't be read. A program found in the cache is already complete.
+static bool submitProgram(const char * vertex_file_path, const char * fragment_file_path, const std::vector<std::string> & defines,
+	PendingProgram & out_program){
+
+	out_program.submitTime = std::chrono::high_resolution_clock::now();
+	out_program.vertex_file_path = vertex_file_path;
+	out_program.fragment_file_path = fragment_file_path;
+	out_program.VertexShaderID = 0;
+	out_program.FragmentShaderID = 0;
+	out_program.completed = false;
+
+	// Read the Vertex Shader code from the file, with its #includes and #defines (see shaderpreprocessor.hpp)
+	PreprocessedShader VertexShader;
+	if (!preprocessShader(vertex_file_path, defines, VertexShader)) {
+		printf("Impossible to open %s. Are you in the right directory ? Don't forget to read the FAQ !\n", vertex_file_path);
+		getchar();
+		return false;
+	}
+	const std::string & VertexShaderCode = VertexShader.source;
+
+	// Read the Fragment Shader code from the file
+	PreprocessedShader FragmentShader;
+	preprocessShader(fragment_file_path, defines, FragmentShader);
+	const std::string & FragmentShaderCode = FragmentShader.source;
 
+	shaderLoadStats.programCount++;
+
+	// Try the cache first
+	out_program.useCache = programBinariesSupported();
+	out_program.cacheKey = 0;
+	if (out_program.useCache){
+		out_program.cacheKey = programCacheKey(VertexShaderCode, FragmentShaderCode);
+		out_program.ProgramID = loadCachedProgram(out_program.cacheKey);
+		if (out_program.ProgramID != 0){
+			printf("Loaded program %s + %s from the cache\n", vertex_file_path, fragment_file_path);
+			shaderLoadStats.cacheHits++;
+			out_program.completed = true;
+			out_program.completionTime = std::chrono::high_resolution_clock::now();
+			reportShaderTime(vertex_file_path, fragment_file_path, out_program.submitTime, out_program.completionTime, true);
+			return true;
+		}
+	}
+
+	// Create the shaders
+	out_program.VertexShaderID = glCreateShader(GL_VERTEX_SHADER);
+	out_program.FragmentShaderID = glCreateShader(GL_FRAGMENT_SHADER);
+
+	// Compile Vertex Shader
+	printf("Compiling shader : %s\n", vertex_file_path);
+	char const* VertexSourcePointer = VertexShaderCode.c_str();
+	glShaderSource(out_program.VertexShaderID, 1, &VertexSourcePointer, NULL);
+	glCompileShader(out_program.VertexShaderID);
 
 	// Compile Fragment Shader
 	printf("Compiling shader : %s\n", fragment_file_path);
 	char const* FragmentSourcePointer = FragmentShaderCode.c_str();
-	glShaderSource(FragmentShaderID, 1, &FragmentSourcePointer, NULL);
-	glCompileShader(FragmentShaderID);
+	glShaderSource(out_program.FragmentShaderID, 1, &FragmentSourcePointer, NULL);
+	glCompileShader(out_program.FragmentShaderID);
 
-	// Check Fragment Shader
-	glGetShaderiv(FragmentShaderID, GL_COMPILE_STATUS, &Result);
-	glGetShaderiv(FragmentShaderID, GL_INFO_LOG_LENGTH, &InfoLogLength);
+	// Link the program. The link waits for the compilations, on the driver's side
+	printf("Linking program\n");
+	out_program.ProgramID = glCreateProgram();
+	glAttachShader(out_program.ProgramID, out_program.VertexShaderID);
+	glAttachShader(out_program.ProgramID, out_program.FragmentShaderID);
+	if (out_program.useCache)
+		glProgramParameteri(out_program.ProgramID, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+	glLinkProgram(out_program.ProgramID);
+	return true;
+}
+
+static void printShaderLog(GLuint ShaderID){
+	int InfoLogLength;
+	glGetShaderiv(ShaderID, GL_INFO_LOG_LENGTH, &InfoLogLength);
 	if (InfoLogLength > 0) {
-		std::vector<char> FragmentShaderErrorMessage(InfoLogLength + 1);
-		glGetShaderInfoLog(FragmentShaderID, InfoLogLength, NULL, &FragmentShaderErrorMessage[0]);
-		printf("%s\n", &FragmentShaderErrorMessage[0]);
+		std::vector<char> ShaderErrorMessage(InfoLogLength + 1);
+		glGetShaderInfoLog(ShaderID, InfoLogLength, NULL, &ShaderErrorMessage[0]);
+		printf("%s\n", &ShaderErrorMessage[0]);
 	}
+}
 
+// Waits for the driver, prints the logs, and saves the program in the cache. Returns the link status.
+static bool finishProgram(PendingProgram & program){
 
+	if (program.VertexShaderID == 0) // from the cache
+		return true;
 
-	// Link the program
-	printf("Linking program\n");
-	GLuint ProgramID = glCreateProgram();
-	glAttachShader(ProgramID, VertexShaderID);
-	glAttachShader(ProgramID, FragmentShaderID);
-	glLinkProgram(ProgramID);
+	GLint Result = GL_FALSE;
+	int InfoLogLength;
+
+	// Check Vertex Shader
+	glGetShaderiv(program.VertexShaderID, GL_COMPILE_STATUS, &Result);
+	if (Result != GL_TRUE)
+		printf("Error in %s :\n", program.vertex_file_path.c_str());
+	printShaderLog(program.VertexShaderID);
+
+	// Check Fragment Shader
+	glGetShaderiv(program.FragmentShaderID, GL_COMPILE_STATUS, &Result);
+	if (Result != GL_TRUE)
+		printf("Error in %s :\n", program.fragment_file_path.c_str());
+	printShaderLog(program.FragmentShaderID);
 
 	// Check the program
-	glGetProgramiv(ProgramID, GL_LINK_STATUS, &Result);
-	glGetProgramiv(ProgramID, GL_INFO_LOG_LENGTH, &InfoLogLength);
+	glGetProgramiv(program.ProgramID, GL_LINK_STATUS, &Result);
+	glGetProgramiv(program.ProgramID, GL_INFO_LOG_LENGTH, &InfoLogLength);
 	if (InfoLogLength > 0) {
 		std::vector<char> ProgramErrorMessage(InfoLogLength + 1);
-		glGetProgramInfoLog(ProgramID, InfoLogLength, NULL, &ProgramErrorMessage[0]);
+		glGetProgramInfoLog(program.ProgramID, InfoLogLength, NULL, &ProgramErrorMessage[0]);
 		printf("%s\n", &ProgramErrorMessage[0]);
 	}
+	if (!program.completed){
+		program.completed = true;
+		program.completionTime = std::chrono::high_resolution_clock::now();
+	}
 
+	glDetachShader(program.ProgramID, program.VertexShaderID);
+	glDetachShader(program.ProgramID, program.FragmentShaderID);
 
-	glDetachShader(ProgramID, VertexShaderID);
-	glDetachShader(ProgramID, FragmentShaderID);
+	glDeleteShader(program.VertexShaderID);
+	glDeleteShader(program.FragmentShaderID);
+	program.VertexShaderID = 0;
+	program.FragmentShaderID = 0;
 
-	glDeleteShader(VertexShaderID);
-	glDeleteShader(FragmentShaderID);
+	if (program.useCache && Result == GL_TRUE)
+		saveCachedProgram(program.cacheKey, program.ProgramID);
 
-	return ProgramID;
+	reportShaderTime(program.vertex_file_path.c_str(), program.fragment_file_path.c_str(), program.submitTime, program.completionTime, false);
+	return Result == GL_TRUE;
+}
+
+// Notes when the driver has finished the pending programs, without waiting, for the timings
+static void pollPendingPrograms(){
+	if (!parallelCompileSupported)
+		return;
+	for (size_t i=0; i<pendingPrograms.size(); i++){
+		PendingProgram & program = pendingPrograms[i];
+		if (program.completed)
+			continue;
+		GLint completed = GL_FALSE;
+		glGetProgramiv(program.ProgramID, GL_COMPLETION_STATUS_ARB, &completed);
+		if (completed){
+			program.completed = true;
+			program.completionTime = std::chrono::high_resolution_clock::now();
+		}
+	}
+}
+
+GLuint LoadShaders(const char* vertex_file_path, const char* fragment_file_path) {
+
+	PROFILE_SCOPE("LoadShaders");
+	std::chrono::high_resolution_clock::time_point startTime = std::chrono::high_resolution_clock::now();
+
+	PendingProgram program;
+	if (!submitProgram(vertex_file_path, fragment_file_path, std::vector<std::string>(), program))
+		return 0;
+	finishProgram(program);
+
+	shaderLoadStats.seconds += std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - startTime).count();
+	return program.ProgramID;
 }
 
+GLuint LoadShadersAsync(const char * vertex_file_path, const char * fragment_file_path){
+
+	PROFILE_SCOPE("LoadShadersAsync");
+	std::chrono::high_resolution_clock::time_point startTime = std::chrono::high_resolution_clock::now();
+
+	enableParallelShaderCompile();
+	pollPendingPrograms();
 
+	PendingProgram program;
+	if (!submitProgram(vertex_file_path, fragment_file_path, std::vector<std::string>(), program))
+		return 0;
+	if (program.VertexShaderID != 0)
+		pendingPrograms.push_back(program);
+
+	shaderLoadStats.seconds += std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - startTime).count();
+	return program.ProgramID;
+}
+
+bool isShaderProgramReady(GLuint programID){
+	pollPendingPrograms();
+	for (size_t i=0; i<pendingPrograms.size(); i++)
+		if (pendingPrograms[i].ProgramID == programID)
+			return pendingPrograms[i].completed;
+	return true;
+}
+
+bool finishShaders(GLuint programID){
+	for (size_t i=0; i<pendingPrograms.size(); i++){
+		if (pendingPrograms[i].ProgramID != programID)
+			continue;
+		PROFILE_SCOPE("finishShaders");
+		std::chrono::high_resolution_clock::time_point startTime = std::chrono::high_resolution_clock::now();
+		pollPendingPrograms();
+		PendingProgram program = pendingPrograms[i];
+		pendingPrograms.erase(pendingPrograms.begin() + i);
+		bool ok = finishProgram(program);
+		shaderLoadStats.seconds += std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - startTime).count();
+		return ok;
+	}
+
+	// Not pending : already checked, or loaded with LoadShaders
+	GLint Result = GL_FALSE;
+	glGetProgramiv(programID, GL_LINK_STATUS, &Result);
+	return Result == GL_TRUE;
+}
+
+void UseShaders(GLuint programID){
+	if (!pendingPrograms.empty())
+		finishShaders(programID);
+	glUseProgram(programID);
+}
+
+// The variants already loaded, by their expanded vertex and fragment sources
+typedef std::pair<std::string, std::string> ShaderSources;
+static std::map<ShaderSources, GLuint> shaderVariants;
+
+GLuint LoadShaderVariant(const char * vertex_file_path, const char * fragment_file_path, const char * defines){
+
+	PROFILE_SCOPE("LoadShaderVariant");
+	std::chrono::high_resolution_clock::time_point startTime = std::chrono::high_resolution_clock::now();
+
+	std::vector<std::string> defineList;
+	parseShaderDefines(defines, defineList);
+
+	// Same sources as a variant which is already there ? The preprocessor only keeps
+	// the #defines which the shaders use, so this happens as soon as a define is useless.
+	PreprocessedShader VertexShader, FragmentShader;
+	if (preprocessShader(vertex_file_path, defineList, VertexShader) && preprocessShader(fragment_file_path, defineList, FragmentShader)){
+		ShaderSources key(VertexShader.source, FragmentShader.source);
+		std::map<ShaderSources, GLuint>::const_iterator it = shaderVariants.find(key);
+		if (it != shaderVariants.end() && glIsProgram(it->second))
+			return it->second;
+
+		PendingProgram program;
+		if (!submitProgram(vertex_file_path, fragment_file_path, defineList, program))
+			return 0;
+		finishProgram(program);
+		shaderVariants[key] = program.ProgramID;
+		shaderLoadStats.seconds += std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - startTime).count();
+		return program.ProgramID;
+	}
+
+	// Let LoadShaders say what is missing
+	return LoadShaders(vertex_file_path, fragment_file_path);
+}
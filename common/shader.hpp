@@ -3,4 +3,43 @@
 
 GLuint LoadShaders(const char * vertex_file_path,const char * fragment_file_path);
 
+// LoadShaders, with "NAME NAME=VALUE ..." as #defines after the #version line of both shaders.
+// Variants whose sources are the same once expanded (see shaderpreprocessor.hpp) are only compiled
+// once, and return the same program : delete it only once.
+// All the loaders also expand #include "file".
+GLuint LoadShaderVariant(const char * vertex_file_path, const char * fragment_file_path, const char * defines);
+
+// LoadShaders keeps the linked programs in this directory (with glGetProgramBinary, when the driver
+// supports it), so that the next runs don't have to compile the shaders again.
+// "shadercache" by default; NULL disables the cache.
+void setShaderCacheDirectory(const char * path);
+
+// Submits the compilation and the link, and returns immediately : the status is only checked
+// when the program is first used (UseShaders), so several programs compile at the same time
+// when the driver has KHR_parallel_shader_compile. Load all the programs first, then use them.
+GLuint LoadShadersAsync(const char * vertex_file_path, const char * fragment_file_path);
+
+// Without waiting : has the driver finished compiling and linking this program ?
+bool isShaderProgramReady(GLuint programID);
+
+// Waits for the program, prints its logs, and returns its link status
+bool finishShaders(GLuint programID);
+
+// glUseProgram, which finishes the program if it was loaded by LoadShadersAsync and not finished yet
+void UseShaders(GLuint programID);
+
+// Called once per program, when it is complete, with the time it took since its submission
+// (until its status was known, without KHR_parallel_shader_compile)
+typedef void (*ShaderTimingFunction)(const char * vertex_file_path, const char * fragment_file_path, double milliseconds, bool fromCache);
+void setShaderTimingFunction(ShaderTimingFunction function);
+
+// What LoadShaders has done so far, to measure the startup time
+struct ShaderLoadStats{
+	unsigned int programCount;
+	unsigned int cacheHits;  // programs which didn't have to be compiled
+	double seconds;          // total time spent in LoadShaders, LoadShadersAsync and finishShaders
+};
+const ShaderLoadStats & getShaderLoadStats();
+void printShaderLoadStats();
+
 #endif
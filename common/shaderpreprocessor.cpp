@@ -0,0 +1,252 @@
+#include <stdio.h>
+#include <string>
+#include <vector>
+#include <map>
+#include <fstream>
+#include <sstream>
+#include <algorithm>
+
+#include <string.h>
+#include <ctype.h>
+
+#include "shaderpreprocessor.hpp"
+
+// Files, as read from the disk, and preprocessed results, keyed by path + defines
+static std::map<std::string, std::string> fileCache;
+static std::map<std::string, PreprocessedShader> resultCache;
+
+#define MAX_INCLUDE_DEPTH 32
+
+unsigned long long hashShaderSource(const std::string & source){
+	unsigned long long hash = 14695981039346656037ULL;
+	for (size_t i=0; i<source.size(); i++){
+		hash ^= (unsigned char)source[i];
+		hash *= 1099511628211ULL;
+	}
+	return hash;
+}
+
+void clearShaderPreprocessorCache(){
+	fileCache.clear();
+	resultCache.clear();
+}
+
+static bool readFile(const std::string & path, std::string & out_text){
+	std::map<std::string, std::string>::const_iterator it = fileCache.find(path);
+	if (it != fileCache.end()){
+		out_text = it->second;
+		return true;
+	}
+	std::ifstream stream(path.c_str(), std::ios::in);
+	if (!stream.is_open())
+		return false;
+	std::stringstream sstr;
+	sstr << stream.rdbuf();
+	out_text = sstr.str();
+	fileCache[path] = out_text;
+	return true;
+}
+
+static std::string directoryOf(const std::string & path){
+	size_t slash = path.find_last_of("/\\");
+	return slash == std::string::npos ? std::string() : path.substr(0, slash + 1);
+}
+
+static const char * skipSpaces(const char * p){
+	while (*p == ' ' || *p == '\t')
+		p++;
+	return p;
+}
+
+// If line is '#include "name"', returns true and the name
+static bool parseInclude(const std::string & line, std::string & out_name){
+	const char * p = skipSpaces(line.c_str());
+	if (*p != '#')
+		return false;
+	p = skipSpaces(p + 1);
+	if (strncmp(p, "include", 7) != 0)
+		return false;
+	p = skipSpaces(p + 7);
+	if (*p != '"')
+		return false;
+	const char * end = strchr(p + 1, '"');
+	if (end == NULL)
+		return false;
+	out_name.assign(p + 1, end);
+	return true;
+}
+
+static bool isVersionLine(const std::string & line){
+	const char * p = skipSpaces(line.c_str());
+	if (*p != '#')
+		return false;
+	p = skipSpaces(p + 1);
+	return strncmp(p, "version", 7) == 0;
+}
+
+// Skips the spaces, new lines and comments from 'at' : what may come before #version.
+// Counts the new lines in lineNumber.
+static size_t skipSpacesAndComments(const std::string & source, size_t at, unsigned int & lineNumber){
+	while (at < source.size()){
+		char c = source[at];
+		if (c == ' ' || c == '\t' || c == '\r'){
+			at++;
+		}else if (c == '\n'){
+			lineNumber++;
+			at++;
+		}else if (source.compare(at, 2, "//") == 0){
+			at = source.find('\n', at);
+			if (at == std::string::npos)
+				return source.size();
+		}else if (source.compare(at, 2, "/*") == 0){
+			size_t end = source.find("*/", at + 2);
+			end = end == std::string::npos ? source.size() : end + 2;
+			lineNumber += (unsigned int)std::count(source.begin() + at, source.begin() + end, '\n');
+			at = end;
+		}else{
+			break;
+		}
+	}
+	return at;
+}
+
+static void appendLineDirective(std::string & out, unsigned int line, size_t fileIndex){
+	char directive[64];
+	sprintf(directive, "#line %u %u\n", line, (unsigned int)fileIndex);
+	out += directive;
+}
+
+static bool expandFile(const std::string & path, int depth, std::vector<std::string> & files, std::string & out){
+	std::string text;
+	if (!readFile(path, text))
+		return false;
+	size_t fileIndex = files.size();
+	files.push_back(path);
+
+	unsigned int lineNumber = 0;
+	size_t start = 0;
+	while (start < text.size()){
+		size_t end = text.find('\n', start);
+		if (end == std::string::npos)
+			end = text.size();
+		std::string line = text.substr(start, end - start);
+		start = end + 1;
+		lineNumber++;
+
+		std::string name;
+		if (!parseInclude(line, name)){
+			out += line;
+			out += '\n';
+			continue;
+		}
+
+		std::string includePath = directoryOf(path) + name;
+		if (std::find(files.begin(), files.end(), includePath) != files.end()){
+			out += '\n'; // already there : keep the line numbers
+			continue;
+		}
+		if (depth >= MAX_INCLUDE_DEPTH){
+			printf("%s:%u : too many nested #include\n", path.c_str(), lineNumber);
+			return false;
+		}
+		appendLineDirective(out, 1, files.size());
+		if (!expandFile(includePath, depth + 1, files, out)){
+			printf("%s:%u : can't include %s\n", path.c_str(), lineNumber, includePath.c_str());
+			return false;
+		}
+		appendLineDirective(out, lineNumber + 1, fileIndex);
+	}
+	return true;
+}
+
+// Does the identifier 'name' appear in source, as a whole word ?
+static bool containsIdentifier(const std::string & source, const std::string & name){
+	for (size_t at = source.find(name); at != std::string::npos; at = source.find(name, at + 1)){
+		char before = at > 0 ? source[at - 1] : ' ';
+		char after = at + name.size() < source.size() ? source[at + name.size()] : ' ';
+		bool wordBefore = isalnum((unsigned char)before) || before == '_';
+		bool wordAfter = isalnum((unsigned char)after) || after == '_';
+		if (!wordBefore && !wordAfter)
+			return true;
+	}
+	return false;
+}
+
+bool preprocessShader(const char * path, const std::vector<std::string> & defines, PreprocessedShader & out_shader){
+
+	// The order of the defines doesn't matter
+	std::vector<std::string> sortedDefines = defines;
+	std::sort(sortedDefines.begin(), sortedDefines.end());
+	std::string key = path;
+	for (size_t i=0; i<sortedDefines.size(); i++)
+		key += "\n" + sortedDefines[i];
+	std::map<std::string, PreprocessedShader>::const_iterator it = resultCache.find(key);
+	if (it != resultCache.end()){
+		out_shader = it->second;
+		return true;
+	}
+
+	PreprocessedShader shader;
+	std::string expanded;
+	if (!expandFile(path, 0, shader.files, expanded))
+		return false;
+
+	// The #defines which are actually used
+	std::string defineLines;
+	for (size_t i=0; i<sortedDefines.size(); i++){
+		std::string name = sortedDefines[i], value;
+		size_t equal = name.find('=');
+		if (equal != std::string::npos){
+			value = name.substr(equal + 1);
+			name = name.substr(0, equal);
+		}
+		if (!containsIdentifier(expanded, name))
+			continue;
+		defineLines += "#define " + name + (value.empty() ? "" : " " + value) + "\n";
+	}
+
+	if (defineLines.empty()){
+		shader.source = expanded;
+	}else{
+		// After #version, which must come first : only comments may be before it
+		unsigned int lineNumber = 1, versionLine = 0;
+		size_t at = skipSpacesAndComments(expanded, 0, lineNumber);
+		size_t end = expanded.find('\n', at);
+		end = end == std::string::npos ? expanded.size() : end;
+		size_t start = 0;
+		if (isVersionLine(expanded.substr(at, end - at))){
+			versionLine = lineNumber;
+			start = end < expanded.size() ? end + 1 : end;
+		}
+		shader.source = expanded.substr(0, start) + defineLines;
+		appendLineDirective(shader.source, versionLine + 1, 0);
+		shader.source += expanded.substr(start);
+	}
+	shader.hash = hashShaderSource(shader.source);
+
+	resultCache[key] = shader;
+	out_shader = shader;
+	return true;
+}
+
+void parseShaderDefines(const char * defines, std::vector<std::string> & out_defines){
+	out_defines.clear();
+	if (defines == NULL)
+		return;
+	std::stringstream sstr(defines);
+	std::string define;
+	while (sstr >> define)
+		out_defines.push_back(define);
+}
+
+void shaderPermutations(const std::vector<std::string> & keys, std::vector<std::vector<std::string> > & out_permutations){
+	out_permutations.clear();
+	if (keys.size() >= 31)
+		return;
+	size_t count = (size_t)1 << keys.size();
+	out_permutations.resize(count);
+	for (size_t mask=0; mask<count; mask++)
+		for (size_t k=0; k<keys.size(); k++)
+			if (mask & ((size_t)1 << k))
+				out_permutations[mask].push_back(keys[k]);
+}
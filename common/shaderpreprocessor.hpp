@@ -0,0 +1,33 @@
+#ifndef SHADERPREPROCESSOR_HPP
+#define SHADERPREPROCESSOR_HPP
+
+// What GLSL doesn't do by itself : #include "file", and variants of the same shader
+// with different #defines ("permutations"). This only works on text; no OpenGL here.
+
+struct PreprocessedShader{
+	std::string source;              // ready for glShaderSource
+	std::vector<std::string> files;  // the source string numbers of the #line directives : files[0] is the main file
+	unsigned long long hash;         // of source
+};
+
+// Reads path and replaces each #include "file" (relative to the including file) by the file itself.
+// A file is only included once, even if several files include it.
+// Each of 'defines' ("NAME" or "NAME=VALUE") becomes a #define after the #version line, but only
+// if NAME appears in the shader : variants which only differ by unused defines get the same source.
+// The results are cached, per file and set of defines. Returns false if a file can't be read.
+bool preprocessShader(const char * path, const std::vector<std::string> & defines, PreprocessedShader & out_shader);
+
+// Splits "NORMAL_MAP SPECULAR_POWER=8" into { "NORMAL_MAP", "SPECULAR_POWER=8" }
+void parseShaderDefines(const char * defines, std::vector<std::string> & out_defines);
+
+// All the combinations of the given keys, each one defined or not : 2^keys.size() sets of defines,
+// starting with the empty one.
+void shaderPermutations(const std::vector<std::string> & keys, std::vector<std::vector<std::string> > & out_permutations);
+
+// 64-bit FNV-1a
+unsigned long long hashShaderSource(const std::string & source);
+
+// Forgets the cached files and results, for instance after the shaders have been edited
+void clearShaderPreprocessorCache();
+
+#endif
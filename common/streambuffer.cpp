@@ -0,0 +1,192 @@
+#include <vector>
+#include <string.h>
+
+#include <GL/glew.h>
+
+#include "streambuffer.hpp"
+#include "profiler.hpp"
+
+#define STREAM_BUFFER_ALIGNMENT 64 // a cache line : two threads never write the same one
+
+static size_t alignStreamOffset(size_t offset){
+	return (offset + STREAM_BUFFER_ALIGNMENT - 1) & ~(size_t)(STREAM_BUFFER_ALIGNMENT - 1);
+}
+
+static const GLbitfield PersistentFlags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+
+// Creates the buffer for stream.mode and stream.frameSize. Returns false if STREAM_PERSISTENT can't be mapped.
+static bool createStreamStorage(StreamBuffer & stream){
+	glGenBuffers(1, &stream.buffer);
+	glBindBuffer(GL_ARRAY_BUFFER, stream.buffer);
+	stream.mapped = NULL;
+	stream.part = 0;
+	stream.offset = 0;
+	for (int p=0; p<STREAM_BUFFER_PARTS; p++)
+		stream.fences[p] = 0;
+
+	switch (stream.mode){
+	case STREAM_PERSISTENT:
+		stream.size = stream.frameSize * STREAM_BUFFER_PARTS;
+		glBufferStorage(GL_ARRAY_BUFFER, stream.size, NULL, PersistentFlags);
+		stream.mapped = (unsigned char *)glMapBufferRange(GL_ARRAY_BUFFER, 0, stream.size, PersistentFlags);
+		if (stream.mapped == NULL){
+			glDeleteBuffers(1, &stream.buffer);
+			stream.buffer = 0;
+			return false;
+		}
+		stream.end = stream.frameSize;
+		break;
+	case STREAM_UNSYNCHRONIZED:
+		// Room for a few frames before each orphaning
+		stream.size = stream.frameSize * STREAM_BUFFER_PARTS;
+		glBufferData(GL_ARRAY_BUFFER, stream.size, NULL, GL_STREAM_DRAW);
+		stream.end = stream.size;
+		break;
+	case STREAM_SUBDATA:
+		stream.size = stream.frameSize;
+		glBufferData(GL_ARRAY_BUFFER, stream.size, NULL, GL_STREAM_DRAW);
+		stream.end = stream.size;
+		break;
+	}
+	return true;
+}
+
+static void waitStreamFence(StreamBuffer & stream, unsigned int part){
+	GLsync fence = stream.fences[part];
+	if (!fence)
+		return;
+	GLenum result = glClientWaitSync(fence, 0, 0);
+	if (result == GL_TIMEOUT_EXPIRED){
+		PROFILE_SCOPE("wait for stream buffer");
+		stream.stats.fenceWaits++;
+		do{
+			result = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000); // 1 second
+		}while (result == GL_TIMEOUT_EXPIRED);
+	}
+	glDeleteSync(fence);
+	stream.fences[part] = 0;
+}
+
+static void destroyStreamStorage(StreamBuffer & stream){
+	for (unsigned int p=0; p<STREAM_BUFFER_PARTS; p++)
+		waitStreamFence(stream, p);
+	if (stream.mapped){
+		glBindBuffer(GL_ARRAY_BUFFER, stream.buffer);
+		glUnmapBuffer(GL_ARRAY_BUFFER);
+		stream.mapped = NULL;
+	}
+	if (stream.buffer)
+		glDeleteBuffers(1, &stream.buffer);
+	stream.buffer = 0;
+}
+
+void initStreamBuffer(StreamBuffer & stream, size_t frameSize, StreamBufferMode preferred){
+	stream.frameSize = alignStreamOffset(frameSize > 0 ? frameSize : 1);
+	stream.writeOffset = 0;
+	stream.writeSize = 0;
+	memset(&stream.stats, 0, sizeof(stream.stats));
+	stream.staging.clear();
+
+	bool persistent = (GLEW_VERSION_4_4 || GLEW_ARB_buffer_storage) && glBufferStorage != NULL;
+	stream.mode = (preferred == STREAM_PERSISTENT && !persistent) ? STREAM_UNSYNCHRONIZED : preferred;
+	if (!createStreamStorage(stream)){
+		stream.mode = STREAM_UNSYNCHRONIZED;
+		createStreamStorage(stream);
+	}
+}
+
+void deleteStreamBuffer(StreamBuffer & stream){
+	destroyStreamStorage(stream);
+	stream.staging.clear();
+}
+
+const char * streamBufferModeName(StreamBufferMode mode){
+	switch (mode){
+	case STREAM_PERSISTENT:     return "persistent";
+	case STREAM_UNSYNCHRONIZED: return "unsynchronized";
+	case STREAM_SUBDATA:        return "glBufferSubData";
+	}
+	return "";
+}
+
+void * beginStreamWrite(StreamBuffer & stream, size_t bytes, size_t & out_offset){
+	size_t offset = alignStreamOffset(stream.offset);
+	if (offset + bytes > stream.end){
+		if (stream.mode == STREAM_UNSYNCHRONIZED && bytes <= stream.size){
+			// Full : a new buffer, while the GPU reads the old one
+			glBindBuffer(GL_ARRAY_BUFFER, stream.buffer);
+			glBufferData(GL_ARRAY_BUFFER, stream.size, NULL, GL_STREAM_DRAW);
+			stream.stats.orphans++;
+		}else{
+			// This frame writes more than frameSize : a bigger buffer. It doesn't happen every frame,
+			// so waiting for the GPU to be done with the old one is simpler.
+			size_t used = (stream.mode == STREAM_PERSISTENT) ? offset - stream.part * stream.frameSize : offset;
+			size_t frameSize = stream.frameSize;
+			while (frameSize < used + bytes)
+				frameSize *= 2;
+			destroyStreamStorage(stream);
+			stream.frameSize = frameSize;
+			if (!createStreamStorage(stream)){
+				stream.mode = STREAM_UNSYNCHRONIZED; // like initStreamBuffer : a NULL 'mapped' can't be written
+				createStreamStorage(stream);
+			}
+			stream.stats.grows++;
+		}
+		offset = 0;
+	}
+
+	stream.writeOffset = offset;
+	stream.writeSize = bytes;
+	stream.offset = offset + bytes;
+	out_offset = offset;
+
+	glBindBuffer(GL_ARRAY_BUFFER, stream.buffer);
+	switch (stream.mode){
+	case STREAM_PERSISTENT:
+		return stream.mapped + offset;
+	case STREAM_UNSYNCHRONIZED:
+		// Nobody uses this part of the buffer : no need to synchronize
+		return glMapBufferRange(GL_ARRAY_BUFFER, offset, bytes, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT | GL_MAP_UNSYNCHRONIZED_BIT);
+	case STREAM_SUBDATA:
+		if (stream.staging.size() < offset + bytes)
+			stream.staging.resize(offset + bytes);
+		return &stream.staging[offset];
+	}
+	return NULL;
+}
+
+void endStreamWrite(StreamBuffer & stream){
+	switch (stream.mode){
+	case STREAM_PERSISTENT:
+		break; // coherent : the GPU sees the writes
+	case STREAM_UNSYNCHRONIZED:
+		glBindBuffer(GL_ARRAY_BUFFER, stream.buffer);
+		glUnmapBuffer(GL_ARRAY_BUFFER);
+		break;
+	case STREAM_SUBDATA:
+		glBindBuffer(GL_ARRAY_BUFFER, stream.buffer);
+		if (stream.writeOffset == 0){
+			glBufferData(GL_ARRAY_BUFFER, stream.size, NULL, GL_STREAM_DRAW); // the first write of the frame
+			stream.stats.orphans++;
+		}
+		glBufferSubData(GL_ARRAY_BUFFER, stream.writeOffset, stream.writeSize, &stream.staging[stream.writeOffset]);
+		break;
+	}
+}
+
+void endStreamFrame(StreamBuffer & stream){
+	switch (stream.mode){
+	case STREAM_PERSISTENT:
+		stream.fences[stream.part] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+		stream.part = (stream.part + 1) % STREAM_BUFFER_PARTS;
+		stream.offset = stream.part * stream.frameSize;
+		stream.end = stream.offset + stream.frameSize;
+		waitStreamFence(stream, stream.part);
+		break;
+	case STREAM_UNSYNCHRONIZED:
+		break; // the next frame writes after this one
+	case STREAM_SUBDATA:
+		stream.offset = 0;
+		break;
+	}
+}
@@ -0,0 +1,62 @@
+#ifndef STREAMBUFFER_HPP
+#define STREAMBUFFER_HPP
+
+// A vertex buffer for what the CPU rewrites every frame (particles, text...). The CPU writes right into
+// the buffer, rather than in its own memory which glBufferSubData then copies. Depending on the driver :
+//
+// STREAM_PERSISTENT : with OpenGL 4.4 or GL_ARB_buffer_storage, the buffer is mapped once, persistent and
+//     coherent, and split in 3 parts : each frame writes in the next part, while the GPU may still read the
+//     2 others. A fence after the draws of each frame tells when its part can be written again : the CPU
+//     only waits when it is 3 frames ahead of the GPU.
+// STREAM_UNSYNCHRONIZED : otherwise, each write maps the range after the previous one, unsynchronized,
+//     like a ring. When the end is reached, the buffer is orphaned, and the writes start again at 0.
+// STREAM_SUBDATA : the usual way, orphaning then glBufferSubData from a copy in CPU memory. For comparison.
+
+enum StreamBufferMode{
+	STREAM_PERSISTENT,
+	STREAM_UNSYNCHRONIZED,
+	STREAM_SUBDATA
+};
+
+#define STREAM_BUFFER_PARTS 3
+
+struct StreamBufferStats{
+	unsigned int fenceWaits;  // STREAM_PERSISTENT : endStreamFrame had to wait for the GPU
+	unsigned int orphans;     // the buffer was full (STREAM_UNSYNCHRONIZED), or each frame (STREAM_SUBDATA)
+	unsigned int grows;       // a frame wrote more than frameSize : the buffer was replaced by a bigger one
+};
+
+struct StreamBuffer{
+	GLuint buffer;
+	StreamBufferMode mode;
+	size_t frameSize;            // what a frame can write
+	size_t size;                 // of the buffer
+	size_t offset;               // where the next write goes
+	size_t end;                  // where the current frame must stop : the end of its part, or of the buffer
+	unsigned int part;           // STREAM_PERSISTENT
+	unsigned char * mapped;      // STREAM_PERSISTENT : the whole buffer, for ever
+	GLsync fences[STREAM_BUFFER_PARTS];
+	std::vector<unsigned char> staging; // STREAM_SUBDATA
+	size_t writeOffset, writeSize;      // between beginStreamWrite and endStreamWrite
+	StreamBufferStats stats;
+};
+
+// 'preferred' if the driver can, or else STREAM_UNSYNCHRONIZED. frameSize is what a frame usually writes.
+void initStreamBuffer(StreamBuffer & stream, size_t frameSize, StreamBufferMode preferred);
+void deleteStreamBuffer(StreamBuffer & stream);
+
+const char * streamBufferModeName(StreamBufferMode mode);
+
+// Returns where to write 'bytes' bytes, and in out_offset where they are in stream.buffer, for glVertexAttribPointer
+// (a multiple of 64). NULL if the buffer couldn't be mapped. Binds stream.buffer to GL_ARRAY_BUFFER.
+// Any thread can write the memory, until endStreamWrite. One write at a time. Draw with it before the next
+// beginStreamWrite : when the buffer is full, that one may replace stream.buffer.
+void * beginStreamWrite(StreamBuffer & stream, size_t bytes, size_t & out_offset);
+
+// Before drawing with what was written
+void endStreamWrite(StreamBuffer & stream);
+
+// After the last draw of the frame which uses the buffer : the next writes go to the next part
+void endStreamFrame(StreamBuffer & stream);
+
+#endif
@@ -1,73 +1,296 @@
 #include <vector>
+#include <math.h>
 #include <glm/glm.hpp>
 
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#define TANGENTSPACE_SSE
+#include <xmmintrin.h>
+#endif
+
 #include "tangentspace.hpp"
 
-void computeTangentBasis(
+// Below this, the UVs of the triangle are (almost) aligned, and 1/determinant
+// would give infinite or huge tangents : we don't use the UVs at all then.
+#define MIN_UV_DETERMINANT 1e-12f
+// Below this squared length, the tangent can't be normalized (degenerate UVs, or tangent parallel to the normal)
+#define MIN_TANGENT_LENGTH2 1e-20f
+
+static void computeTriangleTangent(
+	const glm::vec3 & v0, const glm::vec3 & v1, const glm::vec3 & v2,
+	const glm::vec2 & uv0, const glm::vec2 & uv1, const glm::vec2 & uv2,
+	glm::vec3 & tangent, glm::vec3 & bitangent
+){
+	// Edges of the triangle : postion delta
+	glm::vec3 deltaPos1 = v1-v0;
+	glm::vec3 deltaPos2 = v2-v0;
+
+	// UV delta
+	glm::vec2 deltaUV1 = uv1-uv0;
+	glm::vec2 deltaUV2 = uv2-uv0;
+
+	float determinant = deltaUV1.x * deltaUV2.y - deltaUV1.y * deltaUV2.x;
+	float r = fabsf(determinant) > MIN_UV_DETERMINANT ? 1.0f / determinant : 0.0f;
+	tangent = (deltaPos1 * deltaUV2.y   - deltaPos2 * deltaUV1.y)*r;
+	bitangent = (deltaPos2 * deltaUV1.x   - deltaPos1 * deltaUV2.x)*r;
+}
+
+// See "Going Further"
+static void orthogonalizeTangent(const glm::vec3 & n, glm::vec3 & t, glm::vec3 & b){
+	// Gram-Schmidt orthogonalize
+	t = t - n * glm::dot(n, t);
+	float length2 = glm::dot(t, t);
+	if (length2 > MIN_TANGENT_LENGTH2){
+		t = t * (1.0f / sqrtf(length2));
+	}else{
+		// No usable tangent : take any direction orthogonal to the normal
+		glm::vec3 axis = fabsf(n.x) < 0.9f ? glm::vec3(1,0,0) : glm::vec3(0,1,0);
+		t = glm::normalize(glm::cross(axis, n));
+		b = glm::cross(n, t);
+	}
+
+	// Calculate handedness
+	if (glm::dot(glm::cross(n, t), b) < 0.0f){
+		t = t * -1.0f;
+	}
+}
+
+#ifdef TANGENTSPACE_SSE
+
+// 4 vec3s, one per lane
+struct Vec3x4{
+	__m128 x, y, z;
+};
+
+static inline __m128 dot4(const Vec3x4 & a, const Vec3x4 & b){
+	return _mm_add_ps(_mm_add_ps(_mm_mul_ps(a.x, b.x), _mm_mul_ps(a.y, b.y)), _mm_mul_ps(a.z, b.z));
+}
+
+// v[0], v[stride], v[2*stride], v[3*stride]
+static inline Vec3x4 load4(const glm::vec3 * v, size_t stride){
+	Vec3x4 r;
+	r.x = _mm_setr_ps(v[0].x, v[stride].x, v[2*stride].x, v[3*stride].x);
+	r.y = _mm_setr_ps(v[0].y, v[stride].y, v[2*stride].y, v[3*stride].y);
+	r.z = _mm_setr_ps(v[0].z, v[stride].z, v[2*stride].z, v[3*stride].z);
+	return r;
+}
+
+static inline void store4(const Vec3x4 & a, glm::vec3 * out){
+	float x[4], y[4], z[4];
+	_mm_storeu_ps(x, a.x);
+	_mm_storeu_ps(y, a.y);
+	_mm_storeu_ps(z, a.z);
+	for (int k=0; k<4; k++)
+		out[k] = glm::vec3(x[k], y[k], z[k]);
+}
+
+// computeTriangleTangent for triangles 0..3 of the arrays
+static void computeTriangleTangents4(const glm::vec3 * vertices, const glm::vec2 * uvs, glm::vec3 * tangents, glm::vec3 * bitangents){
+	Vec3x4 v0 = load4(vertices + 0, 3);
+	Vec3x4 v1 = load4(vertices + 1, 3);
+	Vec3x4 v2 = load4(vertices + 2, 3);
+	__m128 u0 = _mm_setr_ps(uvs[0].x, uvs[3].x, uvs[6].x, uvs[ 9].x);
+	__m128 w0 = _mm_setr_ps(uvs[0].y, uvs[3].y, uvs[6].y, uvs[ 9].y);
+	__m128 u1 = _mm_setr_ps(uvs[1].x, uvs[4].x, uvs[7].x, uvs[10].x);
+	__m128 w1 = _mm_setr_ps(uvs[1].y, uvs[4].y, uvs[7].y, uvs[10].y);
+	__m128 u2 = _mm_setr_ps(uvs[2].x, uvs[5].x, uvs[8].x, uvs[11].x);
+	__m128 w2 = _mm_setr_ps(uvs[2].y, uvs[5].y, uvs[8].y, uvs[11].y);
+
+	Vec3x4 deltaPos1 = { _mm_sub_ps(v1.x, v0.x), _mm_sub_ps(v1.y, v0.y), _mm_sub_ps(v1.z, v0.z) };
+	Vec3x4 deltaPos2 = { _mm_sub_ps(v2.x, v0.x), _mm_sub_ps(v2.y, v0.y), _mm_sub_ps(v2.z, v0.z) };
+	__m128 deltaU1 = _mm_sub_ps(u1, u0);
+	__m128 deltaV1 = _mm_sub_ps(w1, w0);
+	__m128 deltaU2 = _mm_sub_ps(u2, u0);
+	__m128 deltaV2 = _mm_sub_ps(w2, w0);
+
+	__m128 determinant = _mm_sub_ps(_mm_mul_ps(deltaU1, deltaV2), _mm_mul_ps(deltaV1, deltaU2));
+	__m128 absDeterminant = _mm_andnot_ps(_mm_set1_ps(-0.0f), determinant);
+	__m128 valid = _mm_cmpgt_ps(absDeterminant, _mm_set1_ps(MIN_UV_DETERMINANT)); // false for NaNs too
+	__m128 r = _mm_and_ps(valid, _mm_div_ps(_mm_set1_ps(1.0f), determinant));
+
+	Vec3x4 t, b;
+	t.x = _mm_mul_ps(_mm_sub_ps(_mm_mul_ps(deltaPos1.x, deltaV2), _mm_mul_ps(deltaPos2.x, deltaV1)), r);
+	t.y = _mm_mul_ps(_mm_sub_ps(_mm_mul_ps(deltaPos1.y, deltaV2), _mm_mul_ps(deltaPos2.y, deltaV1)), r);
+	t.z = _mm_mul_ps(_mm_sub_ps(_mm_mul_ps(deltaPos1.z, deltaV2), _mm_mul_ps(deltaPos2.z, deltaV1)), r);
+	b.x = _mm_mul_ps(_mm_sub_ps(_mm_mul_ps(deltaPos2.x, deltaU1), _mm_mul_ps(deltaPos1.x, deltaU2)), r);
+	b.y = _mm_mul_ps(_mm_sub_ps(_mm_mul_ps(deltaPos2.y, deltaU1), _mm_mul_ps(deltaPos1.y, deltaU2)), r);
+	b.z = _mm_mul_ps(_mm_sub_ps(_mm_mul_ps(deltaPos2.z, deltaU1), _mm_mul_ps(deltaPos1.z, deltaU2)), r);
+
+	glm::vec3 t4[4], b4[4];
+	store4(t, t4);
+	store4(b, b4);
+	// Set the same tangent for all three vertices of the triangle.
+	for (int k=0; k<4; k++){
+		tangents[3*k+0] = tangents[3*k+1] = tangents[3*k+2] = t4[k];
+		bitangents[3*k+0] = bitangents[3*k+1] = bitangents[3*k+2] = b4[k];
+	}
+}
+
+// orthogonalizeTangent for vertices 0..3 of the arrays
+static void orthogonalizeTangents4(const glm::vec3 * normals, glm::vec3 * tangents, glm::vec3 * bitangents){
+	Vec3x4 n = load4(normals, 1);
+	Vec3x4 t = load4(tangents, 1);
+	Vec3x4 b = load4(bitangents, 1);
+
+	__m128 d = dot4(n, t);
+	t.x = _mm_sub_ps(t.x, _mm_mul_ps(n.x, d));
+	t.y = _mm_sub_ps(t.y, _mm_mul_ps(n.y, d));
+	t.z = _mm_sub_ps(t.z, _mm_mul_ps(n.z, d));
+
+	__m128 length2 = dot4(t, t);
+	int valid = _mm_movemask_ps(_mm_cmpgt_ps(length2, _mm_set1_ps(MIN_TANGENT_LENGTH2)));
+	if (valid != 0xF){
+		// Rare : let the scalar version deal with the degenerate ones
+		for (int k=0; k<4; k++)
+			orthogonalizeTangent(normals[k], tangents[k], bitangents[k]);
+		return;
+	}
+	__m128 invLength = _mm_div_ps(_mm_set1_ps(1.0f), _mm_sqrt_ps(length2));
+	t.x = _mm_mul_ps(t.x, invLength);
+	t.y = _mm_mul_ps(t.y, invLength);
+	t.z = _mm_mul_ps(t.z, invLength);
+
+	// Handedness : flip t where dot(cross(n, t), b) < 0
+	Vec3x4 c;
+	c.x = _mm_sub_ps(_mm_mul_ps(n.y, t.z), _mm_mul_ps(n.z, t.y));
+	c.y = _mm_sub_ps(_mm_mul_ps(n.z, t.x), _mm_mul_ps(n.x, t.z));
+	c.z = _mm_sub_ps(_mm_mul_ps(n.x, t.y), _mm_mul_ps(n.y, t.x));
+	__m128 flip = _mm_and_ps(_mm_cmplt_ps(dot4(c, b), _mm_setzero_ps()), _mm_set1_ps(-0.0f));
+	t.x = _mm_xor_ps(t.x, flip);
+	t.y = _mm_xor_ps(t.y, flip);
+	t.z = _mm_xor_ps(t.z, flip);
+
+	store4(t, tangents);
+}
+
+#endif
+
+static void orthogonalizeTangents(const std::vector<glm::vec3> & normals, std::vector<glm::vec3> & tangents, std::vector<glm::vec3> & bitangents, bool useSSE){
+	size_t i = 0;
+#ifdef TANGENTSPACE_SSE
+	if (useSSE){
+		for ( ; i+4<=tangents.size(); i+=4)
+			orthogonalizeTangents4(&normals[i], &tangents[i], &bitangents[i]);
+	}
+#else
+	(void)useSSE;
+#endif
+	for ( ; i<tangents.size(); i++)
+		orthogonalizeTangent(normals[i], tangents[i], bitangents[i]);
+}
+
+static void computeTangentBasis(
 	// inputs
 	std::vector<glm::vec3> & vertices,
 	std::vector<glm::vec2> & uvs,
 	std::vector<glm::vec3> & normals,
 	// outputs
 	std::vector<glm::vec3> & tangents,
-	std::vector<glm::vec3> & bitangents
+	std::vector<glm::vec3> & bitangents,
+	bool useSSE
 ){
+	size_t triangleCount = vertices.size() / 3;
+	tangents.resize(vertices.size());
+	bitangents.resize(vertices.size());
 
-	for (unsigned int i=0; i<vertices.size(); i+=3 ){
+	size_t i = 0;
+#ifdef TANGENTSPACE_SSE
+	if (useSSE){
+		for ( ; i+4<=triangleCount; i+=4)
+			computeTriangleTangents4(&vertices[3*i], &uvs[3*i], &tangents[3*i], &bitangents[3*i]);
+	}
+#endif
+	for ( ; i<triangleCount; i++){
+		glm::vec3 tangent, bitangent;
+		computeTriangleTangent(
+			vertices[3*i+0], vertices[3*i+1], vertices[3*i+2],
+			uvs[3*i+0], uvs[3*i+1], uvs[3*i+2],
+			tangent, bitangent
+		);
 
-		// Shortcuts for vertices
-		glm::vec3 & v0 = vertices[i+0];
-		glm::vec3 & v1 = vertices[i+1];
-		glm::vec3 & v2 = vertices[i+2];
+		// Set the same tangent for all three vertices of the triangle.
+		// They will be merged later, in vboindexer.cpp
+		tangents[3*i+0] = tangents[3*i+1] = tangents[3*i+2] = tangent;
 
-		// Shortcuts for UVs
-		glm::vec2 & uv0 = uvs[i+0];
-		glm::vec2 & uv1 = uvs[i+1];
-		glm::vec2 & uv2 = uvs[i+2];
+		// Same thing for binormals
+		bitangents[3*i+0] = bitangents[3*i+1] = bitangents[3*i+2] = bitangent;
+	}
 
-		// Edges of the triangle : postion delta
-		glm::vec3 deltaPos1 = v1-v0;
-		glm::vec3 deltaPos2 = v2-v0;
+	orthogonalizeTangents(normals, tangents, bitangents, useSSE);
+}
 
-		// UV delta
-		glm::vec2 deltaUV1 = uv1-uv0;
-		glm::vec2 deltaUV2 = uv2-uv0;
+void computeTangentBasis(
+	std::vector<glm::vec3> & vertices,
+	std::vector<glm::vec2> & uvs,
+	std::vector<glm::vec3> & normals,
+	std::vector<glm::vec3> & tangents,
+	std::vector<glm::vec3> & bitangents
+){
+	computeTangentBasis(vertices, uvs, normals, tangents, bitangents, true);
+}
 
-		float r = 1.0f / (deltaUV1.x * deltaUV2.y - deltaUV1.y * deltaUV2.x);
-		glm::vec3 tangent = (deltaPos1 * deltaUV2.y   - deltaPos2 * deltaUV1.y)*r;
-		glm::vec3 bitangent = (deltaPos2 * deltaUV1.x   - deltaPos1 * deltaUV2.x)*r;
+void computeTangentBasis_scalar(
+	std::vector<glm::vec3> & vertices,
+	std::vector<glm::vec2> & uvs,
+	std::vector<glm::vec3> & normals,
+	std::vector<glm::vec3> & tangents,
+	std::vector<glm::vec3> & bitangents
+){
+	computeTangentBasis(vertices, uvs, normals, tangents, bitangents, false);
+}
 
-		// Set the same tangent for all three vertices of the triangle.
-		// They will be merged later, in vboindexer.cpp
-		tangents.push_back(tangent);
-		tangents.push_back(tangent);
-		tangents.push_back(tangent);
+// Angle of the triangle (p, a, b) at p
+static float cornerAngle(const glm::vec3 & p, const glm::vec3 & a, const glm::vec3 & b){
+	glm::vec3 e1 = a - p;
+	glm::vec3 e2 = b - p;
+	float lengths = sqrtf(glm::dot(e1, e1) * glm::dot(e2, e2));
+	if (lengths <= 0.0f)
+		return 0.0f;
+	return acosf(glm::clamp(glm::dot(e1, e2) / lengths, -1.0f, 1.0f));
+}
 
-		// Same thing for binormals
-		bitangents.push_back(bitangent);
-		bitangents.push_back(bitangent);
-		bitangents.push_back(bitangent);
+template <typename IndexType>
+void computeTangentBasisIndexed(
+	// inputs
+	const std::vector<IndexType> & indices,
+	const std::vector<glm::vec3> & vertices,
+	const std::vector<glm::vec2> & uvs,
+	const std::vector<glm::vec3> & normals,
+	// outputs
+	std::vector<glm::vec3> & tangents,
+	std::vector<glm::vec3> & bitangents
+){
+	tangents.assign(vertices.size(), glm::vec3(0.0f));
+	bitangents.assign(vertices.size(), glm::vec3(0.0f));
 
-	}
+	for (size_t i=0; i+2<indices.size(); i+=3){
+		unsigned int index[3] = { indices[i+0], indices[i+1], indices[i+2] };
+		glm::vec3 tangent, bitangent;
+		computeTriangleTangent(
+			vertices[index[0]], vertices[index[1]], vertices[index[2]],
+			uvs[index[0]], uvs[index[1]], uvs[index[2]],
+			tangent, bitangent
+		);
 
-	// See "Going Further"
-	for (unsigned int i=0; i<vertices.size(); i+=1 )
-	{
-		glm::vec3 & n = normals[i];
-		glm::vec3 & t = tangents[i];
-		glm::vec3 & b = bitangents[i];
-		
-		// Gram-Schmidt orthogonalize
-		t = glm::normalize(t - n * glm::dot(n, t));
-		
-		// Calculate handedness
-		if (glm::dot(glm::cross(n, t), b) < 0.0f){
-			t = t * -1.0f;
+		for (int k=0; k<3; k++){
+			// Like MikkTSpace : project on the plane of the vertex' normal and normalize
+			// before accumulating, so that big triangles don't dominate small ones.
+			const glm::vec3 & n = normals[index[k]];
+			glm::vec3 t = tangent - n * glm::dot(n, tangent);
+			glm::vec3 b = bitangent - n * glm::dot(n, bitangent);
+			float tLength2 = glm::dot(t, t);
+			float bLength2 = glm::dot(b, b);
+			if (tLength2 <= MIN_TANGENT_LENGTH2 || bLength2 <= MIN_TANGENT_LENGTH2)
+				continue; // degenerate UVs : this triangle doesn't tell anything
+			float angle = cornerAngle(vertices[index[k]], vertices[index[(k+1)%3]], vertices[index[(k+2)%3]]);
+			tangents[index[k]] += t * (angle / sqrtf(tLength2));
+			bitangents[index[k]] += b * (angle / sqrtf(bLength2));
 		}
-
 	}
 
-
+	orthogonalizeTangents(normals, tangents, bitangents, true);
 }
 
-
+template void computeTangentBasisIndexed<unsigned short>(const std::vector<unsigned short> &, const std::vector<glm::vec3> &,
+	const std::vector<glm::vec2> &, const std::vector<glm::vec3> &, std::vector<glm::vec3> &, std::vector<glm::vec3> &);
+template void computeTangentBasisIndexed<unsigned int>(const std::vector<unsigned int> &, const std::vector<glm::vec3> &,
+	const std::vector<glm::vec2> &, const std::vector<glm::vec3> &, std::vector<glm::vec3> &, std::vector<glm::vec3> &);
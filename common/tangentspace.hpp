@@ -1,6 +1,11 @@
 #ifndef TANGENTSPACE_HPP
 #define TANGENTSPACE_HPP
 
+// One tangent and bitangent per vertex of a non-indexed triangle list
+// (as given by loadOBJ), to be merged by indexVBO_TBN afterwards.
+// The outputs are resized to vertices.size().
+// Triangles with degenerate UVs get an arbitrary tangent, orthogonal to the normal.
+// Uses SSE when available, 4 triangles at a time.
 void computeTangentBasis(
 	// inputs
 	std::vector<glm::vec3> & vertices,
@@ -11,5 +16,29 @@ void computeTangentBasis(
 	std::vector<glm::vec3> & bitangents
 );
 
+// Same thing without SSE, for the tests and benchmarks : the result is the same.
+void computeTangentBasis_scalar(
+	std::vector<glm::vec3> & vertices,
+	std::vector<glm::vec2> & uvs,
+	std::vector<glm::vec3> & normals,
+	std::vector<glm::vec3> & tangents,
+	std::vector<glm::vec3> & bitangents
+);
+
+// Same thing, but for an already indexed mesh (from indexVBO) : the tangents of all the
+// triangles which share a vertex are averaged, weighted by the angle of the triangle
+// at this vertex, like MikkTSpace does. IndexType is unsigned short or unsigned int.
+template <typename IndexType>
+void computeTangentBasisIndexed(
+	// inputs
+	const std::vector<IndexType> & indices,
+	const std::vector<glm::vec3> & vertices,
+	const std::vector<glm::vec2> & uvs,
+	const std::vector<glm::vec3> & normals,
+	// outputs
+	std::vector<glm::vec3> & tangents,
+	std::vector<glm::vec3> & bitangents
+);
+
 
 #endif
\ No newline at end of file
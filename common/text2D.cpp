@@ -1,5 +1,6 @@
 #include <vector>
 #include <cstring>
+#include <cstddef>
 
 #include <GL/glew.h>
 
@@ -10,22 +11,41 @@ using namespace glm;
 #include "shader.hpp"
 #include "texture.hpp"
 
+#include "streambuffer.hpp"
+#include "text2Dbatch.hpp"
 #include "text2D.hpp"
 
+// printText2D only appends the quads of the glyphs to Text2DVertices; flushText2D copies
+// all of them at once into a StreamBuffer, and draws them with a single draw call.
+// Each flush writes in the next part of the stream (see streambuffer.hpp), so the driver never
+// has to wait for the GPU to finish with the previous frames.
+
+#define TEXT2D_FLUSH_SIZE (256 * 1024) // bytes, about 4000 glyphs per flush before the buffer grows
+
 unsigned int Text2DTextureID;
-unsigned int Text2DVertexBufferID;
-unsigned int Text2DUVBufferID;
+unsigned int Text2DIndexBufferID;
 unsigned int Text2DShaderID;
 unsigned int Text2DUniformID;
 
+static std::vector<Text2DVertex> Text2DVertices;  // of this frame, 4 per glyph
+static StreamBuffer Text2DStream;
+static size_t Text2DIndexedGlyphs = 0;            // glyphs which the index buffer can draw
+static Text2DStats Text2DLastStats = { 0, 0, 0 };
+
+static void initText2DBuffers(){
+	initStreamBuffer(Text2DStream, TEXT2D_FLUSH_SIZE, STREAM_PERSISTENT);
+	glGenBuffers(1, &Text2DIndexBufferID);
+	Text2DIndexedGlyphs = 0;
+	Text2DVertices.reserve(1024);
+}
+
 void initText2D(const char * texturePath){
 
 	// Initialize texture
 	Text2DTextureID = loadDDS(texturePath);
 
 	// Initialize VBO
-	glGenBuffers(1, &Text2DVertexBufferID);
-	glGenBuffers(1, &Text2DUVBufferID);
+	initText2DBuffers();
 
 	// Initialize Shader
 	Text2DShaderID = LoadShaders( "TextVertexShader.vertexshader", "TextVertexShader.fragmentshader" );
@@ -35,48 +55,68 @@ void initText2D(const char * texturePath){
 
 }
 
+void initText2DSDF(const char * texturePath){
+
+	// Initialize texture. The distances must be interpolated, and the glyphs never repeat
+	Text2DTextureID = loadDDS(texturePath);
+	glBindTexture(GL_TEXTURE_2D, Text2DTextureID);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+
+	// Initialize VBO
+	initText2DBuffers();
+
+	// Initialize Shader : the same one, which turns the distance into a sharp edge when SDF_FONT is defined
+	Text2DShaderID = LoadShaderVariant( "TextVertexShader.vertexshader", "TextVertexShader.fragmentshader", "SDF_FONT" );
+
+	// Initialize uniforms' IDs
+	Text2DUniformID = glGetUniformLocation( Text2DShaderID, "myTextureSampler" );
+
+}
+
 void printText2D(const char * text, int x, int y, int size){
+	appendText2DQuads(text, x, y, size, Text2DVertices);
+}
 
-	unsigned int length = strlen(text);
-
-	// Fill buffers
-	std::vector<glm::vec2> vertices;
-	std::vector<glm::vec2> UVs;
-	for ( unsigned int i=0 ; i<length ; i++ ){
-		
-		glm::vec2 vertex_up_left    = glm::vec2( x+i*size     , y+size );
-		glm::vec2 vertex_up_right   = glm::vec2( x+i*size+size, y+size );
-		glm::vec2 vertex_down_right = glm::vec2( x+i*size+size, y      );
-		glm::vec2 vertex_down_left  = glm::vec2( x+i*size     , y      );
-
-		vertices.push_back(vertex_up_left   );
-		vertices.push_back(vertex_down_left );
-		vertices.push_back(vertex_up_right  );
-
-		vertices.push_back(vertex_down_right);
-		vertices.push_back(vertex_up_right);
-		vertices.push_back(vertex_down_left);
-
-		char character = text[i];
-		float uv_x = (character%16)/16.0f;
-		float uv_y = (character/16)/16.0f;
-
-		glm::vec2 uv_up_left    = glm::vec2( uv_x           , uv_y );
-		glm::vec2 uv_up_right   = glm::vec2( uv_x+1.0f/16.0f, uv_y );
-		glm::vec2 uv_down_right = glm::vec2( uv_x+1.0f/16.0f, (uv_y + 1.0f/16.0f) );
-		glm::vec2 uv_down_left  = glm::vec2( uv_x           , (uv_y + 1.0f/16.0f) );
-		UVs.push_back(uv_up_left   );
-		UVs.push_back(uv_down_left );
-		UVs.push_back(uv_up_right  );
-
-		UVs.push_back(uv_down_right);
-		UVs.push_back(uv_up_right);
-		UVs.push_back(uv_down_left);
+// Two triangles per glyph (see buildText2DIndices)
+static void growText2DIndices(size_t glyphCount){
+	if (glyphCount <= Text2DIndexedGlyphs)
+		return;
+	size_t capacity = Text2DIndexedGlyphs > 0 ? Text2DIndexedGlyphs : 1024;
+	while (capacity < glyphCount)
+		capacity *= 2;
+	std::vector<unsigned int> indices;
+	buildText2DIndices(capacity, indices);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, Text2DIndexBufferID);
+	glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned int), &indices[0], GL_STATIC_DRAW);
+	Text2DIndexedGlyphs = capacity;
+}
+
+void flushText2D(){
+
+	Text2DLastStats.drawCalls = 0;
+	Text2DLastStats.glyphCount = (unsigned int)(Text2DVertices.size() / 4);
+	Text2DLastStats.bufferOrphans = 0;
+	if (Text2DVertices.empty())
+		return;
+
+	// Copy the quads into the stream
+	size_t bytes = Text2DVertices.size() * sizeof(Text2DVertex);
+	unsigned int replaced = Text2DStream.stats.orphans + Text2DStream.stats.grows;
+	size_t offset;
+	void * data = beginStreamWrite(Text2DStream, bytes, offset);
+	if (data == NULL){
+		Text2DVertices.clear();
+		return;
 	}
-	glBindBuffer(GL_ARRAY_BUFFER, Text2DVertexBufferID);
-	glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(glm::vec2), &vertices[0], GL_STATIC_DRAW);
-	glBindBuffer(GL_ARRAY_BUFFER, Text2DUVBufferID);
-	glBufferData(GL_ARRAY_BUFFER, UVs.size() * sizeof(glm::vec2), &UVs[0], GL_STATIC_DRAW);
+	memcpy(data, &Text2DVertices[0], bytes);
+	endStreamWrite(Text2DStream);
+	Text2DLastStats.bufferOrphans = Text2DStream.stats.orphans + Text2DStream.stats.grows - replaced;
+
+	size_t glyphCount = Text2DVertices.size() / 4;
+	growText2DIndices(glyphCount);
 
 	// Bind shader
 	glUseProgram(Text2DShaderID);
@@ -89,32 +129,41 @@ void printText2D(const char * text, int x, int y, int size){
 
 	// 1rst attribute buffer : vertices
 	glEnableVertexAttribArray(0);
-	glBindBuffer(GL_ARRAY_BUFFER, Text2DVertexBufferID);
-	glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 0, (void*)0 );
+	glBindBuffer(GL_ARRAY_BUFFER, Text2DStream.buffer);
+	glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, sizeof(Text2DVertex), (void*)(offset + offsetof(Text2DVertex, position)) );
 
 	// 2nd attribute buffer : UVs
 	glEnableVertexAttribArray(1);
-	glBindBuffer(GL_ARRAY_BUFFER, Text2DUVBufferID);
-	glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 0, (void*)0 );
+	glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, sizeof(Text2DVertex), (void*)(offset + offsetof(Text2DVertex, uv)) );
+
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, Text2DIndexBufferID);
 
 	glEnable(GL_BLEND);
 	glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
 
-	// Draw call
-	glDrawArrays(GL_TRIANGLES, 0, vertices.size() );
+	// Draw call : all the text of the frame at once
+	glDrawElements(GL_TRIANGLES, (GLsizei)(glyphCount * 6), GL_UNSIGNED_INT, (void*)0);
+	Text2DLastStats.drawCalls++;
 
 	glDisable(GL_BLEND);
 
 	glDisableVertexAttribArray(0);
 	glDisableVertexAttribArray(1);
 
+	endStreamFrame(Text2DStream);
+	Text2DVertices.clear(); // keeps the memory for the next frame
+}
+
+const Text2DStats & getText2DStats(){
+	return Text2DLastStats;
 }
 
 void cleanupText2D(){
 
 	// Delete buffers
-	glDeleteBuffers(1, &Text2DVertexBufferID);
-	glDeleteBuffers(1, &Text2DUVBufferID);
+	deleteStreamBuffer(Text2DStream);
+	glDeleteBuffers(1, &Text2DIndexBufferID);
+	Text2DVertices.clear();
 
 	// Delete texture
 	glDeleteTextures(1, &Text2DTextureID);
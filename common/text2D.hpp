@@ -2,7 +2,25 @@
 #define TEXT2D_HPP
 
 void initText2D(const char * texturePath);
+
+// Like initText2D, with a signed distance field version of the font (see cookSDFFont in distancefield.hpp) :
+// the text stays sharp at any size. TextVertexShader.fragmentshader must handle SDF_FONT.
+void initText2DSDF(const char * texturePath);
+
+// Adds some text to the current batch. Nothing is drawn until flushText2D.
 void printText2D(const char * text, int x, int y, int size);
+
+// Draws all the text printed since the last flush, in one draw call. Call it once per frame, after the 3D.
+void flushText2D();
+
+// What the last flushText2D did
+struct Text2DStats{
+	unsigned int drawCalls;
+	unsigned int glyphCount;
+	unsigned int bufferOrphans; // times the vertex buffer was full and had to be replaced (see StreamBufferStats)
+};
+const Text2DStats & getText2DStats();
+
 void cleanupText2D();
 
 #endif
\ No newline at end of file
@@ -0,0 +1,43 @@
+#include <vector>
+#include <cstring>
+
+#include <glm/glm.hpp>
+
+#include "text2Dbatch.hpp"
+
+void appendText2DQuads(const char * text, int x, int y, int size, std::vector<Text2DVertex> & vertices){
+
+	size_t length = strlen(text);
+	if (length == 0)
+		return;
+
+	size_t first = vertices.size();
+	vertices.resize(first + length * 4);
+	Text2DVertex * vertex = &vertices[0] + first;
+	for ( size_t i=0 ; i<length ; i++ ){
+
+		float left  = (float)(x + (int)i*size);
+		float right = left + size;
+		float down  = (float)y;
+		float up    = down + size;
+
+		unsigned char character = (unsigned char)text[i];
+		float uv_x = (character%16)/16.0f;
+		float uv_y = (character/16)/16.0f;
+
+		vertex[0].position = glm::vec2(left,  up  ); vertex[0].uv = glm::vec2(uv_x,           uv_y           ); // up left
+		vertex[1].position = glm::vec2(left,  down); vertex[1].uv = glm::vec2(uv_x,           uv_y+1.0f/16.0f); // down left
+		vertex[2].position = glm::vec2(right, up  ); vertex[2].uv = glm::vec2(uv_x+1.0f/16.0f, uv_y           ); // up right
+		vertex[3].position = glm::vec2(right, down); vertex[3].uv = glm::vec2(uv_x+1.0f/16.0f, uv_y+1.0f/16.0f); // down right
+		vertex += 4;
+	}
+}
+
+void buildText2DIndices(size_t glyphCount, std::vector<unsigned int> & out_indices){
+	out_indices.resize(glyphCount * 6);
+	for (size_t i=0; i<glyphCount; i++){
+		unsigned int v = (unsigned int)(i * 4);
+		out_indices[i*6+0] = v+0; out_indices[i*6+1] = v+1; out_indices[i*6+2] = v+2;
+		out_indices[i*6+3] = v+3; out_indices[i*6+4] = v+2; out_indices[i*6+5] = v+1;
+	}
+}
@@ -0,0 +1,20 @@
+#ifndef TEXT2DBATCH_HPP
+#define TEXT2DBATCH_HPP
+
+// The CPU part of text2D : the quads of the glyphs and their indices, without any OpenGL, so that it can
+// be measured on its own (see tests/text2Dbatch_benchmark.cpp). Include <vector> and glm first.
+
+struct Text2DVertex{
+	glm::vec2 position;
+	glm::vec2 uv;
+};
+
+// Appends the 4 vertices of each glyph of text to vertices : up left, down left, up right, down right.
+// The glyphs are size x size pixels, from (x, y), and 16x16 of them fill the font texture.
+// No allocation once vertices is big enough.
+void appendText2DQuads(const char * text, int x, int y, int size, std::vector<Text2DVertex> & vertices);
+
+// The 6 indices of each of glyphCount glyphs : up left, down left, up right, then down right, up right, down left
+void buildText2DIndices(size_t glyphCount, std::vector<unsigned int> & out_indices);
+
+#endif
@@ -6,88 +6,44 @@
 
 #include <GLFW/glfw3.h>
 
+#include <vector>
+
+#include "textureimage.hpp"
+#include "mipmapgenerator.hpp"
+#include "texturemanager.hpp"
+#include "texture.hpp"
+#include "profiler.hpp"
+
 
 GLuint loadBMP_custom(const char * imagepath){
 
+	PROFILE_SCOPE("loadBMP_custom");
 	printf("Reading image %s\n", imagepath);
 
-	// Data read from the header of the BMP file
-	unsigned char header[54];
-	unsigned int dataPos;
-	unsigned int imageSize;
-	unsigned int width, height;
-	// Actual RGB data
-	unsigned char * data;
-
-	// Open the file
-	FILE * file = fopen(imagepath,"rb");
-	if (!file){
-		printf("%s could not be opened. Are you in the right directory ? Don't forget to read the FAQ !\n", imagepath);
+	// Read and check the file; the rows are unpadded, bottom row first, ready for OpenGL
+	TextureImage image;
+	if (!loadBMPImage(imagepath, image)){
 		getchar();
 		return 0;
 	}
 
-	// Read the header, i.e. the 54 first bytes
-
-	// If less than 54 bytes are read, problem
-	if ( fread(header, 1, 54, file)!=54 ){ 
-		printf("Not a correct BMP file\n");
-		fclose(file);
-		return 0;
-	}
-	// A BMP files always begins with "BM"
-	if ( header[0]!='B' || header[1]!='M' ){
-		printf("Not a correct BMP file\n");
-		fclose(file);
-		return 0;
-	}
-	// Make sure this is a 24bpp file
-	if ( *(int*)&(header[0x1E])!=0  )         {printf("Not a correct BMP file\n");    fclose(file); return 0;}
-	if ( *(int*)&(header[0x1C])!=24 )         {printf("Not a correct BMP file\n");    fclose(file); return 0;}
-
-	// Read the information about the image
-	dataPos    = *(int*)&(header[0x0A]);
-	imageSize  = *(int*)&(header[0x22]);
-	width      = *(int*)&(header[0x12]);
-	height     = *(int*)&(header[0x16]);
+	// Generate the mipmaps for nice trilinear filtering. This is done on the CPU rather than
+	// with glGenerateMipmap, whose filter depends on the driver : the colors are averaged
+	// in linear space, with a sharper filter than the 2x2 average.
+	MipmapOptions mipmapOptions = { MIPMAP_KAISER, true, false, true, 0 };
+	generateTextureMipmaps(image, mipmapOptions);
 
-	// Some BMP files are misformatted, guess missing information
-	if (imageSize==0)    imageSize=width*height*3; // 3 : one byte for each Red, Green and Blue component
-	if (dataPos==0)      dataPos=54; // The BMP header is done that way
+	// Create one OpenGL texture, and give all the levels to OpenGL
+	GLuint textureID = uploadTextureImage(image);
 
-	// Create a buffer
-	data = new unsigned char [imageSize];
-
-	// Read the actual data from the file into the buffer
-	fread(data,1,imageSize,file);
-
-	// Everything is in memory now, the file can be closed.
-	fclose (file);
-
-	// Create one OpenGL texture
-	GLuint textureID;
-	glGenTextures(1, &textureID);
-	
-	// "Bind" the newly created texture : all future texture functions will modify this texture
-	glBindTexture(GL_TEXTURE_2D, textureID);
-
-	// Give the image to OpenGL
-	glTexImage2D(GL_TEXTURE_2D, 0,GL_RGB, width, height, 0, GL_BGR, GL_UNSIGNED_BYTE, data);
-
-	// OpenGL has now copied the data. Free our own version
-	delete [] data;
-
-	// Poor filtering, or ...
-	//glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-	//glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST); 
-
-	// ... nice trilinear filtering ...
+	// Nice trilinear filtering
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
-	// ... which requires mipmaps. Generate them automatically.
-	glGenerateMipmap(GL_TEXTURE_2D);
+
+	// OpenGL has now copied the data. Free our own version
+	unloadTextureImage(image);
 
 	// Return the ID of the texture we just created
 	return textureID;
@@ -120,99 +76,137 @@ GLuint loadBMP_custom(const char * imagepath){
 
 
 
-#define FOURCC_DXT1 0x31545844 // Equivalent to "DXT1" in ASCII
-#define FOURCC_DXT3 0x33545844 // Equivalent to "DXT3" in ASCII
-#define FOURCC_DXT5 0x35545844 // Equivalent to "DXT5" in ASCII
-
-GLuint loadDDS(const char * imagepath){
-
-	unsigned char header[124];
+static GLenum textureImageTarget(const TextureImage & image){
+	if (image.faceCount == 6)
+		return image.isArray ? GL_TEXTURE_CUBE_MAP_ARRAY : GL_TEXTURE_CUBE_MAP;
+	return image.isArray ? GL_TEXTURE_2D_ARRAY : GL_TEXTURE_2D;
+}
 
-	FILE *fp; 
- 
-	/* try to open the file */ 
-	fp = fopen(imagepath, "rb"); 
-	if (fp == NULL){
-		printf("%s could not be opened. Are you in the right directory ? Don't forget to read the FAQ !\n", imagepath); getchar(); 
-		return 0;
+// Gives a TextureImage to the texture bound to 'target', level by level, straight from the mapped file.
+static void fillTexture(GLenum target, const TextureImage & image){
+
+	glPixelStorei(GL_UNPACK_ALIGNMENT,1);
+
+	for (unsigned int level = 0; level < image.levelCount; ++level)
+	{
+		const TextureLevel & first = getTextureLevel(image, 0, 0, level);
+
+		if (image.isArray){
+			// Allocate the whole level, then fill it one layer (and face) at a time.
+			// For cubemap arrays, each face counts as a layer.
+			GLsizei depth = image.layerCount * image.faceCount;
+			if (image.compressed)
+				glCompressedTexImage3D(target, level, image.internalFormat, first.width, first.height, depth, 0, (GLsizei)(first.size * depth), NULL);
+			else
+				glTexImage3D(target, level, image.internalFormat, first.width, first.height, depth, 0, image.format, image.type, NULL);
+
+			for (unsigned int layer = 0; layer < image.layerCount; ++layer){
+				for (unsigned int face = 0; face < image.faceCount; ++face){
+					const TextureLevel & l = getTextureLevel(image, layer, face, level);
+					GLint z = layer * image.faceCount + face;
+					if (image.compressed)
+						glCompressedTexSubImage3D(target, level, 0, 0, z, l.width, l.height, 1, image.internalFormat, (GLsizei)l.size, l.data);
+					else
+						glTexSubImage3D(target, level, 0, 0, z, l.width, l.height, 1, image.format, image.type, l.data);
+				}
+			}
+		}else{
+			for (unsigned int face = 0; face < image.faceCount; ++face){
+				const TextureLevel & l = getTextureLevel(image, 0, face, level);
+				GLenum faceTarget = image.faceCount == 6 ? GL_TEXTURE_CUBE_MAP_POSITIVE_X + face : target;
+				if (image.compressed)
+					glCompressedTexImage2D(faceTarget, level, image.internalFormat, l.width, l.height, 0, (GLsizei)l.size, l.data);
+				else
+					glTexImage2D(faceTarget, level, image.internalFormat, l.width, l.height, 0, image.format, image.type, l.data);
+			}
+		}
 	}
-   
-	/* verify the type of file */ 
-	char filecode[4]; 
-	fread(filecode, 1, 4, fp); 
-	if (strncmp(filecode, "DDS ", 4) != 0) { 
-		fclose(fp); 
-		return 0; 
-	}
-	
-	/* get the surface desc */ 
-	fread(&header, 124, 1, fp); 
-
-	unsigned int height      = *(unsigned int*)&(header[8 ]);
-	unsigned int width	     = *(unsigned int*)&(header[12]);
-	unsigned int linearSize	 = *(unsigned int*)&(header[16]);
-	unsigned int mipMapCount = *(unsigned int*)&(header[24]);
-	unsigned int fourCC      = *(unsigned int*)&(header[80]);
-
- 
-	unsigned char * buffer;
-	unsigned int bufsize;
-	/* how big is it going to be including all mipmaps? */ 
-	bufsize = mipMapCount > 1 ? linearSize * 2 : linearSize; 
-	buffer = (unsigned char*)malloc(bufsize * sizeof(unsigned char)); 
-	fread(buffer, 1, bufsize, fp); 
-	/* close the file pointer */ 
-	fclose(fp);
-
-	unsigned int components  = (fourCC == FOURCC_DXT1) ? 3 : 4; 
-	unsigned int format;
-	switch(fourCC) 
-	{ 
-	case FOURCC_DXT1: 
-		format = GL_COMPRESSED_RGBA_S3TC_DXT1_EXT; 
-		break; 
-	case FOURCC_DXT3: 
-		format = GL_COMPRESSED_RGBA_S3TC_DXT3_EXT; 
-		break; 
-	case FOURCC_DXT5: 
-		format = GL_COMPRESSED_RGBA_S3TC_DXT5_EXT; 
-		break; 
-	default: 
-		free(buffer); 
-		return 0; 
+
+	if (image.generateMipmaps){
+		// ... nice trilinear filtering ...
+		glTexParameteri(target, GL_TEXTURE_WRAP_S, GL_REPEAT);
+		glTexParameteri(target, GL_TEXTURE_WRAP_T, GL_REPEAT);
+		glTexParameteri(target, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+		glTexParameteri(target, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+		glTexParameteri(target, GL_TEXTURE_BASE_LEVEL, 0);
+		glTexParameteri(target, GL_TEXTURE_MAX_LEVEL, 1000);
+		// ... which requires mipmaps. Generate them automatically.
+		glGenerateMipmap(target);
+	}else{
+		// Only the levels which are in the file : the texture is complete even if the mip chain isn't
+		glTexParameteri(target, GL_TEXTURE_BASE_LEVEL, 0);
+		glTexParameteri(target, GL_TEXTURE_MAX_LEVEL, image.levelCount - 1);
 	}
+}
+
+GLuint uploadTextureImage(const TextureImage & image){
+
+	GLenum target = textureImageTarget(image);
 
 	// Create one OpenGL texture
 	GLuint textureID;
 	glGenTextures(1, &textureID);
 
 	// "Bind" the newly created texture : all future texture functions will modify this texture
-	glBindTexture(GL_TEXTURE_2D, textureID);
-	glPixelStorei(GL_UNPACK_ALIGNMENT,1);	
-	
-	unsigned int blockSize = (format == GL_COMPRESSED_RGBA_S3TC_DXT1_EXT) ? 8 : 16; 
-	unsigned int offset = 0;
-
-	/* load the mipmaps */ 
-	for (unsigned int level = 0; level < mipMapCount && (width || height); ++level) 
-	{ 
-		unsigned int size = ((width+3)/4)*((height+3)/4)*blockSize; 
-		glCompressedTexImage2D(GL_TEXTURE_2D, level, format, width, height,  
-			0, size, buffer + offset); 
-	 
-		offset += size; 
-		width  /= 2; 
-		height /= 2; 
-
-		// Deal with Non-Power-Of-Two textures. This code is not included in the webpage to reduce clutter.
-		if(width < 1) width = 1;
-		if(height < 1) height = 1;
-
-	} 
-
-	free(buffer); 
+	glBindTexture(target, textureID);
+	fillTexture(target, image);
+
+	return textureID;
+}
+
+GLuint loadDDS(const char * imagepath){
+
+	PROFILE_SCOPE("loadDDS");
+
+	// Map the file; the header is validated and the exact size of each level computed
+	TextureImage image;
+	if (!loadDDSImage(imagepath, image))
+		return 0;
+
+	GLuint textureID = uploadTextureImage(image);
+
+	// OpenGL has now copied the data
+	unloadTextureImage(image);
 
 	return textureID;
+}
 
+static void uploadDecodedTexture(unsigned int textureID, const TextureImage * image, void * /*userData*/){
+	// The file couldn't be loaded (the reason has been printed), or the texture was deleted in the meantime :
+	// keep the placeholder
+	if (image == NULL || !glIsTexture(textureID))
+		return;
+	if (textureImageTarget(*image) != GL_TEXTURE_2D){
+		printf("loadTextureAsync : only 2D textures can be loaded asynchronously\n");
+		return;
+	}
+	glBindTexture(GL_TEXTURE_2D, textureID);
+	fillTexture(GL_TEXTURE_2D, *image);
+
+	// Nice trilinear filtering. BMP and TGA files have had their mipmaps generated by the workers
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+}
+
+GLuint loadTextureAsync(TextureManager * manager, const char * imagepath, bool normalMap){
+
+	// Create one OpenGL texture, with a grey 1x1 placeholder until the real image is there
+	GLuint textureID;
+	glGenTextures(1, &textureID);
+	glBindTexture(GL_TEXTURE_2D, textureID);
+
+	unsigned char grey[3] = { 128, 128, 128 };
+	glPixelStorei(GL_UNPACK_ALIGNMENT,1);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB8, 1, 1, 0, GL_RGB, GL_UNSIGNED_BYTE, grey);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, 0);
+
+	requestTextureDecode(manager, imagepath, textureID, normalMap);
+	return textureID;
+}
 
+size_t uploadDecodedTextures(TextureManager * manager, size_t byteBudget){
+	PROFILE_SCOPE("uploadDecodedTextures");
+	return drainDecodedTextures(manager, byteBudget, uploadDecodedTexture, NULL);
 }
\ No newline at end of file
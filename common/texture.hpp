@@ -12,5 +12,24 @@ GLuint loadBMP_custom(const char * imagepath);
 // Load a .DDS file using GLFW's own loader
 GLuint loadDDS(const char * imagepath);
 
+// Creates a texture from an image loaded by loadDDSImage (see textureimage.hpp) :
+// a GL_TEXTURE_2D, GL_TEXTURE_CUBE_MAP, GL_TEXTURE_2D_ARRAY or GL_TEXTURE_CUBE_MAP_ARRAY.
+// The texture stays bound.
+struct TextureImage;
+GLuint uploadTextureImage(const TextureImage & image);
+
+// Returns a texture immediately, with a grey placeholder in it. The file is loaded
+// by the manager's threads (see texturemanager.hpp), and the texture is filled later,
+// during a call to uploadDecodedTextures. Only for 2D textures.
+// The mipmaps of BMP and TGA files are generated by the manager's threads too;
+// use normalMap = true for normal maps, so that they stay normalized.
+struct TextureManager;
+GLuint loadTextureAsync(TextureManager * manager, const char * imagepath, bool normalMap = false);
+
+// Call this once per frame, on the GL thread : uploads the textures which are ready,
+// up to about byteBudget bytes (at least one texture). Returns the number of bytes uploaded.
+// This changes the texture bound to GL_TEXTURE_2D.
+size_t uploadDecodedTextures(TextureManager * manager, size_t byteBudget);
+
 
 #endif
\ No newline at end of file
@@ -0,0 +1,427 @@
+#include <vector>
+#include <string>
+#include <algorithm>
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+
+#include <glm/glm.hpp>
+
+#include <GL/glew.h>
+
+#include "textureimage.hpp"
+#include "texturecompressor.hpp"
+#include "mipmapgenerator.hpp"
+#include "textureatlas.hpp"
+
+// The skyline is the top edge of what has been placed in a page so far, from left to right.
+// A rectangle is placed on it, where its top is the lowest; the skyline then goes over it.
+// This wastes the holes under the overhanging rectangles, but placing the tallest ones first
+// keeps the holes small, and it is much faster than keeping a list of all the free rectangles.
+struct SkylineNode{
+	unsigned int x;
+	unsigned int y;
+	unsigned int width;
+};
+
+// y at which a width x height rectangle fits when its left edge is at skyline[index].x, if it fits at all
+static bool skylineFits(const std::vector<SkylineNode> & skyline, size_t index, unsigned int width, unsigned int height,
+	unsigned int pageSize, unsigned int & out_y){
+	if (skyline[index].x + width > pageSize)
+		return false;
+	unsigned int y = 0;
+	int widthLeft = (int)width;
+	for (size_t i=index; widthLeft > 0; i++){
+		y = std::max(y, skyline[i].y);
+		if (y + height > pageSize)
+			return false;
+		widthLeft -= (int)skyline[i].width;
+	}
+	out_y = y;
+	return true;
+}
+
+static void skylineAdd(std::vector<SkylineNode> & skyline, size_t index, unsigned int x, unsigned int y,
+	unsigned int width, unsigned int height){
+	SkylineNode node = { x, y + height, width };
+	skyline.insert(skyline.begin() + index, node);
+
+	// The nodes under the new one are shortened or removed
+	for (size_t i=index+1; i<skyline.size(); ){
+		unsigned int right = x + width;
+		if (skyline[i].x >= right)
+			break;
+		unsigned int shrink = right - skyline[i].x;
+		if (shrink < skyline[i].width){
+			skyline[i].x += shrink;
+			skyline[i].width -= shrink;
+			break;
+		}
+		skyline.erase(skyline.begin() + i);
+	}
+
+	// Neighbours at the same height are merged
+	for (size_t i=0; i+1<skyline.size(); ){
+		if (skyline[i].y == skyline[i+1].y){
+			skyline[i].width += skyline[i+1].width;
+			skyline.erase(skyline.begin() + i + 1);
+		}else{
+			i++;
+		}
+	}
+}
+
+static unsigned int roundUp(unsigned int value, unsigned int alignment){
+	return (value + alignment - 1) & ~(alignment - 1);
+}
+
+struct TallestFirst{
+	const std::vector<AtlasRect> * rects;
+	bool operator()(size_t a, size_t b) const{
+		const AtlasRect & ra = (*rects)[a];
+		const AtlasRect & rb = (*rects)[b];
+		if (ra.height != rb.height)
+			return ra.height > rb.height;
+		return ra.width > rb.width;
+	}
+};
+
+unsigned int packAtlasRects(std::vector<AtlasRect> & rects, unsigned int pageSize, unsigned int padding, unsigned int alignment){
+	if (alignment < 1)
+		alignment = 1;
+
+	std::vector<size_t> order(rects.size());
+	for (size_t i=0; i<rects.size(); i++)
+		order[i] = i;
+	TallestFirst tallestFirst = { &rects };
+	std::stable_sort(order.begin(), order.end(), tallestFirst);
+
+	std::vector<std::vector<SkylineNode> > pages;
+	for (size_t k=0; k<order.size(); k++){
+		AtlasRect & rect = rects[order[k]];
+		unsigned int cellWidth  = roundUp(rect.width  + 2*padding, alignment);
+		unsigned int cellHeight = roundUp(rect.height + 2*padding, alignment);
+		if (cellWidth > pageSize || cellHeight > pageSize){
+			printf("packAtlasRects : a %ux%u rectangle doesn't fit in a %ux%u page\n", rect.width, rect.height, pageSize, pageSize);
+			return 0;
+		}
+
+		// The lowest place, in the first page where it fits. A new page if there is none.
+		bool placed = false;
+		for (size_t p=0; p<=pages.size() && !placed; p++){
+			if (p == pages.size()){
+				SkylineNode empty = { 0, 0, pageSize };
+				pages.push_back(std::vector<SkylineNode>(1, empty));
+			}
+			std::vector<SkylineNode> & skyline = pages[p];
+			size_t bestIndex = 0;
+			unsigned int bestTop = 0xFFFFFFFF;
+			for (size_t i=0; i<skyline.size(); i++){
+				unsigned int y;
+				if (skylineFits(skyline, i, cellWidth, cellHeight, pageSize, y) && y + cellHeight < bestTop){
+					bestIndex = i;
+					bestTop = y + cellHeight;
+				}
+			}
+			if (bestTop == 0xFFFFFFFF)
+				continue;
+
+			rect.page = (unsigned int)p;
+			rect.x = skyline[bestIndex].x + padding;
+			rect.y = bestTop - cellHeight + padding;
+			skylineAdd(skyline, bestIndex, skyline[bestIndex].x, bestTop - cellHeight, cellWidth, cellHeight);
+			placed = true;
+		}
+	}
+	return (unsigned int)pages.size();
+}
+
+// Level 0 of any texture, as RGBA8 with the top row first
+static bool loadAtlasImage(const char * imagepath, std::vector<unsigned char> & out_rgba,
+	unsigned int & out_width, unsigned int & out_height, bool & out_flipV){
+	TextureImage image;
+	if (!loadTextureImage(imagepath, image))
+		return false;
+
+	const TextureLevel & level = getTextureLevel(image, 0, 0, 0);
+	unsigned int width = level.width, height = level.height;
+	out_rgba.resize((size_t)width * height * 4);
+	bool ok = true;
+	if (image.compressed){
+		ok = decompressImage(level.data, width, height, image.internalFormat, &out_rgba[0]);
+		out_flipV = false;
+	}else if (image.type == GL_UNSIGNED_BYTE && (image.format == GL_BGR || image.format == GL_BGRA ||
+	                                              image.format == GL_RGB || image.format == GL_RGBA)){
+		// DDS files are mapped, and their first row is the top one. BMP and TGA files are decoded bottom row first.
+		bool bottomFirst = image.file.data == NULL;
+		bool bgr = image.format == GL_BGR || image.format == GL_BGRA;
+		unsigned int bytesPerPixel = image.blockSize;
+		for (unsigned int y=0; y<height; y++){
+			const unsigned char * row = level.data + (size_t)(bottomFirst ? height - 1 - y : y) * width * bytesPerPixel;
+			for (unsigned int x=0; x<width; x++){
+				const unsigned char * in = row + x * bytesPerPixel;
+				unsigned char * out = &out_rgba[((size_t)y * width + x) * 4];
+				out[0] = in[bgr ? 2 : 0];
+				out[1] = in[1];
+				out[2] = in[bgr ? 0 : 2];
+				out[3] = bytesPerPixel == 4 ? in[3] : 255;
+			}
+		}
+		out_flipV = bottomFirst;
+	}else{
+		ok = false;
+	}
+	if (!ok)
+		printf("buildTextureAtlas : the format of %s is not supported\n", imagepath);
+
+	out_width = width;
+	out_height = height;
+	unloadTextureImage(image);
+	return ok;
+}
+
+// Mipmaps stay inside their cell if the cells are aligned on the size of the smallest level's pixels,
+// and the padding is still at least one pixel wide in the smallest level.
+static unsigned int atlasLevelCount(unsigned int padding){
+	unsigned int levelCount = 1;
+	while ((padding >> levelCount) != 0)
+		levelCount++;
+	return levelCount;
+}
+
+bool buildTextureAtlas(const std::vector<std::string> & imagepaths, const AtlasOptions & options, TextureAtlas & out_atlas){
+	out_atlas.pages.clear();
+	out_atlas.entries.clear();
+	out_atlas.levelCount = atlasLevelCount(options.padding);
+	unsigned int alignment = std::max(4u, 1u << (out_atlas.levelCount - 1)); // 4 for the compressed blocks
+
+	std::vector<std::vector<unsigned char> > images(imagepaths.size());
+	std::vector<AtlasRect> rects(imagepaths.size());
+	out_atlas.entries.resize(imagepaths.size());
+	for (size_t i=0; i<imagepaths.size(); i++){
+		AtlasEntry & entry = out_atlas.entries[i];
+		entry.name = imagepaths[i];
+		if (!loadAtlasImage(imagepaths[i].c_str(), images[i], entry.width, entry.height, entry.flipV))
+			return false;
+		rects[i].width = entry.width;
+		rects[i].height = entry.height;
+	}
+
+	unsigned int pageCount = packAtlasRects(rects, options.pageSize, options.padding, alignment);
+	if (pageCount == 0 && !rects.empty())
+		return false;
+
+	// The last pages are often mostly empty : use the smallest power of two which contains everything
+	out_atlas.pages.resize(pageCount);
+	for (size_t p=0; p<pageCount; p++){
+		out_atlas.pages[p].width = alignment;
+		out_atlas.pages[p].height = alignment;
+	}
+	for (size_t i=0; i<rects.size(); i++){
+		AtlasPage & page = out_atlas.pages[rects[i].page];
+		unsigned int right  = rects[i].x - options.padding + roundUp(rects[i].width  + 2*options.padding, alignment);
+		unsigned int bottom = rects[i].y - options.padding + roundUp(rects[i].height + 2*options.padding, alignment);
+		while (page.width  < right)  page.width  *= 2;
+		while (page.height < bottom) page.height *= 2;
+	}
+	for (size_t p=0; p<pageCount; p++){
+		AtlasPage & page = out_atlas.pages[p];
+		page.width  = std::min(page.width,  options.pageSize);
+		page.height = std::min(page.height, options.pageSize);
+		page.rgba.assign((size_t)page.width * page.height * 4, 0);
+	}
+
+	// Copy each image in its cell, and repeat its edges in the rest of the cell
+	for (size_t i=0; i<rects.size(); i++){
+		AtlasEntry & entry = out_atlas.entries[i];
+		AtlasPage & page = out_atlas.pages[rects[i].page];
+		entry.page = rects[i].page;
+		entry.x = rects[i].x;
+		entry.y = rects[i].y;
+
+		int x0 = (int)entry.x - (int)options.padding, y0 = (int)entry.y - (int)options.padding;
+		int x1 = x0 + (int)roundUp(entry.width  + 2*options.padding, alignment);
+		int y1 = y0 + (int)roundUp(entry.height + 2*options.padding, alignment);
+		for (int y=y0; y<y1; y++){
+			int sy = std::min(std::max(y - (int)entry.y, 0), (int)entry.height - 1);
+			for (int x=x0; x<x1; x++){
+				int sx = std::min(std::max(x - (int)entry.x, 0), (int)entry.width - 1);
+				memcpy(&page.rgba[((size_t)y * page.width + x) * 4], &images[i][((size_t)sy * entry.width + sx) * 4], 4);
+			}
+		}
+	}
+	return true;
+}
+
+int findAtlasEntry(const TextureAtlas & atlas, const char * imagepath){
+	for (size_t i=0; i<atlas.entries.size(); i++)
+		if (atlas.entries[i].name == imagepath)
+			return (int)i;
+	return -1;
+}
+
+bool remapAtlasUVs(const TextureAtlas & atlas, unsigned int entry, std::vector<glm::vec2> & uvs){
+	if (uvs.empty())
+		return true;
+	const AtlasEntry & e = atlas.entries[entry];
+	const AtlasPage & page = atlas.pages[e.page];
+
+	// Bring all the UVs in [0,1] with the same offset. For instance the UVs of loadOBJ, which
+	// are inverted for DDS files, are usually in [-1,0], which GL_REPEAT makes the same as [0,1].
+	glm::vec2 minUV = uvs[0], maxUV = uvs[0];
+	for (size_t i=1; i<uvs.size(); i++){
+		minUV = glm::min(minUV, uvs[i]);
+		maxUV = glm::max(maxUV, uvs[i]);
+	}
+	glm::vec2 offset = glm::floor(minUV);
+	if (maxUV.x - offset.x > 1.001f || maxUV.y - offset.y > 1.001f){
+		printf("remapAtlasUVs : the UVs repeat %s, which can't be done in an atlas\n", e.name.c_str());
+		return false;
+	}
+
+	for (size_t i=0; i<uvs.size(); i++){
+		glm::vec2 uv = glm::clamp(uvs[i] - offset, 0.0f, 1.0f);
+		if (e.flipV)
+			uv.y = 1.0f - uv.y;
+		uvs[i].x = (e.x + uv.x * e.width)  / page.width;
+		uvs[i].y = (e.y + uv.y * e.height) / page.height;
+	}
+	return true;
+}
+
+// Writes a file under a temporary name first, so that a crash never leaves a half-written file behind
+static bool replaceFile(const std::string & tempPath, const std::string & path){
+	remove(path.c_str()); // rename() doesn't overwrite on Windows
+	if (rename(tempPath.c_str(), path.c_str()) != 0){
+		printf("cookTextureAtlas : can't write %s\n", path.c_str());
+		remove(tempPath.c_str());
+		return false;
+	}
+	return true;
+}
+
+static bool writeAtlasPage(const AtlasPage & page, unsigned int levelCount, BlockFormat format){
+	// Box filter : with the cells aligned, each level only averages pixels of the same cell
+	MipmapOptions mipmapOptions = { MIPMAP_BOX, true, false, false, 0 };
+	std::vector<std::vector<unsigned char> > mips;
+	generateMipmapChain(&page.rgba[0], page.width, page.height, mipmapOptions, mips);
+
+	TextureImage cooked;
+	memset(&cooked.file, 0, sizeof(cooked.file));
+	cooked.width = page.width;
+	cooked.height = page.height;
+	cooked.levelCount = std::min(levelCount, (unsigned int)mips.size());
+	cooked.layerCount = 1;
+	cooked.faceCount = 1;
+	cooked.isArray = false;
+	cooked.compressed = true;
+	cooked.blockSize = format == BLOCK_BC1 ? 8 : 16;
+	cooked.internalFormat = format == BLOCK_BC1 ? GL_COMPRESSED_RGBA_S3TC_DXT1_EXT :
+	                        format == BLOCK_BC3 ? GL_COMPRESSED_RGBA_S3TC_DXT5_EXT : GL_COMPRESSED_RGBA_BPTC_UNORM;
+	cooked.format = 0;
+	cooked.type = 0;
+	cooked.generateMipmaps = false;
+
+	size_t totalSize = 0;
+	for (unsigned int level=0; level<cooked.levelCount; level++)
+		totalSize += compressedImageSize(std::max(page.width >> level, 1u), std::max(page.height >> level, 1u), format);
+	cooked.pixels.resize(totalSize);
+	cooked.levels.resize(cooked.levelCount);
+	size_t offset = 0;
+	for (unsigned int level=0; level<cooked.levelCount; level++){
+		TextureLevel & l = cooked.levels[level];
+		l.width  = std::max(page.width  >> level, 1u);
+		l.height = std::max(page.height >> level, 1u);
+		l.size = compressedImageSize(l.width, l.height, format);
+		l.data = &cooked.pixels[offset];
+		compressImage(&mips[level][0], l.width, l.height, format, &cooked.pixels[offset], 0);
+		offset += l.size;
+	}
+
+	std::string tempPath = page.path + ".tmp";
+	return writeDDSImage(tempPath.c_str(), cooked) && replaceFile(tempPath, page.path);
+}
+
+bool cookTextureAtlas(const std::vector<std::string> & imagepaths, const AtlasOptions & options, BlockFormat format,
+	const char * atlaspath, TextureAtlas & out_atlas){
+
+	printf("Cooking atlas %s...\n", atlaspath);
+
+	if (!buildTextureAtlas(imagepaths, options, out_atlas))
+		return false;
+
+	for (size_t p=0; p<out_atlas.pages.size(); p++){
+		char suffix[32];
+		sprintf(suffix, ".%u.dds", (unsigned int)p);
+		out_atlas.pages[p].path = std::string(atlaspath) + suffix;
+		if (!writeAtlasPage(out_atlas.pages[p], out_atlas.levelCount, format))
+			return false;
+	}
+
+	std::string tempPath = std::string(atlaspath) + ".tmp";
+	FILE * file = fopen(tempPath.c_str(), "w");
+	if (file == NULL){
+		printf("cookTextureAtlas : can't write %s\n", tempPath.c_str());
+		return false;
+	}
+	fprintf(file, "# Texture atlas, written by cookTextureAtlas\n");
+	fprintf(file, "levels %u\n", out_atlas.levelCount);
+	for (size_t p=0; p<out_atlas.pages.size(); p++){
+		const AtlasPage & page = out_atlas.pages[p];
+		fprintf(file, "page %u %u %s\n", page.width, page.height, page.path.c_str());
+	}
+	for (size_t i=0; i<out_atlas.entries.size(); i++){
+		const AtlasEntry & e = out_atlas.entries[i];
+		fprintf(file, "entry %u %u %u %u %u %d %s\n", e.page, e.x, e.y, e.width, e.height, e.flipV ? 1 : 0, e.name.c_str());
+	}
+	bool ok = ferror(file) == 0;
+	fclose(file);
+	return ok && replaceFile(tempPath, atlaspath);
+}
+
+bool loadTextureAtlas(const char * atlaspath, TextureAtlas & out_atlas){
+	out_atlas.pages.clear();
+	out_atlas.entries.clear();
+	out_atlas.levelCount = 1;
+
+	FILE * file = fopen(atlaspath, "r");
+	if (file == NULL){
+		printf("%s could not be opened.\n", atlaspath);
+		return false;
+	}
+
+	char line[1024];
+	bool ok = true;
+	while (ok && fgets(line, sizeof(line), file)){
+		line[strcspn(line, "\r\n")] = 0;
+		int nameStart = 0;
+		AtlasPage page;
+		AtlasEntry entry;
+		int flipV;
+		if (line[0] == '#' || line[0] == 0){
+			continue;
+		}else if (sscanf(line, "levels %u", &out_atlas.levelCount) == 1){
+			continue;
+		}else if (sscanf(line, "page %u %u %n", &page.width, &page.height, &nameStart) == 2 && nameStart > 0){
+			page.path = line + nameStart;
+			out_atlas.pages.push_back(page);
+		}else if (sscanf(line, "entry %u %u %u %u %u %d %n", &entry.page, &entry.x, &entry.y, &entry.width, &entry.height,
+		                  &flipV, &nameStart) == 6 && nameStart > 0){
+			entry.flipV = flipV != 0;
+			entry.name = line + nameStart;
+			out_atlas.entries.push_back(entry);
+		}else{
+			printf("%s : can't read the line \"%s\"\n", atlaspath, line);
+			ok = false;
+		}
+	}
+	fclose(file);
+
+	for (size_t i=0; ok && i<out_atlas.entries.size(); i++){
+		if (out_atlas.entries[i].page >= out_atlas.pages.size()){
+			printf("%s : %s is in a page which doesn't exist\n", atlaspath, out_atlas.entries[i].name.c_str());
+			ok = false;
+		}
+	}
+	return ok;
+}
@@ -0,0 +1,73 @@
+#ifndef TEXTUREATLAS_HPP
+#define TEXTUREATLAS_HPP
+
+// Packs many small textures into a few big ones ("pages"), so that objects which
+// used different textures can be drawn with a single glBindTexture.
+// Each object's UVs must then be moved to where its texture is in the page : see remapAtlasUVs.
+
+// A rectangle to pack. width and height are given; page, x and y are set by packAtlasRects.
+struct AtlasRect{
+	unsigned int width;
+	unsigned int height;
+	unsigned int page;
+	unsigned int x;
+	unsigned int y;
+};
+
+// Places the rectangles in as few pageSize x pageSize pages as possible ("skyline" packer :
+// the tallest rectangles first, each one as low as possible), with 'padding' free pixels
+// around each of them, and with x and y multiples of 'alignment' (a power of two).
+// Returns the number of pages, or 0 if a rectangle is too big for a page.
+unsigned int packAtlasRects(std::vector<AtlasRect> & rects, unsigned int pageSize, unsigned int padding, unsigned int alignment);
+
+struct AtlasOptions{
+	unsigned int pageSize;   // width and height of the pages; the last ones may be smaller
+	unsigned int padding;    // pixels around each texture, filled with copies of its edges so that
+	                         // filtering doesn't bleed the neighbours in. This also limits the number
+	                         // of mipmap levels : 1 + log2(padding), so use at least 4, and a power of two.
+};
+
+struct AtlasPage{
+	unsigned int width;
+	unsigned int height;
+	std::vector<unsigned char> rgba; // top row first, like DDS files. Empty after loadTextureAtlas
+	std::string path;                // the .DDS file, after cookTextureAtlas or loadTextureAtlas
+};
+
+struct AtlasEntry{
+	std::string name;        // the path of the texture, as given to buildTextureAtlas
+	unsigned int page;
+	unsigned int x;          // in pixels, in the page
+	unsigned int y;
+	unsigned int width;
+	unsigned int height;
+	bool flipV;              // BMP and TGA files are stored bottom row first, the pages top row first
+};
+
+struct TextureAtlas{
+	std::vector<AtlasPage> pages;
+	std::vector<AtlasEntry> entries; // in the order of the paths given to buildTextureAtlas
+	unsigned int levelCount;         // mipmap levels which don't bleed across the padding
+};
+
+// Loads the textures (.BMP, .TGA or .DDS, of which only level 0 is used) and packs them into pages.
+bool buildTextureAtlas(const std::vector<std::string> & imagepaths, const AtlasOptions & options, TextureAtlas & out_atlas);
+
+// Index of the entry of the texture imagepath, or -1
+int findAtlasEntry(const TextureAtlas & atlas, const char * imagepath);
+
+// Moves UVs made for the texture of 'entry' (by loadOBJ, indexVBO, ...) to the page of this entry.
+// The result addresses the rows of the page directly : it must not be inverted like the UVs of DDS files.
+// Since pages can't repeat, the UVs of one mesh must all be in the same [n, n+1] range;
+// returns false if they aren't (the texture is repeated over the mesh).
+bool remapAtlasUVs(const TextureAtlas & atlas, unsigned int entry, std::vector<glm::vec2> & uvs);
+
+// Builds an atlas, writes its mipmapped, compressed pages ("atlaspath.0.dds", ...) and a text
+// file, atlaspath, which lists the pages and where each texture is. See texturecompressor.hpp.
+bool cookTextureAtlas(const std::vector<std::string> & imagepaths, const AtlasOptions & options, BlockFormat format,
+	const char * atlaspath, TextureAtlas & out_atlas);
+
+// Reads the text file written by cookTextureAtlas. The pages aren't loaded : use loadDDS on their path.
+bool loadTextureAtlas(const char * atlaspath, TextureAtlas & out_atlas);
+
+#endif
@@ -0,0 +1,672 @@
+#include <vector>
+#include <string>
+#include <thread>
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+
+#include <sys/types.h>
+#include <sys/stat.h>
+
+#include <GL/glew.h>
+
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#define TEXTURECOMPRESSOR_SSE
+#include <xmmintrin.h>
+#endif
+
+#include "textureimage.hpp"
+#include "mipmapgenerator.hpp"
+#include "texturecompressor.hpp"
+
+// A 4x4 block of pixels, one array per channel (r, g, b, a), in [0,255].
+// Pixels outside of the image are copies of the last row / column.
+struct PixelBlock{
+	float channels[4][16];
+};
+
+static void loadPixelBlock(const unsigned char * rgba, unsigned int width, unsigned int height, unsigned int blockX, unsigned int blockY, PixelBlock & out_block){
+	for (unsigned int y=0; y<4; y++){
+		unsigned int py = blockY*4 + y < height ? blockY*4 + y : height - 1;
+		for (unsigned int x=0; x<4; x++){
+			unsigned int px = blockX*4 + x < width ? blockX*4 + x : width - 1;
+			const unsigned char * p = rgba + ((size_t)py * width + px) * 4;
+			for (int c=0; c<4; c++)
+				out_block.channels[c][y*4+x] = p[c];
+		}
+	}
+}
+
+// For each of the 16 pixels, finds the nearest palette entry (using the first channelCount channels,
+// starting at firstChannel). Returns the total squared error.
+static float fitIndices(const PixelBlock & block, int firstChannel, int channelCount,
+	const float palette[][4], int paletteSize, unsigned char * out_indices){
+	float error = 0.0f;
+#ifdef TEXTURECOMPRESSOR_SSE
+	// 4 pixels at a time
+	for (int i=0; i<16; i+=4){
+		__m128 bestDistance = _mm_set1_ps(1e30f);
+		__m128 bestIndex = _mm_setzero_ps();
+		for (int p=0; p<paletteSize; p++){
+			__m128 distance = _mm_setzero_ps();
+			for (int c=0; c<channelCount; c++){
+				__m128 d = _mm_sub_ps(_mm_loadu_ps(&block.channels[firstChannel + c][i]), _mm_set1_ps(palette[p][c]));
+				distance = _mm_add_ps(distance, _mm_mul_ps(d, d));
+			}
+			__m128 closer = _mm_cmplt_ps(distance, bestDistance);
+			bestDistance = _mm_or_ps(_mm_and_ps(closer, distance), _mm_andnot_ps(closer, bestDistance));
+			bestIndex = _mm_or_ps(_mm_and_ps(closer, _mm_set1_ps((float)p)), _mm_andnot_ps(closer, bestIndex));
+		}
+		float distances[4], indices[4];
+		_mm_storeu_ps(distances, bestDistance);
+		_mm_storeu_ps(indices, bestIndex);
+		for (int k=0; k<4; k++){
+			out_indices[i+k] = (unsigned char)indices[k];
+			error += distances[k];
+		}
+	}
+#else
+	for (int i=0; i<16; i++){
+		float bestDistance = 1e30f;
+		int bestIndex = 0;
+		for (int p=0; p<paletteSize; p++){
+			float distance = 0.0f;
+			for (int c=0; c<channelCount; c++){
+				float d = block.channels[firstChannel + c][i] - palette[p][c];
+				distance += d * d;
+			}
+			if (distance < bestDistance){
+				bestDistance = distance;
+				bestIndex = p;
+			}
+		}
+		out_indices[i] = (unsigned char)bestIndex;
+		error += bestDistance;
+	}
+#endif
+	return error;
+}
+
+// First guess for the endpoints : the extremities of the pixels, projected on their principal axis.
+static void findEndpoints(const PixelBlock & block, int channelCount, float out_endpoints[2][4]){
+	float mean[4] = { 0, 0, 0, 0 };
+	for (int c=0; c<channelCount; c++){
+		for (int i=0; i<16; i++)
+			mean[c] += block.channels[c][i];
+		mean[c] /= 16.0f;
+	}
+
+	float covariance[4][4];
+	for (int c=0; c<channelCount; c++){
+		for (int d=0; d<channelCount; d++){
+			float sum = 0.0f;
+			for (int i=0; i<16; i++)
+				sum += (block.channels[c][i] - mean[c]) * (block.channels[d][i] - mean[d]);
+			covariance[c][d] = sum;
+		}
+	}
+
+	// Power iteration, starting from the diagonal of the bounding box
+	float axis[4] = { 0, 0, 0, 0 };
+	for (int c=0; c<channelCount; c++){
+		float lo = 255.0f, hi = 0.0f;
+		for (int i=0; i<16; i++){
+			lo = fminf(lo, block.channels[c][i]);
+			hi = fmaxf(hi, block.channels[c][i]);
+		}
+		axis[c] = hi - lo;
+	}
+	for (int iteration=0; iteration<8; iteration++){
+		float next[4] = { 0, 0, 0, 0 };
+		float length = 0.0f;
+		for (int c=0; c<channelCount; c++){
+			for (int d=0; d<channelCount; d++)
+				next[c] += covariance[c][d] * axis[d];
+			length = fmaxf(length, fabsf(next[c]));
+		}
+		if (length <= 0.0f)
+			break; // all the pixels are the same : keep the current axis
+		for (int c=0; c<channelCount; c++)
+			axis[c] = next[c] / length;
+	}
+	float length2 = 0.0f;
+	for (int c=0; c<channelCount; c++)
+		length2 += axis[c] * axis[c];
+
+	float tMin = 0.0f, tMax = 0.0f;
+	if (length2 > 0.0f){
+		tMin = 1e30f; tMax = -1e30f;
+		for (int i=0; i<16; i++){
+			float t = 0.0f;
+			for (int c=0; c<channelCount; c++)
+				t += (block.channels[c][i] - mean[c]) * axis[c];
+			tMin = fminf(tMin, t);
+			tMax = fmaxf(tMax, t);
+		}
+		tMin /= length2;
+		tMax /= length2;
+	}
+	for (int c=0; c<channelCount; c++){
+		out_endpoints[0][c] = fminf(fmaxf(mean[c] + axis[c] * tMin, 0.0f), 255.0f);
+		out_endpoints[1][c] = fminf(fmaxf(mean[c] + axis[c] * tMax, 0.0f), 255.0f);
+	}
+}
+
+// Least-squares endpoints, given the index of each pixel.
+// weights[index] is how much of endpoint 1 (vs. endpoint 0) this index gives.
+static void refineEndpoints(const PixelBlock & block, int channelCount, const unsigned char * indices,
+	const float * weights, float out_endpoints[2][4]){
+	float a = 0.0f, b = 0.0f, c = 0.0f;
+	float x0[4] = { 0, 0, 0, 0 }, x1[4] = { 0, 0, 0, 0 };
+	for (int i=0; i<16; i++){
+		float w = weights[indices[i]];
+		a += (1.0f - w) * (1.0f - w);
+		b += (1.0f - w) * w;
+		c += w * w;
+		for (int ch=0; ch<channelCount; ch++){
+			x0[ch] += (1.0f - w) * block.channels[ch][i];
+			x1[ch] += w * block.channels[ch][i];
+		}
+	}
+	float determinant = a * c - b * b;
+	if (fabsf(determinant) < 1e-6f)
+		return; // all the pixels use the same index
+	for (int ch=0; ch<channelCount; ch++){
+		out_endpoints[0][ch] = fminf(fmaxf((c * x0[ch] - b * x1[ch]) / determinant, 0.0f), 255.0f);
+		out_endpoints[1][ch] = fminf(fmaxf((a * x1[ch] - b * x0[ch]) / determinant, 0.0f), 255.0f);
+	}
+}
+
+static unsigned short packRGB565(const float color[4]){
+	unsigned int r = (unsigned int)(color[0] * (31.0f / 255.0f) + 0.5f);
+	unsigned int g = (unsigned int)(color[1] * (63.0f / 255.0f) + 0.5f);
+	unsigned int b = (unsigned int)(color[2] * (31.0f / 255.0f) + 0.5f);
+	return (unsigned short)((r << 11) | (g << 5) | b);
+}
+
+static void unpackRGB565(unsigned short c, int out_color[3]){
+	int r = (c >> 11) & 31, g = (c >> 5) & 63, b = c & 31;
+	out_color[0] = (r << 3) | (r >> 2);
+	out_color[1] = (g << 2) | (g >> 4);
+	out_color[2] = (b << 3) | (b >> 2);
+}
+
+// The 4 colors of a BC1 block in 4-color mode (color0 > color1)
+static void bc1Palette(unsigned short c0, unsigned short c1, int out_palette[4][3]){
+	unpackRGB565(c0, out_palette[0]);
+	unpackRGB565(c1, out_palette[1]);
+	for (int c=0; c<3; c++){
+		out_palette[2][c] = (2 * out_palette[0][c] + out_palette[1][c]) / 3;
+		out_palette[3][c] = (out_palette[0][c] + 2 * out_palette[1][c]) / 3;
+	}
+}
+
+// BC1 color block, always in 4-color mode so that it can be used in BC3 too
+static void encodeBC1Block(const PixelBlock & block, unsigned char * out){
+	static const float weights[4] = { 0.0f, 1.0f, 1.0f/3.0f, 2.0f/3.0f };
+
+	float endpoints[2][4];
+	findEndpoints(block, 3, endpoints);
+
+	float bestError = 1e30f;
+	unsigned short best0 = 0, best1 = 0;
+	unsigned char bestIndices[16];
+	for (int iteration=0; iteration<2; iteration++){
+		unsigned short c0 = packRGB565(endpoints[0]);
+		unsigned short c1 = packRGB565(endpoints[1]);
+		if (c0 < c1){
+			unsigned short t = c0; c0 = c1; c1 = t;
+		}
+		int ipalette[4][3];
+		bc1Palette(c0, c1, ipalette);
+		float palette[4][4];
+		for (int p=0; p<4; p++)
+			for (int c=0; c<3; c++)
+				palette[p][c] = (float)ipalette[p][c];
+
+		unsigned char indices[16];
+		// c0 == c1 would mean 3-color mode : use only the first color
+		float error = fitIndices(block, 0, 3, palette, c0 == c1 ? 1 : 4, indices);
+		if (error < bestError){
+			bestError = error;
+			best0 = c0;
+			best1 = c1;
+			memcpy(bestIndices, indices, 16);
+		}
+		// The endpoints may have been swapped : this refines them in the order of the palette
+		if (iteration == 0)
+			refineEndpoints(block, 3, indices, weights, endpoints);
+	}
+
+	out[0] = best0 & 0xFF; out[1] = best0 >> 8;
+	out[2] = best1 & 0xFF; out[3] = best1 >> 8;
+	unsigned int bits = 0;
+	for (int i=0; i<16; i++)
+		bits |= (unsigned int)bestIndices[i] << (2*i);
+	memcpy(out + 4, &bits, 4);
+}
+
+// BC3 alpha block, in 8-alpha mode (alpha0 > alpha1)
+static void encodeAlphaBlock(const PixelBlock & block, unsigned char * out){
+	float lo = 255.0f, hi = 0.0f;
+	for (int i=0; i<16; i++){
+		lo = fminf(lo, block.channels[3][i]);
+		hi = fmaxf(hi, block.channels[3][i]);
+	}
+	int a0 = (int)(hi + 0.5f), a1 = (int)(lo + 0.5f);
+	memset(out, 0, 8);
+	out[0] = (unsigned char)a0;
+	out[1] = (unsigned char)a1;
+	if (a0 == a1)
+		return; // all the indices are 0
+
+	float palette[8][4];
+	palette[0][0] = (float)a0;
+	palette[1][0] = (float)a1;
+	for (int i=2; i<8; i++)
+		palette[i][0] = (float)(((8 - i) * a0 + (i - 1) * a1) / 7);
+	unsigned char indices[16];
+	fitIndices(block, 3, 1, palette, 8, indices);
+
+	unsigned long long bits = 0;
+	for (int i=0; i<16; i++)
+		bits |= (unsigned long long)indices[i] << (3*i);
+	for (int k=0; k<6; k++)
+		out[2+k] = (unsigned char)(bits >> (8*k));
+}
+
+static const int bc7Weights4[16] = { 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+
+static void writeBits(unsigned char * out, unsigned int & position, unsigned int value, unsigned int count){
+	for (unsigned int i=0; i<count; i++, position++){
+		if ((value >> i) & 1)
+			out[position >> 3] |= (unsigned char)(1 << (position & 7));
+	}
+}
+
+// BC7 mode 6 : 7-bit RGBA endpoints + 1 p-bit each, 4-bit indices
+static void encodeBC7Block(const PixelBlock & block, unsigned char * out){
+	float weights[16];
+	for (int i=0; i<16; i++)
+		weights[i] = bc7Weights4[i] / 64.0f;
+
+	float endpoints[2][4];
+	findEndpoints(block, 4, endpoints);
+
+	float bestError = 1e30f;
+	int bestQ[2][4] = { { 0 } }, bestP[2] = { 0, 0 };
+	unsigned char bestIndices[16];
+	memset(bestIndices, 0, 16);
+	for (int iteration=0; iteration<2; iteration++){
+		// Try the 4 combinations of p-bits
+		for (int pbits=0; pbits<4; pbits++){
+			int p[2] = { pbits & 1, pbits >> 1 };
+			int q[2][4], v[2][4];
+			for (int e=0; e<2; e++){
+				for (int c=0; c<4; c++){
+					int qc = (int)floorf((endpoints[e][c] - p[e]) * 0.5f + 0.5f);
+					q[e][c] = qc < 0 ? 0 : (qc > 127 ? 127 : qc);
+					v[e][c] = (q[e][c] << 1) | p[e];
+				}
+			}
+			float palette[16][4];
+			for (int i=0; i<16; i++)
+				for (int c=0; c<4; c++)
+					palette[i][c] = (float)(((64 - bc7Weights4[i]) * v[0][c] + bc7Weights4[i] * v[1][c] + 32) >> 6);
+			unsigned char indices[16];
+			float error = fitIndices(block, 0, 4, palette, 16, indices);
+			if (error < bestError){
+				bestError = error;
+				memcpy(bestQ, q, sizeof(q));
+				bestP[0] = p[0]; bestP[1] = p[1];
+				memcpy(bestIndices, indices, 16);
+			}
+		}
+		if (iteration == 0)
+			refineEndpoints(block, 4, bestIndices, weights, endpoints);
+	}
+
+	// The most significant bit of the first index is implicitly 0 : swap the endpoints if needed
+	if (bestIndices[0] & 8){
+		for (int c=0; c<4; c++){
+			int t = bestQ[0][c]; bestQ[0][c] = bestQ[1][c]; bestQ[1][c] = t;
+		}
+		int t = bestP[0]; bestP[0] = bestP[1]; bestP[1] = t;
+		for (int i=0; i<16; i++)
+			bestIndices[i] = 15 - bestIndices[i];
+	}
+
+	memset(out, 0, 16);
+	unsigned int position = 0;
+	writeBits(out, position, 1 << 6, 7); // mode 6
+	for (int c=0; c<4; c++){
+		writeBits(out, position, bestQ[0][c], 7);
+		writeBits(out, position, bestQ[1][c], 7);
+	}
+	writeBits(out, position, bestP[0], 1);
+	writeBits(out, position, bestP[1], 1);
+	writeBits(out, position, bestIndices[0], 3);
+	for (int i=1; i<16; i++)
+		writeBits(out, position, bestIndices[i], 4);
+}
+
+static unsigned int blockBytes(BlockFormat format){
+	return format == BLOCK_BC1 ? 8 : 16;
+}
+
+size_t compressedImageSize(unsigned int width, unsigned int height, BlockFormat format){
+	return (size_t)((width+3)/4) * ((height+3)/4) * blockBytes(format);
+}
+
+static void compressBlockRows(const unsigned char * rgba, unsigned int width, unsigned int height, BlockFormat format,
+	unsigned char * out_blocks, unsigned int firstRow, unsigned int lastRow){
+	unsigned int blocksX = (width+3)/4;
+	for (unsigned int by=firstRow; by<lastRow; by++){
+		for (unsigned int bx=0; bx<blocksX; bx++){
+			PixelBlock block;
+			loadPixelBlock(rgba, width, height, bx, by, block);
+			unsigned char * out = out_blocks + ((size_t)by * blocksX + bx) * blockBytes(format);
+			if (format == BLOCK_BC1){
+				encodeBC1Block(block, out);
+			}else if (format == BLOCK_BC3){
+				encodeAlphaBlock(block, out);
+				encodeBC1Block(block, out + 8);
+			}else{
+				encodeBC7Block(block, out);
+			}
+		}
+	}
+}
+
+void compressImage(const unsigned char * rgba, unsigned int width, unsigned int height, BlockFormat format,
+	unsigned char * out_blocks, unsigned int threadCount){
+	if (threadCount == 0)
+		threadCount = std::thread::hardware_concurrency();
+	unsigned int blocksY = (height+3)/4;
+	// Not worth starting threads for the small mipmaps
+	unsigned int maxThreads = (unsigned int)(compressedImageSize(width, height, format) / 4096);
+	if (threadCount > maxThreads) threadCount = maxThreads;
+	if (threadCount > blocksY)    threadCount = blocksY;
+	if (threadCount < 1)          threadCount = 1;
+
+	std::vector<std::thread> threads;
+	for (unsigned int t=1; t<threadCount; t++){
+		threads.push_back(std::thread(compressBlockRows, rgba, width, height, format, out_blocks,
+			blocksY * t / threadCount, blocksY * (t+1) / threadCount));
+	}
+	compressBlockRows(rgba, width, height, format, out_blocks, 0, blocksY / threadCount);
+	for (size_t t=0; t<threads.size(); t++)
+		threads[t].join();
+}
+
+// Decoders, to measure the quality and to read compressed DDS files (see decompressImage)
+
+static void decodeBC1Block(const unsigned char * in, bool fourColors, unsigned char out[16][4]){
+	unsigned short c0 = in[0] | (in[1] << 8);
+	unsigned short c1 = in[2] | (in[3] << 8);
+	int palette[4][3];
+	bc1Palette(c0, c1, palette);
+	int alpha[4] = { 255, 255, 255, 255 };
+	if (!fourColors && c0 <= c1){
+		for (int c=0; c<3; c++){
+			palette[2][c] = (palette[0][c] + palette[1][c]) / 2;
+			palette[3][c] = 0;
+		}
+		alpha[3] = 0;
+	}
+	unsigned int bits;
+	memcpy(&bits, in + 4, 4);
+	for (int i=0; i<16; i++){
+		int index = (bits >> (2*i)) & 3;
+		for (int c=0; c<3; c++)
+			out[i][c] = (unsigned char)palette[index][c];
+		out[i][3] = (unsigned char)alpha[index];
+	}
+}
+
+static void decodeAlphaBlock(const unsigned char * in, unsigned char out[16][4]){
+	int a0 = in[0], a1 = in[1];
+	int palette[8] = { a0, a1 };
+	if (a0 > a1){
+		for (int i=2; i<8; i++)
+			palette[i] = ((8 - i) * a0 + (i - 1) * a1) / 7;
+	}else{
+		for (int i=2; i<6; i++)
+			palette[i] = ((6 - i) * a0 + (i - 1) * a1) / 5;
+		palette[6] = 0;
+		palette[7] = 255;
+	}
+	unsigned long long bits = 0;
+	for (int k=0; k<6; k++)
+		bits |= (unsigned long long)in[2+k] << (8*k);
+	for (int i=0; i<16; i++)
+		out[i][3] = (unsigned char)palette[(bits >> (3*i)) & 7];
+}
+
+// BC2 (DXT3) : 4 bits per pixel, no interpolation
+static void decodeExplicitAlphaBlock(const unsigned char * in, unsigned char out[16][4]){
+	for (int i=0; i<16; i++){
+		int a = (in[i/2] >> (4 * (i & 1))) & 15;
+		out[i][3] = (unsigned char)(a * 17);
+	}
+}
+
+static unsigned int readBits(const unsigned char * in, unsigned int & position, unsigned int count){
+	unsigned int value = 0;
+	for (unsigned int i=0; i<count; i++, position++)
+		value |= (unsigned int)((in[position >> 3] >> (position & 7)) & 1) << i;
+	return value;
+}
+
+// Only mode 6; the other modes are decoded as magenta
+static void decodeBC7Block(const unsigned char * in, unsigned char out[16][4]){
+	unsigned int position = 0;
+	if (readBits(in, position, 7) != (1 << 6)){
+		for (int i=0; i<16; i++){
+			out[i][0] = 255; out[i][1] = 0; out[i][2] = 255; out[i][3] = 255;
+		}
+		return;
+	}
+	int q[2][4];
+	for (int c=0; c<4; c++){
+		q[0][c] = readBits(in, position, 7);
+		q[1][c] = readBits(in, position, 7);
+	}
+	int p0 = readBits(in, position, 1);
+	int p1 = readBits(in, position, 1);
+	for (int i=0; i<16; i++){
+		int index = readBits(in, position, i == 0 ? 3 : 4);
+		for (int c=0; c<4; c++){
+			int v0 = (q[0][c] << 1) | p0;
+			int v1 = (q[1][c] << 1) | p1;
+			out[i][c] = (unsigned char)(((64 - bc7Weights4[index]) * v0 + bc7Weights4[index] * v1 + 32) >> 6);
+		}
+	}
+}
+
+bool decompressImage(const unsigned char * blocks, unsigned int width, unsigned int height, unsigned int internalFormat,
+	unsigned char * out_rgba){
+	unsigned int blockSize;
+	switch (internalFormat){
+	case GL_COMPRESSED_RGB_S3TC_DXT1_EXT:
+	case GL_COMPRESSED_RGBA_S3TC_DXT1_EXT:
+	case GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT1_EXT:
+		blockSize = 8;
+		break;
+	case GL_COMPRESSED_RGBA_S3TC_DXT3_EXT:
+	case GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT3_EXT:
+	case GL_COMPRESSED_RGBA_S3TC_DXT5_EXT:
+	case GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT5_EXT:
+	case GL_COMPRESSED_RGBA_BPTC_UNORM:
+	case GL_COMPRESSED_SRGB_ALPHA_BPTC_UNORM:
+		blockSize = 16;
+		break;
+	default:
+		return false;
+	}
+
+	unsigned int blocksX = (width+3)/4, blocksY = (height+3)/4;
+	for (unsigned int by=0; by<blocksY; by++){
+		for (unsigned int bx=0; bx<blocksX; bx++){
+			const unsigned char * in = blocks + ((size_t)by * blocksX + bx) * blockSize;
+			unsigned char decoded[16][4];
+			switch (internalFormat){
+			case GL_COMPRESSED_RGB_S3TC_DXT1_EXT:
+			case GL_COMPRESSED_RGBA_S3TC_DXT1_EXT:
+			case GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT1_EXT:
+				decodeBC1Block(in, false, decoded);
+				break;
+			case GL_COMPRESSED_RGBA_S3TC_DXT3_EXT:
+			case GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT3_EXT:
+				decodeBC1Block(in + 8, true, decoded);
+				decodeExplicitAlphaBlock(in, decoded);
+				break;
+			case GL_COMPRESSED_RGBA_S3TC_DXT5_EXT:
+			case GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT5_EXT:
+				decodeBC1Block(in + 8, true, decoded);
+				decodeAlphaBlock(in, decoded);
+				break;
+			default:
+				decodeBC7Block(in, decoded);
+				break;
+			}
+			for (unsigned int y=0; y<4 && by*4+y<height; y++)
+				for (unsigned int x=0; x<4 && bx*4+x<width; x++)
+					memcpy(out_rgba + ((size_t)(by*4+y) * width + bx*4+x) * 4, decoded[y*4+x], 4);
+		}
+	}
+	return true;
+}
+
+float compressedImagePSNR(const unsigned char * rgba, unsigned int width, unsigned int height, BlockFormat format,
+	const unsigned char * blocks){
+	std::vector<unsigned char> decoded((size_t)width * height * 4);
+	unsigned int internalFormat = format == BLOCK_BC1 ? GL_COMPRESSED_RGBA_S3TC_DXT1_EXT :
+	                              format == BLOCK_BC3 ? GL_COMPRESSED_RGBA_S3TC_DXT5_EXT : GL_COMPRESSED_RGBA_BPTC_UNORM;
+	decompressImage(blocks, width, height, internalFormat, &decoded[0]);
+
+	int channelCount = format == BLOCK_BC1 ? 3 : 4;
+	double squaredError = 0.0;
+	for (size_t i=0; i<(size_t)width * height; i++){
+		for (int c=0; c<channelCount; c++){
+			double d = (double)rgba[i*4+c] - decoded[i*4+c];
+			squaredError += d * d;
+		}
+	}
+	double mse = squaredError / ((double)width * height * channelCount);
+	if (mse <= 0.0)
+		return 100.0f;
+	return (float)(10.0 * log10(255.0 * 255.0 / mse));
+}
+
+bool cookTexture(const char * imagepath, const char * ddspath, BlockFormat format, unsigned int threadCount){
+
+	printf("Cooking %s...\n", imagepath);
+
+	TextureImage source;
+	if (!loadTextureImage(imagepath, source))
+		return false;
+	if (source.compressed || source.levels.size() != 1 || source.type != GL_UNSIGNED_BYTE ||
+	    (source.format != GL_BGR && source.format != GL_BGRA)){
+		printf("cookTexture : %s is not an uncompressed RGB(A) image\n", imagepath);
+		unloadTextureImage(source);
+		return false;
+	}
+
+	// To RGBA, top row first
+	unsigned int width = source.width, height = source.height;
+	unsigned int bytesPerPixel = source.blockSize;
+	std::vector<unsigned char> rgba((size_t)width * height * 4);
+	for (unsigned int y=0; y<height; y++){
+		const unsigned char * row = source.levels[0].data + (size_t)(height - 1 - y) * width * bytesPerPixel;
+		for (unsigned int x=0; x<width; x++){
+			unsigned char * p = &rgba[((size_t)y * width + x) * 4];
+			p[0] = row[x*bytesPerPixel + 2];
+			p[1] = row[x*bytesPerPixel + 1];
+			p[2] = row[x*bytesPerPixel + 0];
+			p[3] = bytesPerPixel == 4 ? row[x*bytesPerPixel + 3] : 255;
+		}
+	}
+	unloadTextureImage(source);
+
+	TextureImage cooked;
+	memset(&cooked.file, 0, sizeof(cooked.file));
+	cooked.width = width;
+	cooked.height = height;
+	cooked.layerCount = 1;
+	cooked.faceCount = 1;
+	cooked.isArray = false;
+	cooked.compressed = true;
+	cooked.blockSize = blockBytes(format);
+	cooked.internalFormat = format == BLOCK_BC1 ? GL_COMPRESSED_RGBA_S3TC_DXT1_EXT :
+	                        format == BLOCK_BC3 ? GL_COMPRESSED_RGBA_S3TC_DXT5_EXT : GL_COMPRESSED_RGBA_BPTC_UNORM;
+	cooked.format = 0;
+	cooked.type = 0;
+	cooked.generateMipmaps = false;
+
+	// All the levels, down to 1x1
+	MipmapOptions mipmapOptions = { MIPMAP_KAISER, true, false, true, threadCount };
+	std::vector<std::vector<unsigned char> > mips;
+	generateMipmapChain(&rgba[0], width, height, mipmapOptions, mips);
+	cooked.levelCount = (unsigned int)mips.size();
+	size_t totalSize = 0;
+	for (unsigned int level=0; level<cooked.levelCount; level++){
+		unsigned int w = width  >> level; if (w < 1) w = 1;
+		unsigned int h = height >> level; if (h < 1) h = 1;
+		totalSize += compressedImageSize(w, h, format);
+	}
+	cooked.pixels.resize(totalSize);
+	cooked.levels.resize(cooked.levelCount);
+
+	size_t offset = 0;
+	for (unsigned int level=0; level<cooked.levelCount; level++){
+		TextureLevel & l = cooked.levels[level];
+		l.width  = width  >> level; if (l.width  < 1) l.width  = 1;
+		l.height = height >> level; if (l.height < 1) l.height = 1;
+		l.size = compressedImageSize(l.width, l.height, format);
+		l.data = &cooked.pixels[offset];
+		compressImage(&mips[level][0], l.width, l.height, format, &cooked.pixels[offset], threadCount);
+		offset += l.size;
+	}
+
+	// Write to a temporary file first, so that a crash never leaves a half-written file behind
+	std::string tempPath = std::string(ddspath) + ".tmp";
+	bool ok = writeDDSImage(tempPath.c_str(), cooked);
+	if (ok){
+		remove(ddspath); // rename() doesn't overwrite on Windows
+		ok = rename(tempPath.c_str(), ddspath) == 0;
+		if (!ok){
+			printf("cookTexture : can't write %s\n", ddspath);
+			remove(tempPath.c_str());
+		}
+	}
+	return ok;
+}
+
+// Modification time, or -1 if the file doesn't exist
+static long long fileTime(const char * path){
+	struct stat st;
+	if (stat(path, &st) != 0)
+		return -1;
+	return (long long)st.st_mtime;
+}
+
+bool loadTextureImage_cooked(const char * imagepath, BlockFormat format, TextureImage & out_image){
+	std::string ddspath = std::string(imagepath) + ".dds";
+	unsigned int internalFormat = format == BLOCK_BC1 ? GL_COMPRESSED_RGBA_S3TC_DXT1_EXT :
+	                              format == BLOCK_BC3 ? GL_COMPRESSED_RGBA_S3TC_DXT5_EXT : GL_COMPRESSED_RGBA_BPTC_UNORM;
+
+	long long sourceTime = fileTime(imagepath);
+	long long cookedTime = fileTime(ddspath.c_str());
+	if (cookedTime >= 0 && cookedTime >= sourceTime){
+		if (loadDDSImage(ddspath.c_str(), out_image)){
+			if (out_image.internalFormat == internalFormat)
+				return true;
+			unloadTextureImage(out_image); // cooked in another format : cook it again
+		}
+	}
+
+	if (!cookTexture(imagepath, ddspath.c_str(), format, 0))
+		return false;
+	return loadDDSImage(ddspath.c_str(), out_image);
+}
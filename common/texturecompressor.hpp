@@ -0,0 +1,43 @@
+#ifndef TEXTURECOMPRESSOR_HPP
+#define TEXTURECOMPRESSOR_HPP
+
+// Block compression on the CPU, so that BMP and TGA files can be cooked into
+// mipmapped .DDS files which take 4 to 8 times less memory on the GPU.
+
+enum BlockFormat{
+	BLOCK_BC1,      // DXT1 : RGB, no alpha.                  8 bytes per 4x4 block
+	BLOCK_BC3,      // DXT5 : RGB + interpolated alpha.       16 bytes per 4x4 block
+	BLOCK_BC7       // BPTC : RGBA, better quality but slower. 16 bytes per 4x4 block
+	                // Only mode 6 (one pair of RGBA endpoints, 16 levels) is used.
+};
+
+size_t compressedImageSize(unsigned int width, unsigned int height, BlockFormat format);
+
+// Compresses width*height RGBA8 pixels (rgba[0..3] is the first pixel of the first row)
+// into out_blocks, which must have room for compressedImageSize() bytes.
+// The rows of blocks are shared between threadCount threads (0 = one per core).
+void compressImage(const unsigned char * rgba, unsigned int width, unsigned int height, BlockFormat format,
+	unsigned char * out_blocks, unsigned int threadCount);
+
+// Decompresses the blocks of one level of a compressed texture into width*height RGBA8 pixels.
+// internalFormat is the one of the TextureImage : DXT1, DXT3, DXT5 (sRGB or not), or BPTC, of which
+// only mode 6 is supported (the blocks of the other modes come out magenta). Returns false for other formats.
+bool decompressImage(const unsigned char * blocks, unsigned int width, unsigned int height, unsigned int internalFormat,
+	unsigned char * out_rgba);
+
+// Decompresses out_blocks and compares it to rgba. The alpha channel is ignored for BLOCK_BC1.
+// Returns the PSNR in dB (100 if there is no difference at all).
+float compressedImagePSNR(const unsigned char * rgba, unsigned int width, unsigned int height, BlockFormat format,
+	const unsigned char * blocks);
+
+// Loads a .BMP or .TGA file, builds its mipmaps (sRGB-correct Kaiser filter, see mipmapgenerator.hpp),
+// compresses them, and writes the result in ddspath.
+// The first row of the .DDS file is the top one, like in all the DDS files of the tutorials,
+// so it must be used with the same UVs as them.
+bool cookTexture(const char * imagepath, const char * ddspath, BlockFormat format, unsigned int threadCount);
+
+// Loads imagepath through a cooked file next to it ("file.bmp.dds"), which is
+// cooked again when it is missing, older than imagepath, or in another format.
+bool loadTextureImage_cooked(const char * imagepath, BlockFormat format, TextureImage & out_image);
+
+#endif
\ No newline at end of file
@@ -0,0 +1,577 @@
+#include <vector>
+#include <stdio.h>
+#include <string.h>
+#include <ctype.h>
+
+#include <GL/glew.h>
+
+#include "textureimage.hpp"
+
+// See https://docs.microsoft.com/en-us/windows/win32/direct3ddds/dx-graphics-dds-pguide
+// A DDS file is :
+// - "DDS ",
+// - a 124-byte DDS_HEADER, which contains a 32-byte DDS_PIXELFORMAT,
+// - if the pixel format's fourCC is "DX10", a 20-byte DDS_HEADER_DXT10,
+// - the data : for each layer, for each face, for each mipmap level, the pixels.
+
+#define DDS_HEADER_SIZE        124
+#define DDS_PIXELFORMAT_SIZE   32
+#define DDS_DX10_HEADER_SIZE   20
+
+#define DDSD_CAPS              0x1
+#define DDSD_HEIGHT            0x2
+#define DDSD_WIDTH             0x4
+#define DDSD_PITCH             0x8
+#define DDSD_PIXELFORMAT       0x1000
+#define DDSD_MIPMAPCOUNT       0x20000
+#define DDSD_LINEARSIZE        0x80000
+#define DDSCAPS_COMPLEX        0x8
+#define DDSCAPS_TEXTURE        0x1000
+#define DDSCAPS_MIPMAP         0x400000
+#define DDPF_ALPHAPIXELS       0x1
+#define DDPF_FOURCC            0x4
+#define DDPF_RGB               0x40
+#define DDPF_LUMINANCE         0x20000
+#define DDSCAPS2_CUBEMAP       0x200
+#define DDSCAPS2_CUBEMAP_ALLFACES 0xFC00
+#define DDSCAPS2_VOLUME        0x200000
+
+#define DDS_DIMENSION_TEXTURE2D 3
+#define DDS_RESOURCE_MISC_TEXTURECUBE 0x4
+
+#define FOURCC(a, b, c, d) ((unsigned int)(a) | ((unsigned int)(b) << 8) | ((unsigned int)(c) << 16) | ((unsigned int)(d) << 24))
+
+// What we need to know about each format we support
+struct DDSFormat{
+	unsigned int dxgiFormat;      // or fourCC for the old-style headers
+	bool compressed;
+	unsigned int blockSize;
+	unsigned int internalFormat;
+	unsigned int format;
+	unsigned int type;
+};
+
+static const DDSFormat fourCCFormats[] = {
+	{ FOURCC('D','X','T','1'), true,  8, GL_COMPRESSED_RGBA_S3TC_DXT1_EXT, 0, 0 },
+	{ FOURCC('D','X','T','3'), true, 16, GL_COMPRESSED_RGBA_S3TC_DXT3_EXT, 0, 0 },
+	{ FOURCC('D','X','T','5'), true, 16, GL_COMPRESSED_RGBA_S3TC_DXT5_EXT, 0, 0 },
+	{ FOURCC('A','T','I','1'), true,  8, GL_COMPRESSED_RED_RGTC1, 0, 0 },
+	{ FOURCC('B','C','4','U'), true,  8, GL_COMPRESSED_RED_RGTC1, 0, 0 },
+	{ FOURCC('B','C','4','S'), true,  8, GL_COMPRESSED_SIGNED_RED_RGTC1, 0, 0 },
+	{ FOURCC('A','T','I','2'), true, 16, GL_COMPRESSED_RG_RGTC2, 0, 0 },
+	{ FOURCC('B','C','5','U'), true, 16, GL_COMPRESSED_RG_RGTC2, 0, 0 },
+	{ FOURCC('B','C','5','S'), true, 16, GL_COMPRESSED_SIGNED_RG_RGTC2, 0, 0 },
+	// Last, so that writeDDSImage picks DXT3 and DXT5 rather than these
+	{ FOURCC('D','X','T','2'), true, 16, GL_COMPRESSED_RGBA_S3TC_DXT3_EXT, 0, 0 }, // premultiplied alpha
+	{ FOURCC('D','X','T','4'), true, 16, GL_COMPRESSED_RGBA_S3TC_DXT5_EXT, 0, 0 }, // premultiplied alpha
+};
+
+// DXGI_FORMAT values, from dxgiformat.h
+static const DDSFormat dxgiFormats[] = {
+	{ 61, false, 1, GL_R8,                                    GL_RED,  GL_UNSIGNED_BYTE }, // R8_UNORM
+	{ 28, false, 4, GL_RGBA8,                                 GL_RGBA, GL_UNSIGNED_BYTE }, // R8G8B8A8_UNORM
+	{ 29, false, 4, GL_SRGB8_ALPHA8,                          GL_RGBA, GL_UNSIGNED_BYTE }, // R8G8B8A8_UNORM_SRGB
+	{ 71, true,  8, GL_COMPRESSED_RGBA_S3TC_DXT1_EXT,         0, 0 },                      // BC1_UNORM
+	{ 72, true,  8, GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT1_EXT,   0, 0 },                      // BC1_UNORM_SRGB
+	{ 74, true, 16, GL_COMPRESSED_RGBA_S3TC_DXT3_EXT,         0, 0 },                      // BC2_UNORM
+	{ 75, true, 16, GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT3_EXT,   0, 0 },                      // BC2_UNORM_SRGB
+	{ 77, true, 16, GL_COMPRESSED_RGBA_S3TC_DXT5_EXT,         0, 0 },                      // BC3_UNORM
+	{ 78, true, 16, GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT5_EXT,   0, 0 },                      // BC3_UNORM_SRGB
+	{ 80, true,  8, GL_COMPRESSED_RED_RGTC1,                  0, 0 },                      // BC4_UNORM
+	{ 81, true,  8, GL_COMPRESSED_SIGNED_RED_RGTC1,           0, 0 },                      // BC4_SNORM
+	{ 83, true, 16, GL_COMPRESSED_RG_RGTC2,                   0, 0 },                      // BC5_UNORM
+	{ 84, true, 16, GL_COMPRESSED_SIGNED_RG_RGTC2,            0, 0 },                      // BC5_SNORM
+	{ 87, false, 4, GL_RGBA8,                                 GL_BGRA, GL_UNSIGNED_BYTE }, // B8G8R8A8_UNORM
+	{ 91, false, 4, GL_SRGB8_ALPHA8,                          GL_BGRA, GL_UNSIGNED_BYTE }, // B8G8R8A8_UNORM_SRGB
+	{ 95, true, 16, GL_COMPRESSED_RGB_BPTC_UNSIGNED_FLOAT,    0, 0 },                      // BC6H_UF16
+	{ 96, true, 16, GL_COMPRESSED_RGB_BPTC_SIGNED_FLOAT,      0, 0 },                      // BC6H_SF16
+	{ 98, true, 16, GL_COMPRESSED_RGBA_BPTC_UNORM,            0, 0 },                      // BC7_UNORM
+	{ 99, true, 16, GL_COMPRESSED_SRGB_ALPHA_BPTC_UNORM,      0, 0 },                      // BC7_UNORM_SRGB
+	// Last, so that writeDDSImage picks the UNORM formats rather than these
+	{ 27, false, 4, GL_RGBA8,                                 GL_RGBA, GL_UNSIGNED_BYTE }, // R8G8B8A8_TYPELESS
+	{ 70, true,  8, GL_COMPRESSED_RGBA_S3TC_DXT1_EXT,         0, 0 },                      // BC1_TYPELESS
+	{ 73, true, 16, GL_COMPRESSED_RGBA_S3TC_DXT3_EXT,         0, 0 },                      // BC2_TYPELESS
+	{ 76, true, 16, GL_COMPRESSED_RGBA_S3TC_DXT5_EXT,         0, 0 },                      // BC3_TYPELESS
+	{ 79, true,  8, GL_COMPRESSED_RED_RGTC1,                  0, 0 },                      // BC4_TYPELESS
+	{ 82, true, 16, GL_COMPRESSED_RG_RGTC2,                   0, 0 },                      // BC5_TYPELESS
+	{ 90, false, 4, GL_RGBA8,                                 GL_BGRA, GL_UNSIGNED_BYTE }, // B8G8R8A8_TYPELESS
+	{ 94, true, 16, GL_COMPRESSED_RGB_BPTC_UNSIGNED_FLOAT,    0, 0 },                      // BC6H_TYPELESS
+	{ 97, true, 16, GL_COMPRESSED_RGBA_BPTC_UNORM,            0, 0 },                      // BC7_TYPELESS
+};
+
+static const DDSFormat * findDDSFormat(const DDSFormat * formats, size_t count, unsigned int code){
+	for (size_t i=0; i<count; i++){
+		if (formats[i].dxgiFormat == code)
+			return &formats[i];
+	}
+	return NULL;
+}
+
+// Old-style uncompressed formats are described with bit masks
+static bool findDDSMaskFormat(const unsigned char * pixelFormat, DDSFormat & out_format){
+	unsigned int flags, bitCount, rMask, gMask, bMask, aMask;
+	memcpy(&flags,    pixelFormat +  4, 4);
+	memcpy(&bitCount, pixelFormat + 12, 4);
+	memcpy(&rMask,    pixelFormat + 16, 4);
+	memcpy(&gMask,    pixelFormat + 20, 4);
+	memcpy(&bMask,    pixelFormat + 24, 4);
+	memcpy(&aMask,    pixelFormat + 28, 4);
+	if (!(flags & (DDPF_RGB | DDPF_LUMINANCE)))
+		return false;
+	bool hasAlpha = (flags & DDPF_ALPHAPIXELS) && aMask != 0;
+
+	out_format.dxgiFormat = 0;
+	out_format.compressed = false;
+	out_format.type = GL_UNSIGNED_BYTE;
+	if (flags & DDPF_LUMINANCE){
+		// A single channel : read it as red, like R8 in DX10 headers
+		if (bitCount != 8 || rMask != 0xFF || hasAlpha)
+			return false;
+		out_format.blockSize = 1;
+		out_format.internalFormat = GL_R8;
+		out_format.format = GL_RED;
+		return true;
+	}
+	if (bitCount == 32 && rMask == 0x00FF0000 && gMask == 0x0000FF00 && bMask == 0x000000FF){
+		out_format.blockSize = 4;
+		out_format.internalFormat = hasAlpha ? GL_RGBA8 : GL_RGB8;
+		out_format.format = GL_BGRA;
+		return true;
+	}
+	if (bitCount == 32 && rMask == 0x000000FF && gMask == 0x0000FF00 && bMask == 0x00FF0000){
+		out_format.blockSize = 4;
+		out_format.internalFormat = hasAlpha ? GL_RGBA8 : GL_RGB8;
+		out_format.format = GL_RGBA;
+		return true;
+	}
+	if (bitCount == 24 && rMask == 0x00FF0000 && gMask == 0x0000FF00 && bMask == 0x000000FF){
+		out_format.blockSize = 3;
+		out_format.internalFormat = GL_RGB8;
+		out_format.format = GL_BGR;
+		return true;
+	}
+	return false;
+}
+
+size_t textureLevelSize(const TextureImage & image, unsigned int width, unsigned int height){
+	if (image.compressed)
+		return (size_t)((width+3)/4) * ((height+3)/4) * image.blockSize;
+	return (size_t)width * height * image.blockSize;
+}
+
+static unsigned int readU32(const unsigned char * p){
+	unsigned int v;
+	memcpy(&v, p, 4); // little-endian, like all the platforms we support
+	return v;
+}
+
+bool loadDDSImage(const char * imagepath, TextureImage & out_image){
+
+	out_image.levels.clear();
+	out_image.pixels.clear();
+	out_image.generateMipmaps = false;
+	if (!mapFile(imagepath, out_image.file))
+		return false;
+
+	const unsigned char * data = out_image.file.data;
+	size_t fileSize = out_image.file.size;
+
+	/* verify the type of file */
+	if (fileSize < 4 + DDS_HEADER_SIZE || memcmp(data, "DDS ", 4) != 0 || readU32(data + 4) != DDS_HEADER_SIZE){
+		printf("%s is not a correct DDS file\n", imagepath);
+		unmapFile(out_image.file);
+		return false;
+	}
+
+	/* get the surface desc */
+	const unsigned char * header = data + 4;
+	unsigned int flags       = readU32(header + 4);
+	unsigned int height      = readU32(header + 8);
+	unsigned int width       = readU32(header + 12);
+	unsigned int mipMapCount = readU32(header + 24);
+	const unsigned char * pixelFormat = header + 72;
+	unsigned int pixelFormatFlags = readU32(pixelFormat + 4);
+	unsigned int fourCC      = readU32(pixelFormat + 8);
+	unsigned int caps2       = readU32(header + 108);
+
+	size_t dataOffset = 4 + DDS_HEADER_SIZE;
+	const DDSFormat * format = NULL;
+	DDSFormat maskFormat;
+	unsigned int layerCount = 1;
+	unsigned int faceCount = 1;
+	bool isArray = false;
+	bool isVolume = (caps2 & DDSCAPS2_VOLUME) != 0;
+
+	if (readU32(pixelFormat) != DDS_PIXELFORMAT_SIZE){
+		printf("%s is not a correct DDS file\n", imagepath);
+		unmapFile(out_image.file);
+		return false;
+	}
+
+	if ((pixelFormatFlags & DDPF_FOURCC) && fourCC == FOURCC('D','X','1','0')){
+		if (fileSize < dataOffset + DDS_DX10_HEADER_SIZE){
+			printf("%s is truncated\n", imagepath);
+			unmapFile(out_image.file);
+			return false;
+		}
+		const unsigned char * dx10 = data + dataOffset;
+		unsigned int dxgiFormat        = readU32(dx10 + 0);
+		unsigned int resourceDimension = readU32(dx10 + 4);
+		unsigned int miscFlag          = readU32(dx10 + 8);
+		unsigned int arraySize         = readU32(dx10 + 12);
+		dataOffset += DDS_DX10_HEADER_SIZE;
+
+		format = findDDSFormat(dxgiFormats, sizeof(dxgiFormats) / sizeof(dxgiFormats[0]), dxgiFormat);
+		if (format == NULL){
+			printf("%s : DXGI format %u is not supported\n", imagepath, dxgiFormat);
+			unmapFile(out_image.file);
+			return false;
+		}
+		isVolume = isVolume || resourceDimension != DDS_DIMENSION_TEXTURE2D;
+		if (miscFlag & DDS_RESOURCE_MISC_TEXTURECUBE)
+			faceCount = 6;
+		if (arraySize == 0){
+			printf("%s is not a correct DDS file\n", imagepath);
+			unmapFile(out_image.file);
+			return false;
+		}
+		// A single layer is a plain 2D texture (or cubemap) : many tools write all their files with DX10 headers
+		layerCount = arraySize;
+		isArray = arraySize > 1;
+	}else{
+		if (pixelFormatFlags & DDPF_FOURCC){
+			format = findDDSFormat(fourCCFormats, sizeof(fourCCFormats) / sizeof(fourCCFormats[0]), fourCC);
+		}else if (findDDSMaskFormat(pixelFormat, maskFormat)){
+			format = &maskFormat;
+		}
+		if (format == NULL){
+			printf("%s : this kind of DDS file is not supported\n", imagepath);
+			unmapFile(out_image.file);
+			return false;
+		}
+		if (caps2 & DDSCAPS2_CUBEMAP){
+			if ((caps2 & DDSCAPS2_CUBEMAP_ALLFACES) != DDSCAPS2_CUBEMAP_ALLFACES){
+				printf("%s : cubemaps without all 6 faces are not supported\n", imagepath);
+				unmapFile(out_image.file);
+				return false;
+			}
+			faceCount = 6;
+		}
+	}
+
+	if (isVolume){
+		printf("%s : volume and 1D textures are not supported\n", imagepath);
+		unmapFile(out_image.file);
+		return false;
+	}
+
+	// Some writers leave mipMapCount to 0 when there is a single level
+	if (!(flags & DDSD_MIPMAPCOUNT) || mipMapCount == 0)
+		mipMapCount = 1;
+	unsigned int maxLevels = 1;
+	while (maxLevels < 32 && ((width | height) >> maxLevels) != 0)
+		maxLevels++;
+	if (width == 0 || height == 0 || mipMapCount > maxLevels || (faceCount == 6 && width != height)){
+		printf("%s : invalid dimensions\n", imagepath);
+		unmapFile(out_image.file);
+		return false;
+	}
+
+	out_image.width = width;
+	out_image.height = height;
+	out_image.levelCount = mipMapCount;
+	out_image.layerCount = layerCount;
+	out_image.faceCount = faceCount;
+	out_image.isArray = isArray;
+	out_image.compressed = format->compressed;
+	out_image.blockSize = format->blockSize;
+	out_image.internalFormat = format->internalFormat;
+	out_image.format = format->format;
+	out_image.type = format->type;
+
+	// The exact size of the whole mip chain, checked against the file size
+	// before any pointer is handed out.
+	unsigned long long chainSize = 0;
+	for (unsigned int level=0; level<mipMapCount; level++){
+		unsigned int w = width  >> level; if (w < 1) w = 1;
+		unsigned int h = height >> level; if (h < 1) h = 1;
+		chainSize += textureLevelSize(out_image, w, h);
+	}
+	unsigned long long totalSize = chainSize * faceCount * layerCount;
+	if (totalSize > fileSize - dataOffset){
+		printf("%s is truncated : %llu bytes of pixels expected, %llu found\n",
+			imagepath, totalSize, (unsigned long long)(fileSize - dataOffset));
+		unmapFile(out_image.file);
+		return false;
+	}
+
+	out_image.levels.resize((size_t)layerCount * faceCount * mipMapCount);
+	size_t offset = dataOffset;
+	size_t i = 0;
+	for (unsigned int layer=0; layer<layerCount; layer++){
+		for (unsigned int face=0; face<faceCount; face++){
+			for (unsigned int level=0; level<mipMapCount; level++){
+				TextureLevel & l = out_image.levels[i++];
+				l.width  = width  >> level; if (l.width  < 1) l.width  = 1;
+				l.height = height >> level; if (l.height < 1) l.height = 1;
+				l.size = textureLevelSize(out_image, l.width, l.height);
+				l.data = data + offset;
+				offset += l.size;
+			}
+		}
+	}
+
+	return true;
+}
+
+static void writeU32(unsigned char * p, unsigned int v){
+	memcpy(p, &v, 4);
+}
+
+bool writeDDSImage(const char * imagepath, const TextureImage & image){
+
+	// Find how to describe the format : fourCC if possible, so that old tools can read the file, DX10 otherwise
+	const DDSFormat * fourCCFormat = NULL;
+	const DDSFormat * dxgiFormat = NULL;
+	for (size_t i=0; i<sizeof(fourCCFormats) / sizeof(fourCCFormats[0]) && !fourCCFormat; i++){
+		if (fourCCFormats[i].internalFormat == image.internalFormat)
+			fourCCFormat = &fourCCFormats[i];
+	}
+	for (size_t i=0; i<sizeof(dxgiFormats) / sizeof(dxgiFormats[0]) && !dxgiFormat; i++){
+		if (dxgiFormats[i].internalFormat == image.internalFormat && dxgiFormats[i].format == image.format)
+			dxgiFormat = &dxgiFormats[i];
+	}
+	if (fourCCFormat == NULL && dxgiFormat == NULL){
+		printf("writeDDSImage : %s : unsupported format 0x%X\n", imagepath, image.internalFormat);
+		return false;
+	}
+	bool dx10 = fourCCFormat == NULL || image.layerCount > 1;
+
+	unsigned char header[4 + DDS_HEADER_SIZE + DDS_DX10_HEADER_SIZE];
+	memset(header, 0, sizeof(header));
+	memcpy(header, "DDS ", 4);
+	unsigned char * h = header + 4;
+	writeU32(h + 0, DDS_HEADER_SIZE);
+	writeU32(h + 4, DDSD_CAPS | DDSD_HEIGHT | DDSD_WIDTH | DDSD_PIXELFORMAT | DDSD_MIPMAPCOUNT |
+		(image.compressed ? DDSD_LINEARSIZE : DDSD_PITCH));
+	writeU32(h + 8, image.height);
+	writeU32(h + 12, image.width);
+	writeU32(h + 16, image.compressed ? (unsigned int)textureLevelSize(image, image.width, image.height) : image.width * image.blockSize);
+	writeU32(h + 24, image.levelCount);
+	writeU32(h + 72, DDS_PIXELFORMAT_SIZE);
+	writeU32(h + 76, DDPF_FOURCC);
+	writeU32(h + 80, dx10 ? FOURCC('D','X','1','0') : fourCCFormat->dxgiFormat);
+	writeU32(h + 104, DDSCAPS_TEXTURE | (image.levelCount > 1 ? DDSCAPS_COMPLEX | DDSCAPS_MIPMAP : 0) | (image.faceCount == 6 ? DDSCAPS_COMPLEX : 0));
+	writeU32(h + 108, image.faceCount == 6 ? DDSCAPS2_CUBEMAP | DDSCAPS2_CUBEMAP_ALLFACES : 0);
+	size_t headerSize = 4 + DDS_HEADER_SIZE;
+	if (dx10){
+		unsigned char * d = header + headerSize;
+		writeU32(d + 0, dxgiFormat->dxgiFormat);
+		writeU32(d + 4, DDS_DIMENSION_TEXTURE2D);
+		writeU32(d + 8, image.faceCount == 6 ? DDS_RESOURCE_MISC_TEXTURECUBE : 0);
+		writeU32(d + 12, image.layerCount);
+		headerSize += DDS_DX10_HEADER_SIZE;
+	}
+
+	FILE * file = fopen(imagepath, "wb");
+	if (file == NULL){
+		printf("writeDDSImage : can't create %s\n", imagepath);
+		return false;
+	}
+	bool ok = fwrite(header, 1, headerSize, file) == headerSize;
+	// The levels are already in the order of DDS files
+	for (size_t i=0; i<image.levels.size() && ok; i++)
+		ok = fwrite(image.levels[i].data, 1, image.levels[i].size, file) == image.levels[i].size;
+	ok = (fclose(file) == 0) && ok;
+	if (!ok){
+		printf("writeDDSImage : can't write %s\n", imagepath);
+		remove(imagepath);
+	}
+	return ok;
+}
+
+// BMP and TGA : a single level of tightly packed BGR(A) pixels, bottom row first
+static void setDecodedImage(TextureImage & out_image, unsigned int width, unsigned int height, unsigned int bytesPerPixel){
+	out_image.width = width;
+	out_image.height = height;
+	out_image.levelCount = 1;
+	out_image.layerCount = 1;
+	out_image.faceCount = 1;
+	out_image.isArray = false;
+	out_image.compressed = false;
+	out_image.blockSize = bytesPerPixel;
+	out_image.internalFormat = bytesPerPixel == 4 ? GL_RGBA8 : GL_RGB8;
+	out_image.format = bytesPerPixel == 4 ? GL_BGRA : GL_BGR;
+	out_image.type = GL_UNSIGNED_BYTE;
+	out_image.generateMipmaps = true;
+	out_image.pixels.resize((size_t)width * height * bytesPerPixel);
+	out_image.levels.resize(1);
+	out_image.levels[0].data = out_image.pixels.empty() ? NULL : &out_image.pixels[0];
+	out_image.levels[0].size = out_image.pixels.size();
+	out_image.levels[0].width = width;
+	out_image.levels[0].height = height;
+}
+
+// The decoders read the file through a mapping too, but don't keep it
+static bool mapImageFile(const char * imagepath, TextureImage & out_image){
+	out_image.levels.clear();
+	out_image.pixels.clear();
+	out_image.generateMipmaps = false;
+	return mapFile(imagepath, out_image.file);
+}
+
+bool loadBMPImage(const char * imagepath, TextureImage & out_image){
+
+	if (!mapImageFile(imagepath, out_image))
+		return false;
+	const unsigned char * header = out_image.file.data;
+	size_t fileSize = out_image.file.size;
+
+	// A BMP files always begins with "BM", and the header is 54 bytes long.
+	// Make sure this is an uncompressed 24bpp file
+	if (fileSize < 54 || header[0]!='B' || header[1]!='M' || readU32(header + 0x1E) != 0 || (readU32(header + 0x1C) & 0xFFFF) != 24){
+		printf("%s is not a correct BMP file\n", imagepath);
+		unmapFile(out_image.file);
+		return false;
+	}
+
+	unsigned int dataPos = readU32(header + 0x0A);
+	int width            = (int)readU32(header + 0x12);
+	int height           = (int)readU32(header + 0x16);
+	if (dataPos == 0) dataPos = 54; // Some BMP files are misformatted, guess missing information
+	// A negative height means that the first row is the top one
+	bool topDown = height < 0;
+	if (topDown) height = -height;
+
+	// Each row is padded to 4 bytes
+	size_t rowSize = ((size_t)width * 3 + 3) & ~(size_t)3;
+	if (width <= 0 || height <= 0 || width > 65536 || height > 65536 || dataPos > fileSize || rowSize * height > fileSize - dataPos){
+		printf("%s is not a correct BMP file\n", imagepath);
+		unmapFile(out_image.file);
+		return false;
+	}
+
+	setDecodedImage(out_image, width, height, 3);
+	for (int y=0; y<height; y++){
+		const unsigned char * row = out_image.file.data + dataPos + rowSize * (topDown ? height - 1 - y : y);
+		memcpy(&out_image.pixels[(size_t)y * width * 3], row, (size_t)width * 3);
+	}
+
+	unmapFile(out_image.file);
+	return true;
+}
+
+bool loadTGAImage(const char * imagepath, TextureImage & out_image){
+
+	if (!mapImageFile(imagepath, out_image))
+		return false;
+	const unsigned char * header = out_image.file.data;
+	size_t fileSize = out_image.file.size;
+
+	// 18-byte header. Only true-color images (type 2, or 10 when RLE-compressed) without palette
+	if (fileSize < 18 || header[1] != 0 || (header[2] != 2 && header[2] != 10) || (header[16] != 24 && header[16] != 32)){
+		printf("%s is not a supported TGA file\n", imagepath);
+		unmapFile(out_image.file);
+		return false;
+	}
+	unsigned int width  = header[12] | (header[13] << 8);
+	unsigned int height = header[14] | (header[15] << 8);
+	unsigned int bytesPerPixel = header[16] / 8;
+	bool rle = header[2] == 10;
+	bool topDown = (header[17] & 0x20) != 0;
+	size_t dataPos = 18 + header[0]; // skip the image ID
+
+	setDecodedImage(out_image, width, height, bytesPerPixel);
+	size_t imageSize = out_image.pixels.size();
+	const unsigned char * src = out_image.file.data + dataPos;
+	const unsigned char * end = out_image.file.data + fileSize;
+	bool ok = dataPos <= fileSize;
+
+	if (ok && !rle){
+		ok = imageSize <= (size_t)(end - src);
+		if (ok && imageSize)
+			memcpy(&out_image.pixels[0], src, imageSize);
+	}else if (ok){
+		// Packets : a 1-byte header, then either 1 pixel repeated (header & 0x7F) + 1 times,
+		// or (header & 0x7F) + 1 raw pixels.
+		size_t written = 0;
+		while (ok && written < imageSize){
+			ok = src < end;
+			if (!ok) break;
+			unsigned char packet = *src++;
+			size_t count = ((size_t)(packet & 0x7F) + 1) * bytesPerPixel;
+			size_t needed = (packet & 0x80) ? bytesPerPixel : count;
+			ok = count <= imageSize - written && needed <= (size_t)(end - src);
+			if (!ok) break;
+			if (packet & 0x80){
+				for (size_t i=0; i<count; i+=bytesPerPixel)
+					memcpy(&out_image.pixels[written + i], src, bytesPerPixel);
+			}else{
+				memcpy(&out_image.pixels[written], src, count);
+			}
+			src += needed;
+			written += count;
+		}
+	}
+	unmapFile(out_image.file);
+	if (!ok){
+		printf("%s is truncated\n", imagepath);
+		out_image.levels.clear();
+		out_image.pixels.clear();
+		return false;
+	}
+
+	// OpenGL wants the bottom row first
+	if (topDown){
+		size_t rowSize = (size_t)width * bytesPerPixel;
+		std::vector<unsigned char> row(rowSize);
+		for (unsigned int y=0; y<height/2; y++){
+			unsigned char * a = &out_image.pixels[y * rowSize];
+			unsigned char * b = &out_image.pixels[(height - 1 - y) * rowSize];
+			memcpy(&row[0], a, rowSize);
+			memcpy(a, b, rowSize);
+			memcpy(b, &row[0], rowSize);
+		}
+	}
+	return true;
+}
+
+bool loadTextureImage(const char * imagepath, TextureImage & out_image){
+	const char * extension = strrchr(imagepath, '.');
+	char lower[5] = { 0 };
+	for (int i=0; extension && i<4 && extension[i]; i++)
+		lower[i] = (char)tolower((unsigned char)extension[i]);
+
+	if (strcmp(lower, ".dds") == 0)
+		return loadDDSImage(imagepath, out_image);
+	if (strcmp(lower, ".bmp") == 0)
+		return loadBMPImage(imagepath, out_image);
+	if (strcmp(lower, ".tga") == 0)
+		return loadTGAImage(imagepath, out_image);
+
+	printf("%s : unknown image format\n", imagepath);
+	out_image.levels.clear();
+	out_image.pixels.clear();
+	out_image.file.data = NULL;
+	out_image.file.size = 0;
+	out_image.file.fileHandle = NULL;
+	out_image.file.mappingHandle = NULL;
+	return false;
+}
+
+size_t textureImageSize(const TextureImage & image){
+	size_t size = 0;
+	for (size_t i=0; i<image.levels.size(); i++)
+		size += image.levels[i].size;
+	return size;
+}
+
+const TextureLevel & getTextureLevel(const TextureImage & image, unsigned int layer, unsigned int face, unsigned int level){
+	return image.levels[((size_t)layer * image.faceCount + face) * image.levelCount + level];
+}
+
+void unloadTextureImage(TextureImage & image){
+	image.levels.clear();
+	image.pixels.clear();
+	unmapFile(image.file);
+}
@@ -0,0 +1,70 @@
+#ifndef TEXTUREIMAGE_HPP
+#define TEXTUREIMAGE_HPP
+
+#include "mappedfile.hpp"
+
+// One mipmap level of one face of one layer of a texture.
+struct TextureLevel{
+	const unsigned char * data;
+	size_t size;                  // in bytes
+	unsigned int width;
+	unsigned int height;
+};
+
+// A texture on the CPU side, ready to be given to OpenGL as-is, level by level.
+// For DDS files nothing is decoded : the levels point directly into the mapped file.
+// For BMP and TGA files, the levels point into 'pixels'.
+struct TextureImage{
+	unsigned int width;           // of level 0
+	unsigned int height;
+	unsigned int levelCount;      // mipmap levels, at least 1
+	unsigned int layerCount;      // 1 unless this is an array texture
+	unsigned int faceCount;       // 6 for cubemaps, 1 otherwise
+	bool isArray;                 // true if layerCount > 1 : upload it as a GL_TEXTURE_2D_ARRAY (or CUBE_MAP_ARRAY)
+
+	bool compressed;
+	unsigned int blockSize;       // bytes per 4x4 block if compressed, bytes per pixel otherwise
+	unsigned int internalFormat;  // GL_COMPRESSED_RGBA_S3TC_DXT1_EXT, GL_RGBA8, ...
+	unsigned int format;          // only for uncompressed textures : GL_BGRA, ...
+	unsigned int type;            // only for uncompressed textures : GL_UNSIGNED_BYTE, ...
+
+	// All the levels of face 0 of layer 0, then all the levels of face 1, ... (the order of DDS files).
+	// Use getTextureLevel() rather than indexing this directly.
+	std::vector<TextureLevel> levels;
+	bool generateMipmaps;         // only level 0 is there : call glGenerateMipmap after uploading it
+
+	MappedFile file;
+	std::vector<unsigned char> pixels;
+};
+
+// Maps a .DDS file and checks that its header is consistent with its size.
+// Supports DXT1/3/5 (BC1-3), ATI1/ATI2 (BC4-5), 8-bit luminance, 24 and 32-bit RGB(A), and
+// DX10 headers with BC1-BC7, R8, RGBA8 and BGRA8, including sRGB formats,
+// cubemaps and arrays. Volume textures are not supported.
+bool loadDDSImage(const char * imagepath, TextureImage & out_image);
+
+// Decodes an uncompressed 24-bit .BMP file, like loadBMP_custom.
+bool loadBMPImage(const char * imagepath, TextureImage & out_image);
+
+// Decodes a 24 or 32-bit .TGA file, uncompressed or RLE-compressed.
+bool loadTGAImage(const char * imagepath, TextureImage & out_image);
+
+// Calls one of the above, depending on the extension of imagepath (.dds, .bmp or .tga)
+bool loadTextureImage(const char * imagepath, TextureImage & out_image);
+
+// Writes a .DDS file that loadDDSImage can read back. Supports BC1 and BC3 (with an old-style header),
+// BC7, sRGB formats and arrays (with a DX10 header), and uncompressed R8, RGBA8 / BGRA8.
+// Note that like all DDS files, the first row of each level is the top one.
+bool writeDDSImage(const char * imagepath, const TextureImage & image);
+
+const TextureLevel & getTextureLevel(const TextureImage & image, unsigned int layer, unsigned int face, unsigned int level);
+
+// Size in bytes of one level of one face, for any format
+size_t textureLevelSize(const TextureImage & image, unsigned int width, unsigned int height);
+
+// Size in bytes of all the levels, faces and layers
+size_t textureImageSize(const TextureImage & image);
+
+void unloadTextureImage(TextureImage & image);
+
+#endif
\ No newline at end of file
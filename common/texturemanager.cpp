@@ -0,0 +1,170 @@
+#include <vector>
+#include <deque>
+#include <string>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+#include "textureimage.hpp"
+#include "mipmapgenerator.hpp"
+#include "texturemanager.hpp"
+#include "profiler.hpp"
+
+struct TextureRequest{
+	std::string path;
+	unsigned int userID;
+	bool normalMap;
+};
+
+struct DecodedTexture{
+	unsigned int userID;
+	TextureImage * image; // NULL if the file couldn't be loaded
+};
+
+struct TextureManager{
+	std::vector<std::thread> workers;
+
+	// Everything below is protected by the mutex
+	std::mutex mutex;
+	std::condition_variable requestAdded;   // workers wait for work
+	std::condition_variable decodedTaken;   // workers wait for room in 'decoded'
+	std::deque<TextureRequest> requests;
+	std::deque<DecodedTexture> decoded;
+	unsigned int maxDecoded;
+	unsigned int pending;
+	bool quitting;
+};
+
+static void freeDecodedTexture(DecodedTexture & texture){
+	if (texture.image){
+		unloadTextureImage(*texture.image);
+		delete texture.image;
+		texture.image = NULL;
+	}
+}
+
+static void textureWorker(TextureManager * manager){
+	setProfilerThreadName("texture worker");
+	while (true){
+		TextureRequest request;
+		{
+			std::unique_lock<std::mutex> lock(manager->mutex);
+			while (!manager->quitting && manager->requests.empty())
+				manager->requestAdded.wait(lock);
+			if (manager->quitting)
+				return;
+			request = manager->requests.front();
+			manager->requests.pop_front();
+		}
+
+		beginProfileScope("decode texture");
+		DecodedTexture texture;
+		texture.userID = request.userID;
+		texture.image = new TextureImage;
+		if (loadTextureImage(request.path.c_str(), *texture.image)){
+			// DDS files are only mapped : read them now, on this thread, rather
+			// than when the GL thread touches the pages during the upload.
+			const unsigned char * data = texture.image->file.data;
+			size_t size = texture.image->file.size;
+			volatile unsigned char sum = 0;
+			for (size_t i=0; i<size; i+=4096)
+				sum += data[i];
+
+			// The other workers are busy with the other files : one thread each
+			if (texture.image->generateMipmaps){
+				MipmapOptions options = { MIPMAP_KAISER, !request.normalMap, request.normalMap, true, 1 };
+				generateTextureMipmaps(*texture.image, options);
+			}
+		}else{
+			delete texture.image;
+			texture.image = NULL;
+		}
+		endProfileScope();
+
+		{
+			std::unique_lock<std::mutex> lock(manager->mutex);
+			while (!manager->quitting && manager->decoded.size() >= manager->maxDecoded)
+				manager->decodedTaken.wait(lock);
+			if (manager->quitting){
+				freeDecodedTexture(texture);
+				return;
+			}
+			manager->decoded.push_back(texture);
+		}
+	}
+}
+
+TextureManager * createTextureManager(unsigned int threadCount, unsigned int maxDecodedTextures){
+	if (threadCount == 0)
+		threadCount = std::thread::hardware_concurrency();
+	if (threadCount == 0)
+		threadCount = 1;
+
+	TextureManager * manager = new TextureManager;
+	manager->maxDecoded = maxDecodedTextures > 0 ? maxDecodedTextures : 1;
+	manager->pending = 0;
+	manager->quitting = false;
+	for (unsigned int i=0; i<threadCount; i++)
+		manager->workers.push_back(std::thread(textureWorker, manager));
+	return manager;
+}
+
+void destroyTextureManager(TextureManager * manager){
+	{
+		std::lock_guard<std::mutex> lock(manager->mutex);
+		manager->quitting = true;
+	}
+	manager->requestAdded.notify_all();
+	manager->decodedTaken.notify_all();
+	for (size_t i=0; i<manager->workers.size(); i++)
+		manager->workers[i].join();
+
+	for (size_t i=0; i<manager->decoded.size(); i++)
+		freeDecodedTexture(manager->decoded[i]);
+	delete manager;
+}
+
+void requestTextureDecode(TextureManager * manager, const char * imagepath, unsigned int userID, bool normalMap){
+	TextureRequest request;
+	request.path = imagepath;
+	request.userID = userID;
+	request.normalMap = normalMap;
+	{
+		std::lock_guard<std::mutex> lock(manager->mutex);
+		manager->requests.push_back(request);
+		manager->pending++;
+	}
+	manager->requestAdded.notify_one();
+}
+
+size_t drainDecodedTextures(TextureManager * manager, size_t byteBudget, TextureUploadFunction upload, void * userData){
+	// Take the images out of the queue first, so that the workers aren't blocked during the uploads
+	std::vector<DecodedTexture> textures;
+	size_t bytes = 0;
+	{
+		std::lock_guard<std::mutex> lock(manager->mutex);
+		while (!manager->decoded.empty() && (textures.empty() || bytes < byteBudget)){
+			const DecodedTexture & texture = manager->decoded.front();
+			size_t size = texture.image ? textureImageSize(*texture.image) : 0;
+			if (!textures.empty() && bytes + size > byteBudget)
+				break;
+			textures.push_back(texture);
+			bytes += size;
+			manager->decoded.pop_front();
+		}
+		manager->pending -= (unsigned int)textures.size();
+	}
+	if (!textures.empty())
+		manager->decodedTaken.notify_all();
+
+	for (size_t i=0; i<textures.size(); i++){
+		upload(textures[i].userID, textures[i].image, userData);
+		freeDecodedTexture(textures[i]);
+	}
+	return bytes;
+}
+
+unsigned int pendingTextureCount(TextureManager * manager){
+	std::lock_guard<std::mutex> lock(manager->mutex);
+	return manager->pending;
+}
@@ -0,0 +1,38 @@
+#ifndef TEXTUREMANAGER_HPP
+#define TEXTUREMANAGER_HPP
+
+// Loads textures in the background : worker threads read and decode the files
+// (see loadTextureImage), and the GL thread uploads them a few at a time,
+// so that a frame never waits for the disk.
+// This part doesn't use OpenGL at all. See loadTextureAsync and
+// uploadDecodedTextures in texture.hpp for the OpenGL side.
+
+struct TextureManager;
+struct TextureImage;
+
+// threadCount = 0 means one thread per core.
+// At most maxDecodedTextures images wait for their upload at any time :
+// when the GL thread is late, the workers wait instead of using more and more memory.
+TextureManager * createTextureManager(unsigned int threadCount, unsigned int maxDecodedTextures);
+
+// Waits for the workers to finish their current file, and frees all the pending images.
+void destroyTextureManager(TextureManager * manager);
+
+// Queues imagepath for decoding, and returns immediately.
+// userID is given back to the upload function; typically, the GL texture to fill.
+// Images without mipmaps (BMP, TGA) get theirs on the worker, see generateTextureMipmaps;
+// normalMap selects the renormalizing filter rather than the sRGB one.
+void requestTextureDecode(TextureManager * manager, const char * imagepath, unsigned int userID, bool normalMap = false);
+
+// Called for each decoded image. image is NULL if the file couldn't be loaded.
+typedef void (*TextureUploadFunction)(unsigned int userID, const TextureImage * image, void * userData);
+
+// Gives the decoded images to 'upload', in the order they were decoded, until byteBudget bytes
+// have been given (at least one image is given, even if it is bigger than the budget).
+// Returns the number of bytes given.
+size_t drainDecodedTextures(TextureManager * manager, size_t byteBudget, TextureUploadFunction upload, void * userData);
+
+// Number of textures requested but not drained yet
+unsigned int pendingTextureCount(TextureManager * manager);
+
+#endif
\ No newline at end of file
@@ -4,8 +4,12 @@
 #include <glm/glm.hpp>
 
 #include "vboindexer.hpp"
+#include "profiler.hpp"
 
 #include <string.h> // for memcmp
+#include <stdio.h>
+#include <math.h>
+#include <float.h>
 
 
 // Returns true iif v1 can be considered equal to v2
@@ -97,7 +101,9 @@ bool getSimilarVertexIndex_fast(
 	}
 }
 
-void indexVBO(
+// Previous version of indexVBO, based on a std::map.
+// O(n log n), and one memory allocation per unique vertex. Kept for reference and for the benchmarks.
+void indexVBO_map(
 	std::vector<glm::vec3> & in_vertices,
 	std::vector<glm::vec2> & in_uvs,
 	std::vector<glm::vec3> & in_normals,
@@ -132,13 +138,123 @@ void indexVBO(
 	}
 }
 
+// Hash of the bits of a vertex. Two vertices are "the same" if all their bits are equal,
+// exactly like the memcmp() of the std::map version.
+static unsigned int hashPackedVertex(const PackedVertex & packed){
+	unsigned int words[sizeof(PackedVertex) / 4];
+	memcpy(words, &packed, sizeof(words));
+	unsigned int hash = 2166136261u;
+	for (unsigned int i=0; i<sizeof(words)/4; i++){
+		hash ^= words[i];
+		hash *= 16777619u;
+		hash ^= hash >> 15;
+	}
+	return hash;
+}
+
+// An open-addressing (linear probing) hash table, sized once and for all
+// so that it is never more than half full.
+// Each slot remembers the hash (to skip most comparisons) and the index of the vertex in out_XXXX.
+struct VertexHashSlot{
+	unsigned int hash;
+	unsigned int index; // index in out_XXXX + 1. 0 = empty slot.
+};
+
+template <typename IndexType>
+bool indexVBO(
+	std::vector<glm::vec3> & in_vertices,
+	std::vector<glm::vec2> & in_uvs,
+	std::vector<glm::vec3> & in_normals,
+
+	std::vector<IndexType> & out_indices,
+	std::vector<glm::vec3> & out_vertices,
+	std::vector<glm::vec2> & out_uvs,
+	std::vector<glm::vec3> & out_normals
+){
+	PROFILE_SCOPE("indexVBO");
 
+	// There can't be more unique vertices than input vertices
+	size_t tableSize = 16;
+	while (tableSize < 2 * in_vertices.size())
+		tableSize *= 2;
+	std::vector<VertexHashSlot> table(tableSize);
+	size_t mask = tableSize - 1;
 
+	const size_t maxIndex = (size_t)(IndexType)~(IndexType)0;
 
+	// To give the out_XXXX back as they were, if the mesh is too big for IndexType
+	const size_t startIndices = out_indices.size();
+	const size_t startVertices = out_vertices.size();
 
+	out_indices.reserve(out_indices.size() + in_vertices.size());
 
+	// For each input vertex
+	for ( unsigned int i=0; i<in_vertices.size(); i++ ){
+
+		PackedVertex packed = {in_vertices[i], in_uvs[i], in_normals[i]};
+		unsigned int hash = hashPackedVertex(packed);
+
+		// Try to find a similar vertex in out_XXXX
+		size_t slot = hash & mask;
+		while (table[slot].index != 0){
+			if (table[slot].hash == hash){
+				unsigned int candidate = table[slot].index - 1;
+				PackedVertex other = {out_vertices[candidate], out_uvs[candidate], out_normals[candidate]};
+				if (memcmp(&packed, &other, sizeof(PackedVertex)) == 0)
+					break;
+			}
+			slot = (slot + 1) & mask;
+		}
 
-void indexVBO_TBN(
+		if ( table[slot].index != 0 ){ // A similar vertex is already in the VBO, use it instead !
+			out_indices.push_back( (IndexType)(table[slot].index - 1) );
+		}else{ // If not, it needs to be added in the output data.
+			size_t newindex = out_vertices.size();
+			if (newindex > maxIndex){
+				printf("indexVBO : this mesh has more than %llu vertices, use 32-bit indices\n", (unsigned long long)maxIndex + 1);
+				out_indices .resize(startIndices);
+				out_vertices.resize(startVertices);
+				out_uvs     .resize(startVertices);
+				out_normals .resize(startVertices);
+				return false;
+			}
+			out_vertices.push_back( in_vertices[i]);
+			out_uvs     .push_back( in_uvs[i]);
+			out_normals .push_back( in_normals[i]);
+			out_indices .push_back( (IndexType)newindex );
+			table[slot].hash  = hash;
+			table[slot].index = (unsigned int)newindex + 1;
+		}
+	}
+	return true;
+}
+
+// The only two index types OpenGL can use for big meshes
+template bool indexVBO<unsigned short>(
+	std::vector<glm::vec3> &, std::vector<glm::vec2> &, std::vector<glm::vec3> &,
+	std::vector<unsigned short> &, std::vector<glm::vec3> &, std::vector<glm::vec2> &, std::vector<glm::vec3> &);
+template bool indexVBO<unsigned int>(
+	std::vector<glm::vec3> &, std::vector<glm::vec2> &, std::vector<glm::vec3> &,
+	std::vector<unsigned int> &, std::vector<glm::vec3> &, std::vector<glm::vec2> &, std::vector<glm::vec3> &);
+
+bool narrowIndices(const std::vector<unsigned int> & in_indices, std::vector<unsigned short> & out_indices){
+	for (size_t i=0; i<in_indices.size(); i++){
+		if (in_indices[i] > 0xFFFF)
+			return false;
+	}
+	out_indices.assign(in_indices.begin(), in_indices.end());
+	return true;
+}
+
+
+
+
+
+
+
+// Previous version of indexVBO_TBN, with a linear search for each vertex : O(n^2).
+// Kept for reference and for the tests; indexVBO_TBN gives exactly the same result.
+void indexVBO_TBN_slow(
 	std::vector<glm::vec3> & in_vertices,
 	std::vector<glm::vec2> & in_uvs,
 	std::vector<glm::vec3> & in_normals,
@@ -175,3 +291,188 @@ void indexVBO_TBN(
 		}
 	}
 }
+
+// Finds the already-exported vertices which are similar (in the getSimilarVertexIndex sense)
+// to a new one, without looking at all of them.
+// Positions are put in a grid of cells twice as big as the is_near() tolerance : 
+// a similar vertex is then always in the same cell or in one of the 26 around it.
+// Cells are hashed into a fixed-size table of buckets; each bucket is a linked list
+// of vertices (through 'next'), most recent first.
+struct NearVertexGrid{
+	std::vector<unsigned int> buckets; // first vertex of each bucket + 1. 0 = empty.
+	std::vector<unsigned int> next;    // for each vertex, the next one in the same bucket + 1. 0 = end.
+	size_t mask;
+};
+
+static const float gridCellSize = 0.02f; // 2 * the tolerance of is_near()
+
+static inline bool getGridCell(const glm::vec3 & position, int cell[3]){
+	for (int k=0; k<3; k++){
+		// NaNs and infinities : is_near() always fails for them, don't put them in the grid
+		if (!(fabsf(position[k]) <= FLT_MAX))
+			return false;
+		// Huge values (but is_near() works for them, as for any other value) : all in the last cell.
+		// At these sizes, floats are more than 0.01 apart, so a similar vertex has exactly the same value.
+		float c = floorf(position[k] / gridCellSize);
+		cell[k] = (int)(c < -1e9f ? -1e9f : (c > 1e9f ? 1e9f : c));
+	}
+	return true;
+}
+
+static inline size_t hashGridCell(int x, int y, int z, size_t mask){
+	unsigned int h = (unsigned int)x * 73856093u ^ (unsigned int)y * 19349663u ^ (unsigned int)z * 83492791u;
+	h ^= h >> 13;
+	h *= 0x5bd1e995u;
+	h ^= h >> 15;
+	return h & mask;
+}
+
+static void initNearVertexGrid(NearVertexGrid & grid, size_t maxVertices){
+	size_t bucketCount = 16;
+	while (bucketCount < 2 * maxVertices)
+		bucketCount *= 2;
+	grid.buckets.assign(bucketCount, 0);
+	grid.next.clear();
+	grid.next.reserve(maxVertices);
+	grid.mask = bucketCount - 1;
+}
+
+// Same result as getSimilarVertexIndex : the first (smallest) similar index.
+static bool getSimilarVertexIndex_grid(
+	const NearVertexGrid & grid,
+	glm::vec3 & in_vertex, 
+	glm::vec2 & in_uv, 
+	glm::vec3 & in_normal, 
+	std::vector<glm::vec3> & out_vertices,
+	std::vector<glm::vec2> & out_uvs,
+	std::vector<glm::vec3> & out_normals,
+	unsigned int & result
+){
+	int cell[3];
+	if (!getGridCell(in_vertex, cell))
+		return false;
+
+	bool found = false;
+	size_t visited[27];
+	int visitedCount = 0;
+	for (int dz=-1; dz<=1; dz++)
+	for (int dy=-1; dy<=1; dy++)
+	for (int dx=-1; dx<=1; dx++){
+		size_t bucket = hashGridCell(cell[0]+dx, cell[1]+dy, cell[2]+dz, grid.mask);
+		// Several neighbour cells can fall in the same bucket. Visit it only once.
+		bool seen = false;
+		for (int k=0; k<visitedCount; k++)
+			seen = seen || (visited[k] == bucket);
+		if (seen)
+			continue;
+		visited[visitedCount++] = bucket;
+
+		for (unsigned int i = grid.buckets[bucket]; i != 0; i = grid.next[i-1]){
+			unsigned int candidate = i-1;
+			if (found && candidate >= result)
+				continue;
+			if (
+				is_near( in_vertex.x , out_vertices[candidate].x ) &&
+				is_near( in_vertex.y , out_vertices[candidate].y ) &&
+				is_near( in_vertex.z , out_vertices[candidate].z ) &&
+				is_near( in_uv.x     , out_uvs     [candidate].x ) &&
+				is_near( in_uv.y     , out_uvs     [candidate].y ) &&
+				is_near( in_normal.x , out_normals [candidate].x ) &&
+				is_near( in_normal.y , out_normals [candidate].y ) &&
+				is_near( in_normal.z , out_normals [candidate].z )
+			){
+				result = candidate;
+				found = true;
+			}
+		}
+	}
+	return found;
+}
+
+// Registers out_vertices[index], which must be the last exported vertex.
+static void addToNearVertexGrid(NearVertexGrid & grid, const glm::vec3 & vertex, unsigned int index){
+	grid.next.resize(index + 1, 0);
+	int cell[3];
+	if (!getGridCell(vertex, cell))
+		return;
+	size_t bucket = hashGridCell(cell[0], cell[1], cell[2], grid.mask);
+	grid.next[index] = grid.buckets[bucket];
+	grid.buckets[bucket] = index + 1;
+}
+
+template <typename IndexType>
+bool indexVBO_TBN(
+	std::vector<glm::vec3> & in_vertices,
+	std::vector<glm::vec2> & in_uvs,
+	std::vector<glm::vec3> & in_normals,
+	std::vector<glm::vec3> & in_tangents,
+	std::vector<glm::vec3> & in_bitangents,
+
+	std::vector<IndexType> & out_indices,
+	std::vector<glm::vec3> & out_vertices,
+	std::vector<glm::vec2> & out_uvs,
+	std::vector<glm::vec3> & out_normals,
+	std::vector<glm::vec3> & out_tangents,
+	std::vector<glm::vec3> & out_bitangents
+){
+	PROFILE_SCOPE("indexVBO_TBN");
+	const size_t maxIndex = (size_t)(IndexType)~(IndexType)0;
+
+	// To give the out_XXXX back as they were, if the mesh is too big for IndexType.
+	// The tangents of the vertices which were already there get summed : keep them too.
+	const size_t startIndices = out_indices.size();
+	const size_t startVertices = out_vertices.size();
+	std::vector<glm::vec3> startTangents(out_tangents.begin(), out_tangents.begin() + startVertices);
+	std::vector<glm::vec3> startBitangents(out_bitangents.begin(), out_bitangents.begin() + startVertices);
+
+	// out_XXXX may already contain vertices : they can be reused too
+	NearVertexGrid grid;
+	initNearVertexGrid(grid, out_vertices.size() + in_vertices.size());
+	for ( unsigned int i=0; i<out_vertices.size(); i++ )
+		addToNearVertexGrid(grid, out_vertices[i], i);
+
+	out_indices.reserve(out_indices.size() + in_vertices.size());
+
+	// For each input vertex
+	for ( unsigned int i=0; i<in_vertices.size(); i++ ){
+
+		// Try to find a similar vertex in out_XXXX
+		unsigned int index;
+		bool found = getSimilarVertexIndex_grid(grid, in_vertices[i], in_uvs[i], in_normals[i],     out_vertices, out_uvs, out_normals, index);
+
+		if ( found ){ // A similar vertex is already in the VBO, use it instead !
+			out_indices.push_back( (IndexType)index );
+
+			// Average the tangents and the bitangents
+			out_tangents[index] += in_tangents[i];
+			out_bitangents[index] += in_bitangents[i];
+		}else{ // If not, it needs to be added in the output data.
+			size_t newindex = out_vertices.size();
+			if (newindex > maxIndex){
+				printf("indexVBO_TBN : this mesh has more than %llu vertices, use 32-bit indices\n", (unsigned long long)maxIndex + 1);
+				out_indices   .resize(startIndices);
+				out_vertices  .resize(startVertices);
+				out_uvs       .resize(startVertices);
+				out_normals   .resize(startVertices);
+				out_tangents  .assign(startTangents.begin(), startTangents.end());
+				out_bitangents.assign(startBitangents.begin(), startBitangents.end());
+				return false;
+			}
+			out_vertices.push_back( in_vertices[i]);
+			out_uvs     .push_back( in_uvs[i]);
+			out_normals .push_back( in_normals[i]);
+			out_tangents .push_back( in_tangents[i]);
+			out_bitangents .push_back( in_bitangents[i]);
+			out_indices .push_back( (IndexType)newindex );
+			addToNearVertexGrid(grid, in_vertices[i], (unsigned int)newindex);
+		}
+	}
+	return true;
+}
+
+template bool indexVBO_TBN<unsigned short>(
+	std::vector<glm::vec3> &, std::vector<glm::vec2> &, std::vector<glm::vec3> &, std::vector<glm::vec3> &, std::vector<glm::vec3> &,
+	std::vector<unsigned short> &, std::vector<glm::vec3> &, std::vector<glm::vec2> &, std::vector<glm::vec3> &, std::vector<glm::vec3> &, std::vector<glm::vec3> &);
+template bool indexVBO_TBN<unsigned int>(
+	std::vector<glm::vec3> &, std::vector<glm::vec2> &, std::vector<glm::vec3> &, std::vector<glm::vec3> &, std::vector<glm::vec3> &,
+	std::vector<unsigned int> &, std::vector<glm::vec3> &, std::vector<glm::vec2> &, std::vector<glm::vec3> &, std::vector<glm::vec3> &, std::vector<glm::vec3> &);
@@ -1,7 +1,37 @@
 #ifndef VBOINDEXER_HPP
 #define VBOINDEXER_HPP
 
-void indexVBO(
+// Merges the identical vertices of a triangle soup, and builds an index buffer.
+// IndexType can be unsigned short or unsigned int. Returns false if the mesh has
+// too many unique vertices for IndexType (more than 65536 for unsigned short) :
+// the out_XXXX are then given back as they were before the call.
+template <typename IndexType>
+bool indexVBO(
+	std::vector<glm::vec3> & in_vertices,
+	std::vector<glm::vec2> & in_uvs,
+	std::vector<glm::vec3> & in_normals,
+
+	std::vector<IndexType> & out_indices,
+	std::vector<glm::vec3> & out_vertices,
+	std::vector<glm::vec2> & out_uvs,
+	std::vector<glm::vec3> & out_normals
+);
+
+// Previous versions of indexVBO, kept for reference and for the tests and benchmarks :
+// indexVBO_map with a std::map (same result as indexVBO), indexVBO_slow with a linear search,
+// which merges the nearly identical vertices like indexVBO_TBN does.
+// Their indices are truncated to 16 bits when there are more than 65536 unique vertices.
+void indexVBO_map(
+	std::vector<glm::vec3> & in_vertices,
+	std::vector<glm::vec2> & in_uvs,
+	std::vector<glm::vec3> & in_normals,
+
+	std::vector<unsigned short> & out_indices,
+	std::vector<glm::vec3> & out_vertices,
+	std::vector<glm::vec2> & out_uvs,
+	std::vector<glm::vec3> & out_normals
+);
+void indexVBO_slow(
 	std::vector<glm::vec3> & in_vertices,
 	std::vector<glm::vec2> & in_uvs,
 	std::vector<glm::vec3> & in_normals,
@@ -12,8 +42,35 @@ void indexVBO(
 	std::vector<glm::vec3> & out_normals
 );
 
+// Converts 32-bit indices to 16-bit ones, which take half the memory.
+// Returns false (and leaves out_indices alone) if an index doesn't fit in 16 bits.
+// Typical use : indexVBO with unsigned int indices, then narrowIndices() to pick
+// the smallest index type that works for this mesh.
+bool narrowIndices(const std::vector<unsigned int> & in_indices, std::vector<unsigned short> & out_indices);
+
+
+// Same as indexVBO, but vertices are merged when they are only *nearly* the same,
+// and the tangents and bitangents of merged vertices are summed.
+// IndexType can be unsigned short or unsigned int. Returns false if there are too many vertices for it :
+// the out_XXXX are then given back as they were before the call.
+template <typename IndexType>
+bool indexVBO_TBN(
+	std::vector<glm::vec3> & in_vertices,
+	std::vector<glm::vec2> & in_uvs,
+	std::vector<glm::vec3> & in_normals,
+	std::vector<glm::vec3> & in_tangents,
+	std::vector<glm::vec3> & in_bitangents,
+
+	std::vector<IndexType> & out_indices,
+	std::vector<glm::vec3> & out_vertices,
+	std::vector<glm::vec2> & out_uvs,
+	std::vector<glm::vec3> & out_normals,
+	std::vector<glm::vec3> & out_tangents,
+	std::vector<glm::vec3> & out_bitangents
+);
 
-void indexVBO_TBN(
+// Previous version of indexVBO_TBN, with a linear search : O(n^2). Same result, for at most 65536 vertices.
+void indexVBO_TBN_slow(
 	std::vector<glm::vec3> & in_vertices,
 	std::vector<glm::vec2> & in_uvs,
 	std::vector<glm::vec3> & in_normals,
@@ -0,0 +1,331 @@
+#include <vector>
+#include <algorithm>
+#include <math.h>
+
+#include <glm/glm.hpp>
+
+#include "vertexcache.hpp"
+
+// Tom Forsyth's algorithm, see https://tomforsyth1000.github.io/papers/fast_vert_cache_opt.html
+// Each vertex gets a score, depending on its position in a simulated LRU cache (recently used
+// vertices are better) and on how many triangles still use it (finishing a vertex off is better).
+// Then we greedily emit the triangle whose vertices have the best total score.
+
+#define FORSYTH_CACHE_SIZE 32
+
+static float forsythVertexScore(int cachePosition, unsigned int remainingTriangles){
+	if (remainingTriangles == 0)
+		return -1.0f; // not used anymore
+
+	float score = 0.0f;
+	if (cachePosition >= 0){
+		if (cachePosition < 3){
+			// Used by the last triangle : whatever we do, it's almost free
+			score = 0.75f;
+		}else{
+			score = powf(1.0f - (cachePosition - 3) * (1.0f / (FORSYTH_CACHE_SIZE - 3)), 1.5f);
+		}
+	}
+	// Bonus for vertices with few triangles left
+	score += 2.0f / sqrtf((float)remainingTriangles);
+	return score;
+}
+
+template <typename IndexType>
+void optimizeVertexCache(std::vector<IndexType> & indices, size_t vertexCount){
+	size_t triangleCount = indices.size() / 3;
+	if (triangleCount == 0)
+		return;
+
+	// Triangles which use each vertex : adjacency[offsets[v] .. offsets[v]+remaining[v]].
+	// Emitted triangles are swapped at the end of each list, out of the live part.
+	std::vector<unsigned int> remaining(vertexCount, 0);
+	for (size_t i=0; i<triangleCount*3; i++)
+		remaining[indices[i]]++;
+	std::vector<unsigned int> offsets(vertexCount + 1, 0);
+	for (size_t v=0; v<vertexCount; v++)
+		offsets[v+1] = offsets[v] + remaining[v];
+	std::vector<unsigned int> adjacency(triangleCount * 3);
+	{
+		std::vector<unsigned int> fill(offsets.begin(), offsets.end() - 1);
+		for (size_t t=0; t<triangleCount; t++)
+			for (int k=0; k<3; k++)
+				adjacency[fill[indices[3*t+k]]++] = (unsigned int)t;
+	}
+
+	std::vector<int> cachePosition(vertexCount, -1);
+	std::vector<float> vertexScore(vertexCount);
+	for (size_t v=0; v<vertexCount; v++)
+		vertexScore[v] = forsythVertexScore(-1, remaining[v]);
+
+	std::vector<float> triangleScore(triangleCount);
+	std::vector<char> emitted(triangleCount, 0);
+	int best = 0;
+	for (size_t t=0; t<triangleCount; t++){
+		triangleScore[t] = vertexScore[indices[3*t+0]] + vertexScore[indices[3*t+1]] + vertexScore[indices[3*t+2]];
+		if (triangleScore[t] > triangleScore[best])
+			best = (int)t;
+	}
+
+	std::vector<IndexType> output;
+	output.reserve(triangleCount * 3);
+
+	// The simulated cache. It temporarily grows to FORSYTH_CACHE_SIZE+3 entries
+	// when a triangle is added; the extra ones are the vertices which fall out.
+	unsigned int cache[FORSYTH_CACHE_SIZE + 3];
+	unsigned int newCache[FORSYTH_CACHE_SIZE + 3];
+	int cacheCount = 0;
+	size_t cursor = 0; // to find a new triangle when the cache has nothing good left
+
+	while (output.size() < triangleCount * 3){
+		if (best < 0){
+			// Nothing in the cache can be used anymore : start somewhere else
+			while (emitted[cursor])
+				cursor++;
+			best = (int)cursor;
+		}
+
+		// Emit the best triangle
+		unsigned int tri[3] = { indices[3*best+0], indices[3*best+1], indices[3*best+2] };
+		output.push_back((IndexType)tri[0]);
+		output.push_back((IndexType)tri[1]);
+		output.push_back((IndexType)tri[2]);
+		emitted[best] = 1;
+
+		// Remove it from the live triangles of its vertices
+		for (int k=0; k<3; k++){
+			unsigned int v = tri[k];
+			unsigned int * list = &adjacency[offsets[v]];
+			for (unsigned int j=0; j<remaining[v]; j++){
+				if (list[j] == (unsigned int)best){
+					std::swap(list[j], list[remaining[v]-1]);
+					remaining[v]--;
+					break;
+				}
+			}
+		}
+
+		// Its vertices go to the front of the cache, the others move back
+		int newCount = 0;
+		for (int k=0; k<3; k++){
+			bool duplicate = false; // degenerate triangles
+			for (int j=0; j<newCount; j++)
+				duplicate = duplicate || (newCache[j] == tri[k]);
+			if (!duplicate)
+				newCache[newCount++] = tri[k];
+		}
+		for (int j=0; j<cacheCount; j++){
+			unsigned int v = cache[j];
+			if (v != tri[0] && v != tri[1] && v != tri[2])
+				newCache[newCount++] = v;
+		}
+
+		// Update the scores of all the vertices which moved, including the ones which fell out
+		for (int j=0; j<newCount; j++){
+			unsigned int v = newCache[j];
+			cachePosition[v] = j < FORSYTH_CACHE_SIZE ? j : -1;
+			vertexScore[v] = forsythVertexScore(cachePosition[v], remaining[v]);
+		}
+
+		// ... then the scores of their triangles, and find the next best one
+		best = -1;
+		float bestScore = -1.0f;
+		for (int j=0; j<newCount; j++){
+			unsigned int v = newCache[j];
+			const unsigned int * list = &adjacency[offsets[v]];
+			for (unsigned int a=0; a<remaining[v]; a++){
+				unsigned int t = list[a];
+				float score = vertexScore[indices[3*t+0]] + vertexScore[indices[3*t+1]] + vertexScore[indices[3*t+2]];
+				triangleScore[t] = score;
+				if (score > bestScore){
+					bestScore = score;
+					best = (int)t;
+				}
+			}
+		}
+
+		cacheCount = newCount < FORSYTH_CACHE_SIZE ? newCount : FORSYTH_CACHE_SIZE;
+		for (int j=0; j<cacheCount; j++)
+			cache[j] = newCache[j];
+	}
+
+	indices.swap(output);
+}
+
+// Adds a vertex to a simulated FIFO cache. Returns true if it was a miss.
+// A vertex is in the cache if it was added less than cacheSize misses ago.
+static inline bool fifoCacheAccess(std::vector<size_t> & timestamps, size_t & misses, unsigned int v, unsigned int cacheSize){
+	if (timestamps[v] != 0 && misses - timestamps[v] < cacheSize)
+		return false;
+	misses++;
+	timestamps[v] = misses;
+	return true;
+}
+
+template <typename IndexType>
+VertexCacheStats simulateVertexCache(const std::vector<IndexType> & indices, size_t vertexCount, unsigned int cacheSize){
+	std::vector<size_t> timestamps(vertexCount, 0);
+	std::vector<char> used(vertexCount, 0);
+	size_t misses = 0;
+	size_t usedCount = 0;
+	for (size_t i=0; i<indices.size(); i++){
+		fifoCacheAccess(timestamps, misses, indices[i], cacheSize);
+		if (!used[indices[i]]){
+			used[indices[i]] = 1;
+			usedCount++;
+		}
+	}
+	VertexCacheStats stats;
+	stats.acmr = indices.size() >= 3 ? (float)misses / (indices.size() / 3) : 0.0f;
+	stats.atvr = usedCount ? (float)misses / usedCount : 0.0f;
+	return stats;
+}
+
+struct TriangleCluster{
+	size_t begin, end; // in triangles
+	float sortKey;
+};
+
+static bool clusterFacesMoreOutwards(const TriangleCluster & a, const TriangleCluster & b){
+	return a.sortKey > b.sortKey;
+}
+
+template <typename IndexType>
+void optimizeOverdraw(std::vector<IndexType> & indices, const std::vector<glm::vec3> & vertices, float threshold){
+	size_t triangleCount = indices.size() / 3;
+	if (triangleCount < 2)
+		return;
+
+	// Cut the triangle list in clusters. A cluster can end when
+	// - the next triangle misses the cache completely : the order is already broken there, or
+	// - its own ACMR is good enough : the misses caused by starting the next cluster
+	//   somewhere else in the list are paid for.
+	const unsigned int cacheSize = 16;
+	float targetACMR = simulateVertexCache(indices, vertices.size(), cacheSize).acmr * threshold;
+
+	std::vector<TriangleCluster> clusters;
+	std::vector<size_t> timestamps(vertices.size(), 0);
+	size_t misses = 0;
+	size_t clusterBegin = 0, clusterMisses = 0;
+	for (size_t t=0; t<triangleCount; t++){
+		size_t before = misses;
+		for (int k=0; k<3; k++)
+			fifoCacheAccess(timestamps, misses, indices[3*t+k], cacheSize);
+		size_t triangleMisses = misses - before;
+
+		if (triangleMisses == 3 && t > clusterBegin){
+			TriangleCluster cluster = { clusterBegin, t, 0.0f };
+			clusters.push_back(cluster);
+			clusterBegin = t;
+			clusterMisses = 0;
+		}
+		clusterMisses += triangleMisses;
+		if ((float)clusterMisses / (t + 1 - clusterBegin) <= targetACMR){
+			TriangleCluster cluster = { clusterBegin, t + 1, 0.0f };
+			clusters.push_back(cluster);
+			clusterBegin = t + 1;
+			clusterMisses = 0;
+			// The next cluster may be drawn after any other one : assume a cold cache,
+			// i.e. pretend that cacheSize other vertices were loaded in between.
+			misses += cacheSize;
+		}
+	}
+	if (clusterBegin < triangleCount){
+		TriangleCluster cluster = { clusterBegin, triangleCount, 0.0f };
+		clusters.push_back(cluster);
+	}
+
+	// Center of the mesh, weighted by area
+	glm::vec3 meshCenter(0.0f);
+	float meshArea = 0.0f;
+	for (size_t t=0; t<triangleCount; t++){
+		const glm::vec3 & a = vertices[indices[3*t+0]];
+		const glm::vec3 & b = vertices[indices[3*t+1]];
+		const glm::vec3 & c = vertices[indices[3*t+2]];
+		float area = glm::length(glm::cross(b - a, c - a));
+		meshCenter += (a + b + c) * (area / 3.0f);
+		meshArea += area;
+	}
+	if (meshArea > 0.0f)
+		meshCenter /= meshArea;
+
+	// The more a cluster faces away from the center, the more likely it is to hide other clusters.
+	for (size_t i=0; i<clusters.size(); i++){
+		glm::vec3 center(0.0f), normal(0.0f);
+		float area = 0.0f;
+		for (size_t t=clusters[i].begin; t<clusters[i].end; t++){
+			const glm::vec3 & a = vertices[indices[3*t+0]];
+			const glm::vec3 & b = vertices[indices[3*t+1]];
+			const glm::vec3 & c = vertices[indices[3*t+2]];
+			glm::vec3 n = glm::cross(b - a, c - a); // length = 2 * area
+			float triangleArea = glm::length(n);
+			center += (a + b + c) * (triangleArea / 3.0f);
+			normal += n;
+			area += triangleArea;
+		}
+		if (area > 0.0f)
+			center /= area;
+		float normalLength = glm::length(normal);
+		clusters[i].sortKey = normalLength > 0.0f ? glm::dot(center - meshCenter, normal / normalLength) : 0.0f;
+	}
+
+	std::stable_sort(clusters.begin(), clusters.end(), clusterFacesMoreOutwards);
+
+	std::vector<IndexType> output;
+	output.reserve(indices.size());
+	for (size_t i=0; i<clusters.size(); i++)
+		output.insert(output.end(), indices.begin() + 3*clusters[i].begin, indices.begin() + 3*clusters[i].end);
+	indices.swap(output);
+}
+
+template <typename T>
+static void remapArray(std::vector<T> & data, const std::vector<unsigned int> & remap){
+	std::vector<T> result(data.size());
+	for (size_t i=0; i<data.size(); i++)
+		result[remap[i]] = data[i];
+	data.swap(result);
+}
+
+template <typename IndexType>
+void optimizeVertexFetch(
+	std::vector<IndexType> & indices,
+	std::vector<glm::vec3> & vertices,
+	std::vector<glm::vec2> & uvs,
+	std::vector<glm::vec3> & normals,
+	std::vector<glm::vec3> * tangents,
+	std::vector<glm::vec3> * bitangents
+){
+	// remap[old index] = new index
+	const unsigned int unused = ~0u;
+	std::vector<unsigned int> remap(vertices.size(), unused);
+	unsigned int next = 0;
+	for (size_t i=0; i<indices.size(); i++){
+		unsigned int & r = remap[indices[i]];
+		if (r == unused)
+			r = next++;
+		indices[i] = (IndexType)r;
+	}
+	for (size_t v=0; v<remap.size(); v++){
+		if (remap[v] == unused)
+			remap[v] = next++;
+	}
+
+	remapArray(vertices, remap);
+	remapArray(uvs, remap);
+	remapArray(normals, remap);
+	if (tangents)
+		remapArray(*tangents, remap);
+	if (bitangents)
+		remapArray(*bitangents, remap);
+}
+
+template void optimizeVertexCache<unsigned short>(std::vector<unsigned short> &, size_t);
+template void optimizeVertexCache<unsigned int>(std::vector<unsigned int> &, size_t);
+template void optimizeOverdraw<unsigned short>(std::vector<unsigned short> &, const std::vector<glm::vec3> &, float);
+template void optimizeOverdraw<unsigned int>(std::vector<unsigned int> &, const std::vector<glm::vec3> &, float);
+template void optimizeVertexFetch<unsigned short>(std::vector<unsigned short> &, std::vector<glm::vec3> &, std::vector<glm::vec2> &,
+	std::vector<glm::vec3> &, std::vector<glm::vec3> *, std::vector<glm::vec3> *);
+template void optimizeVertexFetch<unsigned int>(std::vector<unsigned int> &, std::vector<glm::vec3> &, std::vector<glm::vec2> &,
+	std::vector<glm::vec3> &, std::vector<glm::vec3> *, std::vector<glm::vec3> *);
+template VertexCacheStats simulateVertexCache<unsigned short>(const std::vector<unsigned short> &, size_t, unsigned int);
+template VertexCacheStats simulateVertexCache<unsigned int>(const std::vector<unsigned int> &, size_t, unsigned int);
@@ -0,0 +1,48 @@
+#ifndef VERTEXCACHE_HPP
+#define VERTEXCACHE_HPP
+
+// Reordering of the outputs of indexVBO / indexVBO_TBN for faster rendering.
+// Typical use, after indexVBO :
+//   optimizeVertexCache(indices, vertices.size());      // fewer vertex shader invocations
+//   optimizeOverdraw(indices, vertices, 1.05f);         // optional : fewer hidden pixels shaded
+//   optimizeVertexFetch(indices, vertices, uvs, normals, NULL, NULL); // better memory locality
+// IndexType can be unsigned short or unsigned int.
+
+// Reorders the triangles so that the GPU's post-transform cache is hit more often.
+// This is Tom Forsyth's "Linear-Speed Vertex Cache Optimisation".
+template <typename IndexType>
+void optimizeVertexCache(std::vector<IndexType> & indices, size_t vertexCount);
+
+// Reorders clusters of triangles (without breaking the vertex cache order inside each cluster)
+// so that the ones facing outwards are drawn first, and hide the others.
+// Clusters are cut where the cache would miss anyway. 'threshold' (typically 1.05)
+// is roughly how much worse the ACMR is allowed to become to make smaller clusters.
+// This is a simplified version of "Fast Triangle Reordering for Vertex Locality and Reduced Overdraw", Sander et al.
+template <typename IndexType>
+void optimizeOverdraw(std::vector<IndexType> & indices, const std::vector<glm::vec3> & vertices, float threshold);
+
+// Renumbers the vertices in the order they are first used by the indices, so that
+// the vertex fetches read memory mostly sequentially. Vertices which are never
+// used are moved at the end. tangents and bitangents can be NULL.
+template <typename IndexType>
+void optimizeVertexFetch(
+	std::vector<IndexType> & indices,
+	std::vector<glm::vec3> & vertices,
+	std::vector<glm::vec2> & uvs,
+	std::vector<glm::vec3> & normals,
+	std::vector<glm::vec3> * tangents,
+	std::vector<glm::vec3> * bitangents
+);
+
+// Simulates a FIFO post-transform cache of cacheSize entries.
+// ACMR = Average Cache Miss Ratio = transformed vertices / triangles. 0.5 is the best possible, 3 the worst.
+// ATVR = Average Transformed Vertex Ratio = transformed vertices / used vertices. 1 is the best possible.
+struct VertexCacheStats{
+	float acmr;
+	float atvr;
+};
+
+template <typename IndexType>
+VertexCacheStats simulateVertexCache(const std::vector<IndexType> & indices, size_t vertexCount, unsigned int cacheSize);
+
+#endif
@@ -0,0 +1,323 @@
+#include <vector>
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+
+#include <GL/glew.h>
+
+#include <glm/glm.hpp>
+#include <glm/gtc/packing.hpp>
+
+#include "vertexlayout.hpp"
+
+// Octahedral encoding : the unit sphere is projected on an octahedron,
+// which is then unfolded on the [-1,1] square. Much more precise than
+// quantizing x, y and z separately with the same number of bits.
+// See "A Survey of Efficient Representations for Independent Unit Vectors", Cigolle et al.
+static inline float signNotZero(float v){
+	return v >= 0.0f ? 1.0f : -1.0f;
+}
+
+static glm::vec2 encodeOctahedral(glm::vec3 n){
+	float l1 = fabs(n.x) + fabs(n.y) + fabs(n.z);
+	if (l1 == 0.0f)
+		return glm::vec2(0.0f);
+	n /= l1;
+	glm::vec2 result(n.x, n.y);
+	if (n.z < 0.0f){
+		result.x = (1.0f - fabs(n.y)) * signNotZero(n.x);
+		result.y = (1.0f - fabs(n.x)) * signNotZero(n.y);
+	}
+	return result;
+}
+
+// This is what the vertex shader has to do with DIRECTION_OCT16 normals :
+//   vec3 n = vec3(e.xy, 1.0 - abs(e.x) - abs(e.y));
+//   float t = max(-n.z, 0.0);
+//   n.xy += vec2(n.x >= 0.0 ? -t : t, n.y >= 0.0 ? -t : t);
+//   n = normalize(n);
+static glm::vec3 decodeOctahedral(glm::vec2 e){
+	glm::vec3 n(e.x, e.y, 1.0f - fabs(e.x) - fabs(e.y));
+	float t = n.z < 0.0f ? -n.z : 0.0f;
+	n.x += n.x >= 0.0f ? -t : t;
+	n.y += n.y >= 0.0f ? -t : t;
+	return glm::normalize(n);
+}
+
+// Same convention as computeTangentBasis : the bitangent is +/- cross(n, t)
+static inline float handedness(const glm::vec3 & n, const glm::vec3 & t, const glm::vec3 & b){
+	return glm::dot(glm::cross(n, t), b) < 0.0f ? -1.0f : 1.0f;
+}
+
+static size_t positionBytes(PositionFormat format){
+	return format == POSITION_UNORM16 ? 8 : 12;
+}
+
+static size_t uvBytes(UVFormat format){
+	return format == UV_HALF ? 4 : 8;
+}
+
+static size_t directionBytes(DirectionFormat format, bool isTangent){
+	switch (format){
+	case DIRECTION_INT_2_10_10_10: return 4;
+	case DIRECTION_OCT16:          return isTangent ? 8 : 4;
+	default:                       return isTangent ? 16 : 12;
+	}
+}
+
+static void setDirectionAttribute(VertexAttribute & attribute, DirectionFormat format, bool isTangent){
+	switch (format){
+	case DIRECTION_INT_2_10_10_10:
+		attribute.size = 4; attribute.type = GL_INT_2_10_10_10_REV; attribute.normalized = true;
+		break;
+	case DIRECTION_OCT16:
+		// Tangents : 2 for the direction, 1 for the handedness, 1 of padding
+		attribute.size = isTangent ? 3 : 2; attribute.type = GL_SHORT; attribute.normalized = true;
+		break;
+	default:
+		attribute.size = isTangent ? 4 : 3; attribute.type = GL_FLOAT; attribute.normalized = false;
+		break;
+	}
+}
+
+static void writeDirection(unsigned char * dst, DirectionFormat format, glm::vec3 d, float w, bool isTangent){
+	float length = glm::length(d);
+	if (length > 0.0f)
+		d /= length;
+	switch (format){
+	case DIRECTION_INT_2_10_10_10:{
+		glm::uint32 p = glm::packSnorm3x10_1x2(glm::vec4(d, isTangent ? w : 0.0f));
+		memcpy(dst, &p, 4);
+		break;
+	}
+	case DIRECTION_OCT16:{
+		glm::vec2 e = encodeOctahedral(d);
+		if (isTangent){
+			glm::uint64 p = glm::packSnorm4x16(glm::vec4(e, w, 0.0f));
+			memcpy(dst, &p, 8);
+		}else{
+			glm::uint32 p = glm::packSnorm2x16(e);
+			memcpy(dst, &p, 4);
+		}
+		break;
+	}
+	default:{
+		float f[4] = { d.x, d.y, d.z, w };
+		memcpy(dst, f, isTangent ? 16 : 12);
+		break;
+	}
+	}
+}
+
+static glm::vec3 readDirection(const unsigned char * src, DirectionFormat format, bool isTangent, float & w){
+	w = 0.0f;
+	switch (format){
+	case DIRECTION_INT_2_10_10_10:{
+		glm::uint32 p;
+		memcpy(&p, src, 4);
+		glm::vec4 v = glm::unpackSnorm3x10_1x2(p);
+		w = v.w;
+		return glm::vec3(v);
+	}
+	case DIRECTION_OCT16:{
+		if (isTangent){
+			glm::uint64 p;
+			memcpy(&p, src, 8);
+			glm::vec4 v = glm::unpackSnorm4x16(p);
+			w = v.z;
+			return decodeOctahedral(glm::vec2(v));
+		}
+		glm::uint32 p;
+		memcpy(&p, src, 4);
+		return decodeOctahedral(glm::unpackSnorm2x16(p));
+	}
+	default:{
+		float f[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+		memcpy(f, src, isTangent ? 16 : 12);
+		w = f[3];
+		return glm::vec3(f[0], f[1], f[2]);
+	}
+	}
+}
+
+void packVertices(
+	const VertexLayoutOptions & options,
+	const std::vector<glm::vec3> & vertices,
+	const std::vector<glm::vec2> & uvs,
+	const std::vector<glm::vec3> & normals,
+	const std::vector<glm::vec3> * tangents,
+	const std::vector<glm::vec3> * bitangents,
+	PackedVertices & out_packed
+){
+	bool hasTangents = tangents != NULL && bitangents != NULL;
+	size_t n = vertices.size();
+
+	// Size of each attribute
+	size_t sizes[4] = {
+		positionBytes(options.positionFormat),
+		uvBytes(options.uvFormat),
+		directionBytes(options.normalFormat, false),
+		hasTangents ? directionBytes(options.tangentFormat, true) : 0
+	};
+	size_t vertexSize = sizes[0] + sizes[1] + sizes[2] + sizes[3];
+
+	// Where each attribute starts, and how far apart two vertices are
+	VertexAttribute * attributes[4] = { &out_packed.position, &out_packed.uv, &out_packed.normal, &out_packed.tangent };
+	size_t offset = 0;
+	for (int a=0; a<4; a++){
+		attributes[a]->offset = offset;
+		attributes[a]->stride = (int)(options.interleaved ? vertexSize : sizes[a]);
+		offset += options.interleaved ? sizes[a] : sizes[a] * n;
+	}
+
+	if (options.positionFormat == POSITION_UNORM16){
+		out_packed.position.size = 3; out_packed.position.type = GL_UNSIGNED_SHORT; out_packed.position.normalized = true;
+	}else{
+		out_packed.position.size = 3; out_packed.position.type = GL_FLOAT; out_packed.position.normalized = false;
+	}
+	if (options.uvFormat == UV_HALF){
+		out_packed.uv.size = 2; out_packed.uv.type = GL_HALF_FLOAT; out_packed.uv.normalized = false;
+	}else{
+		out_packed.uv.size = 2; out_packed.uv.type = GL_FLOAT; out_packed.uv.normalized = false;
+	}
+	setDirectionAttribute(out_packed.normal, options.normalFormat, false);
+	if (hasTangents)
+		setDirectionAttribute(out_packed.tangent, options.tangentFormat, true);
+	else
+		memset(&out_packed.tangent, 0, sizeof(out_packed.tangent));
+
+	// Bounding box, for quantized positions
+	glm::vec3 minimum(0.0f), maximum(0.0f);
+	if (n > 0){
+		minimum = maximum = vertices[0];
+		for (size_t i=1; i<n; i++){
+			minimum = glm::min(minimum, vertices[i]);
+			maximum = glm::max(maximum, vertices[i]);
+		}
+	}
+	out_packed.positionBias  = minimum;
+	out_packed.positionScale = maximum - minimum;
+	for (int k=0; k<3; k++){
+		if (out_packed.positionScale[k] == 0.0f)
+			out_packed.positionScale[k] = 1.0f; // flat mesh : avoid dividing by 0
+	}
+
+	out_packed.vertexCount = n;
+	out_packed.data.assign(vertexSize * n, 0);
+	unsigned char * data = n ? &out_packed.data[0] : NULL;
+
+	for (size_t i=0; i<n; i++){
+		unsigned char * p = data + out_packed.position.offset + i * out_packed.position.stride;
+		if (options.positionFormat == POSITION_UNORM16){
+			glm::vec3 q = (vertices[i] - out_packed.positionBias) / out_packed.positionScale;
+			glm::uint64 packed = glm::packUnorm4x16(glm::vec4(q, 0.0f));
+			memcpy(p, &packed, 8);
+		}else{
+			memcpy(p, &vertices[i], 12);
+		}
+
+		p = data + out_packed.uv.offset + i * out_packed.uv.stride;
+		if (options.uvFormat == UV_HALF){
+			glm::uint32 packed = glm::packHalf2x16(uvs[i]);
+			memcpy(p, &packed, 4);
+		}else{
+			memcpy(p, &uvs[i], 8);
+		}
+
+		p = data + out_packed.normal.offset + i * out_packed.normal.stride;
+		writeDirection(p, options.normalFormat, normals[i], 0.0f, false);
+
+		if (hasTangents){
+			p = data + out_packed.tangent.offset + i * out_packed.tangent.stride;
+			float w = handedness(normals[i], (*tangents)[i], (*bitangents)[i]);
+			writeDirection(p, options.tangentFormat, (*tangents)[i], w, true);
+		}
+	}
+}
+
+// Angle between two directions, in degrees. 0 if one of them is null.
+static float angleBetween(glm::vec3 a, glm::vec3 b){
+	float la = glm::length(a), lb = glm::length(b);
+	if (la == 0.0f || lb == 0.0f)
+		return 0.0f;
+	float c = glm::dot(a, b) / (la * lb);
+	if (c >  1.0f) c =  1.0f;
+	if (c < -1.0f) c = -1.0f;
+	return acosf(c) * 57.2957795f;
+}
+
+void compareVertexLayout(
+	const PackedVertices & packed,
+	const std::vector<glm::vec3> & vertices,
+	const std::vector<glm::vec2> & uvs,
+	const std::vector<glm::vec3> & normals,
+	const std::vector<glm::vec3> * tangents,
+	const std::vector<glm::vec3> * bitangents,
+	VertexLayoutReport & out_report
+){
+	bool hasTangents = tangents != NULL && bitangents != NULL && packed.tangent.size != 0;
+	size_t n = packed.vertexCount;
+
+	memset(&out_report, 0, sizeof(out_report));
+	out_report.packedBytes = packed.data.size();
+	out_report.floatBytes  = n * (sizeof(glm::vec3) + sizeof(glm::vec2) + sizeof(glm::vec3));
+	if (hasTangents)
+		out_report.floatBytes += n * 2 * sizeof(glm::vec3); // tangents and bitangents
+
+	const unsigned char * data = n ? &packed.data[0] : NULL;
+	for (size_t i=0; i<n; i++){
+		// Positions
+		const unsigned char * p = data + packed.position.offset + i * packed.position.stride;
+		glm::vec3 position;
+		if (packed.position.type == GL_UNSIGNED_SHORT){
+			glm::uint64 q;
+			memcpy(&q, p, 8);
+			position = glm::vec3(glm::unpackUnorm4x16(q)) * packed.positionScale + packed.positionBias;
+		}else{
+			memcpy(&position, p, 12);
+		}
+		glm::vec3 dp = glm::abs(position - vertices[i]);
+		out_report.maxPositionError = glm::max(out_report.maxPositionError, glm::max(dp.x, glm::max(dp.y, dp.z)));
+
+		// UVs
+		p = data + packed.uv.offset + i * packed.uv.stride;
+		glm::vec2 uv;
+		if (packed.uv.type == GL_HALF_FLOAT){
+			glm::uint32 q;
+			memcpy(&q, p, 4);
+			uv = glm::unpackHalf2x16(q);
+		}else{
+			memcpy(&uv, p, 8);
+		}
+		glm::vec2 duv = glm::abs(uv - uvs[i]);
+		out_report.maxUVError = glm::max(out_report.maxUVError, glm::max(duv.x, duv.y));
+
+		// Normals
+		DirectionFormat normalFormat = packed.normal.type == GL_FLOAT ? DIRECTION_FLOAT32 :
+		                               packed.normal.type == GL_SHORT ? DIRECTION_OCT16 : DIRECTION_INT_2_10_10_10;
+		float w;
+		p = data + packed.normal.offset + i * packed.normal.stride;
+		glm::vec3 normal = readDirection(p, normalFormat, false, w);
+		out_report.maxNormalError = glm::max(out_report.maxNormalError, angleBetween(normal, normals[i]));
+
+		// Tangents
+		if (hasTangents){
+			DirectionFormat tangentFormat = packed.tangent.type == GL_FLOAT ? DIRECTION_FLOAT32 :
+			                                packed.tangent.type == GL_SHORT ? DIRECTION_OCT16 : DIRECTION_INT_2_10_10_10;
+			p = data + packed.tangent.offset + i * packed.tangent.stride;
+			glm::vec3 tangent = readDirection(p, tangentFormat, true, w);
+			out_report.maxTangentError = glm::max(out_report.maxTangentError, angleBetween(tangent, (*tangents)[i]));
+			if ((w < 0.0f) != (handedness(normals[i], (*tangents)[i], (*bitangents)[i]) < 0.0f))
+				out_report.handednessErrors++;
+		}
+	}
+}
+
+void printVertexLayoutReport(const char * name, const VertexLayoutReport & report){
+	printf("%s : %u bytes instead of %u (%.0f%%)\n", name,
+		(unsigned int)report.packedBytes, (unsigned int)report.floatBytes,
+		report.floatBytes ? 100.0 * report.packedBytes / report.floatBytes : 100.0);
+	printf("    max error : position %g, uv %g, normal %.3f deg, tangent %.3f deg, %u wrong handedness\n",
+		report.maxPositionError, report.maxUVError, report.maxNormalError, report.maxTangentError,
+		(unsigned int)report.handednessErrors);
+}
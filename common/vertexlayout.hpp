@@ -0,0 +1,94 @@
+#ifndef VERTEXLAYOUT_HPP
+#define VERTEXLAYOUT_HPP
+
+// Packs the outputs of indexVBO / indexVBO_TBN into a single vertex buffer,
+// either interleaved (one struct per vertex) or as one array per attribute,
+// and optionally with smaller formats than 32-bit floats.
+
+enum PositionFormat{
+	POSITION_FLOAT32,   // 3 floats                                           12 bytes
+	POSITION_UNORM16    // 3 normalized unsigned shorts + 1 of padding.        8 bytes
+	                    // The shader must compute position = p * positionScale + positionBias
+};
+
+enum UVFormat{
+	UV_FLOAT32,         // 2 floats                                            8 bytes
+	UV_HALF             // 2 half floats                                       4 bytes
+};
+
+enum DirectionFormat{ // used for normals and tangents
+	DIRECTION_FLOAT32,  // 3 floats (4 for tangents)                          12 (16) bytes
+	DIRECTION_INT_2_10_10_10, // GL_INT_2_10_10_10_REV, normalized             4 bytes
+	DIRECTION_OCT16     // octahedral encoding in 2 normalized shorts.         4 (8) bytes
+	                    // The shader must decode it, see decodeOctahedral() in vertexlayout.cpp
+};
+// Tangents get a 4th component : the handedness of the tangent basis (+1 or -1),
+// so that the bitangent can be computed in the shader as cross(normal, tangent.xyz) * tangent.w
+
+struct VertexLayoutOptions{
+	bool interleaved;
+	PositionFormat positionFormat;
+	UVFormat uvFormat;
+	DirectionFormat normalFormat;
+	DirectionFormat tangentFormat;
+};
+
+// Everything glVertexAttribPointer needs for one attribute.
+// 'size' is 0 if the attribute isn't in the buffer.
+struct VertexAttribute{
+	int size;
+	unsigned int type;  // GL_FLOAT, GL_HALF_FLOAT, GL_SHORT, ...
+	bool normalized;
+	int stride;
+	size_t offset;
+};
+
+struct PackedVertices{
+	std::vector<unsigned char> data; // upload this in a GL_ARRAY_BUFFER
+	size_t vertexCount;
+
+	VertexAttribute position;
+	VertexAttribute uv;
+	VertexAttribute normal;
+	VertexAttribute tangent;
+
+	glm::vec3 positionScale; // only for POSITION_UNORM16
+	glm::vec3 positionBias;
+};
+
+// tangents and bitangents can be NULL.
+void packVertices(
+	const VertexLayoutOptions & options,
+	const std::vector<glm::vec3> & vertices,
+	const std::vector<glm::vec2> & uvs,
+	const std::vector<glm::vec3> & normals,
+	const std::vector<glm::vec3> * tangents,
+	const std::vector<glm::vec3> * bitangents,
+	PackedVertices & out_packed
+);
+
+// How much was lost by packing, and how much memory was saved.
+struct VertexLayoutReport{
+	size_t packedBytes;
+	size_t floatBytes;          // the same vertices in separate float arrays
+	float maxPositionError;     // in world units
+	float maxUVError;
+	float maxNormalError;       // in degrees
+	float maxTangentError;      // in degrees
+	size_t handednessErrors;    // number of tangents with the wrong sign
+};
+
+// Unpacks everything and compares it to the original data.
+void compareVertexLayout(
+	const PackedVertices & packed,
+	const std::vector<glm::vec3> & vertices,
+	const std::vector<glm::vec2> & uvs,
+	const std::vector<glm::vec3> & normals,
+	const std::vector<glm::vec3> * tangents,
+	const std::vector<glm::vec3> * bitangents,
+	VertexLayoutReport & out_report
+);
+
+void printVertexLayoutReport(const char * name, const VertexLayoutReport & report);
+
+#endif
@@ -146,7 +146,7 @@ int main( void )
 	glBindVertexArray(VertexArrayID);
 
 	// Create and compile our GLSL program from the shaders
-	GLuint programID = LoadShaders( "StandardShading.vertexshader", "StandardShading.fragmentshader" );
+	GLuint programID = LoadShaderVariant( "../common/StandardShading.vertexshader", "../common/StandardShading.fragmentshader", "" );
 
 
 	// Get a handle for our "MVP" uniform
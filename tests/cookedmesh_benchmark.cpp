@@ -0,0 +1,166 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+#include <string>
+#include <chrono>
+
+#include <sys/types.h>
+#include <sys/stat.h>
+#ifdef _WIN32
+#include <sys/utime.h>
+#include <direct.h>
+#define mkdir(path, mode) _mkdir(path)
+#define rmdir _rmdir
+#else
+#include <utime.h>
+#include <unistd.h>
+#endif
+
+#include <glm/glm.hpp>
+
+#include <common/objloader.hpp>
+#include <common/vboindexer.hpp>
+#include <common/tangentspace.hpp>
+#include <common/cookedmesh.hpp>
+
+#include "testing.hpp"
+
+// "cookedmesh_benchmark [triangles]" writes a synthetic OBJ file (1 million triangles by default), and compares
+// what a tutorial does without the cooked files (loadOBJ_fast, indexVBO, computeTangentBasisIndexed)
+// with loadOBJ_cooked : the first time, which cooks, the next times, which only map the cooked file,
+// and after the .obj was touched without being modified. When the cooked file can't be written, the same mesh
+// must still load.
+
+// Where writeCookedMesh puts CookedMeshHeader::sourceTime : after magic, version, headerSize, flags and sourceSize
+#define SOURCE_TIME_OFFSET 24
+
+static bool readCookedSourceTime(const char * cookedPath, unsigned long long & out_time){
+	FILE * file = fopen(cookedPath, "rb");
+	if (file == NULL)
+		return false;
+	bool ok = fseek(file, SOURCE_TIME_OFFSET, SEEK_SET) == 0 && fread(&out_time, sizeof(out_time), 1, file) == 1;
+	fclose(file);
+	return ok;
+}
+
+// Like a checkout would : another modification time, the same contents
+static bool touchFile(const char * path, unsigned long long & out_time){
+	struct stat st;
+	if (stat(path, &st) != 0)
+		return false;
+	struct utimbuf times;
+	times.actime = st.st_atime;
+	times.modtime = st.st_mtime + 10;
+	out_time = (unsigned long long)times.modtime;
+	return utime(path, &times) == 0;
+}
+
+// Mapping alone reads nothing : read all the arrays too, like the upload to the GPU would
+static float readCookedMesh(const CookedMesh & mesh){
+	float sum = 0.0f;
+	for (unsigned int i=0; i<mesh.vertexCount; i++)
+		sum += mesh.vertices[i].x + mesh.uvs[i].x + mesh.normals[i].x + mesh.tangents[i].x + mesh.bitangents[i].x;
+	const unsigned char * indices = (const unsigned char *)mesh.indices;
+	for (size_t i=0; i<(size_t)mesh.indexCount * mesh.indexSize; i++)
+		sum += indices[i];
+	return sum;
+}
+
+static float Sum = 0.0f; // so that the reads aren't optimized away
+
+static bool sameArray(const void * a, const void * b, size_t size){
+	return (a == NULL) == (b == NULL) && (a == NULL || memcmp(a, b, size) == 0);
+}
+
+// A directory where writeCookedMesh puts its temporary file, like a read-only checkout : loadOBJ_cooked
+// can't cook, but still gives the arrays which the cooked file has, from memory
+static void checkNotCooked(const char * path, const char * cookedPath, const CookedMesh & cooked){
+	std::string tempPath = std::string(cookedPath) + ".tmp";
+	remove(cookedPath);
+	if (!CHECK(mkdir(tempPath.c_str(), 0755) == 0))
+		return;
+	CookedMesh mesh;
+	if (CHECK(loadOBJ_cooked(path, true, mesh))){
+		size_t vertexCount = cooked.vertexCount;
+		CHECK(mesh.file.data == NULL && !mesh.storage.empty());
+		CHECK(mesh.vertexCount == cooked.vertexCount && mesh.indexCount == cooked.indexCount && mesh.indexSize == cooked.indexSize);
+		CHECK(sameArray(mesh.vertices, cooked.vertices, vertexCount * sizeof(glm::vec3)));
+		CHECK(sameArray(mesh.uvs, cooked.uvs, vertexCount * sizeof(glm::vec2)));
+		CHECK(sameArray(mesh.normals, cooked.normals, vertexCount * sizeof(glm::vec3)));
+		CHECK(sameArray(mesh.tangents, cooked.tangents, vertexCount * sizeof(glm::vec3)));
+		CHECK(sameArray(mesh.bitangents, cooked.bitangents, vertexCount * sizeof(glm::vec3)));
+		CHECK(sameArray(mesh.indices, cooked.indices, (size_t)cooked.indexCount * cooked.indexSize));
+		unloadCookedMesh(mesh);
+	}
+	struct stat st;
+	CHECK(stat(cookedPath, &st) != 0); // nothing was cooked
+	rmdir(tempPath.c_str());
+}
+
+static double timeCookedLoad(const char * path, CookedMesh & mesh){
+	std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+	if (CHECK(loadOBJ_cooked(path, true, mesh) && mesh.tangents != NULL))
+		Sum += readCookedMesh(mesh);
+	return millisecondsSince(start);
+}
+
+int main(int argc, char * argv[]){
+	unsigned int triangles = argc > 1 ? (unsigned int)atoi(argv[1]) : 1000000;
+	unsigned int cells = gridCells(triangles);
+
+	const char * path = "cookedmesh_benchmark.obj";
+	const char * cookedPath = "cookedmesh_benchmark.obj.cooked";
+	remove(cookedPath);
+	if (!CHECK(writeGridOBJ(path, cells)))
+		return testResult();
+	printf("%u triangles\n", 2 * cells * cells);
+
+	std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+	std::vector<glm::vec3> vertices, normals;
+	std::vector<glm::vec2> uvs;
+	CHECK(loadOBJ_fast(path, vertices, uvs, normals, 0));
+	std::vector<unsigned int> indices;
+	std::vector<glm::vec3> indexed_vertices, indexed_normals, indexed_tangents, indexed_bitangents;
+	std::vector<glm::vec2> indexed_uvs;
+	CHECK(indexVBO(vertices, uvs, normals, indices, indexed_vertices, indexed_uvs, indexed_normals));
+	computeTangentBasisIndexed(indices, indexed_vertices, indexed_uvs, indexed_normals, indexed_tangents, indexed_bitangents);
+	double coldTime = millisecondsSince(start);
+
+	CookedMesh mesh;
+	double cookTime = timeCookedLoad(path, mesh);
+	CHECK(mesh.indexCount == indices.size() && mesh.vertexCount == indexed_vertices.size());
+	unloadCookedMesh(mesh);
+
+	double mapTime = 0.0;
+	const int loads = 10;
+	for (int i=0; i<loads; i++){
+		mapTime += timeCookedLoad(path, mesh);
+		CHECK(mesh.indexCount == indices.size() && mesh.vertexCount == indexed_vertices.size());
+		unloadCookedMesh(mesh);
+	}
+	mapTime /= loads;
+
+	// Touched : the first load hashes the .obj and stamps the new time, the next one doesn't hash it anymore
+	unsigned long long touchedTime = 0, stampedTime = 0;
+	CHECK(touchFile(path, touchedTime));
+	double touchedLoadTime = timeCookedLoad(path, mesh);
+	CHECK(mesh.indexCount == indices.size());
+	unloadCookedMesh(mesh);
+	CHECK(readCookedSourceTime(cookedPath, stampedTime) && stampedTime == touchedTime);
+	double afterTouchTime = timeCookedLoad(path, mesh);
+	checkNotCooked(path, cookedPath, mesh);
+	unloadCookedMesh(mesh);
+
+	printf("loadOBJ_fast + indexVBO + computeTangentBasisIndexed : %8.2f ms\n", coldTime);
+	printf("loadOBJ_cooked, cooking                              : %8.2f ms\n", cookTime);
+	printf("loadOBJ_cooked, cooked                               : %8.2f ms, %6.0fx faster\n", mapTime, coldTime / mapTime);
+	printf("loadOBJ_cooked, .obj touched                         : %8.2f ms\n", touchedLoadTime);
+	printf("loadOBJ_cooked, after that                           : %8.2f ms\n", afterTouchTime);
+
+	printf("(%g)\n", Sum);
+
+	remove(path);
+	remove(cookedPath);
+	return testResult();
+}
@@ -0,0 +1,211 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <vector>
+#include <string>
+#include <chrono>
+
+#include <GL/glew.h>
+
+#include <common/textureimage.hpp>
+#include <common/distancefield.hpp>
+
+#include "testing.hpp"
+
+// "distancefield_test [font.dds] [data directory] [-write]" checks signedDistanceField against a brute force
+// search and against the exact distance to a disc, on 1 and 4 threads. Then buildSDFFont on the font
+// (tutorial11_2d_fonts/Holstein.DDS) must give the golden field of tests/data/sdf_holstein_8.dds, 8x8 glyphs,
+// within 1 per pixel, and cookSDFFont must write a file which loads back as a plain GL_R8 texture.
+// -write writes the golden file again : only do it after checking the new field, for instance with tutorial 11.
+
+static const SDFFontOptions GoldenOptions = { 8, 1.5f, 1 };
+
+// The distance from the center of each pixel to the nearest pixel of the other side, minus half a pixel :
+// what signedDistanceField computes, the slow way
+static void bruteForceField(const std::vector<unsigned char> & coverage, unsigned int width, unsigned int height,
+	unsigned char threshold, std::vector<float> & out_distances){
+	out_distances.resize(coverage.size());
+	for (unsigned int y=0; y<height; y++){
+		for (unsigned int x=0; x<width; x++){
+			bool inside = coverage[y * width + x] >= threshold;
+			float nearest = 1e30f;
+			for (unsigned int j=0; j<height; j++){
+				for (unsigned int i=0; i<width; i++){
+					if ((coverage[j * width + i] >= threshold) == inside)
+						continue;
+					float dx = (float)i - (float)x, dy = (float)j - (float)y;
+					float d = dx*dx + dy*dy;
+					nearest = d < nearest ? d : nearest;
+				}
+			}
+			out_distances[y * width + x] = inside ? 0.5f - sqrtf(nearest) : sqrtf(nearest) - 0.5f;
+		}
+	}
+}
+
+// Random discs and scattered pixels : thin parts, holes and lone pixels
+static void makeBlobs(unsigned int width, unsigned int height, unsigned int seed, std::vector<unsigned char> & out_coverage){
+	out_coverage.assign((size_t)width * height, 0);
+	unsigned int random = seed;
+	for (int disc=0; disc<6; disc++){
+		random = random * 1664525u + 1013904223u;
+		float cx = (float)(random >> 8 & 0xFFFF) / 65536.0f * width;
+		random = random * 1664525u + 1013904223u;
+		float cy = (float)(random >> 8 & 0xFFFF) / 65536.0f * height;
+		random = random * 1664525u + 1013904223u;
+		float r = 1.0f + (float)(random >> 8 & 0xFFFF) / 65536.0f * width / 4;
+		unsigned char value = disc % 3 == 2 ? 0 : 255; // some discs cut holes in the others
+		for (unsigned int y=0; y<height; y++)
+			for (unsigned int x=0; x<width; x++)
+				if ((x - cx) * (x - cx) + (y - cy) * (y - cy) <= r * r)
+					out_coverage[y * width + x] = value;
+	}
+	for (int pixel=0; pixel<8; pixel++){
+		random = random * 1664525u + 1013904223u;
+		out_coverage[(random >> 8) % out_coverage.size()] = 200;
+	}
+}
+
+static void checkBruteForce(unsigned int width, unsigned int height, unsigned int seed){
+	std::vector<unsigned char> coverage;
+	makeBlobs(width, height, seed, coverage);
+	std::vector<float> expected;
+	bruteForceField(coverage, width, height, 128, expected);
+	for (unsigned int threadCount=1; threadCount<=4; threadCount+=3){
+		std::vector<float> distances(coverage.size());
+		signedDistanceField(&coverage[0], width, height, 128, &distances[0], threadCount);
+		float worst = 0.0f;
+		for (size_t i=0; i<distances.size(); i++){
+			// No pixel at all on the other side : only "far away" makes sense
+			float error = fabsf(expected[i]) > 1e9f ? (fabsf(distances[i]) > 1e9f ? 0.0f : 1.0f) : fabsf(distances[i] - expected[i]);
+			worst = error > worst ? error : worst;
+		}
+		if (!CHECK(worst < 1e-3f))
+			printf("  %ux%u, seed %u, %u threads : error %f\n", width, height, seed, threadCount, worst);
+	}
+}
+
+// Close to the exact distance to the circle, give or take the pixelation of its edge
+static void checkDisc(){
+	const unsigned int size = 64;
+	const float cx = 30.3f, cy = 33.6f, r = 17.2f;
+	std::vector<unsigned char> coverage(size * size);
+	for (unsigned int y=0; y<size; y++)
+		for (unsigned int x=0; x<size; x++)
+			coverage[y * size + x] = (x - cx) * (x - cx) + (y - cy) * (y - cy) <= r * r ? 255 : 0;
+	std::vector<float> distances(coverage.size());
+	signedDistanceField(&coverage[0], size, size, 128, &distances[0], 4);
+	float worst = 0.0f;
+	for (unsigned int y=0; y<size; y++){
+		for (unsigned int x=0; x<size; x++){
+			float exact = sqrtf((x - cx) * (x - cx) + (y - cy) * (y - cy)) - r;
+			float error = fabsf(distances[y * size + x] - exact);
+			worst = error > worst ? error : worst;
+		}
+	}
+	printf("disc : worst error %.3f pixels\n", worst);
+	CHECK(worst < 1.0f);
+}
+
+static bool writeGolden(const std::string & path, const TextureImage & image){
+	printf("writing %s\n", path.c_str());
+	return writeDDSImage(path.c_str(), image);
+}
+
+static void compareLevels(const TextureImage & a, const TextureImage & b, const char * what){
+	if (!CHECK(a.levelCount == b.levelCount && a.width == b.width && a.height == b.height))
+		return;
+	int maxDifference = 0;
+	for (unsigned int l=0; l<a.levelCount; l++){
+		const TextureLevel & la = getTextureLevel(a, 0, 0, l);
+		const TextureLevel & lb = getTextureLevel(b, 0, 0, l);
+		if (!CHECK(la.size == lb.size))
+			continue;
+		for (size_t i=0; i<la.size; i++){
+			int d = abs((int)la.data[i] - (int)lb.data[i]);
+			maxDifference = d > maxDifference ? d : maxDifference;
+		}
+	}
+	printf("%-24s : %ux%u, %u levels, max difference %d\n", what, a.width, a.height, a.levelCount, maxDifference);
+	CHECK(maxDifference <= 1);
+}
+
+static void checkFont(const char * fontpath, const std::string & directory, bool write){
+	TextureImage field;
+	if (!CHECK(buildSDFFont(fontpath, GoldenOptions, field)))
+		return;
+	CHECK(field.width == 16 * GoldenOptions.cellSize && field.internalFormat == GL_R8 && field.format == GL_RED && !field.isArray);
+
+	// The glyphs are shared between the threads, but computed the same way
+	SDFFontOptions threaded = GoldenOptions;
+	threaded.threadCount = 4;
+	TextureImage threadedField;
+	if (CHECK(buildSDFFont(fontpath, threaded, threadedField))){
+		CHECK(threadedField.pixels == field.pixels);
+		unloadTextureImage(threadedField);
+	}
+
+	// Some of each glyph inside, and its borders outside : the neighbours don't leak into it
+	const TextureLevel & level = getTextureLevel(field, 0, 0, 0);
+	unsigned int c = GoldenOptions.cellSize;
+	unsigned char insideA = 0, borderA = 0;
+	for (unsigned int y=0; y<c; y++){
+		for (unsigned int x=0; x<c; x++){
+			unsigned char value = level.data[(4 * c + y) * level.width + 1 * c + x]; // 'A' : 65 = 4 * 16 + 1
+			insideA = value > insideA ? value : insideA;
+			if (x == 0 || y == 0 || x == c-1 || y == c-1)
+				borderA = value > borderA ? value : borderA;
+		}
+	}
+	CHECK(insideA > 128 && borderA < 128);
+
+	std::string goldenPath = directory + "/sdf_holstein_8.dds";
+	if (write){
+		CHECK(writeGolden(goldenPath, field));
+	}else{
+		TextureImage golden;
+		if (CHECK(loadDDSImage(goldenPath.c_str(), golden))){
+			CHECK(golden.internalFormat == GL_R8 && !golden.isArray);
+			compareLevels(field, golden, goldenPath.c_str());
+			unloadTextureImage(golden);
+		}
+	}
+
+	// Cooked, then read back like initText2DSDF does : a 2D texture, not an array of 1 layer
+	const char * cookedPath = "distancefield_test.sdf.dds";
+	remove(cookedPath);
+	TextureImage cooked;
+	if (CHECK(cookSDFFont(fontpath, cookedPath, GoldenOptions)) && CHECK(loadDDSImage(cookedPath, cooked))){
+		CHECK(cooked.internalFormat == GL_R8 && cooked.format == GL_RED && cooked.layerCount == 1 && !cooked.isArray);
+		compareLevels(field, cooked, cookedPath);
+		unloadTextureImage(cooked);
+	}
+	remove(cookedPath);
+	unloadTextureImage(field);
+}
+
+int main(int argc, char * argv[]){
+	const char * fontpath = "tutorial11_2d_fonts/Holstein.DDS";
+	std::string directory = "tests/data";
+	bool write = false;
+	int position = 0;
+	for (int i=1; i<argc; i++){
+		if (strcmp(argv[i], "-write") == 0)
+			write = true;
+		else if (position++ == 0)
+			fontpath = argv[i];
+		else
+			directory = argv[i];
+	}
+
+	if (!write){
+		checkBruteForce(1, 1, 1);
+		checkBruteForce(17, 9, 2);
+		checkBruteForce(40, 40, 3);
+		checkBruteForce(23, 61, 4);
+		checkDisc();
+	}
+	checkFont(fontpath, directory, write);
+	return testResult();
+}
@@ -0,0 +1,59 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <vector>
+#include <chrono>
+
+#include <common/textureimage.hpp>
+#include <common/mipmapgenerator.hpp>
+
+#include "testing.hpp"
+
+// "mipmapgenerator_benchmark [size]" times generateMipmapChain on a size x size image (2048 by default)
+// with each filter, for colors (sRGB) and for normal maps, on 1 thread and on all of them.
+
+struct NamedOptions{
+	const char * name;
+	MipmapOptions options;
+};
+
+static const NamedOptions Options[] = {
+	{ "box, sRGB",            { MIPMAP_BOX,     true,  false, true, 1 } },
+	{ "Kaiser, sRGB",         { MIPMAP_KAISER,  true,  false, true, 1 } },
+	{ "Lanczos, sRGB",        { MIPMAP_LANCZOS, true,  false, true, 1 } },
+	{ "Kaiser, linear",       { MIPMAP_KAISER,  false, false, true, 1 } },
+	{ "Kaiser, normal map",   { MIPMAP_KAISER,  false, true,  true, 1 } },
+};
+
+int main(int argc, char * argv[]){
+	unsigned int size = argc > 1 ? (unsigned int)atoi(argv[1]) : 2048;
+	std::vector<unsigned char> rgba((size_t)size * size * 4);
+	unsigned int random = 12345;
+	for (size_t i=0; i<rgba.size(); i++){
+		random = random * 1664525u + 1013904223u;
+		rgba[i] = (unsigned char)(random >> 24);
+	}
+	double pixels = (double)size * size;
+	unsigned int levelCount = 1;
+	while (size >> levelCount)
+		levelCount++;
+	printf("%ux%u, %u levels\n", size, size, levelCount);
+
+	for (size_t o=0; o<sizeof(Options)/sizeof(Options[0]); o++){
+		double best[2] = { 1e30, 1e30 }; // [1 thread, all]
+		for (int run=0; run<3; run++){
+			for (int t=0; t<2; t++){
+				MipmapOptions options = Options[o].options;
+				options.threadCount = t == 0 ? 1 : 0;
+				std::vector<std::vector<unsigned char> > levels;
+				std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+				generateMipmapChain(&rgba[0], size, size, options, levels);
+				double milliseconds = millisecondsSince(start);
+				best[t] = milliseconds < best[t] ? milliseconds : best[t];
+				CHECK(levels.size() == levelCount && levels.back().size() == 4);
+			}
+		}
+		printf("%-20s : 1 thread %8.2f ms (%6.1f Mpixels/s), all threads %8.2f ms (%6.1f Mpixels/s)\n",
+			Options[o].name, best[0], pixels / (best[0] * 1000.0), best[1], pixels / (best[1] * 1000.0));
+	}
+	return testResult();
+}
@@ -0,0 +1,184 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <vector>
+#include <string>
+#include <chrono>
+
+#include <GL/glew.h>
+
+#include <common/textureimage.hpp>
+#include <common/mipmapgenerator.hpp>
+
+#include "testing.hpp"
+
+// "mipmapgenerator_test [data directory] [-write]" compares the mip chains of two generated 64x40 images
+// with the box, Kaiser and Lanczos filters, and the normal map chain, to the golden ones in tests/data/
+// (mipmap_*.dds, RGBA8 with all their levels). Each byte may differ by 1 at most, for the rounding of
+// other compilers and math libraries. -write writes the golden files again : only do it after checking
+// the new chains, since the test then compares the generator to itself.
+// Filtering a constant image must give the same constant, and the normals must stay normalized.
+
+struct GoldenChain{
+	const char * name;
+	MipmapOptions options;
+};
+
+static const GoldenChain Chains[] = {
+	{ "mipmap_box_srgb_wrap",       { MIPMAP_BOX,     true,  false, true,  1 } },
+	{ "mipmap_kaiser_srgb_wrap",    { MIPMAP_KAISER,  true,  false, true,  1 } },
+	{ "mipmap_lanczos_srgb_clamp",  { MIPMAP_LANCZOS, true,  false, false, 1 } },
+	{ "mipmap_kaiser_linear_clamp", { MIPMAP_KAISER,  false, false, false, 4 } },
+	{ "mipmap_kaiser_normalmap",    { MIPMAP_KAISER,  false, true,  true,  1 } },
+};
+
+static const unsigned int Width = 64, Height = 40; // 40 -> 20 -> 10 -> 5 -> 2 : an odd level too
+
+// Checkers, a gradient, rings and a varying alpha : sharp edges and smooth parts. Only integers,
+// so that it is the same everywhere.
+static void makeColorImage(std::vector<unsigned char> & rgba){
+	rgba.resize(Width * Height * 4);
+	for (unsigned int y=0; y<Height; y++){
+		for (unsigned int x=0; x<Width; x++){
+			unsigned char * p = &rgba[(y * Width + x) * 4];
+			int dx = (int)x - 32, dy = (int)y - 20;
+			p[0] = ((x / 8 + y / 8) % 2) ? 230 : 20;
+			p[1] = (unsigned char)(x * 255 / (Width - 1));
+			p[2] = (unsigned char)((dx * dx + dy * dy) % 97 * 2);
+			p[3] = (unsigned char)(y * 6 + (x % 3) * 10);
+		}
+	}
+}
+
+// Bumpy normals, mapped from [-1,1] to [0,255]. Divisions and square roots are exact in IEEE floats.
+static void makeNormalImage(std::vector<unsigned char> & rgba){
+	rgba.resize(Width * Height * 4);
+	for (unsigned int y=0; y<Height; y++){
+		for (unsigned int x=0; x<Width; x++){
+			float n[3] = { (float)((x * 37 + y * 11) % 61) - 30.0f, (float)((x * 13 + y * 29) % 53) - 26.0f, 60.0f };
+			float length = sqrtf(n[0]*n[0] + n[1]*n[1] + n[2]*n[2]);
+			unsigned char * p = &rgba[(y * Width + x) * 4];
+			for (int c=0; c<3; c++)
+				p[c] = (unsigned char)((n[c] / length + 1.0f) * 127.5f + 0.5f);
+			p[3] = 255;
+		}
+	}
+}
+
+static unsigned int levelWidth(unsigned int level)  { return Width  >> level ? Width  >> level : 1; }
+static unsigned int levelHeight(unsigned int level) { return Height >> level ? Height >> level : 1; }
+
+static bool writeGolden(const std::string & path, const std::vector<std::vector<unsigned char> > & levels){
+	TextureImage image;
+	memset(&image.file, 0, sizeof(image.file));
+	image.width = Width;
+	image.height = Height;
+	image.levelCount = (unsigned int)levels.size();
+	image.layerCount = 1;
+	image.faceCount = 1;
+	image.isArray = false;
+	image.compressed = false;
+	image.blockSize = 4;
+	image.internalFormat = GL_RGBA8;
+	image.format = GL_RGBA;
+	image.type = GL_UNSIGNED_BYTE;
+	image.generateMipmaps = false;
+	for (unsigned int l=0; l<image.levelCount; l++){
+		TextureLevel level = { &levels[l][0], levels[l].size(), levelWidth(l), levelHeight(l) };
+		image.levels.push_back(level);
+	}
+	return writeDDSImage(path.c_str(), image);
+}
+
+static void compareToGolden(const std::string & path, const std::vector<std::vector<unsigned char> > & levels){
+	TextureImage golden;
+	if (!CHECK(loadDDSImage(path.c_str(), golden)))
+		return;
+	CHECK(golden.width == Width && golden.height == Height && golden.internalFormat == GL_RGBA8 && golden.format == GL_RGBA);
+	if (CHECK(golden.levelCount == levels.size())){
+		int maxDifference = 0;
+		unsigned int different = 0;
+		for (unsigned int l=0; l<golden.levelCount; l++){
+			const TextureLevel & g = golden.levels[l];
+			if (!CHECK(g.size == levels[l].size()))
+				continue;
+			for (size_t i=0; i<g.size; i++){
+				int d = abs((int)g.data[i] - (int)levels[l][i]);
+				maxDifference = d > maxDifference ? d : maxDifference;
+				different += d ? 1 : 0;
+			}
+		}
+		printf("%-28s : %u levels, %u bytes different, max difference %d\n", path.c_str(), golden.levelCount, different, maxDifference);
+		CHECK(maxDifference <= 1);
+	}
+	unloadTextureImage(golden);
+}
+
+// A constant image stays the same constant, whatever the filter : its weights sum to 1
+static void checkConstant(const GoldenChain & chain){
+	unsigned char color[4] = { 200, 90, 17, 128 };
+	if (chain.options.normalMap){
+		color[0] = 128; color[1] = 128; color[2] = 255; color[3] = 255; // (0, 0, 1)
+	}
+	std::vector<unsigned char> rgba(Width * Height * 4);
+	for (size_t i=0; i<rgba.size(); i++)
+		rgba[i] = color[i % 4];
+	std::vector<std::vector<unsigned char> > levels;
+	generateMipmapChain(&rgba[0], Width, Height, chain.options, levels);
+	int maxDifference = 0;
+	for (size_t l=0; l<levels.size(); l++){
+		for (size_t i=0; i<levels[l].size(); i++){
+			int d = abs((int)levels[l][i] - (int)color[i % 4]);
+			maxDifference = d > maxDifference ? d : maxDifference;
+		}
+	}
+	CHECK(maxDifference <= 1);
+}
+
+static void checkNormalized(const std::vector<std::vector<unsigned char> > & levels){
+	float worst = 0.0f;
+	for (size_t l=0; l<levels.size(); l++){
+		for (size_t i=0; i<levels[l].size(); i+=4){
+			float n[3];
+			for (int c=0; c<3; c++)
+				n[c] = levels[l][i+c] / 127.5f - 1.0f;
+			float error = fabsf(sqrtf(n[0]*n[0] + n[1]*n[1] + n[2]*n[2]) - 1.0f);
+			worst = error > worst ? error : worst;
+		}
+	}
+	printf("  worst normal length error : %.4f\n", worst);
+	CHECK(worst < 0.015f); // 8-bit rounding of each coordinate
+}
+
+int main(int argc, char * argv[]){
+	std::string directory = "tests/data";
+	bool write = false;
+	for (int i=1; i<argc; i++){
+		if (strcmp(argv[i], "-write") == 0)
+			write = true;
+		else
+			directory = argv[i];
+	}
+
+	std::vector<unsigned char> color, normals;
+	makeColorImage(color);
+	makeNormalImage(normals);
+
+	for (size_t c=0; c<sizeof(Chains)/sizeof(Chains[0]); c++){
+		const GoldenChain & chain = Chains[c];
+		std::vector<std::vector<unsigned char> > levels;
+		generateMipmapChain(chain.options.normalMap ? &normals[0] : &color[0], Width, Height, chain.options, levels);
+		std::string path = directory + "/" + chain.name + ".dds";
+		if (write){
+			printf("writing %s\n", path.c_str());
+			CHECK(writeGolden(path, levels));
+		}else{
+			compareToGolden(path, levels);
+		}
+		checkConstant(chain);
+		if (chain.options.normalMap)
+			checkNormalized(levels);
+	}
+	return testResult();
+}
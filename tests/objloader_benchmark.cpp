@@ -0,0 +1,60 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+#include <chrono>
+
+#include <glm/glm.hpp>
+
+#include <common/objloader.hpp>
+
+#include "testing.hpp"
+
+// "objloader_benchmark [triangles]" writes a synthetic OBJ file of about 'triangles' triangles
+// (a bumpy grid, 2 million triangles by default), and times loadOBJ and loadOBJ_fast on it.
+// Both must give exactly the same arrays.
+
+struct OBJArrays{
+	std::vector<glm::vec3> vertices;
+	std::vector<glm::vec2> uvs;
+	std::vector<glm::vec3> normals;
+};
+
+static bool sameArrays(const OBJArrays & a, const OBJArrays & b){
+	return a.vertices.size() == b.vertices.size() && a.uvs.size() == b.uvs.size() && a.normals.size() == b.normals.size() &&
+		!a.vertices.empty() &&
+		memcmp(&a.vertices[0], &b.vertices[0], a.vertices.size() * sizeof(glm::vec3)) == 0 &&
+		memcmp(&a.uvs[0],      &b.uvs[0],      a.uvs.size()      * sizeof(glm::vec2)) == 0 &&
+		memcmp(&a.normals[0],  &b.normals[0],  a.normals.size()  * sizeof(glm::vec3)) == 0;
+}
+
+int main(int argc, char * argv[]){
+	unsigned int triangles = argc > 1 ? (unsigned int)atoi(argv[1]) : 2000000;
+	unsigned int cells = gridCells(triangles);
+
+	const char * path = "objloader_benchmark.obj";
+	if (!CHECK(writeGridOBJ(path, cells)))
+		return testResult();
+
+	std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+	OBJArrays reference;
+	CHECK(loadOBJ(path, reference.vertices, reference.uvs, reference.normals));
+	double referenceTime = millisecondsSince(start);
+	CHECK(reference.vertices.size() == 6 * (size_t)cells * cells);
+
+	printf("%u triangles\n", 2 * cells * cells);
+	printf("loadOBJ                   : %8.1f ms\n", referenceTime);
+	const unsigned int threadCounts[3] = { 1, 4, 0 };
+	const char * threadNames[3] = { "1 thread ", "4 threads", "all cores" };
+	for (int t=0; t<3; t++){
+		start = std::chrono::high_resolution_clock::now();
+		OBJArrays fast;
+		CHECK(loadOBJ_fast(path, fast.vertices, fast.uvs, fast.normals, threadCounts[t]));
+		double fastTime = millisecondsSince(start);
+		CHECK(sameArrays(reference, fast));
+		printf("loadOBJ_fast, %s : %8.1f ms, %5.1fx faster\n", threadNames[t], fastTime, referenceTime / fastTime);
+	}
+
+	remove(path);
+	return testResult();
+}
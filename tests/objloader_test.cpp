@@ -0,0 +1,133 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+#include <chrono>
+
+#include <glm/glm.hpp>
+
+#include <common/objloader.hpp>
+
+#include "testing.hpp"
+
+// Checks that loadOBJ_fast gives byte-identical arrays with any number of threads, on a file big enough
+// to be split in many chunks (1 MB each at least), whose faces mix all the corner formats, polygons,
+// absolute indices, and negative indices which point far back, into the previous chunks.
+// The arrays must also be what the file describes.
+
+static unsigned int RandomState = 12345;
+static unsigned int nextRandom(){
+	RandomState = RandomState * 1664525u + 1013904223u;
+	return RandomState >> 8;
+}
+
+// Multiples of 1/8 : printed with 3 decimals, they are read back exactly
+static float randomCoordinate(){
+	return ((int)(nextRandom() % 20000) - 10000) / 8.0f;
+}
+
+struct OBJArrays{
+	std::vector<glm::vec3> vertices;
+	std::vector<glm::vec2> uvs;
+	std::vector<glm::vec3> normals;
+};
+
+// 1-based absolute index, or negative relative index, of one of the 'count' first elements
+static int randomReference(unsigned int count, unsigned int & out_index){
+	unsigned int back = nextRandom() % (nextRandom() % 4 == 0 ? count : (count < 64 ? count : 64u)); // mostly close, sometimes far
+	out_index = count - 1 - back;
+	return nextRandom() % 2 ? -(int)(back + 1) : (int)out_index + 1;
+}
+
+static bool writeTestOBJ(const char * path, size_t minBytes, OBJArrays & expected){
+	FILE * file = fopen(path, "wb");
+	if (file == NULL)
+		return false;
+	std::vector<glm::vec3> vertices, normals;
+	std::vector<glm::vec2> uvs;
+	long written = 0;
+	while ((size_t)written < minBytes){
+		// A few new vertices, then a face which uses them, and older ones
+		for (int k=0; k<3; k++){
+			glm::vec3 v(randomCoordinate(), randomCoordinate(), randomCoordinate());
+			glm::vec2 uv(randomCoordinate(), randomCoordinate());
+			glm::vec3 n(randomCoordinate(), randomCoordinate(), randomCoordinate());
+			fprintf(file, "v %.3f %.3f %.3f\nvt %.3f %.3f\nvn %.3f %.3f %.3f\n", v.x, v.y, v.z, uv.x, uv.y, n.x, n.y, n.z);
+			vertices.push_back(v);
+			uvs.push_back(glm::vec2(uv.x, -uv.y)); // like loadOBJ
+			normals.push_back(n);
+		}
+		if (nextRandom() % 16 == 0)
+			fprintf(file, "# comment\ng group%u\n", nextRandom() % 100);
+
+		unsigned int cornerCount = 3 + nextRandom() % 4;
+		unsigned int format = nextRandom() % 4; // v, v/vt, v//vn, v/vt/vn
+		glm::vec3 polygonVertices[6], polygonNormals[6];
+		glm::vec2 polygonUVs[6];
+		fprintf(file, "f");
+		for (unsigned int c=0; c<cornerCount; c++){
+			unsigned int v, vt, vn;
+			int rv = randomReference((unsigned int)vertices.size(), v);
+			int rt = randomReference((unsigned int)uvs.size(), vt);
+			int rn = randomReference((unsigned int)normals.size(), vn);
+			polygonVertices[c] = vertices[v];
+			polygonUVs[c]      = (format & 1) ? uvs[vt] : glm::vec2(0.0f);
+			polygonNormals[c]  = (format & 2) ? normals[vn] : glm::vec3(0.0f);
+			if (format == 0) fprintf(file, " %d", rv);
+			if (format == 1) fprintf(file, " %d/%d", rv, rt);
+			if (format == 2) fprintf(file, " %d//%d", rv, rn);
+			if (format == 3) fprintf(file, " %d/%d/%d", rv, rt, rn);
+		}
+		fprintf(file, "\n");
+		// Triangulated as a fan
+		for (unsigned int c=2; c<cornerCount; c++){
+			unsigned int corners[3] = { 0, c-1, c };
+			for (int k=0; k<3; k++){
+				expected.vertices.push_back(polygonVertices[corners[k]]);
+				expected.uvs     .push_back(polygonUVs     [corners[k]]);
+				expected.normals .push_back(polygonNormals [corners[k]]);
+			}
+		}
+		written = ftell(file);
+	}
+	return fclose(file) == 0;
+}
+
+static bool sameArrays(const OBJArrays & a, const OBJArrays & b){
+	return a.vertices.size() == b.vertices.size() && a.uvs.size() == b.uvs.size() && a.normals.size() == b.normals.size() &&
+		!a.vertices.empty() &&
+		memcmp(&a.vertices[0], &b.vertices[0], a.vertices.size() * sizeof(glm::vec3)) == 0 &&
+		memcmp(&a.uvs[0],      &b.uvs[0],      a.uvs.size()      * sizeof(glm::vec2)) == 0 &&
+		memcmp(&a.normals[0],  &b.normals[0],  a.normals.size()  * sizeof(glm::vec3)) == 0;
+}
+
+int main(){
+	const char * path = "objloader_test.obj";
+	OBJArrays expected;
+	if (!CHECK(writeTestOBJ(path, 12 << 20, expected)))
+		return testResult();
+	printf("%u triangles\n", (unsigned int)(expected.vertices.size() / 3));
+
+	OBJArrays serial;
+	CHECK(loadOBJ_fast(path, serial.vertices, serial.uvs, serial.normals, 1));
+	CHECK(sameArrays(serial, expected));
+
+	// 12 MB : up to 12 chunks. 5 and 7 put the boundaries at odd places.
+	const unsigned int threadCounts[] = { 2, 3, 5, 7, 12, 0 };
+	for (size_t t=0; t<sizeof(threadCounts)/sizeof(threadCounts[0]); t++){
+		std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+		OBJArrays parallel;
+		CHECK(loadOBJ_fast(path, parallel.vertices, parallel.uvs, parallel.normals, threadCounts[t]));
+		printf("%2u threads : %6.1f ms\n", threadCounts[t], millisecondsSince(start));
+		CHECK(sameArrays(serial, parallel));
+	}
+
+	// The arrays are appended to what the vectors already contain
+	OBJArrays twice = serial;
+	CHECK(loadOBJ_fast(path, twice.vertices, twice.uvs, twice.normals, 4));
+	CHECK(twice.vertices.size() == 2 * serial.vertices.size() &&
+		memcmp(&twice.vertices[serial.vertices.size()], &serial.vertices[0], serial.vertices.size() * sizeof(glm::vec3)) == 0);
+
+	remove(path);
+	return testResult();
+}
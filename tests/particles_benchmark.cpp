@@ -0,0 +1,620 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <vector>
+#include <algorithm>
+#include <chrono>
+
+#include <glm/glm.hpp>
+#include <glm/gtx/norm.hpp>
+
+#include <common/particlesystem.hpp>
+#include <common/particleeffect.hpp>
+#include <common/jobpool.hpp>
+
+#include "testing.hpp"
+
+// "particles_benchmark [particles]" compares ParticleSystem with the loop tutorial18_particles used to have,
+// and the ways to sort the particles, checks ParticleSystem with bursts of particles, and checks that
+// ParticleEffect gives the same particles on any number of threads. 100000 particles by default, like
+// the tutorial; the bigger runs are scaled with it. Doesn't use OpenGL.
+
+// The CPU representation of a particle in tutorial18_particles, before ParticleSystem
+struct ReferenceParticle{
+	glm::vec3 pos, speed;
+	unsigned char r,g,b,a; // Color
+	float size, angle, weight;
+	float life; // Remaining life of the particle. if <0 : dead and unused.
+	float cameradistance; // *Squared* distance to the camera. if dead : -1.0f
+
+	bool operator<(const ReferenceParticle& that) const {
+		// Sort in reverse order : far particles drawn first.
+		return this->cameradistance > that.cameradistance;
+	}
+};
+
+// The "Simulate all particles" loop of tutorial18_particles
+static int simulateReferenceParticles(std::vector<ReferenceParticle> & particles, double delta, const glm::vec3 & CameraPosition,
+	float * g_particule_position_size_data, unsigned char * g_particule_color_data
+){
+	int ParticlesCount = 0;
+	for(size_t i=0; i<particles.size(); i++){
+
+		ReferenceParticle& p = particles[i]; // shortcut
+
+		if(p.life > 0.0f){
+
+			// Decrease life
+			p.life -= delta;
+			if (p.life > 0.0f){
+
+				// Simulate simple physics : gravity only, no collisions
+				p.speed += glm::vec3(0.0f,-9.81f, 0.0f) * (float)delta * 0.5f;
+				p.pos += p.speed * (float)delta;
+				p.cameradistance = glm::length2( p.pos - CameraPosition );
+
+				// Fill the GPU buffer
+				g_particule_position_size_data[4*ParticlesCount+0] = p.pos.x;
+				g_particule_position_size_data[4*ParticlesCount+1] = p.pos.y;
+				g_particule_position_size_data[4*ParticlesCount+2] = p.pos.z;
+				g_particule_position_size_data[4*ParticlesCount+3] = p.size;
+
+				g_particule_color_data[4*ParticlesCount+0] = p.r;
+				g_particule_color_data[4*ParticlesCount+1] = p.g;
+				g_particule_color_data[4*ParticlesCount+2] = p.b;
+				g_particule_color_data[4*ParticlesCount+3] = p.a;
+
+			}else{
+				// Particles that just died will be put at the end of the buffer in SortParticles();
+				p.cameradistance = -1.0f;
+			}
+
+			ParticlesCount++;
+
+		}
+	}
+	return ParticlesCount;
+}
+
+// A ParticleSystem with the same particles. Their color is their index in 'particles', to find them back.
+static void spawnReferenceParticles(ParticleSystem & system, const std::vector<ReferenceParticle> & particles){
+	initParticleSystem(system, (unsigned int)particles.size());
+	for (unsigned int i=0; i<particles.size(); i++){
+		const ReferenceParticle & p = particles[i];
+		unsigned char color[4];
+		memcpy(color, &i, 4);
+		spawnParticle(system, p.pos, p.speed, p.life, p.size, color);
+	}
+}
+
+// Runs 'frames' frames of the loop of tutorial18_particles (one struct per particle) and of
+// ParticleSystem on 'count' live particles, checks that they give the same positions, and prints
+// the time per frame of each step. Returns false if the positions differ.
+static bool compareParticleUpdate(unsigned int count, unsigned int frames){
+	const float delta = 0.016f;
+	const glm::vec3 cameraPosition(0.0f, 0.0f, 5.0f);
+
+	// Particles like those of tutorial18_particles, at various ages
+	std::vector<ReferenceParticle> initial(count);
+	for (unsigned int i=0; i<count; i++){
+		ReferenceParticle & p = initial[i];
+		p.pos = glm::vec3(0.0f, 0.0f, -20.0f);
+		p.speed = glm::vec3(0.0f, 10.0f, 0.0f) + glm::vec3(
+			(rand()%2000 - 1000.0f)/1000.0f,
+			(rand()%2000 - 1000.0f)/1000.0f,
+			(rand()%2000 - 1000.0f)/1000.0f
+		) * 1.5f;
+		p.r = rand() % 256;
+		p.g = rand() % 256;
+		p.b = rand() % 256;
+		p.a = (rand() % 256) / 3;
+		p.size = (rand()%1000)/2000.0f + 0.1f;
+		p.angle = p.weight = 0.0f;
+		p.life = (rand()%1000)/200.0f + 0.01f;
+		p.cameradistance = -1.0f;
+	}
+
+	std::vector<float> positionSize(4 * count);
+	std::vector<unsigned char> colors(4 * count);
+
+	// Same positions ? The reference isn't sorted here, so that its particles stay where they are
+	std::vector<ReferenceParticle> reference = initial;
+	ParticleSystem system;
+	spawnReferenceParticles(system, initial);
+	for (unsigned int f=0; f<frames; f++){
+		simulateReferenceParticles(reference, delta, cameraPosition, positionSize.data(), colors.data());
+		updateParticles(system, delta, cameraPosition);
+	}
+	float difference = 0.0f;
+	unsigned int mismatches = 0;
+	for (unsigned int i=0; i<count; i++)
+		if (reference[i].life > 0.0f)
+			mismatches++;
+	for (unsigned int k=0; k<system.aliveCount; k++){
+		const ReferenceParticle & p = reference[system.color[k]];
+		if (p.life > 0.0f){
+			mismatches--;
+			glm::vec3 position(system.positionX[k], system.positionY[k], system.positionZ[k]);
+			difference = std::max(difference, glm::length(position - p.pos));
+		}else{
+			mismatches++;
+		}
+	}
+
+	// Times. The reference sorts all the slots, like SortParticles
+	double referenceSimulate = 0.0, referenceSort = 0.0;
+	unsigned int referenceCount = 0;
+	reference = initial;
+	for (unsigned int f=0; f<frames; f++){
+		std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+		referenceCount = simulateReferenceParticles(reference, delta, cameraPosition, positionSize.data(), colors.data());
+		referenceSimulate += millisecondsSince(start);
+		start = std::chrono::high_resolution_clock::now();
+		std::sort(reference.begin(), reference.end());
+		referenceSort += millisecondsSince(start);
+	}
+
+	double simulate = 0.0, sort = 0.0, write = 0.0;
+	unsigned int systemCount = 0;
+	spawnReferenceParticles(system, initial);
+	for (unsigned int f=0; f<frames; f++){
+		std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+		updateParticles(system, delta, cameraPosition);
+		simulate += millisecondsSince(start);
+		start = std::chrono::high_resolution_clock::now();
+		sortParticles(system);
+		sort += millisecondsSince(start);
+		start = std::chrono::high_resolution_clock::now();
+		systemCount = writeParticleVertices(system, positionSize.data(), colors.data());
+		write += millisecondsSince(start);
+	}
+
+	// The tutorial also counts the particles which die during the frame
+	printf("%u particles, %u frames : %u alive at the end (tutorial : %u drawn), %u life mismatches, max position difference %g\n",
+		count, frames, systemCount, referenceCount, mismatches, difference);
+	printf("tutorial loop  : simulate + fill %8.3f ms   sort %8.3f ms                     total %8.3f ms per frame\n",
+		referenceSimulate / frames, referenceSort / frames, (referenceSimulate + referenceSort) / frames);
+	printf("ParticleSystem : simulate        %8.3f ms   sort %8.3f ms   write %8.3f ms   total %8.3f ms per frame\n",
+		simulate / frames, sort / frames, write / frames, (simulate + sort + write) / frames);
+	return mismatches == 0 && difference < 1e-3f;
+}
+
+
+
+// FindUnusedParticle of tutorial18_particles
+static int findUnusedReferenceParticle(std::vector<ReferenceParticle> & particles, int & LastUsedParticle){
+
+	for(size_t i=LastUsedParticle; i<particles.size(); i++){
+		if (particles[i].life < 0){
+			LastUsedParticle = (int)i;
+			return (int)i;
+		}
+	}
+
+	for(int i=0; i<LastUsedParticle; i++){
+		if (particles[i].life < 0){
+			LastUsedParticle = i;
+			return i;
+		}
+	}
+
+	return 0; // All particles are taken, override the first one
+}
+
+// The same sequence for a given seed, on all platforms
+static unsigned int nextStressRandom(unsigned int & state){
+	state = state * 1664525u + 1013904223u;
+	return state >> 8;
+}
+
+static void randomStressParticle(unsigned int & state, glm::vec3 & speed, float & life){
+	speed = glm::vec3(0.0f, 10.0f, 0.0f) + glm::vec3(
+		(nextStressRandom(state)%2000 - 1000.0f)/1000.0f,
+		(nextStressRandom(state)%2000 - 1000.0f)/1000.0f,
+		(nextStressRandom(state)%2000 - 1000.0f)/1000.0f
+	) * 1.5f;
+	life = 0.02f + (nextStressRandom(state)%1000)/1000.0f;
+}
+
+// A particle which the stress test expects to be alive
+struct StressParticle{
+	unsigned int id;
+	float life;
+};
+
+static bool deadStressParticle(const StressParticle & p){
+	return p.life <= 0.0f;
+}
+
+static bool lessStressId(const StressParticle & a, const StressParticle & b){
+	return a.id < b.id;
+}
+
+// Emits particles in bursts (some bigger than the room left), and checks after each frame that exactly
+// the expected particles are alive, once each. Also runs the same emissions through the loop of
+// tutorial18_particles, which scans for dead particles and updates all of them, and prints the time
+// per frame of both. Returns false if a check failed.
+static bool stressParticleSystem(unsigned int capacity, unsigned int frames, unsigned int seed){
+	const float delta = 0.016f;
+	const glm::vec3 origin(0.0f, 0.0f, -20.0f);
+	const glm::vec3 cameraPosition(0.0f, 0.0f, 5.0f);
+
+	// Mostly a trickle, sometimes a burst, and sometimes more than the whole pool.
+	// The particles live 1 s at most : the pool is full after the biggest bursts, and almost empty between them.
+	std::vector<unsigned int> emissions(frames);
+	unsigned int state = seed;
+	for (unsigned int f=0; f<frames; f++){
+		unsigned int kind = nextStressRandom(state) % 64;
+		if (kind == 0)
+			emissions[f] = capacity + nextStressRandom(state) % (capacity + 1);
+		else if (kind < 5)
+			emissions[f] = nextStressRandom(state) % (capacity/4 + 1);
+		else
+			emissions[f] = nextStressRandom(state) % (capacity/1000 + 1);
+	}
+	unsigned int particleSeed = state;
+
+	std::vector<float> positionSize(4 * capacity);
+	std::vector<unsigned char> colors(4 * capacity);
+
+	// Checked run. The ids of the particles are in their color.
+	ParticleSystem system;
+	initParticleSystem(system, capacity);
+	std::vector<StressParticle> expected; // by id
+	std::vector<unsigned int> ids;
+	unsigned int nextId = 0, dropped = 0, mostAlive = 0;
+	bool ok = true;
+	state = particleSeed;
+	for (unsigned int f=0; f<frames && ok; f++){
+		for (unsigned int e=0; e<emissions[f]; e++){
+			glm::vec3 speed;
+			float life;
+			randomStressParticle(state, speed, life);
+			unsigned int id = nextId++;
+			unsigned char color[4];
+			memcpy(color, &id, 4);
+			unsigned int index = spawnParticle(system, origin, speed, life, 0.1f, color);
+			if (expected.size() < capacity){
+				StressParticle p = { id, life };
+				expected.push_back(p);
+				if (index >= capacity){
+					printf("stressParticleSystem : frame %u, particle %u wasn't spawned\n", f, id);
+					ok = false;
+				}
+			}else{
+				dropped++;
+				if (index != capacity){
+					printf("stressParticleSystem : frame %u, particle %u was spawned in a full pool\n", f, id);
+					ok = false;
+				}
+			}
+		}
+		mostAlive = std::max(mostAlive, system.aliveCount);
+
+		updateParticles(system, delta, cameraPosition);
+		sortParticles(system);
+		for (size_t k=0; k<expected.size(); k++)
+			expected[k].life -= delta;
+		expected.erase(std::remove_if(expected.begin(), expected.end(), deadStressParticle), expected.end());
+
+		// The same ids, once each, with the same life
+		if (system.aliveCount != expected.size()){
+			printf("stressParticleSystem : frame %u, %u particles alive instead of %u\n", f, system.aliveCount, (unsigned int)expected.size());
+			ok = false;
+			break;
+		}
+		ids.assign(system.color.begin(), system.color.begin() + system.aliveCount);
+		std::sort(ids.begin(), ids.end());
+		for (size_t k=0; k<ids.size() && ok; k++){
+			if (ids[k] != expected[k].id){
+				printf("stressParticleSystem : frame %u, particle %u is alive instead of %u\n", f, ids[k], expected[k].id);
+				ok = false;
+			}
+		}
+		for (unsigned int k=0; k<system.aliveCount && ok; k++){
+			unsigned int id = system.color[k];
+			StressParticle key = { id, 0.0f };
+			const StressParticle & p = *std::lower_bound(expected.begin(), expected.end(), key, lessStressId);
+			if (system.life[k] != p.life){
+				printf("stressParticleSystem : frame %u, particle %u has %f seconds left instead of %f\n", f, id, system.life[k], p.life);
+				ok = false;
+			}
+		}
+	}
+	if (ok && system.droppedCount != dropped){
+		printf("stressParticleSystem : %u particles dropped instead of %u\n", system.droppedCount, dropped);
+		ok = false;
+	}
+
+	// Timed runs, with the same emissions
+	double spawn = 0.0, update = 0.0, sort = 0.0;
+	initParticleSystem(system, capacity);
+	state = particleSeed;
+	for (unsigned int f=0; f<frames; f++){
+		std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+		for (unsigned int e=0; e<emissions[f]; e++){
+			glm::vec3 speed;
+			float life;
+			randomStressParticle(state, speed, life);
+			unsigned char color[4] = { 255, 255, 255, 85 };
+			spawnParticle(system, origin, speed, life, 0.1f, color);
+		}
+		spawn += millisecondsSince(start);
+		start = std::chrono::high_resolution_clock::now();
+		updateParticles(system, delta, cameraPosition);
+		writeParticleVertices(system, positionSize.data(), colors.data());
+		update += millisecondsSince(start);
+		start = std::chrono::high_resolution_clock::now();
+		sortParticles(system);
+		sort += millisecondsSince(start);
+	}
+
+	double referenceSpawn = 0.0, referenceUpdate = 0.0, referenceSort = 0.0;
+	std::vector<ReferenceParticle> reference(capacity);
+	for (unsigned int i=0; i<capacity; i++){
+		reference[i].life = -1.0f;
+		reference[i].cameradistance = -1.0f;
+	}
+	int LastUsedParticle = 0;
+	state = particleSeed;
+	for (unsigned int f=0; f<frames; f++){
+		// Once the particles are all alive, FindUnusedParticle scans all of them for each new one,
+		// and replaces particle 0 : the bursts would take minutes. Only spawn those which have room.
+		unsigned int unused = 0;
+		for (unsigned int i=0; i<capacity; i++)
+			if (reference[i].life < 0)
+				unused++;
+
+		std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+		for (unsigned int e=0; e<emissions[f]; e++){
+			glm::vec3 speed;
+			float life;
+			randomStressParticle(state, speed, life);
+			if (e >= unused)
+				continue;
+			ReferenceParticle & p = reference[findUnusedReferenceParticle(reference, LastUsedParticle)];
+			p.speed = speed;
+			p.life = life;
+			p.pos = origin;
+			p.r = p.g = p.b = 255;
+			p.a = 85;
+			p.size = 0.1f;
+		}
+		referenceSpawn += millisecondsSince(start);
+		start = std::chrono::high_resolution_clock::now();
+		simulateReferenceParticles(reference, delta, cameraPosition, positionSize.data(), colors.data());
+		referenceUpdate += millisecondsSince(start);
+		start = std::chrono::high_resolution_clock::now();
+		std::sort(reference.begin(), reference.end());
+		referenceSort += millisecondsSince(start);
+	}
+
+	printf("%u particles, %u frames, seed %u : %u spawned, %u dropped, at most %u alive : %s\n",
+		capacity, frames, seed, nextId, dropped, mostAlive, ok ? "OK" : "FAILED");
+	printf("tutorial loop  : spawn %8.3f ms   simulate + fill %8.3f ms   sort %8.3f ms per frame\n",
+		referenceSpawn / frames, referenceUpdate / frames, referenceSort / frames);
+	printf("ParticleSystem : spawn %8.3f ms   simulate + fill %8.3f ms   sort %8.3f ms per frame\n",
+		spawn / frames, update / frames, sort / frames);
+	return ok;
+}
+
+
+
+// A particle of the scenes of compareParticleSorts, 'age' seconds after it was spawned.
+// The fountain of tutorial18_particles, or dust drifting slowly in a 200 x 50 x 200 box around it
+static void spawnSortSceneParticle(ParticleSystem & system, bool dust, unsigned int & state, float maxLife, float age){
+	const glm::vec3 origin(0.0f, 0.0f, -20.0f);
+	const unsigned char white[4] = { 255, 255, 255, 85 };
+	glm::vec3 speed;
+	float life;
+	randomStressParticle(state, speed, life);
+	glm::vec3 position = origin;
+	if (dust){
+		speed = (speed - glm::vec3(0.0f, 10.0f, 0.0f)) * 0.05f;
+		position += glm::vec3(
+			(nextStressRandom(state)%20000 - 10000.0f)/100.0f,
+			(nextStressRandom(state)%20000 - 10000.0f)/400.0f,
+			(nextStressRandom(state)%20000 - 10000.0f)/100.0f
+		);
+	}
+	position += speed * age + system.gravity * (0.5f * age * age);
+	spawnParticle(system, position, speed + system.gravity * age, maxLife - age, 0.1f, white);
+}
+
+// Runs 'frames' frames of 'count' particles, in two scenes : the fountain of tutorial18_particles seen by a camera
+// turning around it, whose order changes a lot, and slowly drifting dust, whose order hardly changes. With each
+// ParticleSort, and the radix sort on a JobPool too, checks that the particles are sorted after each frame, and prints
+// the time per frame of sortParticles. Returns false if they weren't, or if the JobPool changed the order of the radix sort.
+static bool compareParticleSorts(unsigned int count, unsigned int frames){
+	const float delta = 0.016f;
+	const float maxLife = 5.0f;
+	const glm::vec3 origin(0.0f, 0.0f, -20.0f);
+	const ParticleSort sorts[4] = { PARTICLE_SORT_STD, PARTICLE_SORT_RADIX, PARTICLE_SORT_RADIX, PARTICLE_SORT_INCREMENTAL };
+	const char * names[4] = { "std::sort  ", "radix      ", "radix, pool", "incremental" };
+	JobPool * pool = createJobPool(3); // 4 slices from 65536 particles, even on fewer cores
+	bool ok = true;
+
+	for (int scene=0; scene<2; scene++){
+		bool dust = (scene == 1);
+		// The scene has been running for maxLife seconds : the particles are of all ages,
+		// and as many are spawned each frame as die
+		ParticleSystem initial;
+		initParticleSystem(initial, count);
+		if (dust)
+			initial.gravity = glm::vec3(0.0f);
+		unsigned int state = 1;
+		for (unsigned int i=0; i<count; i++)
+			spawnSortSceneParticle(initial, dust, state, maxLife, (i + 0.5f) / count * maxLife);
+
+		if (dust)
+			printf("%u particles, %u frames, dust and a still camera :\n", count, frames);
+		else
+			printf("%u particles, %u frames, fountain and a camera turning around it :\n", count, frames);
+		ParticleSystem radixSorted;
+		for (int s=0; s<4; s++){
+			ParticleSystem system = initial;
+			system.sortMode = sorts[s];
+			if (s == 2)
+				system.pool = pool;
+			state = 2;
+			float spawnDebt = 0.0f;
+			double sort = 0.0;
+			unsigned int unsortedFrames = 0;
+			for (unsigned int f=0; f<frames; f++){
+				for (spawnDebt += count * delta / maxLife; spawnDebt >= 1.0f; spawnDebt -= 1.0f)
+					spawnSortSceneParticle(system, dust, state, maxLife, 0.0f);
+				// 25 units away from the fountain, a quarter turn per 3 seconds
+				float angle = dust ? 0.0f : f * delta * 0.5f;
+				updateParticles(system, delta, origin + glm::vec3(25.0f * sinf(angle), 2.0f, 25.0f * cosf(angle)));
+
+				std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+				sortParticles(system);
+				sort += millisecondsSince(start);
+
+				for (unsigned int k=1; k<system.aliveCount; k++){
+					if (system.cameraDistance[k-1] < system.cameraDistance[k]){
+						unsortedFrames++;
+						break;
+					}
+				}
+			}
+			printf("  %s : sortParticles %8.3f ms per frame, %u alive at the end, %u unsorted frames",
+				names[s], sort / frames, system.aliveCount, unsortedFrames);
+			if (sorts[s] == PARTICLE_SORT_INCREMENTAL)
+				printf(", %u fallbacks to the radix sort", system.sortFallbacks);
+			printf("\n");
+			ok = ok && unsortedFrames == 0;
+
+			// Stable on the same keys : the slices of the pool must give exactly the same order
+			if (s == 1)
+				radixSorted = system;
+			if (s == 2 && (system.positionX != radixSorted.positionX || system.positionZ != radixSorted.positionZ)){
+				printf("  the radix sort on %u threads gives a different order\n", jobPoolThreadCount(pool) + 1);
+				ok = false;
+			}
+		}
+	}
+	destroyJobPool(pool);
+	return ok;
+}
+
+
+
+// Fountains like the one of tutorial18_particles, in rows of 8, which live 1 second
+static void addFountains(ParticleEffect & effect, unsigned int emitterCount, unsigned int particlesPerEmitter){
+	for (unsigned int e=0; e<emitterCount; e++){
+		ParticleEmitterSettings settings;
+		settings.position = glm::vec3((e % 8) * 4.0f - 14.0f, 0.0f, -20.0f - (e / 8) * 4.0f);
+		settings.direction = glm::vec3(0.0f, 10.0f, 0.0f);
+		settings.spread = 1.5f;
+		settings.particlesPerSecond = (float)particlesPerEmitter;
+		settings.life = 1.0f;
+		settings.minSize = 0.1f;
+		settings.maxSize = 0.6f;
+		settings.capacity = particlesPerEmitter;
+		addParticleEmitter(effect, settings);
+	}
+}
+
+static glm::vec3 compareCameraPosition(unsigned int frame){
+	float angle = frame * 0.016f * 0.5f;
+	return glm::vec3(30.0f * sinf(angle), 5.0f, -30.0f + 30.0f * cosf(angle));
+}
+
+static bool sameParticleVertices(unsigned int countA, const float * positionSizeA, const unsigned char * colorA,
+	unsigned int countB, const float * positionSizeB, const unsigned char * colorB){
+	return countA == countB && (countA == 0 || (
+		memcmp(positionSizeA, positionSizeB, countA * 4 * sizeof(float)) == 0 &&
+		memcmp(colorA, colorB, countA * 4) == 0));
+}
+
+// Runs 'frames' frames of 'emitterCount' emitters of 'particlesPerEmitter' particles each, on the calling thread
+// and on a JobPool of 'threadCount' threads (0 = one per core), and checks that the vertices are exactly the same.
+// Prints the time per frame of both, and how long the calling thread waits when it has as much work of its own
+// (the drawing) as the simulation. Returns false if the vertices differ.
+static bool compareParticleEffectThreads(unsigned int emitterCount, unsigned int particlesPerEmitter, unsigned int frames,
+	unsigned int threadCount, unsigned int seed){
+	const float delta = 0.016f;
+	const unsigned int warmupFrames = 63; // until the first particles die : then as many are spawned as die
+
+	JobPool * pool = createJobPool(threadCount);
+	ParticleEffect sequential, threaded, ahead;
+	initParticleEffect(sequential, NULL, seed);
+	initParticleEffect(threaded, pool, seed);
+	initParticleEffect(ahead, pool, seed);
+	addFountains(sequential, emitterCount, particlesPerEmitter);
+	addFountains(threaded, emitterCount, particlesPerEmitter);
+	addFountains(ahead, emitterCount, particlesPerEmitter);
+
+	bool same = true;
+	unsigned int particleCount = 0;
+	double sequentialTime = 0.0, threadedTime = 0.0, drawTime = 0.0, waitTime = 0.0;
+	// 'ahead' simulates frame f+1 while the calling thread "draws" frame f : as long as the simulation takes
+	beginParticleFrame(ahead, delta, compareCameraPosition(0));
+	for (unsigned int f=0; f<warmupFrames+frames; f++){
+		bool timed = (f >= warmupFrames);
+		glm::vec3 cameraPosition = compareCameraPosition(f);
+
+		std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+		beginParticleFrame(sequential, delta, cameraPosition);
+		const float * sequentialPositionSize;
+		const unsigned char * sequentialColor;
+		unsigned int sequentialCount = finishParticleFrame(sequential, &sequentialPositionSize, &sequentialColor);
+		double sequentialFrame = millisecondsSince(start);
+
+		start = std::chrono::high_resolution_clock::now();
+		beginParticleFrame(threaded, delta, cameraPosition);
+		const float * threadedPositionSize;
+		const unsigned char * threadedColor;
+		unsigned int threadedCount = finishParticleFrame(threaded, &threadedPositionSize, &threadedColor);
+		double threadedFrame = millisecondsSince(start);
+
+		start = std::chrono::high_resolution_clock::now();
+		const float * aheadPositionSize;
+		const unsigned char * aheadColor;
+		unsigned int aheadCount = finishParticleFrame(ahead, &aheadPositionSize, &aheadColor);
+		double waitFrame = millisecondsSince(start);
+		beginParticleFrame(ahead, delta, compareCameraPosition(f+1));
+		start = std::chrono::high_resolution_clock::now();
+		while (millisecondsSince(start) < sequentialFrame)
+			;
+
+		same = same && sameParticleVertices(sequentialCount, sequentialPositionSize, sequentialColor, threadedCount, threadedPositionSize, threadedColor);
+		same = same && sameParticleVertices(sequentialCount, sequentialPositionSize, sequentialColor, aheadCount, aheadPositionSize, aheadColor);
+		particleCount = sequentialCount;
+		if (timed){
+			sequentialTime += sequentialFrame;
+			threadedTime += threadedFrame;
+			drawTime += sequentialFrame;
+			waitTime += waitFrame;
+		}
+	}
+	finishParticleFrame(ahead, NULL, NULL);
+
+	printf("%u emitters, %u particles at the end, %u frames, %u threads : %s\n",
+		emitterCount, particleCount, frames, jobPoolThreadCount(pool), same ? "same vertices" : "DIFFERENT VERTICES");
+	printf("calling thread only                      : %8.3f ms per frame\n", sequentialTime / frames);
+	printf("job pool, waiting                        : %8.3f ms per frame\n", threadedTime / frames);
+	printf("job pool, one frame ahead, drawing %6.3f : waits %8.3f ms per frame\n", drawTime / frames, waitTime / frames);
+	destroyJobPool(pool);
+	return same;
+}
+
+
+
+int main(int argc, char * argv[]){
+	unsigned int particles = argc > 1 ? (unsigned int)atoi(argv[1]) : 100000;
+
+	CHECK(compareParticleUpdate(particles * 10, 20));
+	CHECK(compareParticleUpdate(particles, 100));
+	CHECK(compareParticleSorts(particles / 10, 600));
+	CHECK(compareParticleSorts(particles, 300));
+	CHECK(compareParticleSorts(particles * 5, 60));
+	CHECK(compareParticleSorts(particles * 20, 20));
+	CHECK(stressParticleSystem(particles, 300, 1));
+	CHECK(stressParticleSystem(1000, 3000, 2));
+	CHECK(compareParticleEffectThreads(32, particles / 5, 100, 0, 1));
+	CHECK(compareParticleEffectThreads(4, particles, 100, 2, 2));
+	return testResult();
+}
@@ -0,0 +1,357 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+#include <string>
+#include <thread>
+#include <chrono>
+
+#include <common/profiler.hpp>
+
+#include "testing.hpp"
+
+// "profiler_benchmark [scopes]" times empty PROFILE_SCOPEs (10 million by default) with the profiler disabled,
+// then enabled. Then checks what writeProfileTrace writes, with a small JSON parser : well-formed JSON, nested
+// scopes inside their parent, the ring of each thread keeping only its last PROFILER_RING_SIZE scopes, in order,
+// and the scopes of worker threads on their own line, under their own name. Doesn't use OpenGL.
+
+static const char * TracePath = "profiler_benchmark.trace.json";
+static const unsigned int WorkerCount = 4;
+static const unsigned int WorkerScopes = 100;
+static const char * WorkerNames[WorkerCount] = { "worker 0", "worker 1", "worker 2", "worker 3" };
+
+// Just enough JSON to read a trace back
+struct JSONValue{
+	enum Type{ JSON_NULL, JSON_BOOL, JSON_NUMBER, JSON_STRING, JSON_ARRAY, JSON_OBJECT };
+	Type type;
+	double number;
+	std::string string;
+	std::vector<JSONValue> items;    // of an array, or the values of an object
+	std::vector<std::string> keys;   // of an object
+
+	const JSONValue * member(const char * key) const {
+		for (size_t i=0; i<keys.size(); i++)
+			if (keys[i] == key)
+				return &items[i];
+		return NULL;
+	}
+};
+
+static void skipJSONSpaces(const char *& at){
+	while (*at == ' ' || *at == '\t' || *at == '\n' || *at == '\r')
+		at++;
+}
+
+static bool parseJSONString(const char *& at, std::string & out_string){
+	if (*at != '"')
+		return false;
+	at++;
+	out_string.clear();
+	while (*at != '"'){
+		if ((unsigned char)*at < 0x20)
+			return false; // unescaped control character, or the end of the text
+		if (*at != '\\'){
+			out_string += *at++;
+			continue;
+		}
+		at++;
+		static const char escapes[] = "\"\\/bfnrt";
+		const char * escaped = strchr(escapes, *at);
+		if (*at != '\0' && escaped != NULL){
+			out_string += "\"\\/\b\f\n\r\t"[escaped - escapes];
+			at++;
+		}else if (*at == 'u'){
+			unsigned int code = 0;
+			for (int i=1; i<=4; i++){
+				char c = at[i];
+				if (!((c >= '0' && c <= '9') || (c >= 'a' && c <= 'f') || (c >= 'A' && c <= 'F')))
+					return false;
+				code = code * 16 + (c <= '9' ? c - '0' : (c | 0x20) - 'a' + 10);
+			}
+			out_string += code < 0x80 ? (char)code : '?';
+			at += 5;
+		}else{
+			return false;
+		}
+	}
+	at++;
+	return true;
+}
+
+// -? (0 | [1-9][0-9]*) (. [0-9]+)? ([eE] [+-]? [0-9]+)?
+static bool parseJSONNumber(const char *& at, double & out_number){
+	const char * start = at;
+	if (*at == '-')
+		at++;
+	if (*at == '0')
+		at++;
+	else if (*at >= '1' && *at <= '9')
+		while (*at >= '0' && *at <= '9') at++;
+	else
+		return false;
+	if (*at == '.'){
+		if (!(*++at >= '0' && *at <= '9'))
+			return false;
+		while (*at >= '0' && *at <= '9') at++;
+	}
+	if (*at == 'e' || *at == 'E'){
+		at++;
+		if (*at == '+' || *at == '-')
+			at++;
+		if (!(*at >= '0' && *at <= '9'))
+			return false;
+		while (*at >= '0' && *at <= '9') at++;
+	}
+	out_number = strtod(std::string(start, at).c_str(), NULL);
+	return true;
+}
+
+static bool parseJSONValue(const char *& at, JSONValue & out_value, int depth){
+	if (depth > 32)
+		return false;
+	skipJSONSpaces(at);
+	out_value.type = JSONValue::JSON_NULL;
+	out_value.number = 0.0;
+	if (*at == '{' || *at == '['){
+		bool object = (*at == '{');
+		char close = object ? '}' : ']';
+		out_value.type = object ? JSONValue::JSON_OBJECT : JSONValue::JSON_ARRAY;
+		at++;
+		skipJSONSpaces(at);
+		if (*at == close){
+			at++;
+			return true;
+		}
+		for (;;){
+			if (object){
+				skipJSONSpaces(at);
+				out_value.keys.push_back(std::string());
+				if (!parseJSONString(at, out_value.keys.back()))
+					return false;
+				skipJSONSpaces(at);
+				if (*at++ != ':')
+					return false;
+			}
+			out_value.items.push_back(JSONValue());
+			if (!parseJSONValue(at, out_value.items.back(), depth + 1))
+				return false;
+			skipJSONSpaces(at);
+			if (*at == close){
+				at++;
+				return true;
+			}
+			if (*at++ != ',')
+				return false;
+		}
+	}
+	if (*at == '"'){
+		out_value.type = JSONValue::JSON_STRING;
+		return parseJSONString(at, out_value.string);
+	}
+	const char * words[3] = { "true", "false", "null" };
+	for (int w=0; w<3; w++){
+		if (strncmp(at, words[w], strlen(words[w])) == 0){
+			at += strlen(words[w]);
+			out_value.type = w < 2 ? JSONValue::JSON_BOOL : JSONValue::JSON_NULL;
+			out_value.number = w == 0 ? 1.0 : 0.0;
+			return true;
+		}
+	}
+	out_value.type = JSONValue::JSON_NUMBER;
+	return parseJSONNumber(at, out_value.number);
+}
+
+// The whole text must be one value
+static bool parseJSON(const std::string & text, JSONValue & out_value){
+	const char * at = text.c_str();
+	if (!parseJSONValue(at, out_value, 0))
+		return false;
+	skipJSONSpaces(at);
+	return at == text.c_str() + text.size();
+}
+
+static bool readText(const char * path, std::string & out_text){
+	FILE * file = fopen(path, "rb");
+	if (file == NULL)
+		return false;
+	out_text.clear();
+	char buffer[4096];
+	size_t read;
+	while ((read = fread(buffer, 1, sizeof(buffer), file)) > 0)
+		out_text.append(buffer, read);
+	fclose(file);
+	return true;
+}
+
+// A complete ("X") event of the trace, in microseconds
+struct TraceEvent{
+	std::string name;
+	double begin, end;
+};
+
+struct TraceThread{
+	unsigned int tid;
+	std::string name;
+	std::vector<TraceEvent> events;
+};
+
+static TraceThread & traceThread(std::vector<TraceThread> & threads, unsigned int tid){
+	for (size_t t=0; t<threads.size(); t++)
+		if (threads[t].tid == tid)
+			return threads[t];
+	threads.push_back(TraceThread());
+	threads.back().tid = tid;
+	return threads.back();
+}
+
+static const TraceThread * namedThread(const std::vector<TraceThread> & threads, const char * name){
+	for (size_t t=0; t<threads.size(); t++)
+		if (threads[t].name == name)
+			return &threads[t];
+	return NULL;
+}
+
+// Checks the structure of the trace, and gives its events, thread by thread
+static bool readTrace(const char * path, std::vector<TraceThread> & out_threads){
+	std::string text;
+	JSONValue trace;
+	if (!CHECK(readText(path, text)) || !CHECK(parseJSON(text, trace)))
+		return false;
+	const JSONValue * events = trace.member("traceEvents");
+	if (!CHECK(trace.type == JSONValue::JSON_OBJECT && events != NULL && events->type == JSONValue::JSON_ARRAY))
+		return false;
+	unsigned int malformed = 0;
+	for (size_t i=0; i<events->items.size(); i++){
+		const JSONValue & event = events->items[i];
+		const JSONValue * name = event.member("name");
+		const JSONValue * phase = event.member("ph");
+		const JSONValue * tid = event.member("tid");
+		if (name == NULL || name->type != JSONValue::JSON_STRING || phase == NULL || tid == NULL || tid->type != JSONValue::JSON_NUMBER){
+			malformed++;
+			continue;
+		}
+		TraceThread & thread = traceThread(out_threads, (unsigned int)tid->number);
+		if (phase->string == "M"){
+			const JSONValue * args = event.member("args");
+			const JSONValue * threadName = args ? args->member("name") : NULL;
+			if (name->string == "thread_name" && threadName != NULL && threadName->type == JSONValue::JSON_STRING)
+				thread.name = threadName->string;
+			else
+				malformed++;
+		}else if (phase->string == "X"){
+			const JSONValue * ts = event.member("ts");
+			const JSONValue * dur = event.member("dur");
+			if (ts == NULL || dur == NULL || ts->type != JSONValue::JSON_NUMBER || dur->type != JSONValue::JSON_NUMBER || dur->number < 0.0){
+				malformed++;
+				continue;
+			}
+			TraceEvent traceEvent = { name->string, ts->number, ts->number + dur->number };
+			thread.events.push_back(traceEvent);
+		}else{
+			malformed++;
+		}
+	}
+	return CHECK(malformed == 0);
+}
+
+static bool inside(const TraceEvent & child, const TraceEvent & parent){
+	const double rounding = 0.002; // the trace has 3 decimals of microseconds
+	return child.begin >= parent.begin - rounding && child.end <= parent.end + rounding;
+}
+
+static void checkJSONParser(){
+	JSONValue value;
+	CHECK(parseJSON("{\"a\":[1,-2.5e3,\"x\\\"\\u0041\"],\"b\":{},\"c\":true,\"d\":null}", value));
+	CHECK(value.member("a") && value.member("a")->items.size() == 3 && value.member("a")->items[2].string == "x\"A");
+	CHECK(!parseJSON("{\"a\":1,}", value));
+	CHECK(!parseJSON("[1 2]", value));
+	CHECK(!parseJSON("{\"a\":01}", value));
+	CHECK(!parseJSON("[\"tab\there\"]", value));
+	CHECK(!parseJSON("{\"a\":1}}", value));
+}
+
+// noinline, so that the loops really go through the scopes
+#if defined(_MSC_VER)
+__declspec(noinline)
+#elif defined(__GNUC__)
+__attribute__((noinline))
+#endif
+static double timeEmptyScopes(unsigned int count){
+	std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+	for (unsigned int i=0; i<count; i++){
+		PROFILE_SCOPE("empty");
+	}
+	return millisecondsSince(start) * 1e6 / count;
+}
+
+static void workerScopes(unsigned int w){
+	setProfilerThreadName(WorkerNames[w]);
+	for (unsigned int i=0; i<WorkerScopes; i++){
+		PROFILE_SCOPE("work");
+		PROFILE_SCOPE("step");
+	}
+}
+
+int main(int argc, char * argv[]){
+	unsigned int scopes = argc > 1 ? (unsigned int)atoi(argv[1]) : 10000000;
+	if (scopes < 2 * PROFILER_RING_SIZE + 123)
+		scopes = 2 * PROFILER_RING_SIZE + 123; // so that the ring of the main thread wraps around
+	checkJSONParser();
+
+	// Disabled, a scope is only a test; enabled, it reads the clock twice and writes in the ring
+	setProfilerEnabled(false);
+	CHECK(!beginProfileScope("disabled"));
+	double disabled = timeEmptyScopes(scopes);
+	setProfilerEnabled(true);
+	double enabled = timeEmptyScopes(scopes);
+	printf("%u empty scopes : %6.2f ns per scope disabled, %6.2f ns enabled\n", scopes, disabled, enabled);
+	CHECK(disabled < 100.0 && enabled < 5000.0); // only sanity bounds : the numbers are what matters
+
+	// Nested, last in the ring of the main thread
+	{
+		PROFILE_SCOPE("outer");
+		{ PROFILE_SCOPE("inner"); }
+		{ PROFILE_SCOPE("inner"); }
+	}
+
+	std::vector<std::thread> workers;
+	for (unsigned int w=0; w<WorkerCount; w++)
+		workers.push_back(std::thread(workerScopes, w));
+	for (unsigned int w=0; w<WorkerCount; w++)
+		workers[w].join();
+	setProfilerEnabled(false);
+
+	std::vector<TraceThread> threads;
+	remove(TracePath);
+	if (CHECK(writeProfileTrace(TracePath)) && readTrace(TracePath, threads)){
+		// The ring : the last PROFILER_RING_SIZE scopes, oldest first
+		const TraceThread * main = namedThread(threads, "main");
+		if (CHECK(main != NULL && main->events.size() == PROFILER_RING_SIZE)){
+			const std::vector<TraceEvent> & events = main->events;
+			unsigned int unordered = 0;
+			for (size_t e=1; e<events.size(); e++)
+				unordered += events[e].end < events[e-1].end - 0.002;
+			CHECK(unordered == 0);
+			// The scopes are recorded when they end : inner, inner, outer
+			size_t last = events.size() - 1;
+			CHECK(events[last].name == "outer" && events[last-1].name == "inner" && events[last-2].name == "inner");
+			CHECK(inside(events[last-1], events[last]) && inside(events[last-2], events[last]));
+			CHECK(events[last-2].end <= events[last-1].begin + 0.002);
+			CHECK(events[0].name == "empty");
+		}
+
+		// Each worker on its own line, even though it has finished
+		for (unsigned int w=0; w<WorkerCount; w++){
+			const TraceThread * worker = namedThread(threads, WorkerNames[w]);
+			if (!CHECK(worker != NULL && worker->events.size() == 2 * WorkerScopes))
+				continue;
+			unsigned int misplaced = 0;
+			for (size_t e=0; e+1<worker->events.size(); e+=2)
+				misplaced += worker->events[e].name != "step" || worker->events[e+1].name != "work" || !inside(worker->events[e], worker->events[e+1]);
+			CHECK(misplaced == 0);
+		}
+		CHECK(threads.size() == 1 + WorkerCount);
+	}
+	remove(TracePath);
+	return testResult();
+}
@@ -0,0 +1,26 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <vector>
+#include <chrono>
+
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+using namespace glm;
+
+#include <common/quaternion_utils.hpp>
+
+#include "testing.hpp"
+
+// "quaternion_benchmark [count]" runs compareQuaternionBatches on count random inputs (1000000 by default) :
+// the batch functions of quaternion_utils.hpp must give the results of the scalar ones, within the
+// precision of their acos and sin polynomials, and it prints how much faster they are.
+
+int main(int argc, char * argv[]){
+	size_t count = argc > 1 ? (size_t)atoi(argv[1]) : 1000000;
+	srand(12345);
+	float difference = compareQuaternionBatches(count);
+	CHECK(difference < 1e-4f);
+	// Not a multiple of 4 : the last ones go through the scalar versions
+	CHECK(compareQuaternionBatches(7) < 1e-4f);
+	return testResult();
+}
@@ -0,0 +1,215 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+#include <string>
+#include <chrono>
+
+#include <sys/types.h>
+#include <sys/stat.h>
+#ifdef _WIN32
+#include <io.h>
+#include <direct.h>
+#define rmdir _rmdir
+#else
+#include <dirent.h>
+#include <unistd.h>
+#endif
+
+#include <GL/glew.h>
+
+#include <GLFW/glfw3.h>
+
+#include <common/shader.hpp>
+#include <common/shaderpreprocessor.hpp>
+
+#include "testing.hpp"
+
+// "shadercache_test" opens a hidden window, and checks the program cache of LoadShaders (see shader.cpp) :
+// a first load compiles and saves the binary, the next one takes it from the cache, an edited shader is
+// compiled again, and a truncated, garbage, or too long cached binary is deleted and compiled again.
+// Without a display, or when the driver can't give program binaries, returns 77 : ctest counts the test as skipped.
+// LIBGL_ALWAYS_SOFTWARE=1 to try it without a GPU.
+
+static const int SkippedResult = 77;
+static const char * CacheDirectory = "shadercache_test_cache";
+static const char * VertexPath = "shadercache_test.vertexshader";
+static const char * FragmentPath = "shadercache_test.fragmentshader";
+
+static const char * VertexShader =
+	"#version 330 core\n"
+	"layout(location = 0) in vec3 position;\n"
+	"void main(){ gl_Position = vec4(position, 1.0); }\n";
+static const char * FragmentShader =
+	"#version 330 core\n"
+	"uniform vec3 tint;\n"
+	"out vec3 color;\n"
+	"void main(){ color = tint; }\n";
+static const char * EditedFragmentShader =
+	"#version 330 core\n"
+	"uniform vec3 tint;\n"
+	"out vec3 color;\n"
+	"void main(){ color = tint * 0.5; }\n";
+
+static bool writeBytes(const std::string & path, const void * data, size_t size){
+	FILE * file = fopen(path.c_str(), "wb");
+	if (file == NULL){
+		printf("Can't create %s\n", path.c_str());
+		return false;
+	}
+	bool ok = size == 0 || fwrite(data, size, 1, file) == 1;
+	return fclose(file) == 0 && ok;
+}
+
+static bool readBytes(const std::string & path, std::vector<unsigned char> & out_bytes){
+	FILE * file = fopen(path.c_str(), "rb");
+	if (file == NULL)
+		return false;
+	out_bytes.clear();
+	unsigned char buffer[4096];
+	size_t read;
+	while ((read = fread(buffer, 1, sizeof(buffer), file)) > 0)
+		out_bytes.insert(out_bytes.end(), buffer, buffer + read);
+	fclose(file);
+	return true;
+}
+
+// The .bin files of the cache directory
+static std::vector<std::string> cachedPrograms(){
+	std::vector<std::string> paths;
+#ifdef _WIN32
+	struct _finddata_t found;
+	intptr_t handle = _findfirst((std::string(CacheDirectory) + "/*.bin").c_str(), &found);
+	if (handle == -1)
+		return paths;
+	do{
+		paths.push_back(std::string(CacheDirectory) + "/" + found.name);
+	}while (_findnext(handle, &found) == 0);
+	_findclose(handle);
+#else
+	DIR * directory = opendir(CacheDirectory);
+	if (directory == NULL)
+		return paths;
+	while (struct dirent * entry = readdir(directory)){
+		size_t length = strlen(entry->d_name);
+		if (length > 4 && strcmp(entry->d_name + length - 4, ".bin") == 0)
+			paths.push_back(std::string(CacheDirectory) + "/" + entry->d_name);
+	}
+	closedir(directory);
+#endif
+	return paths;
+}
+
+static void clearCache(){
+	std::vector<std::string> paths = cachedPrograms();
+	for (size_t i=0; i<paths.size(); i++)
+		remove(paths[i].c_str());
+	rmdir(CacheDirectory);
+}
+
+// The one which 'after' has and 'before' hasn't
+static std::string newProgram(const std::vector<std::string> & before, const std::vector<std::string> & after){
+	for (size_t i=0; i<after.size(); i++){
+		bool found = false;
+		for (size_t j=0; j<before.size(); j++)
+			found = found || after[i] == before[j];
+		if (!found)
+			return after[i];
+	}
+	return "";
+}
+
+// LoadShaders, which must take the program from the cache or not, and give a program which works either way
+static void checkLoad(const char * what, bool expectHit){
+	unsigned int hits = getShaderLoadStats().cacheHits;
+	GLuint programID = LoadShaders(VertexPath, FragmentPath);
+	bool hit = getShaderLoadStats().cacheHits == hits + 1;
+	if (!CHECK(hit == expectHit))
+		printf("  %s : %s\n", what, hit ? "taken from the cache" : "compiled");
+	GLint linked = GL_FALSE;
+	if (CHECK(programID != 0))
+		glGetProgramiv(programID, GL_LINK_STATUS, &linked);
+	if (!CHECK(linked == GL_TRUE && glGetUniformLocation(programID, "tint") != -1))
+		printf("  %s : not a working program\n", what);
+	glDeleteProgram(programID);
+}
+
+// Damages the cached binary, which the next load must replace
+static void checkCorrupted(const std::string & path, const char * what, const std::vector<unsigned char> & bytes){
+	if (!CHECK(writeBytes(path, bytes.empty() ? NULL : &bytes[0], bytes.size())))
+		return;
+	checkLoad(what, false);
+	std::vector<unsigned char> rewritten;
+	CHECK(readBytes(path, rewritten) && rewritten.size() > 24); // magic, version, format, length and key, then the binary
+	checkLoad("after it was compiled again", true);
+}
+
+int main(){
+	if (!glfwInit()){
+		printf("Failed to initialize GLFW : skipped\n");
+		return SkippedResult;
+	}
+	glfwWindowHint(GLFW_VISIBLE, GL_FALSE);
+	glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
+	glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+	glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE); // To make macOS happy; should not be needed
+	glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+	GLFWwindow * window = glfwCreateWindow(64, 64, "shadercache_test", NULL, NULL);
+	if (window == NULL){
+		printf("Failed to open a hidden GLFW window with OpenGL 3.3 : skipped\n");
+		glfwTerminate();
+		return SkippedResult;
+	}
+	glfwMakeContextCurrent(window);
+	glewExperimental = true; // Needed for core profile
+	if (!CHECK(glewInit() == GLEW_OK)){
+		glfwTerminate();
+		return testResult();
+	}
+	GLint formatCount = 0;
+	if (GLEW_VERSION_4_1 || GLEW_ARB_get_program_binary)
+		glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formatCount);
+	if (formatCount == 0){
+		printf("%s can't give program binaries : skipped\n", (const char *)glGetString(GL_RENDERER));
+		glfwTerminate();
+		return SkippedResult;
+	}
+
+	clearCache();
+	setShaderCacheDirectory(CacheDirectory);
+	CHECK(writeBytes(VertexPath, VertexShader, strlen(VertexShader)));
+	CHECK(writeBytes(FragmentPath, FragmentShader, strlen(FragmentShader)));
+
+	// A miss, then a hit
+	checkLoad("first load", false);
+	std::vector<std::string> programs = cachedPrograms();
+	CHECK(programs.size() == 1);
+	checkLoad("second load", true);
+
+	// The edited shader is another program. As if the tutorial ran again : the preprocessor doesn't read the file twice
+	CHECK(writeBytes(FragmentPath, EditedFragmentShader, strlen(EditedFragmentShader)));
+	clearShaderPreprocessorCache();
+	checkLoad("edited shader", false);
+	std::vector<std::string> editedPrograms = cachedPrograms();
+	CHECK(editedPrograms.size() == 2);
+	checkLoad("edited shader, again", true);
+
+	// Damaged binaries are compiled again, and replaced
+	std::string path = newProgram(programs, editedPrograms);
+	std::vector<unsigned char> bytes;
+	if (CHECK(!path.empty() && readBytes(path, bytes) && bytes.size() > 24)){
+		std::vector<unsigned char> truncated(bytes.begin(), bytes.begin() + bytes.size() / 2);
+		checkCorrupted(path, "truncated binary", truncated);
+		std::vector<unsigned char> tooLong = bytes;
+		memset(&tooLong[12], 0xFF, 4); // the length of the binary : 4 GB
+		checkCorrupted(path, "binary length 0xFFFFFFFF", tooLong);
+		checkCorrupted(path, "garbage", std::vector<unsigned char>(100, 0xAB));
+		checkCorrupted(path, "empty file", std::vector<unsigned char>());
+	}
+
+	clearCache();
+	remove(VertexPath);
+	remove(FragmentPath);
+	glfwTerminate();
+	return testResult();
+}
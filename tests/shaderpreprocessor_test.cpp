@@ -0,0 +1,163 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+#include <string>
+#include <chrono>
+
+#include <common/shaderpreprocessor.hpp>
+
+#include "testing.hpp"
+
+// "shaderpreprocessor_test [common directory]" checks preprocessShader on small shaders written in the
+// current directory : #include (once per file, with #line directives), where the #defines go (after
+// #version, even behind comments), unused defines, parseShaderDefines, shaderPermutations and the cache.
+// With the common directory, also checks the variants of the shared StandardShading shaders.
+
+static bool writeText(const std::string & path, const char * text){
+	FILE * file = fopen(path.c_str(), "wb");
+	if (file == NULL){
+		printf("Can't create %s\n", path.c_str());
+		return false;
+	}
+	fputs(text, file);
+	return fclose(file) == 0;
+}
+
+static std::vector<std::string> defineList(const char * defines){
+	std::vector<std::string> list;
+	parseShaderDefines(defines, list);
+	return list;
+}
+
+static size_t countOf(const std::string & text, const char * what){
+	size_t count = 0;
+	for (size_t at = text.find(what); at != std::string::npos; at = text.find(what, at + 1))
+		count++;
+	return count;
+}
+
+static void checkIncludes(){
+	CHECK(writeText("spp_main.glsl", "#version 330 core\n#include \"spp_a.glsl\"\n#include \"spp_b.glsl\"\nvoid main(){}\n"));
+	CHECK(writeText("spp_a.glsl", "#include \"spp_b.glsl\"\nfloat a;\n#include \"spp_a.glsl\"\n"));
+	CHECK(writeText("spp_b.glsl", "float b;\n"));
+
+	PreprocessedShader shader;
+	if (!CHECK(preprocessShader("spp_main.glsl", std::vector<std::string>(), shader)))
+		return;
+	const char * expected =
+		"#version 330 core\n"
+		"#line 1 1\n"
+		"#line 1 2\n"
+		"float b;\n"
+		"#line 2 1\n"
+		"float a;\n"
+		"\n"                 // spp_a.glsl includes itself : only once
+		"#line 3 0\n"
+		"\n"                 // spp_b.glsl is already there
+		"void main(){}\n";
+	CHECK(shader.source == expected);
+	CHECK(shader.files.size() == 3 && shader.files[0] == "spp_main.glsl" && shader.files[1] == "spp_a.glsl" && shader.files[2] == "spp_b.glsl");
+	CHECK(shader.hash == hashShaderSource(shader.source));
+
+	CHECK(writeText("spp_missing_include.glsl", "#version 330 core\n#include \"spp_nothing.glsl\"\n"));
+	CHECK(!preprocessShader("spp_missing_include.glsl", std::vector<std::string>(), shader));
+	CHECK(!preprocessShader("spp_nothing.glsl", std::vector<std::string>(), shader));
+}
+
+// The defines go right after #version, whatever comes before it, followed by a #line for the next line
+static void checkDefinePlacement(const char * name, const char * text, const char * expected){
+	std::string path = std::string("spp_") + name + ".glsl";
+	CHECK(writeText(path, text));
+	PreprocessedShader shader;
+	if (CHECK(preprocessShader(path.c_str(), defineList("FOO=2 BAR"), shader)) && !CHECK(shader.source == expected))
+		printf("  %s :\n%s\n", name, shader.source.c_str());
+}
+
+static void checkDefines(){
+	checkDefinePlacement("version", "#version 330 core\nint x = FOO;\n",
+		"#version 330 core\n#define FOO 2\n#line 2 0\nint x = FOO;\n");
+	checkDefinePlacement("line_comments", "// A shader\n  // with comments\n\n#version 330 core\nint x = FOO + BAR;\n",
+		"// A shader\n  // with comments\n\n#version 330 core\n#define BAR\n#define FOO 2\n#line 5 0\nint x = FOO + BAR;\n");
+	checkDefinePlacement("block_comment", "/* A shader\n * with a block comment\n */\n#version 330 core\nint x = FOO;\n",
+		"/* A shader\n * with a block comment\n */\n#version 330 core\n#define FOO 2\n#line 5 0\nint x = FOO;\n");
+	checkDefinePlacement("same_line", "/* one line */ # version 330\nint x = FOO;\n",
+		"/* one line */ # version 330\n#define FOO 2\n#line 2 0\nint x = FOO;\n");
+	checkDefinePlacement("no_version", "int x = FOO;\n",
+		"#define FOO 2\n#line 1 0\nint x = FOO;\n");
+	// Only whole identifiers count : FOOD and BARE don't use FOO and BAR
+	checkDefinePlacement("unused", "#version 330 core\nint FOOD = BARE;\n",
+		"#version 330 core\nint FOOD = BARE;\n");
+
+	// Variants which only differ by unused defines, or by their order, are the same
+	PreprocessedShader a, b, c;
+	CHECK(preprocessShader("spp_version.glsl", defineList("FOO=2 BAR UNUSED"), a));
+	CHECK(preprocessShader("spp_version.glsl", defineList("UNUSED FOO=2"), b));
+	CHECK(preprocessShader("spp_version.glsl", defineList("FOO=3"), c));
+	CHECK(a.source == b.source && a.hash == b.hash);
+	CHECK(a.source != c.source && a.hash != c.hash);
+}
+
+static void checkCache(){
+	CHECK(writeText("spp_cached.glsl", "#version 330 core\nint x = 1;\n"));
+	PreprocessedShader first, second;
+	CHECK(preprocessShader("spp_cached.glsl", std::vector<std::string>(), first));
+	CHECK(writeText("spp_cached.glsl", "#version 330 core\nint x = 2;\n"));
+	CHECK(preprocessShader("spp_cached.glsl", std::vector<std::string>(), second));
+	CHECK(first.source == second.source); // still the cached file
+	clearShaderPreprocessorCache();
+	CHECK(preprocessShader("spp_cached.glsl", std::vector<std::string>(), second));
+	CHECK(second.source == "#version 330 core\nint x = 2;\n");
+}
+
+static void checkHelpers(){
+	std::vector<std::string> defines = defineList("  NORMAL_MAP\tSPECULAR_POWER=8 \n ALPHA ");
+	CHECK(defines.size() == 3 && defines[0] == "NORMAL_MAP" && defines[1] == "SPECULAR_POWER=8" && defines[2] == "ALPHA");
+	CHECK(defineList(NULL).empty() && defineList("").empty());
+
+	std::vector<std::string> keys;
+	keys.push_back("A");
+	keys.push_back("B");
+	std::vector<std::vector<std::string> > permutations;
+	shaderPermutations(keys, permutations);
+	CHECK(permutations.size() == 4);
+	if (permutations.size() == 4){
+		CHECK(permutations[0].empty());
+		CHECK(permutations[1].size() == 1 && permutations[1][0] == "A");
+		CHECK(permutations[2].size() == 1 && permutations[2][0] == "B");
+		CHECK(permutations[3].size() == 2 && permutations[3][0] == "A" && permutations[3][1] == "B");
+	}
+
+	// The FNV-1a test vectors
+	CHECK(hashShaderSource("") == 14695981039346656037ULL);
+	CHECK(hashShaderSource("a") == 0xaf63dc4c8601ec8cULL);
+	CHECK(hashShaderSource("foobar") == 0x85944171f73967e8ULL);
+}
+
+// The shaders which tutorials 8 to 10, 17 and misc05 share : 2 variants of the fragment shader
+static void checkStandardShading(const std::string & directory){
+	std::string vertexPath = directory + "/StandardShading.vertexshader";
+	std::string fragmentPath = directory + "/StandardShading.fragmentshader";
+	PreprocessedShader vertex, vertexTransparent, opaque, unused, transparent;
+	CHECK(preprocessShader(vertexPath.c_str(), defineList(""), vertex));
+	CHECK(preprocessShader(vertexPath.c_str(), defineList("TRANSPARENT"), vertexTransparent));
+	CHECK(preprocessShader(fragmentPath.c_str(), defineList(""), opaque));
+	CHECK(preprocessShader(fragmentPath.c_str(), defineList("UNUSED"), unused));
+	CHECK(preprocessShader(fragmentPath.c_str(), defineList("TRANSPARENT"), transparent));
+	CHECK(vertex.source == vertexTransparent.source); // so tutorial 10 shares the vertex shader
+	CHECK(opaque.source == unused.source);
+	CHECK(opaque.source != transparent.source);
+	CHECK(transparent.source.compare(0, 17, "#version 330 core") == 0);
+	CHECK(countOf(transparent.source, "#define TRANSPARENT\n") == 1);
+	CHECK(transparent.source.find("#define TRANSPARENT") < transparent.source.find("out vec4 color"));
+}
+
+int main(int argc, char * argv[]){
+	checkIncludes();
+	checkDefines();
+	checkCache();
+	checkHelpers();
+	if (argc > 1)
+		checkStandardShading(argv[1]);
+	return testResult();
+}
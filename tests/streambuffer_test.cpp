@@ -0,0 +1,121 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+#include <chrono>
+
+#include <GL/glew.h>
+
+#include <GLFW/glfw3.h>
+
+#include <common/streambuffer.hpp>
+
+#include "testing.hpp"
+
+// "streambuffer_test" opens a hidden window, and checks and times the ways to stream vertices of StreamBuffer
+// (see testStreamBuffers) : as many as the particles of tutorial18_particles, then small writes, which fill the
+// buffer of STREAM_UNSYNCHRONIZED more often. LIBGL_ALWAYS_SOFTWARE=1 to try it without a GPU.
+// Without a display, returns 77 : ctest counts the test as skipped.
+
+static const int SkippedResult = 77;
+
+static unsigned int streamTestValue(unsigned int frame, size_t i){
+	return frame * 2654435761u + (unsigned int)i;
+}
+
+// Writes 'frames' frames of bytesPerFrame bytes with each mode, which the GPU copies to another buffer, checks the
+// copies of the last frames, and prints the time per frame that the CPU spends to write. Returns false if a copy is wrong.
+static bool testStreamBuffers(size_t bytesPerFrame, unsigned int frames){
+	const unsigned int checkedFrames = 4; // more than STREAM_BUFFER_PARTS : a part written too early shows
+	size_t valueCount = bytesPerFrame / 4;
+	size_t bytes = valueCount * 4;
+	if (frames < checkedFrames)
+		frames = checkedFrames;
+
+	// The GPU copies each frame here, as if it drew it
+	GLuint copies;
+	glGenBuffers(1, &copies);
+	glBindBuffer(GL_COPY_WRITE_BUFFER, copies);
+	glBufferData(GL_COPY_WRITE_BUFFER, bytes * checkedFrames, NULL, GL_STREAM_COPY);
+
+	bool ok = true;
+	std::vector<unsigned int> copied(valueCount);
+	const StreamBufferMode modes[3] = { STREAM_PERSISTENT, STREAM_UNSYNCHRONIZED, STREAM_SUBDATA };
+	printf("%u frames of %u bytes, on %s :\n", frames, (unsigned int)bytes, (const char *)glGetString(GL_RENDERER));
+	for (int m=0; m<3; m++){
+		StreamBuffer stream;
+		initStreamBuffer(stream, bytes, modes[m]);
+		if (stream.mode != modes[m]){
+			printf("  %-16s : not supported\n", streamBufferModeName(modes[m]));
+			deleteStreamBuffer(stream);
+			continue;
+		}
+
+		double write = 0.0;
+		for (unsigned int f=0; f<frames; f++){
+			std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+			size_t offset;
+			unsigned int * values = (unsigned int *)beginStreamWrite(stream, bytes, offset);
+			if (values == NULL){
+				ok = false;
+				break;
+			}
+			for (size_t i=0; i<valueCount; i++)
+				values[i] = streamTestValue(f, i);
+			endStreamWrite(stream);
+			write += millisecondsSince(start);
+
+			glBindBuffer(GL_COPY_READ_BUFFER, stream.buffer);
+			glBindBuffer(GL_COPY_WRITE_BUFFER, copies);
+			glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, offset, (f % checkedFrames) * bytes, bytes);
+			endStreamFrame(stream);
+		}
+
+		unsigned int wrong = 0;
+		glBindBuffer(GL_COPY_WRITE_BUFFER, copies);
+		for (unsigned int f=frames-checkedFrames; f<frames; f++){
+			glGetBufferSubData(GL_COPY_WRITE_BUFFER, (f % checkedFrames) * bytes, bytes, &copied[0]);
+			for (size_t i=0; i<valueCount; i++)
+				if (copied[i] != streamTestValue(f, i))
+					wrong++;
+		}
+		ok = ok && wrong == 0;
+		printf("  %-16s : write %8.3f ms per frame (%5.2f GB/s), %u fence waits, %u orphans, %u grows, %u wrong values\n",
+			streamBufferModeName(stream.mode), write / frames, bytes * frames / (write * 1e6),
+			stream.stats.fenceWaits, stream.stats.orphans, stream.stats.grows, wrong);
+		deleteStreamBuffer(stream);
+	}
+	glDeleteBuffers(1, &copies);
+	return ok;
+}
+
+int main(){
+	if (!glfwInit()){
+		printf("Failed to initialize GLFW : skipped\n");
+		return SkippedResult;
+	}
+	glfwWindowHint(GLFW_VISIBLE, GL_FALSE);
+	glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
+	glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+	glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE); // To make macOS happy; should not be needed
+	glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+	GLFWwindow * window = glfwCreateWindow(64, 64, "streambuffer_test", NULL, NULL);
+	if (window == NULL){
+		printf("Failed to open a hidden GLFW window with OpenGL 3.3 : skipped\n");
+		glfwTerminate();
+		return SkippedResult;
+	}
+	glfwMakeContextCurrent(window);
+	glewExperimental = true; // Needed for core profile
+	if (!CHECK(glewInit() == GLEW_OK)){
+		glfwTerminate();
+		return testResult();
+	}
+
+	const size_t particleCount = 100000;
+	CHECK(testStreamBuffers(particleCount * 4 * (sizeof(GLfloat) + sizeof(GLubyte)), 300));
+	CHECK(testStreamBuffers(64 * 1024, 1000));
+
+	glfwTerminate();
+	return testResult();
+}
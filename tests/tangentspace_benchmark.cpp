@@ -0,0 +1,83 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <vector>
+#include <chrono>
+
+#include <glm/glm.hpp>
+
+#include <common/tangentspace.hpp>
+
+#include "testing.hpp"
+
+// "tangentspace_benchmark [triangles]" times computeTangentBasis (with SSE when available), its scalar version,
+// and computeTangentBasisIndexed, on a bumpy grid of about 'triangles' triangles (2 million by default).
+
+struct Grid{
+	std::vector<unsigned int> indices;
+	std::vector<glm::vec3> vertices;
+	std::vector<glm::vec2> uvs;
+	std::vector<glm::vec3> normals;
+};
+
+static void makeGrid(unsigned int cells, Grid & grid){
+	unsigned int side = cells + 1;
+	for (unsigned int y=0; y<side; y++){
+		for (unsigned int x=0; x<side; x++){
+			grid.vertices.push_back(glm::vec3(x * 0.01f, 0.05f * ((x * 7 + y * 13) % 17), y * -0.01f));
+			grid.uvs.push_back(glm::vec2((float)x / cells, (float)y / cells));
+			grid.normals.push_back(glm::normalize(glm::vec3(0.1f * ((x % 5) - 2.0f), 0.9f, 0.1f * ((y % 3) - 1.0f))));
+		}
+	}
+	for (unsigned int y=0; y<cells; y++){
+		for (unsigned int x=0; x<cells; x++){
+			unsigned int a = y * side + x, b = a + 1, c = a + side, d = c + 1;
+			unsigned int corners[6] = { a, b, d, a, d, c };
+			grid.indices.insert(grid.indices.end(), corners, corners + 6);
+		}
+	}
+}
+
+static void printTime(const char * name, double milliseconds, size_t triangles){
+	printf("%-32s : %8.2f ms, %6.1f M triangles/s\n", name, milliseconds, triangles / (milliseconds * 1000.0));
+}
+
+int main(int argc, char * argv[]){
+	unsigned int triangles = argc > 1 ? (unsigned int)atoi(argv[1]) : 2000000;
+	Grid grid;
+	makeGrid(gridCells(triangles), grid);
+	size_t triangleCount = grid.indices.size() / 3;
+	printf("%u triangles\n", (unsigned int)triangleCount);
+
+	// The triangle soup that loadOBJ would give
+	std::vector<glm::vec3> vertices, normals;
+	std::vector<glm::vec2> uvs;
+	for (size_t i=0; i<grid.indices.size(); i++){
+		vertices.push_back(grid.vertices[grid.indices[i]]);
+		uvs.push_back(grid.uvs[grid.indices[i]]);
+		normals.push_back(grid.normals[grid.indices[i]]);
+	}
+
+	const int runs = 3; // the best of them
+	double best[3] = { 1e30, 1e30, 1e30 };
+	for (int r=0; r<runs; r++){
+		std::vector<glm::vec3> tangents, bitangents, scalarTangents, scalarBitangents, indexedTangents, indexedBitangents;
+		std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+		computeTangentBasis(vertices, uvs, normals, tangents, bitangents);
+		best[0] = glm::min(best[0], millisecondsSince(start));
+
+		start = std::chrono::high_resolution_clock::now();
+		computeTangentBasis_scalar(vertices, uvs, normals, scalarTangents, scalarBitangents);
+		best[1] = glm::min(best[1], millisecondsSince(start));
+		CHECK(tangents == scalarTangents);
+
+		start = std::chrono::high_resolution_clock::now();
+		computeTangentBasisIndexed(grid.indices, grid.vertices, grid.uvs, grid.normals, indexedTangents, indexedBitangents);
+		best[2] = glm::min(best[2], millisecondsSince(start));
+		CHECK(indexedTangents.size() == grid.vertices.size());
+	}
+	printTime("computeTangentBasis", best[0], triangleCount);
+	printTime("computeTangentBasis_scalar", best[1], triangleCount);
+	printTime("computeTangentBasisIndexed", best[2], triangleCount);
+	printf("SSE : %.2fx faster than scalar\n", best[1] / best[0]);
+	return testResult();
+}
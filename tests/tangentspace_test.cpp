@@ -0,0 +1,190 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <vector>
+#include <chrono>
+
+#include <glm/glm.hpp>
+
+#include <common/vboindexer.hpp>
+#include <common/tangentspace.hpp>
+
+#include "testing.hpp"
+
+// Checks computeTangentBasis against its scalar version, and both computeTangentBasis + indexVBO_TBN and
+// computeTangentBasisIndexed against the exact tangents of a sphere. Degenerate UVs must give usable tangents too.
+
+static unsigned int RandomState = 12345;
+static float randomFloat(){
+	RandomState = RandomState * 1664525u + 1013904223u;
+	return (float)(RandomState >> 8) / 16777216.0f * 2.0f - 1.0f;
+}
+
+// Angle between two directions, in degrees
+static float angleBetween(glm::vec3 a, glm::vec3 b){
+	float c = glm::dot(glm::normalize(a), glm::normalize(b));
+	return acosf(glm::clamp(c, -1.0f, 1.0f)) * 57.2957795f;
+}
+
+static bool isUnitAndOrthogonal(const glm::vec3 & t, const glm::vec3 & n){
+	return fabsf(glm::length(t) - 1.0f) < 1e-4f && fabsf(glm::dot(t, glm::normalize(n))) < 1e-4f;
+}
+
+// Random triangles, a count which isn't a multiple of 4, some of them with degenerate UVs
+static void checkScalarAndSSE(){
+	std::vector<glm::vec3> vertices, normals, tangents, bitangents, scalarTangents, scalarBitangents;
+	std::vector<glm::vec2> uvs;
+	for (int i=0; i<3*1001; i++){
+		vertices.push_back(glm::vec3(randomFloat(), randomFloat(), randomFloat()));
+		normals.push_back(glm::normalize(glm::vec3(randomFloat(), randomFloat(), randomFloat()) + glm::vec3(0.0f, 0.0f, 2.0f)));
+		uvs.push_back(i % 21 < 3 ? glm::vec2(0.5f) : glm::vec2(randomFloat(), randomFloat()));
+	}
+	computeTangentBasis(vertices, uvs, normals, tangents, bitangents);
+	computeTangentBasis_scalar(vertices, uvs, normals, scalarTangents, scalarBitangents);
+
+	float maxDifference = 0.0f;
+	unsigned int notOrthogonal = 0;
+	for (size_t i=0; i<vertices.size(); i++){
+		glm::vec3 dt = glm::abs(tangents[i] - scalarTangents[i]);
+		glm::vec3 db = glm::abs(bitangents[i] - scalarBitangents[i]) / glm::max(1.0f, glm::length(scalarBitangents[i]));
+		maxDifference = glm::max(maxDifference, glm::max(glm::max(dt.x, glm::max(dt.y, dt.z)), glm::max(db.x, glm::max(db.y, db.z))));
+		if (!isUnitAndOrthogonal(tangents[i], normals[i]))
+			notOrthogonal++;
+	}
+	printf("SSE and scalar : %u vertices, max difference %g, %u tangents not unit and orthogonal to the normal\n",
+		(unsigned int)vertices.size(), maxDifference, notOrthogonal);
+	CHECK(maxDifference <= 1e-6f);
+	CHECK(notOrthogonal == 0);
+}
+
+// A sphere without its poles, u around the Y axis, v along the meridians.
+// The exact tangent is the derivative of the position along u, the bitangent along v.
+struct SphereBand{
+	std::vector<unsigned int> indices;
+	std::vector<glm::vec3> vertices;
+	std::vector<glm::vec2> uvs;
+	std::vector<glm::vec3> normals;
+	std::vector<glm::vec3> exactTangents;
+	std::vector<glm::vec3> exactBitangents;
+};
+
+static void makeSphereBand(unsigned int segments, unsigned int rings, SphereBand & band){
+	for (unsigned int r=0; r<=rings; r++){
+		float v = (float)r / rings;
+		float latitude = (v - 0.5f) * 2.6f; // about +-75 degrees
+		for (unsigned int s=0; s<=segments; s++){
+			float u = (float)s / segments;
+			float longitude = u * 6.2831853f;
+			glm::vec3 p(cosf(latitude) * cosf(longitude), sinf(latitude), -cosf(latitude) * sinf(longitude));
+			band.vertices.push_back(p);
+			band.normals.push_back(p);
+			band.uvs.push_back(glm::vec2(u, v));
+			band.exactTangents.push_back(glm::vec3(-sinf(longitude), 0.0f, -cosf(longitude)));
+			band.exactBitangents.push_back(glm::vec3(-sinf(latitude) * cosf(longitude), cosf(latitude), sinf(latitude) * sinf(longitude)));
+		}
+	}
+	for (unsigned int r=0; r<rings; r++){
+		for (unsigned int s=0; s<segments; s++){
+			unsigned int a = r * (segments + 1) + s, b = a + 1, c = a + segments + 1, d = c + 1;
+			unsigned int corners[6] = { a, b, d, a, d, c };
+			band.indices.insert(band.indices.end(), corners, corners + 6);
+		}
+	}
+}
+
+// Worst angles to the exact tangents and bitangents.
+// The vertices of the UV seam only get the tangents of the triangles on one side : these are
+// half a segment off. Everywhere else, both sides are averaged, within 'tolerance' degrees.
+static void compareToExact(const char * name, const SphereBand & band, unsigned int segments, float tolerance,
+	const std::vector<glm::vec3> & vertices, const std::vector<glm::vec2> & uvs, const std::vector<glm::vec3> & normals,
+	const std::vector<glm::vec3> & tangents, const std::vector<glm::vec3> & bitangents
+){
+	float worst[2][2] = { { 0.0f, 0.0f }, { 0.0f, 0.0f } }; // [seam][tangent, bitangent]
+	unsigned int notOrthogonal = 0;
+	for (size_t i=0; i<vertices.size(); i++){
+		// The vertices may have been reordered : find the exact tangent by the position
+		size_t exact = 0;
+		float best = 1e30f;
+		for (size_t j=0; j<band.vertices.size(); j++){
+			glm::vec3 d = band.vertices[j] - vertices[i];
+			if (glm::dot(d, d) < best){
+				best = glm::dot(d, d);
+				exact = j;
+			}
+		}
+		// Only the part of the bitangent orthogonal to the tangent and the normal matters : its sign is the handedness
+		glm::vec3 c = glm::cross(normals[i], tangents[i]);
+		float * w = worst[uvs[i].x == 0.0f || uvs[i].x == 1.0f ? 1 : 0];
+		w[0] = glm::max(w[0], angleBetween(tangents[i], band.exactTangents[exact]));
+		w[1] = glm::max(w[1], angleBetween(c * glm::sign(glm::dot(c, bitangents[i])), band.exactBitangents[exact]));
+		if (!isUnitAndOrthogonal(tangents[i], normals[i]))
+			notOrthogonal++;
+	}
+	printf("%-36s : worst tangent %6.3f deg (%6.3f on the seam), worst bitangent %6.3f deg (%6.3f on the seam), %u not orthogonal\n",
+		name, worst[0][0], worst[1][0], worst[0][1], worst[1][1], notOrthogonal);
+	float halfSegment = 180.0f / segments;
+	CHECK(worst[0][0] < tolerance && worst[0][1] < tolerance);
+	CHECK(worst[1][0] < halfSegment && worst[1][1] < halfSegment);
+	CHECK(notOrthogonal == 0);
+}
+
+static void checkSphere(){
+	const unsigned int segments = 48;
+	SphereBand band;
+	makeSphereBand(segments, 24, band);
+
+	std::vector<glm::vec3> tangents, bitangents;
+	computeTangentBasisIndexed(band.indices, band.vertices, band.uvs, band.normals, tangents, bitangents);
+	compareToExact("computeTangentBasisIndexed", band, segments, 0.1f, band.vertices, band.uvs, band.normals, tangents, bitangents);
+
+	// The same mesh as a triangle soup, like loadOBJ gives
+	std::vector<glm::vec3> vertices, normals, soupTangents, soupBitangents;
+	std::vector<glm::vec2> uvs;
+	for (size_t i=0; i<band.indices.size(); i++){
+		vertices.push_back(band.vertices[band.indices[i]]);
+		uvs.push_back(band.uvs[band.indices[i]]);
+		normals.push_back(band.normals[band.indices[i]]);
+	}
+	computeTangentBasis(vertices, uvs, normals, soupTangents, soupBitangents);
+	std::vector<unsigned int> indices;
+	std::vector<glm::vec3> indexed_vertices, indexed_normals, indexed_tangents, indexed_bitangents;
+	std::vector<glm::vec2> indexed_uvs;
+	CHECK(indexVBO_TBN(vertices, uvs, normals, soupTangents, soupBitangents,
+		indices, indexed_vertices, indexed_uvs, indexed_normals, indexed_tangents, indexed_bitangents));
+	// indexVBO_TBN sums the tangents : orthogonalize them again, like a shader would.
+	// The sum isn't weighted : a vertex has more triangles on one side than on the other, so it is less precise.
+	for (size_t i=0; i<indexed_tangents.size(); i++){
+		glm::vec3 & t = indexed_tangents[i];
+		t = glm::normalize(t - indexed_normals[i] * glm::dot(indexed_normals[i], t));
+	}
+	compareToExact("computeTangentBasis + indexVBO_TBN", band, segments, 2.0f, indexed_vertices, indexed_uvs, indexed_normals, indexed_tangents, indexed_bitangents);
+}
+
+// Triangles whose UVs are all the same, or aligned : no tangent can be computed from them
+static void checkDegenerateUVs(){
+	std::vector<unsigned int> indices;
+	std::vector<glm::vec3> vertices, normals, tangents, bitangents;
+	std::vector<glm::vec2> uvs;
+	for (int i=0; i<3*8; i++){
+		indices.push_back(i);
+		vertices.push_back(glm::vec3(randomFloat(), randomFloat(), randomFloat()));
+		normals.push_back(i < 12 ? glm::vec3(1.0f, 0.0f, 0.0f) : glm::normalize(glm::vec3(randomFloat(), randomFloat(), randomFloat())));
+		uvs.push_back(i % 2 ? glm::vec2(0.25f) : glm::vec2(i * 0.1f, i * 0.1f));
+	}
+	unsigned int bad = 0;
+	computeTangentBasisIndexed(indices, vertices, uvs, normals, tangents, bitangents);
+	for (size_t i=0; i<vertices.size(); i++)
+		bad += isUnitAndOrthogonal(tangents[i], normals[i]) ? 0 : 1;
+	computeTangentBasis(vertices, uvs, normals, tangents, bitangents);
+	for (size_t i=0; i<vertices.size(); i++)
+		bad += isUnitAndOrthogonal(tangents[i], normals[i]) ? 0 : 1;
+	printf("Degenerate UVs : %u tangents not unit and orthogonal to the normal\n", bad);
+	CHECK(bad == 0);
+}
+
+int main(){
+	checkScalarAndSSE();
+	checkSphere();
+	checkDegenerateUVs();
+	return testResult();
+}
@@ -0,0 +1,72 @@
+#ifndef TESTING_HPP
+#define TESTING_HPP
+
+// What the tests and benchmarks of this directory share. Each one is a small executable which prints
+// what it measures, and returns 0 when all its CHECKs passed : ctest runs them (see CMakeLists.txt).
+// Include <stdio.h> and <chrono> first. Everything is inline : each test only uses some of it.
+
+static unsigned int FailedChecks = 0;
+
+static inline bool checkCondition(bool condition, const char * text, const char * file, int line){
+	if (!condition){
+		printf("%s(%d) : check failed : %s\n", file, line, text);
+		FailedChecks++;
+	}
+	return condition;
+}
+
+// Counts a failure, and goes on : the other checks still run
+#define CHECK(condition) checkCondition((condition), #condition, __FILE__, __LINE__)
+
+static inline double millisecondsSince(std::chrono::high_resolution_clock::time_point start){
+	return std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+}
+
+// A synthetic OBJ file : a bumpy grid of cells x cells squares, each made of 2 triangles.
+// Its vertices are shared by up to 6 triangles, like in a real mesh.
+static inline bool writeGridOBJ(const char * path, unsigned int cells){
+	FILE * file = fopen(path, "wb");
+	if (file == NULL){
+		printf("Can't create %s\n", path);
+		return false;
+	}
+	unsigned int side = cells + 1;
+	fprintf(file, "# %u x %u grid, %u triangles\n", cells, cells, 2 * cells * cells);
+	for (unsigned int y=0; y<side; y++)
+		for (unsigned int x=0; x<side; x++)
+			fprintf(file, "v %f %f %f\n", x * 0.01f, 0.05f * ((x * 7 + y * 13) % 17), y * -0.01f);
+	for (unsigned int y=0; y<side; y++)
+		for (unsigned int x=0; x<side; x++)
+			fprintf(file, "vt %f %f\n", (float)x / cells, (float)y / cells);
+	for (unsigned int y=0; y<side; y++)
+		for (unsigned int x=0; x<side; x++)
+			fprintf(file, "vn %f %f %f\n", 0.1f * ((x % 5) - 2.0f), 0.9f, 0.1f * ((y % 3) - 1.0f));
+	for (unsigned int y=0; y<cells; y++){
+		for (unsigned int x=0; x<cells; x++){
+			unsigned int a = y * side + x + 1, b = a + 1, c = a + side, d = c + 1;
+			fprintf(file, "f %u/%u/%u %u/%u/%u %u/%u/%u\n", a, a, a, b, b, b, d, d, d);
+			fprintf(file, "f %u/%u/%u %u/%u/%u %u/%u/%u\n", a, a, a, d, d, d, c, c, c);
+		}
+	}
+	return fclose(file) == 0;
+}
+
+// The grid for about 'triangles' triangles
+static inline unsigned int gridCells(unsigned int triangles){
+	unsigned int cells = 1;
+	while (2 * (cells + 1) * (cells + 1) <= triangles)
+		cells++;
+	return cells;
+}
+
+// What main returns
+static inline int testResult(){
+	if (FailedChecks != 0){
+		printf("%u checks failed\n", FailedChecks);
+		return 1;
+	}
+	printf("All checks passed\n");
+	return 0;
+}
+
+#endif
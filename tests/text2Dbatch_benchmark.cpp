@@ -0,0 +1,108 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+#include <chrono>
+
+#include <glm/glm.hpp>
+
+#include <common/text2Dbatch.hpp>
+
+#include "testing.hpp"
+
+// "text2Dbatch_benchmark [labels]" times the quads of a HUD of 'labels' labels (500 by default) per frame :
+// appendText2DQuads into one array, which keeps its memory from one frame to the next, against what
+// printText2D used to do, 6 vertices and 6 UVs per glyph in new vectors for each label.
+// The indexed quads must draw the same triangles as the old vertices.
+
+static const int Frames = 200;
+
+// The old printText2D, without OpenGL
+static void oldText2DVertices(const char * text, int x, int y, int size, std::vector<glm::vec2> & vertices, std::vector<glm::vec2> & UVs){
+	unsigned int length = strlen(text);
+	for ( unsigned int i=0 ; i<length ; i++ ){
+		glm::vec2 vertex_up_left    = glm::vec2( x+i*size     , y+size );
+		glm::vec2 vertex_up_right   = glm::vec2( x+i*size+size, y+size );
+		glm::vec2 vertex_down_right = glm::vec2( x+i*size+size, y      );
+		glm::vec2 vertex_down_left  = glm::vec2( x+i*size     , y      );
+		vertices.push_back(vertex_up_left   );
+		vertices.push_back(vertex_down_left );
+		vertices.push_back(vertex_up_right  );
+		vertices.push_back(vertex_down_right);
+		vertices.push_back(vertex_up_right);
+		vertices.push_back(vertex_down_left);
+
+		char character = text[i];
+		float uv_x = (character%16)/16.0f;
+		float uv_y = (character/16)/16.0f;
+		glm::vec2 uv_up_left    = glm::vec2( uv_x           , uv_y );
+		glm::vec2 uv_up_right   = glm::vec2( uv_x+1.0f/16.0f, uv_y );
+		glm::vec2 uv_down_right = glm::vec2( uv_x+1.0f/16.0f, (uv_y + 1.0f/16.0f) );
+		glm::vec2 uv_down_left  = glm::vec2( uv_x           , (uv_y + 1.0f/16.0f) );
+		UVs.push_back(uv_up_left   );
+		UVs.push_back(uv_down_left );
+		UVs.push_back(uv_up_right  );
+		UVs.push_back(uv_down_right);
+		UVs.push_back(uv_up_right);
+		UVs.push_back(uv_down_left);
+	}
+}
+
+int main(int argc, char * argv[]){
+	int labelCount = argc > 1 ? atoi(argv[1]) : 500;
+
+	// Labels like a HUD's : "12.3 ms", "label 42 : 7"...
+	std::vector<std::vector<char> > labels(labelCount, std::vector<char>(32));
+	size_t glyphCount = 0;
+	for (int l=0; l<labelCount; l++){
+		snprintf(&labels[l][0], 32, l % 2 ? "%d.%d ms" : "label %d : %d", l, (l * 7) % 1000);
+		glyphCount += strlen(&labels[l][0]);
+	}
+
+	// Same triangles : the old vertices of each label, against the indexed new ones
+	std::vector<Text2DVertex> quads;
+	std::vector<glm::vec2> oldVertices, oldUVs;
+	for (int l=0; l<labelCount; l++){
+		appendText2DQuads(&labels[l][0], 10, 20 * l, 16 + l % 3, quads);
+		oldText2DVertices(&labels[l][0], 10, 20 * l, 16 + l % 3, oldVertices, oldUVs);
+	}
+	std::vector<unsigned int> indices;
+	buildText2DIndices(quads.size() / 4, indices);
+	unsigned int different = 0;
+	if (CHECK(quads.size() == glyphCount * 4 && indices.size() == oldVertices.size())){
+		for (size_t i=0; i<indices.size(); i++){
+			const Text2DVertex & v = quads[indices[i]];
+			different += v.position != oldVertices[i] || v.uv != oldUVs[i];
+		}
+	}
+	CHECK(different == 0);
+
+	// The old way
+	float checksum = 0.0f;
+	std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+	for (int frame=0; frame<Frames; frame++){
+		for (int l=0; l<labelCount; l++){
+			std::vector<glm::vec2> vertices, UVs;
+			oldText2DVertices(&labels[l][0], 10, 20 * l, 16, vertices, UVs);
+			checksum += vertices.back().x + UVs.back().y;
+		}
+	}
+	double oldMilliseconds = millisecondsSince(start);
+
+	// The batch : one array for the whole frame, cleared but never freed
+	quads.clear();
+	start = std::chrono::high_resolution_clock::now();
+	for (int frame=0; frame<Frames; frame++){
+		for (int l=0; l<labelCount; l++)
+			appendText2DQuads(&labels[l][0], 10, 20 * l, 16, quads);
+		checksum += quads.back().position.x + quads.back().uv.y;
+		quads.clear();
+	}
+	double newMilliseconds = millisecondsSince(start);
+
+	double glyphs = (double)glyphCount * Frames;
+	printf("%d labels, %u glyphs per frame (checksum %g)\n", labelCount, (unsigned int)glyphCount, checksum);
+	printf("new vectors per label : %7.3f ms per frame, %6.2f ns per glyph\n", oldMilliseconds / Frames, oldMilliseconds * 1e6 / glyphs);
+	printf("one batch per frame   : %7.3f ms per frame, %6.2f ns per glyph\n", newMilliseconds / Frames, newMilliseconds * 1e6 / glyphs);
+	return testResult();
+}
@@ -0,0 +1,326 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+#include <string>
+#include <chrono>
+
+#include <glm/glm.hpp>
+
+#include <GL/glew.h>
+
+#include <common/textureimage.hpp>
+#include <common/texturecompressor.hpp>
+#include <common/mipmapgenerator.hpp>
+#include <common/textureatlas.hpp>
+
+#include "testing.hpp"
+
+// Checks packAtlasRects on random sets of rectangles : no two padded cells overlap, all are in their page,
+// and the pages are well filled. Then builds an atlas of generated BMP, TGA and DDS files : sampling the
+// pages through the UVs given by remapAtlasUVs must give back each texel of each image, and the box
+// filtered levels must not mix two images. The cooked atlas must read back the same.
+
+static unsigned int RandomState = 12345;
+static unsigned int nextRandom(){
+	RandomState = RandomState * 1664525u + 1013904223u;
+	return RandomState >> 8;
+}
+
+static unsigned int roundUp(unsigned int value, unsigned int alignment){
+	return (value + alignment - 1) / alignment * alignment;
+}
+
+// The cell of a packed rectangle : the rectangle, its padding, rounded up to the alignment
+struct Cell{
+	unsigned int page, x0, y0, x1, y1;
+};
+
+static Cell cellOf(const AtlasRect & r, unsigned int padding, unsigned int alignment){
+	Cell c = { r.page, r.x - padding, r.y - padding, 0, 0 };
+	c.x1 = c.x0 + roundUp(r.width  + 2*padding, alignment);
+	c.y1 = c.y0 + roundUp(r.height + 2*padding, alignment);
+	return c;
+}
+
+static void checkPacking(const char * name, unsigned int count, unsigned int minSize, unsigned int maxSize,
+	unsigned int pageSize, unsigned int padding, unsigned int alignment, double minimumEfficiency){
+	std::vector<AtlasRect> rects(count);
+	for (unsigned int i=0; i<count; i++){
+		rects[i].width  = minSize + nextRandom() % (maxSize - minSize + 1);
+		rects[i].height = minSize + nextRandom() % (maxSize - minSize + 1);
+	}
+	std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+	unsigned int pageCount = packAtlasRects(rects, pageSize, padding, alignment);
+	double milliseconds = millisecondsSince(start);
+	if (!CHECK(pageCount > 0))
+		return;
+
+	unsigned int outside = 0, overlaps = 0, misaligned = 0;
+	std::vector<Cell> cells(count);
+	std::vector<double> cellArea(pageCount, 0.0);
+	std::vector<unsigned int> pageHeight(pageCount, 0);
+	for (unsigned int i=0; i<count; i++){
+		Cell & c = cells[i];
+		c = cellOf(rects[i], padding, alignment);
+		outside += (c.page >= pageCount || rects[i].x < padding || rects[i].y < padding || c.x1 > pageSize || c.y1 > pageSize) ? 1 : 0;
+		misaligned += (c.x0 % alignment || c.y0 % alignment) ? 1 : 0;
+		if (c.page < pageCount){
+			cellArea[c.page] += (double)(c.x1 - c.x0) * (c.y1 - c.y0);
+			pageHeight[c.page] = c.y1 > pageHeight[c.page] ? c.y1 : pageHeight[c.page];
+		}
+	}
+	for (unsigned int i=0; i<count; i++)
+		for (unsigned int j=i+1; j<count; j++)
+			if (cells[i].page == cells[j].page && cells[i].x0 < cells[j].x1 && cells[j].x0 < cells[i].x1 &&
+			    cells[i].y0 < cells[j].y1 && cells[j].y0 < cells[i].y1)
+				overlaps++;
+
+	// The cells over the area of the pages, up to the top of the highest cell of each page
+	double used = 0.0, area = 0.0;
+	for (unsigned int p=0; p<pageCount; p++){
+		used += cellArea[p];
+		area += (double)pageSize * pageHeight[p];
+	}
+	double efficiency = used / area;
+	printf("%-36s : %4u rectangles in %2u pages, %5.1f%% filled, %u outside, %u overlaps, %u misaligned, %7.2f ms\n",
+		name, count, pageCount, efficiency * 100.0, outside, overlaps, misaligned, milliseconds);
+	CHECK(outside == 0 && overlaps == 0 && misaligned == 0);
+	CHECK(efficiency >= minimumEfficiency);
+}
+
+// A generated image, and how its UVs look when they come from loadOBJ
+struct AtlasImage{
+	std::string path;
+	unsigned int width;
+	unsigned int height;
+	bool topFirst;                      // DDS : the UVs of loadOBJ are inverted, in [-1,0]
+	std::vector<unsigned char> rgba;    // top row first
+};
+
+static void writeBytes(const char * path, const std::vector<unsigned char> & bytes){
+	FILE * file = fopen(path, "wb");
+	fwrite(&bytes[0], 1, bytes.size(), file);
+	fclose(file);
+}
+
+static void writeU32(std::vector<unsigned char> & bytes, size_t offset, unsigned int v){
+	memcpy(&bytes[offset], &v, 4);
+}
+
+static void writeImage(const AtlasImage & image){
+	const char * extension = strrchr(image.path.c_str(), '.');
+	unsigned int w = image.width, h = image.height;
+	if (strcmp(extension, ".bmp") == 0){
+		size_t rowSize = ((size_t)w * 3 + 3) & ~(size_t)3;
+		std::vector<unsigned char> bytes(54 + rowSize * h, 0);
+		bytes[0] = 'B'; bytes[1] = 'M';
+		writeU32(bytes, 0x0A, 54);
+		writeU32(bytes, 0x0E, 40);
+		writeU32(bytes, 0x12, w);
+		writeU32(bytes, 0x16, h);
+		writeU32(bytes, 0x1A, 1 | (24 << 16));
+		for (unsigned int y=0; y<h; y++){
+			for (unsigned int x=0; x<w; x++){
+				const unsigned char * p = &image.rgba[((size_t)(h - 1 - y) * w + x) * 4];
+				unsigned char * out = &bytes[54 + y * rowSize + x * 3];
+				out[0] = p[2]; out[1] = p[1]; out[2] = p[0];
+			}
+		}
+		writeBytes(image.path.c_str(), bytes);
+	}else if (strcmp(extension, ".tga") == 0){
+		std::vector<unsigned char> bytes(18 + (size_t)w * h * 4, 0);
+		bytes[2] = 2;
+		bytes[12] = (unsigned char)w; bytes[13] = (unsigned char)(w >> 8);
+		bytes[14] = (unsigned char)h; bytes[15] = (unsigned char)(h >> 8);
+		bytes[16] = 32;
+		for (unsigned int y=0; y<h; y++){
+			for (unsigned int x=0; x<w; x++){
+				const unsigned char * p = &image.rgba[((size_t)(h - 1 - y) * w + x) * 4];
+				unsigned char * out = &bytes[18 + ((size_t)y * w + x) * 4];
+				out[0] = p[2]; out[1] = p[1]; out[2] = p[0]; out[3] = p[3];
+			}
+		}
+		writeBytes(image.path.c_str(), bytes);
+	}else{
+		TextureImage dds;
+		memset(&dds.file, 0, sizeof(dds.file));
+		dds.width = w;
+		dds.height = h;
+		dds.levelCount = 1;
+		dds.layerCount = 1;
+		dds.faceCount = 1;
+		dds.isArray = false;
+		dds.compressed = false;
+		dds.blockSize = 4;
+		dds.internalFormat = GL_RGBA8;
+		dds.format = GL_RGBA;
+		dds.type = GL_UNSIGNED_BYTE;
+		dds.generateMipmaps = false;
+		TextureLevel level = { &image.rgba[0], image.rgba.size(), w, h };
+		dds.levels.push_back(level);
+		writeDDSImage(image.path.c_str(), dds);
+	}
+}
+
+// Random texels, or a single color : 'color' is 0 for random texels
+static void makeImages(std::vector<AtlasImage> & images, unsigned int count, unsigned int color){
+	const char * extensions[3] = { ".bmp", ".tga", ".dds" };
+	for (unsigned int i=0; i<count; i++){
+		AtlasImage image;
+		char name[64];
+		sprintf(name, "textureatlas_test_%u%s", i, extensions[i % 3]);
+		image.path = name;
+		image.width  = 8 + nextRandom() % 120;
+		image.height = 8 + nextRandom() % 120;
+		image.topFirst = i % 3 == 2;
+		image.rgba.resize((size_t)image.width * image.height * 4);
+		for (size_t k=0; k<image.rgba.size(); k++)
+			image.rgba[k] = color ? (unsigned char)((color * (i + 1) * (k % 4 + 3)) & 0xFF) : (unsigned char)nextRandom();
+		for (size_t k=3; k<image.rgba.size() && i % 3 == 0; k+=4)
+			image.rgba[k] = 255; // no alpha in BMP files
+		writeImage(image);
+		images.push_back(image);
+	}
+}
+
+// The UVs of the center of each texel, remapped, must fall in the same texel of the page
+static void checkRemappedTexels(const TextureAtlas & atlas, const std::vector<AtlasImage> & images){
+	unsigned int wrong = 0, samples = 0;
+	for (size_t i=0; i<images.size(); i++){
+		const AtlasImage & image = images[i];
+		int entry = findAtlasEntry(atlas, image.path.c_str());
+		if (!CHECK(entry == (int)i))
+			continue;
+		std::vector<glm::vec2> uvs;
+		for (unsigned int y=0; y<image.height; y++){
+			for (unsigned int x=0; x<image.width; x++){
+				// t goes up from the first row of the texture in OpenGL : the bottom one for BMP and TGA files
+				float s = (x + 0.5f) / image.width;
+				float t = image.topFirst ? (y + 0.5f) / image.height - 1.0f : 1.0f - (y + 0.5f) / image.height;
+				uvs.push_back(glm::vec2(s, t));
+			}
+		}
+		if (!CHECK(remapAtlasUVs(atlas, (unsigned int)entry, uvs)))
+			continue;
+		const AtlasPage & page = atlas.pages[atlas.entries[entry].page];
+		for (unsigned int y=0; y<image.height; y++){
+			for (unsigned int x=0; x<image.width; x++){
+				glm::vec2 uv = uvs[(size_t)y * image.width + x];
+				unsigned int px = (unsigned int)(uv.x * page.width), py = (unsigned int)(uv.y * page.height);
+				const unsigned char * texel = &page.rgba[((size_t)py * page.width + px) * 4];
+				wrong += memcmp(texel, &image.rgba[((size_t)y * image.width + x) * 4], 4) == 0 ? 0 : 1;
+				samples++;
+			}
+		}
+	}
+	printf("remapped UVs : %u texels sampled, %u wrong\n", samples, wrong);
+	CHECK(wrong == 0);
+
+	// UVs which repeat the texture can't be remapped
+	std::vector<glm::vec2> repeated(2, glm::vec2(0.0f));
+	repeated[1] = glm::vec2(2.0f, 0.5f);
+	printf("  ");
+	CHECK(!remapAtlasUVs(atlas, 0, repeated));
+}
+
+// With single color images, each level of each page must keep the color of each cell over the whole cell
+static void checkMipmapsDontBleed(const TextureAtlas & atlas, const std::vector<AtlasImage> & images, unsigned int padding){
+	unsigned int alignment = 1u << (atlas.levelCount - 1);
+	alignment = alignment < 4 ? 4 : alignment;
+	unsigned int bleeding = 0;
+	for (size_t p=0; p<atlas.pages.size(); p++){
+		const AtlasPage & page = atlas.pages[p];
+		MipmapOptions options = { MIPMAP_BOX, true, false, false, 1 };
+		std::vector<std::vector<unsigned char> > levels;
+		generateMipmapChain(&page.rgba[0], page.width, page.height, options, levels);
+		for (size_t i=0; i<images.size(); i++){
+			const AtlasEntry & e = atlas.entries[i];
+			if (e.page != p)
+				continue;
+			unsigned int x0 = e.x - padding, y0 = e.y - padding;
+			unsigned int x1 = x0 + roundUp(e.width + 2*padding, alignment), y1 = y0 + roundUp(e.height + 2*padding, alignment);
+			for (unsigned int l=0; l<atlas.levelCount; l++){
+				unsigned int levelWidth = page.width >> l ? page.width >> l : 1;
+				for (unsigned int y=y0>>l; y<y1>>l; y++){
+					for (unsigned int x=x0>>l; x<x1>>l; x++){
+						const unsigned char * texel = &levels[l][((size_t)y * levelWidth + x) * 4];
+						for (int c=0; c<4; c++)
+							bleeding += abs((int)texel[c] - (int)images[i].rgba[c]) > 1 ? 1 : 0;
+					}
+				}
+			}
+		}
+	}
+	printf("single color images, %u levels : %u texels of other images in the cells\n", atlas.levelCount, bleeding);
+	CHECK(bleeding == 0);
+}
+
+static void removeImages(const std::vector<AtlasImage> & images){
+	for (size_t i=0; i<images.size(); i++)
+		remove(images[i].path.c_str());
+}
+
+static void checkAtlas(){
+	std::vector<AtlasImage> images;
+	makeImages(images, 30, 0);
+	std::vector<std::string> paths;
+	for (size_t i=0; i<images.size(); i++)
+		paths.push_back(images[i].path);
+
+	AtlasOptions options = { 512, 4 };
+	TextureAtlas atlas;
+	if (CHECK(buildTextureAtlas(paths, options, atlas))){
+		printf("atlas : %u images in %u pages, %u levels\n", (unsigned int)images.size(), (unsigned int)atlas.pages.size(), atlas.levelCount);
+		checkRemappedTexels(atlas, images);
+	}
+
+	// Cooked, then read back : the same entries, and pages which load as plain 2D textures
+	TextureAtlas cooked, loaded;
+	if (CHECK(cookTextureAtlas(paths, options, BLOCK_BC1, "textureatlas_test.atlas", cooked)) &&
+	    CHECK(loadTextureAtlas("textureatlas_test.atlas", loaded))){
+		CHECK(loaded.levelCount == cooked.levelCount && loaded.pages.size() == cooked.pages.size() && loaded.entries.size() == cooked.entries.size());
+		for (size_t i=0; i<loaded.entries.size() && i<cooked.entries.size(); i++){
+			const AtlasEntry & a = loaded.entries[i];
+			const AtlasEntry & b = cooked.entries[i];
+			CHECK(a.name == b.name && a.page == b.page && a.x == b.x && a.y == b.y && a.width == b.width && a.height == b.height && a.flipV == b.flipV);
+		}
+		for (size_t p=0; p<loaded.pages.size(); p++){
+			TextureImage page;
+			if (CHECK(loadDDSImage(loaded.pages[p].path.c_str(), page)))
+				CHECK(!page.isArray && page.width == loaded.pages[p].width && page.height == loaded.pages[p].height && page.levelCount == loaded.levelCount);
+			unloadTextureImage(page);
+			remove(loaded.pages[p].path.c_str());
+		}
+	}
+	remove("textureatlas_test.atlas");
+	removeImages(images);
+
+	// Bigger padding : more levels
+	std::vector<AtlasImage> plain;
+	makeImages(plain, 20, 7);
+	paths.clear();
+	for (size_t i=0; i<plain.size(); i++)
+		paths.push_back(plain[i].path);
+	AtlasOptions paddedOptions = { 1024, 16 };
+	TextureAtlas padded;
+	if (CHECK(buildTextureAtlas(paths, paddedOptions, padded)))
+		checkMipmapsDontBleed(padded, plain, paddedOptions.padding);
+	removeImages(plain);
+}
+
+int main(){
+	checkPacking("small squares-ish, no padding",         500,   4,  64, 1024, 0, 1, 0.85);
+	checkPacking("mixed sizes, padding 4",                  400,   8, 128, 1024, 4, 4, 0.85);
+	checkPacking("mixed sizes, padding 8, aligned 16",      400,   8, 128, 2048, 8, 16, 0.80);
+	checkPacking("big ones, several pages",                 100,  64, 400, 1024, 2, 4, 0.75);
+
+	std::vector<AtlasRect> tooBig(1);
+	tooBig[0].width = 1020;
+	tooBig[0].height = 10;
+	printf("  ");
+	CHECK(packAtlasRects(tooBig, 1024, 4, 4) == 0);
+
+	checkAtlas();
+	return testResult();
+}
@@ -0,0 +1,174 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+#include <string>
+#include <chrono>
+
+#include <GL/glew.h>
+
+#include <common/textureimage.hpp>
+#include <common/texturecompressor.hpp>
+
+#include "testing.hpp"
+
+// "texturecompressor_benchmark [image.bmp...]" compresses each image (uvtemplate.bmp of tutorial 5 and
+// normal.bmp of tutorial 13 by default) to BC1, BC3 and BC7, on 1 thread and on all of them, and prints
+// the PSNR and the throughput of each (the PSNR of the default images is checked too). Then it cooks them to BC7 with cookTexture and loadTextureImage_cooked :
+// the .DDS files must load back as plain 2D textures, whose level 0 is what compressImage gives.
+
+struct NamedFormat{
+	const char * name;
+	BlockFormat format;
+};
+
+static const NamedFormat Formats[3] = {
+	{ "BC1", BLOCK_BC1 },
+	{ "BC3", BLOCK_BC3 },
+	{ "BC7", BLOCK_BC7 },
+};
+
+// The PSNR of the default images must not get worse, for each format. normal.bmp is noisy : even the best line
+// through the colors of each 4x4 block, without any quantization, only gives about 20 dB.
+struct DefaultImage{
+	const char * path;
+	float minimumPSNR[3];
+};
+
+static const DefaultImage DefaultImages[2] = {
+	{ "tutorial05_textured_cube/uvtemplate.bmp", { 33.0f, 34.0f, 40.5f } },
+	{ "tutorial13_normal_mapping/normal.bmp",    { 18.5f, 20.0f, 20.5f } },
+};
+
+// The RGBA8 pixels that cookTexture compresses : top row first
+static bool loadRGBA(const char * path, unsigned int & width, unsigned int & height, std::vector<unsigned char> & rgba){
+	TextureImage image;
+	if (!loadTextureImage(path, image))
+		return false;
+	width = image.width;
+	height = image.height;
+	unsigned int bytesPerPixel = image.blockSize;
+	rgba.resize((size_t)width * height * 4);
+	for (unsigned int y=0; y<height; y++){
+		const unsigned char * row = image.levels[0].data + (size_t)(height - 1 - y) * width * bytesPerPixel;
+		for (unsigned int x=0; x<width; x++){
+			unsigned char * p = &rgba[((size_t)y * width + x) * 4];
+			p[0] = row[x*bytesPerPixel + 2];
+			p[1] = row[x*bytesPerPixel + 1];
+			p[2] = row[x*bytesPerPixel + 0];
+			p[3] = bytesPerPixel == 4 ? row[x*bytesPerPixel + 3] : 255;
+		}
+	}
+	unloadTextureImage(image);
+	return true;
+}
+
+static bool copyFile(const char * from, const char * to){
+	FILE * in = fopen(from, "rb");
+	if (in == NULL)
+		return false;
+	FILE * out = fopen(to, "wb");
+	bool ok = out != NULL;
+	char buffer[65536];
+	size_t size;
+	while (ok && (size = fread(buffer, 1, sizeof(buffer), in)) > 0)
+		ok = fwrite(buffer, 1, size, out) == size;
+	fclose(in);
+	if (out)
+		ok = fclose(out) == 0 && ok;
+	return ok;
+}
+
+static unsigned int fullChainLevels(unsigned int width, unsigned int height){
+	unsigned int levels = 1;
+	while ((width | height) >> levels)
+		levels++;
+	return levels;
+}
+
+// A cooked file : one 2D texture with all its levels, level 0 being 'blocks'
+static bool isCookedBC7(const TextureImage & cooked, unsigned int width, unsigned int height, const std::vector<unsigned char> & blocks){
+	return !cooked.isArray && cooked.layerCount == 1 && cooked.faceCount == 1 && cooked.compressed &&
+		cooked.internalFormat == GL_COMPRESSED_RGBA_BPTC_UNORM && cooked.width == width && cooked.height == height &&
+		cooked.levelCount == fullChainLevels(width, height) &&
+		cooked.levels[0].size == blocks.size() && memcmp(cooked.levels[0].data, &blocks[0], blocks.size()) == 0;
+}
+
+static void benchmarkImage(const char * path, const float * minimumPSNR){
+	unsigned int width = 0, height = 0;
+	std::vector<unsigned char> rgba;
+	if (!CHECK(loadRGBA(path, width, height, rgba)))
+		return;
+	double pixels = (double)width * height;
+	printf("%s : %ux%u\n", path, width, height);
+
+	std::vector<unsigned char> bc7Blocks;
+	float psnrs[3];
+	for (size_t f=0; f<sizeof(Formats)/sizeof(Formats[0]); f++){
+		std::vector<unsigned char> blocks(compressedImageSize(width, height, Formats[f].format));
+		double best[2] = { 1e30, 1e30 }; // [1 thread, all]
+		for (int run=0; run<3; run++){
+			for (int t=0; t<2; t++){
+				std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+				compressImage(&rgba[0], width, height, Formats[f].format, &blocks[0], t == 0 ? 1 : 0);
+				double milliseconds = millisecondsSince(start);
+				best[t] = milliseconds < best[t] ? milliseconds : best[t];
+			}
+		}
+		float psnr = compressedImagePSNR(&rgba[0], width, height, Formats[f].format, &blocks[0]);
+		printf("  %s : PSNR %6.2f dB, 1 thread %8.2f ms (%6.2f Mpixels/s), all threads %8.2f ms (%6.2f Mpixels/s)\n",
+			Formats[f].name, psnr, best[0], pixels / (best[0] * 1000.0), best[1], pixels / (best[1] * 1000.0));
+		psnrs[f] = psnr;
+		if (minimumPSNR)
+			CHECK(psnr >= minimumPSNR[f]);
+		if (Formats[f].format == BLOCK_BC7)
+			bc7Blocks = blocks;
+	}
+
+	CHECK(psnrs[2] >= psnrs[0]);
+
+	// The cooker, and the cooked files that the tutorials load, on a copy : they are written next to the image
+	const char * extension = strrchr(path, '.');
+	std::string copyPath = std::string("texturecompressor_benchmark") + (extension ? extension : ".bmp");
+	std::string ddspath = copyPath + ".dds";
+	if (!CHECK(copyFile(path, copyPath.c_str())))
+		return;
+	remove(ddspath.c_str());
+	std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+	CHECK(cookTexture(copyPath.c_str(), ddspath.c_str(), BLOCK_BC7, 0));
+	double cookTime = millisecondsSince(start);
+	TextureImage cooked;
+	if (CHECK(loadDDSImage(ddspath.c_str(), cooked)))
+		CHECK(isCookedBC7(cooked, width, height, bc7Blocks));
+	unloadTextureImage(cooked);
+
+	start = std::chrono::high_resolution_clock::now();
+	if (CHECK(loadTextureImage_cooked(copyPath.c_str(), BLOCK_BC7, cooked)))
+		CHECK(isCookedBC7(cooked, width, height, bc7Blocks));
+	double loadTime = millisecondsSince(start);
+	unloadTextureImage(cooked);
+	remove(ddspath.c_str());
+	remove(copyPath.c_str());
+	printf("  cookTexture BC7 with all the levels : %8.2f ms, then loadTextureImage_cooked : %6.3f ms\n\n", cookTime, loadTime);
+}
+
+// The minimums of a default image, given by any path which ends like its own
+static const float * defaultMinimumPSNR(const char * path){
+	for (int i=0; i<2; i++){
+		size_t length = strlen(path), defaultLength = strlen(DefaultImages[i].path);
+		if (length >= defaultLength && strcmp(path + length - defaultLength, DefaultImages[i].path) == 0)
+			return DefaultImages[i].minimumPSNR;
+	}
+	return NULL;
+}
+
+int main(int argc, char * argv[]){
+	if (argc > 1){
+		for (int i=1; i<argc; i++)
+			benchmarkImage(argv[i], defaultMinimumPSNR(argv[i]));
+	}else{
+		for (int i=0; i<2; i++)
+			benchmarkImage(DefaultImages[i].path, DefaultImages[i].minimumPSNR);
+	}
+	return testResult();
+}
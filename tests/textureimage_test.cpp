@@ -0,0 +1,227 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+#include <chrono>
+
+#include <GL/glew.h>
+
+#include <common/textureimage.hpp>
+
+#include "testing.hpp"
+
+// Checks loadDDSImage and writeDDSImage on generated DDS files : DX10 files with a single layer are plain
+// 2D textures or cubemaps, not arrays, like the old-style files. Each level must point to its own bytes
+// in the file, and truncated or invalid files must be refused.
+
+#define FOURCC(a, b, c, d) ((unsigned int)(a) | ((unsigned int)(b) << 8) | ((unsigned int)(c) << 16) | ((unsigned int)(d) << 24))
+
+static const char * Path = "textureimage_test.dds";
+
+// What to put in the header of a generated file
+struct DDSDescription{
+	unsigned int fourCC;            // FOURCC('D','X','1','0') for a DX10 header
+	unsigned int dxgiFormat;        // with a DX10 header only
+	bool compressed;
+	unsigned int blockSize;
+	unsigned int width;
+	unsigned int height;
+	unsigned int levelCount;
+	unsigned int arraySize;         // written in the DX10 header, even if it is 0
+	bool cube;
+	unsigned int resourceDimension; // 3 for 2D textures, 4 for volume textures
+};
+
+static DDSDescription dx10Description(unsigned int dxgiFormat, bool compressed, unsigned int blockSize, unsigned int arraySize){
+	DDSDescription d = { FOURCC('D','X','1','0'), dxgiFormat, compressed, blockSize, 64, 32, 7, arraySize, false, 3 };
+	return d;
+}
+
+static DDSDescription fourCCDescription(unsigned int fourCC, unsigned int blockSize){
+	DDSDescription d = { fourCC, 0, true, blockSize, 64, 32, 7, 1, false, 3 };
+	return d;
+}
+
+static size_t levelSize(const DDSDescription & d, unsigned int level){
+	unsigned int w = d.width >> level;  if (w < 1) w = 1;
+	unsigned int h = d.height >> level; if (h < 1) h = 1;
+	if (d.compressed)
+		return (size_t)((w+3)/4) * ((h+3)/4) * d.blockSize;
+	return (size_t)w * h * d.blockSize;
+}
+
+static size_t headerSize(const DDSDescription & d){
+	return 4 + 124 + (d.fourCC == FOURCC('D','X','1','0') ? 20 : 0);
+}
+
+static size_t pixelsSize(const DDSDescription & d){
+	size_t size = 0;
+	for (unsigned int level=0; level<d.levelCount; level++)
+		size += levelSize(d, level);
+	return size * (d.cube ? 6 : 1) * (d.arraySize ? d.arraySize : 1);
+}
+
+// The byte at 'offset' in the file, after the headers
+static unsigned char pattern(size_t offset){
+	return (unsigned char)((offset * 7 + offset / 251) & 0xFF);
+}
+
+static void writeU32(std::vector<unsigned char> & file, size_t offset, unsigned int v){
+	memcpy(&file[offset], &v, 4);
+}
+
+// Writes the file described by 'd', without its last 'missing' bytes
+static void writeDDS(const DDSDescription & d, size_t missing){
+	size_t dataOffset = headerSize(d);
+	std::vector<unsigned char> file(dataOffset + pixelsSize(d), 0);
+	memcpy(&file[0], "DDS ", 4);
+	writeU32(file, 4, 124);
+	writeU32(file, 8, 0x1 | 0x2 | 0x4 | 0x1000 | 0x20000);
+	writeU32(file, 12, d.height);
+	writeU32(file, 16, d.width);
+	writeU32(file, 28, d.levelCount);
+	writeU32(file, 76, 32);
+	writeU32(file, 80, 0x4); // DDPF_FOURCC
+	writeU32(file, 84, d.fourCC);
+	writeU32(file, 108, 0x1000);
+	if (d.fourCC == FOURCC('D','X','1','0')){
+		writeU32(file, 128, d.dxgiFormat);
+		writeU32(file, 132, d.resourceDimension);
+		writeU32(file, 136, d.cube ? 0x4 : 0);
+		writeU32(file, 140, d.arraySize);
+	}else if (d.cube){
+		writeU32(file, 112, 0x200 | 0xFC00);
+	}
+	for (size_t i=dataOffset; i<file.size(); i++)
+		file[i] = pattern(i - dataOffset);
+	FILE * out = fopen(Path, "wb");
+	fwrite(&file[0], 1, file.size() - missing, out);
+	fclose(out);
+}
+
+// Each level must be where the DDS layout puts it : all the levels of face 0 of layer 0, then face 1, ...
+static bool levelsInPlace(const DDSDescription & d, const TextureImage & image){
+	unsigned int faceCount = d.cube ? 6 : 1;
+	const unsigned char * pixels = image.file.data + headerSize(d);
+	size_t offset = 0;
+	for (unsigned int layer=0; layer<image.layerCount; layer++){
+		for (unsigned int face=0; face<faceCount; face++){
+			for (unsigned int level=0; level<d.levelCount; level++){
+				const TextureLevel & l = getTextureLevel(image, layer, face, level);
+				unsigned int w = d.width >> level, h = d.height >> level;
+				if (l.data != pixels + offset || l.size != levelSize(d, level) || l.width != (w ? w : 1) || l.height != (h ? h : 1))
+					return false;
+				if (l.data[0] != pattern(offset) || l.data[l.size - 1] != pattern(offset + l.size - 1))
+					return false;
+				offset += l.size;
+			}
+		}
+	}
+	return offset == pixelsSize(d);
+}
+
+static void checkLoad(const char * name, const DDSDescription & d, unsigned int internalFormat, bool expectArray){
+	writeDDS(d, 0);
+	TextureImage image;
+	bool loaded = loadDDSImage(Path, image);
+	printf("%-28s : %s\n", name, !loaded ? "not loaded" : image.isArray ? "array" : "not an array");
+	if (!CHECK(loaded))
+		return;
+	unsigned int layerCount = d.arraySize ? d.arraySize : 1;
+	CHECK(image.isArray == expectArray);
+	CHECK(image.isArray == (image.layerCount > 1));
+	CHECK(image.layerCount == layerCount);
+	CHECK(image.faceCount == (d.cube ? 6u : 1u));
+	CHECK(image.width == d.width && image.height == d.height && image.levelCount == d.levelCount);
+	CHECK(image.internalFormat == internalFormat && image.compressed == d.compressed && image.blockSize == d.blockSize);
+	CHECK(image.levels.size() == (size_t)layerCount * image.faceCount * d.levelCount);
+	CHECK(levelsInPlace(d, image));
+	CHECK(textureImageSize(image) == pixelsSize(d));
+	unloadTextureImage(image);
+}
+
+static void checkRefused(const char * name, const DDSDescription & d, size_t missing){
+	writeDDS(d, missing);
+	TextureImage image;
+	printf("%-28s : ", name);
+	CHECK(!loadDDSImage(Path, image));
+}
+
+// writeDDSImage, then loadDDSImage again : same description, same bytes
+static void checkRoundTrip(const char * name, const DDSDescription & d){
+	writeDDS(d, 0);
+	TextureImage image;
+	if (!CHECK(loadDDSImage(Path, image)))
+		return;
+	std::vector<unsigned char> pixels(image.levels[0].data, image.levels[0].data + textureImageSize(image));
+	const char * copyPath = "textureimage_test_copy.dds";
+	CHECK(writeDDSImage(copyPath, image));
+	TextureImage copy;
+	if (CHECK(loadDDSImage(copyPath, copy))){
+		printf("%-28s : written back, %s\n", name, copy.isArray ? "array" : "not an array");
+		CHECK(copy.isArray == image.isArray && copy.layerCount == image.layerCount && copy.faceCount == image.faceCount);
+		CHECK(copy.width == image.width && copy.height == image.height && copy.levelCount == image.levelCount);
+		CHECK(copy.internalFormat == image.internalFormat && copy.format == image.format);
+		CHECK(textureImageSize(copy) == pixels.size() && memcmp(copy.levels[0].data, &pixels[0], pixels.size()) == 0);
+	}
+	unloadTextureImage(copy);
+	unloadTextureImage(image);
+	remove(copyPath);
+}
+
+int main(){
+	// Single layer DX10 files, like texconv and many other tools write them
+	checkLoad("DX10 BC1, 1 layer",        dx10Description(71, true,  8, 1), GL_COMPRESSED_RGBA_S3TC_DXT1_EXT, false);
+	checkLoad("DX10 BC3, 1 layer",        dx10Description(77, true, 16, 1), GL_COMPRESSED_RGBA_S3TC_DXT5_EXT, false);
+	checkLoad("DX10 BC7, 1 layer",        dx10Description(98, true, 16, 1), GL_COMPRESSED_RGBA_BPTC_UNORM, false);
+	checkLoad("DX10 BC7 sRGB, 1 layer",   dx10Description(99, true, 16, 1), GL_COMPRESSED_SRGB_ALPHA_BPTC_UNORM, false);
+	checkLoad("DX10 RGBA8 sRGB, 1 layer", dx10Description(29, false, 4, 1), GL_SRGB8_ALPHA8, false);
+	checkLoad("DX10 R8, 1 layer",         dx10Description(61, false, 1, 1), GL_R8, false);
+	DDSDescription cube = dx10Description(98, true, 16, 1);
+	cube.cube = true;
+	cube.height = cube.width;
+	checkLoad("DX10 BC7 cubemap",         cube, GL_COMPRESSED_RGBA_BPTC_UNORM, false);
+
+	// Arrays
+	checkLoad("DX10 BC7, 4 layers",       dx10Description(98, true, 16, 4), GL_COMPRESSED_RGBA_BPTC_UNORM, true);
+	checkLoad("DX10 BGRA8, 3 layers",     dx10Description(87, false, 4, 3), GL_RGBA8, true);
+	DDSDescription cubeArray = cube;
+	cubeArray.arraySize = 2;
+	checkLoad("DX10 BC7 cubemap, 2 layers", cubeArray, GL_COMPRESSED_RGBA_BPTC_UNORM, true);
+
+	// Old-style headers
+	checkLoad("DXT1",                     fourCCDescription(FOURCC('D','X','T','1'), 8), GL_COMPRESSED_RGBA_S3TC_DXT1_EXT, false);
+	checkLoad("DXT5",                     fourCCDescription(FOURCC('D','X','T','5'), 16), GL_COMPRESSED_RGBA_S3TC_DXT5_EXT, false);
+	DDSDescription oldCube = fourCCDescription(FOURCC('D','X','T','1'), 8);
+	oldCube.cube = true;
+	oldCube.height = oldCube.width;
+	checkLoad("DXT1 cubemap",             oldCube, GL_COMPRESSED_RGBA_S3TC_DXT1_EXT, false);
+
+	// Invalid files
+	checkRefused("BC7, 1 byte missing",   dx10Description(98, true, 16, 1), 1);
+	checkRefused("BC7 array, 1 layer missing", dx10Description(98, true, 16, 4), pixelsSize(dx10Description(98, true, 16, 1)));
+	checkRefused("DXT1, 1 byte missing",  fourCCDescription(FOURCC('D','X','T','1'), 8), 1);
+	checkRefused("DX10 header cut",       dx10Description(98, true, 16, 1), pixelsSize(dx10Description(98, true, 16, 1)) + 10);
+	checkRefused("DX10, 0 layers",        dx10Description(98, true, 16, 0), 0);
+	checkRefused("DX10, unknown format",  dx10Description(2, false, 16, 1), 0);
+	DDSDescription volume = dx10Description(98, true, 16, 1);
+	volume.resourceDimension = 4;
+	checkRefused("DX10 volume",           volume, 0);
+	DDSDescription notSquare = cube;
+	notSquare.height = notSquare.width / 2;
+	checkRefused("cubemap not square",    notSquare, 0);
+	DDSDescription tooManyLevels = dx10Description(98, true, 16, 1);
+	tooManyLevels.levelCount = 8;
+	checkRefused("too many levels",       tooManyLevels, 0);
+
+	// Written back by writeDDSImage : single layers stay single layers
+	checkRoundTrip("DX10 BC7, 1 layer",   dx10Description(98, true, 16, 1));
+	checkRoundTrip("DX10 BC1 sRGB, 1 layer", dx10Description(72, true, 8, 1));
+	checkRoundTrip("DX10 R8, 1 layer",    dx10Description(61, false, 1, 1));
+	checkRoundTrip("DX10 BC7, 4 layers",  dx10Description(98, true, 16, 4));
+	checkRoundTrip("DX10 BC7 cubemap",    cube);
+	checkRoundTrip("DXT5",                fourCCDescription(FOURCC('D','X','T','5'), 16));
+
+	remove(Path);
+	return testResult();
+}
@@ -0,0 +1,237 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+#include <string>
+#include <chrono>
+#include <thread>
+
+#include <GL/glew.h>
+
+#include <common/textureimage.hpp>
+#include <common/texturemanager.hpp>
+
+#include "testing.hpp"
+
+// "texturemanager_stress_test [textures]" requests 'textures' textures (800 by default) from generated
+// BMP, TGA and DDS files, missing files and corrupt ones, with 1, 4 and one thread per core, and drains
+// them with a byte budget like uploadDecodedTextures does, without OpenGL : each texture must be given
+// exactly once, with the right image (or NULL), and each drain must keep to its budget.
+// Then it destroys a manager which still has work, as when the application quits during the loading.
+
+// Each generated file starts with a pixel whose color is its number, so that images can't be mixed up
+struct StressFile{
+	std::string path;
+	unsigned int width;
+	unsigned int height;
+	bool valid;
+};
+
+static unsigned int fullChainLevels(unsigned int width, unsigned int height){
+	unsigned int levels = 1;
+	while ((width | height) >> levels)
+		levels++;
+	return levels;
+}
+
+static void writeBytes(const char * path, const std::vector<unsigned char> & bytes){
+	FILE * file = fopen(path, "wb");
+	fwrite(&bytes[0], 1, bytes.size(), file);
+	fclose(file);
+}
+
+static void writeU32(std::vector<unsigned char> & bytes, size_t offset, unsigned int v){
+	memcpy(&bytes[offset], &v, 4);
+}
+
+static std::vector<unsigned char> makeBMP(const StressFile & f, unsigned char number){
+	size_t rowSize = ((size_t)f.width * 3 + 3) & ~(size_t)3;
+	std::vector<unsigned char> bytes(54 + rowSize * f.height, 0);
+	bytes[0] = 'B';
+	bytes[1] = 'M';
+	writeU32(bytes, 0x02, (unsigned int)bytes.size());
+	writeU32(bytes, 0x0A, 54);
+	writeU32(bytes, 0x0E, 40);
+	writeU32(bytes, 0x12, f.width);
+	writeU32(bytes, 0x16, f.height);
+	writeU32(bytes, 0x1A, 1 | (24 << 16));
+	for (size_t i=54; i<bytes.size(); i++)
+		bytes[i] = (unsigned char)(i * 13);
+	bytes[54] = bytes[55] = bytes[56] = number;
+	return bytes;
+}
+
+static void writeTGA(const StressFile & f, unsigned char number, unsigned int bytesPerPixel){
+	std::vector<unsigned char> bytes(18 + (size_t)f.width * f.height * bytesPerPixel, 0);
+	bytes[2] = 2;
+	bytes[12] = (unsigned char)f.width;  bytes[13] = (unsigned char)(f.width >> 8);
+	bytes[14] = (unsigned char)f.height; bytes[15] = (unsigned char)(f.height >> 8);
+	bytes[16] = (unsigned char)(bytesPerPixel * 8);
+	for (size_t i=18; i<bytes.size(); i++)
+		bytes[i] = (unsigned char)(i * 29);
+	bytes[18] = bytes[19] = bytes[20] = number;
+	writeBytes(f.path.c_str(), bytes);
+}
+
+// An RGBA8 image with all its levels : writeDDSImage gives it a single layer DX10 header
+static void writeDDS(const StressFile & f, unsigned char number){
+	TextureImage image;
+	image.width = f.width;
+	image.height = f.height;
+	image.levelCount = fullChainLevels(f.width, f.height);
+	image.layerCount = 1;
+	image.faceCount = 1;
+	image.isArray = false;
+	image.compressed = false;
+	image.blockSize = 4;
+	image.internalFormat = GL_RGBA8;
+	image.format = GL_RGBA;
+	image.type = GL_UNSIGNED_BYTE;
+	image.generateMipmaps = false;
+	std::vector<std::vector<unsigned char> > levels(image.levelCount);
+	for (unsigned int level=0; level<image.levelCount; level++){
+		TextureLevel l;
+		l.width  = f.width  >> level; if (l.width  < 1) l.width  = 1;
+		l.height = f.height >> level; if (l.height < 1) l.height = 1;
+		levels[level].assign((size_t)l.width * l.height * 4, (unsigned char)(level * 40));
+		levels[level][0] = levels[level][1] = levels[level][2] = number;
+		l.data = &levels[level][0];
+		l.size = levels[level].size();
+		image.levels.push_back(l);
+	}
+	writeDDSImage(f.path.c_str(), image);
+}
+
+static void makeFiles(std::vector<StressFile> & files){
+	const unsigned int sizes[6][2] = { { 256, 256 }, { 64, 16 }, { 1, 1 }, { 100, 37 }, { 512, 128 }, { 3, 200 } };
+	for (unsigned int i=0; i<24; i++){
+		StressFile f;
+		const char * extensions[4] = { ".bmp", ".tga", ".tga", ".dds" };
+		char name[64];
+		sprintf(name, "texturemanager_stress_%u%s", i, extensions[i % 4]);
+		f.path = name;
+		f.width = sizes[i % 6][0];
+		f.height = sizes[i % 6][1];
+		f.valid = true;
+		if (i % 4 == 0)      writeBytes(name, makeBMP(f, (unsigned char)i));
+		else if (i % 4 == 1) writeTGA(f, (unsigned char)i, 3);
+		else if (i % 4 == 2) writeTGA(f, (unsigned char)i, 4);
+		else                 writeDDS(f, (unsigned char)i);
+		files.push_back(f);
+	}
+	// A missing file, a truncated BMP, and a file which isn't a DDS file at all
+	StressFile missing = { "texturemanager_stress_missing.dds", 0, 0, false };
+	files.push_back(missing);
+	StressFile truncated = { "texturemanager_stress_truncated.bmp", 64, 64, false };
+	std::vector<unsigned char> bytes = makeBMP(truncated, 0);
+	bytes.resize(bytes.size() / 2);
+	writeBytes(truncated.path.c_str(), bytes);
+	files.push_back(truncated);
+	StressFile garbage = { "texturemanager_stress_garbage.dds", 0, 0, false };
+	bytes.assign(200, 'D');
+	writeBytes(garbage.path.c_str(), bytes);
+	files.push_back(garbage);
+}
+
+// The 24 valid files, and one of the 3 invalid ones every 50 textures
+static unsigned int fileNumber(unsigned int userID){
+	return userID % 50 == 49 ? 24 + userID / 50 % 3 : userID % 24;
+}
+
+// What the upload function sees
+struct StressState{
+	const std::vector<StressFile> * files;
+	std::vector<unsigned int> uploads;  // per userID
+	unsigned int wrongImages;
+	size_t drainBytes;                  // of the current drain
+	unsigned int drainImages;
+};
+
+static void checkUpload(unsigned int userID, const TextureImage * image, void * userData){
+	StressState & state = *(StressState *)userData;
+	const StressFile & f = (*state.files)[fileNumber(userID)];
+	state.uploads[userID]++;
+	state.drainImages++;
+	if (image == NULL){
+		state.wrongImages += f.valid ? 1 : 0;
+		return;
+	}
+	state.drainBytes += textureImageSize(*image);
+	unsigned char number = (unsigned char)fileNumber(userID);
+	const TextureLevel & level0 = image->levels[0];
+	bool right = f.valid && !image->isArray && image->layerCount == 1 && image->faceCount == 1 &&
+		image->width == f.width && image->height == f.height && !image->generateMipmaps &&
+		image->levelCount == fullChainLevels(f.width, f.height) && image->levels.size() == image->levelCount &&
+		level0.width == f.width && level0.data[0] == number && level0.data[1] == number && level0.data[2] == number;
+	state.wrongImages += right ? 0 : 1;
+}
+
+static void stress(const std::vector<StressFile> & files, unsigned int textureCount, unsigned int threadCount, size_t byteBudget){
+	StressState state;
+	state.files = &files;
+	state.uploads.assign(textureCount, 0);
+	state.wrongImages = 0;
+	unsigned int overBudget = 0, drains = 0;
+
+	std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+	TextureManager * manager = createTextureManager(threadCount, 8);
+	// The requests come in waves, between the frames, like a level being streamed in
+	unsigned int requested = 0;
+	while ((requested < textureCount || pendingTextureCount(manager) > 0) && millisecondsSince(start) < 60000.0){
+		for (unsigned int i=0; i<50 && requested < textureCount; i++, requested++)
+			requestTextureDecode(manager, files[fileNumber(requested)].path.c_str(), requested, requested % 7 == 0);
+		state.drainBytes = 0;
+		state.drainImages = 0;
+		size_t bytes = drainDecodedTextures(manager, byteBudget, checkUpload, &state);
+		CHECK(bytes == state.drainBytes);
+		if (state.drainImages > 1 && bytes > byteBudget)
+			overBudget++;
+		drains += state.drainImages ? 1 : 0;
+		std::this_thread::sleep_for(std::chrono::milliseconds(1)); // the rest of the frame
+	}
+	destroyTextureManager(manager);
+	double milliseconds = millisecondsSince(start);
+
+	unsigned int notOnce = 0;
+	for (unsigned int i=0; i<textureCount; i++)
+		notOnce += state.uploads[i] == 1 ? 0 : 1;
+	printf("%3u threads, budget %7u bytes : %u textures in %8.2f ms, %u drains, %u not given once, %u wrong, %u over budget\n",
+		threadCount, (unsigned int)byteBudget, textureCount, milliseconds,
+		drains, notOnce, state.wrongImages, overBudget);
+	CHECK(notOnce == 0);
+	CHECK(state.wrongImages == 0);
+	CHECK(overBudget == 0);
+}
+
+// Quitting while the workers are busy, and while they wait for room in the queue of decoded images
+static void destroyBusyManager(const std::vector<StressFile> & files, unsigned int textureCount){
+	StressState state;
+	state.files = &files;
+	state.uploads.assign(textureCount, 0);
+	state.wrongImages = 0;
+	std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+	TextureManager * manager = createTextureManager(4, 2);
+	for (unsigned int i=0; i<textureCount; i++)
+		requestTextureDecode(manager, files[fileNumber(i)].path.c_str(), i, false);
+	drainDecodedTextures(manager, 0, checkUpload, &state);
+	destroyTextureManager(manager);
+	printf("destroyed with %u textures requested : %8.2f ms\n", textureCount, millisecondsSince(start));
+	CHECK(state.wrongImages == 0);
+}
+
+int main(int argc, char * argv[]){
+	unsigned int textureCount = argc > 1 ? (unsigned int)atoi(argv[1]) : 800;
+	std::vector<StressFile> files;
+	makeFiles(files);
+
+	stress(files, textureCount, 1, 1 << 20);
+	stress(files, textureCount, 4, 1 << 20);
+	stress(files, textureCount, 0, 1 << 20);
+	stress(files, textureCount, 0, 1000);           // smaller than most images : one image per drain
+	stress(files, textureCount, 0, (size_t)-1);     // everything that is ready
+	destroyBusyManager(files, textureCount);
+
+	for (size_t i=0; i<files.size(); i++)
+		remove(files[i].path.c_str());
+	return testResult();
+}
@@ -0,0 +1,105 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+#include <chrono>
+
+#include <glm/glm.hpp>
+
+#include <common/vboindexer.hpp>
+
+#include "testing.hpp"
+
+// "vboindexer_benchmark [vertices]" times indexVBO and indexVBO_map (the std::map version it replaced)
+// on vertex soups like the ones loadOBJ gives : of 'vertices' (10 million by default), 3/10 and 1/10 of that.
+// Both must find the same unique vertices, in the same order.
+// Also checks that indexVBO gives the outputs back as they were when there are too many vertices.
+
+struct VertexSoup{
+	std::vector<glm::vec3> vertices;
+	std::vector<glm::vec2> uvs;
+	std::vector<glm::vec3> normals;
+};
+
+// The triangles of a bumpy grid, each with its own 3 vertices : each unique vertex is there 6 times
+static void makeGridSoup(unsigned int soupVertices, VertexSoup & soup){
+	unsigned int cells = gridCells(soupVertices / 3);
+	for (unsigned int y=0; y<cells; y++){
+		for (unsigned int x=0; x<cells; x++){
+			const unsigned int corners[6][2] = { {x,y}, {x+1,y}, {x+1,y+1}, {x,y}, {x+1,y+1}, {x,y+1} };
+			for (int k=0; k<6; k++){
+				unsigned int cx = corners[k][0], cy = corners[k][1];
+				soup.vertices.push_back(glm::vec3(cx * 0.01f, 0.05f * ((cx * 7 + cy * 13) % 17), cy * -0.01f));
+				soup.uvs     .push_back(glm::vec2((float)cx / cells, (float)cy / cells));
+				soup.normals .push_back(glm::vec3(0.1f * ((cx % 5) - 2.0f), 0.9f, 0.1f * ((cy % 3) - 1.0f)));
+			}
+		}
+	}
+}
+
+static bool sameVertices(const VertexSoup & a, const VertexSoup & b){
+	return a.vertices.size() == b.vertices.size() && !a.vertices.empty() &&
+		memcmp(&a.vertices[0], &b.vertices[0], a.vertices.size() * sizeof(glm::vec3)) == 0 &&
+		memcmp(&a.uvs[0],      &b.uvs[0],      a.uvs.size()      * sizeof(glm::vec2)) == 0 &&
+		memcmp(&a.normals[0],  &b.normals[0],  a.normals.size()  * sizeof(glm::vec3)) == 0;
+}
+
+// Each index must give back the vertex of the soup
+static bool indicesGiveSoup(const std::vector<unsigned int> & indices, const VertexSoup & indexed, const VertexSoup & soup){
+	if (indices.size() != soup.vertices.size())
+		return false;
+	for (size_t i=0; i<indices.size(); i++){
+		unsigned int v = indices[i];
+		if (v >= indexed.vertices.size() ||
+		    memcmp(&indexed.vertices[v], &soup.vertices[i], sizeof(glm::vec3)) != 0 ||
+		    memcmp(&indexed.uvs[v],      &soup.uvs[i],      sizeof(glm::vec2)) != 0 ||
+		    memcmp(&indexed.normals[v],  &soup.normals[i],  sizeof(glm::vec3)) != 0)
+			return false;
+	}
+	return true;
+}
+
+static void checkOverflow(){
+	VertexSoup soup;
+	makeGridSoup(600000, soup); // about 100000 unique vertices : too many for 16 bits
+	VertexSoup indexed;
+	std::vector<unsigned short> indices(3, 1);
+	indexed.vertices.resize(2, glm::vec3(1.0f));
+	indexed.uvs     .resize(2, glm::vec2(2.0f));
+	indexed.normals .resize(2, glm::vec3(3.0f));
+	CHECK(!indexVBO(soup.vertices, soup.uvs, soup.normals, indices, indexed.vertices, indexed.uvs, indexed.normals));
+	CHECK(indices.size() == 3 && indices[2] == 1);
+	CHECK(indexed.vertices.size() == 2 && indexed.uvs.size() == 2 && indexed.normals.size() == 2 && indexed.vertices[1] == glm::vec3(1.0f));
+}
+
+int main(int argc, char * argv[]){
+	unsigned int maxVertices = argc > 1 ? (unsigned int)atoi(argv[1]) : 10000000;
+
+	checkOverflow();
+
+	printf("   vertices    unique      indexVBO   indexVBO_map\n");
+	const unsigned int tenths[3] = { 1, 3, 10 };
+	for (int s=0; s<3; s++){
+		VertexSoup soup;
+		makeGridSoup((unsigned int)((unsigned long long)maxVertices * tenths[s] / 10), soup);
+
+		std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+		VertexSoup indexed;
+		std::vector<unsigned int> indices;
+		CHECK(indexVBO(soup.vertices, soup.uvs, soup.normals, indices, indexed.vertices, indexed.uvs, indexed.normals));
+		double hashTime = millisecondsSince(start);
+		CHECK(indicesGiveSoup(indices, indexed, soup));
+
+		// Its indices are truncated to 16 bits, but it still finds the unique vertices
+		start = std::chrono::high_resolution_clock::now();
+		VertexSoup mapIndexed;
+		std::vector<unsigned short> mapIndices;
+		indexVBO_map(soup.vertices, soup.uvs, soup.normals, mapIndices, mapIndexed.vertices, mapIndexed.uvs, mapIndexed.normals);
+		double mapTime = millisecondsSince(start);
+		CHECK(sameVertices(indexed, mapIndexed));
+
+		printf("%11u %9u %10.1f ms %10.1f ms  %5.1fx faster, %6.1f M vertices/s\n", (unsigned int)soup.vertices.size(),
+			(unsigned int)indexed.vertices.size(), hashTime, mapTime, mapTime / hashTime, soup.vertices.size() / (hashTime * 1000.0));
+	}
+	return testResult();
+}
@@ -0,0 +1,75 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <vector>
+#include <chrono>
+
+#include <glm/glm.hpp>
+
+#include <common/vboindexer.hpp>
+
+#include "testing.hpp"
+
+// "vboindexer_tbn_benchmark [vertices]" times indexVBO_TBN on vertex soups of 1000 vertices to 'vertices'
+// (4 million by default), each twice as big as the previous one : the time per vertex must stay about the same.
+// indexVBO_TBN_slow, which is O(n^2), is timed too on the smallest ones.
+
+// The triangles of a grid, each with its own 3 vertices, moved by less than the tolerance of is_near()
+static void makeGridSoup(unsigned int soupVertices,
+	std::vector<glm::vec3> & vertices, std::vector<glm::vec2> & uvs, std::vector<glm::vec3> & normals,
+	std::vector<glm::vec3> & tangents, std::vector<glm::vec3> & bitangents
+){
+	unsigned int cells = gridCells(soupVertices / 3);
+	unsigned int random = 1;
+	for (unsigned int y=0; y<cells; y++){
+		for (unsigned int x=0; x<cells; x++){
+			const unsigned int corners[6][2] = { {x,y}, {x+1,y}, {x+1,y+1}, {x,y}, {x+1,y+1}, {x,y+1} };
+			for (int k=0; k<6; k++){
+				random = random * 1664525u + 1013904223u;
+				float jitter = (float)(random >> 24) / 256.0f * 0.004f;
+				float cx = (float)corners[k][0], cy = (float)corners[k][1];
+				vertices.push_back(glm::vec3(cx * 0.1f + jitter, 0.5f * ((corners[k][0] * 7 + corners[k][1] * 13) % 17), cy * -0.1f));
+				uvs.push_back(glm::vec2(cx / cells, cy / cells + jitter));
+				normals.push_back(glm::vec3(0.0f, 1.0f, jitter));
+				tangents.push_back(glm::vec3(1.0f, 0.0f, jitter));
+				bitangents.push_back(glm::vec3(0.0f, jitter, 1.0f));
+			}
+		}
+	}
+}
+
+int main(int argc, char * argv[]){
+	unsigned int maxVertices = argc > 1 ? (unsigned int)atoi(argv[1]) : 4000000;
+	const unsigned int maxSlowVertices = 50000;
+
+	printf("   vertices    unique   indexVBO_TBN     ns/vertex   indexVBO_TBN_slow   speedup\n");
+	for (unsigned int size = 1000; size <= maxVertices; size *= 2){
+		std::vector<glm::vec3> vertices, normals, tangents, bitangents;
+		std::vector<glm::vec2> uvs;
+		makeGridSoup(size, vertices, uvs, normals, tangents, bitangents);
+
+		std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+		std::vector<unsigned int> indices;
+		std::vector<glm::vec3> indexed_vertices, indexed_normals, indexed_tangents, indexed_bitangents;
+		std::vector<glm::vec2> indexed_uvs;
+		CHECK(indexVBO_TBN(vertices, uvs, normals, tangents, bitangents,
+			indices, indexed_vertices, indexed_uvs, indexed_normals, indexed_tangents, indexed_bitangents));
+		double fastTime = millisecondsSince(start);
+		CHECK(indices.size() == vertices.size());
+
+		printf("%11u %9u %11.2f ms %13.1f", (unsigned int)vertices.size(), (unsigned int)indexed_vertices.size(),
+			fastTime, fastTime * 1e6 / vertices.size());
+		if (size <= maxSlowVertices){
+			start = std::chrono::high_resolution_clock::now();
+			std::vector<unsigned short> slow_indices;
+			std::vector<glm::vec3> slow_vertices, slow_normals, slow_tangents, slow_bitangents;
+			std::vector<glm::vec2> slow_uvs;
+			indexVBO_TBN_slow(vertices, uvs, normals, tangents, bitangents,
+				slow_indices, slow_vertices, slow_uvs, slow_normals, slow_tangents, slow_bitangents);
+			double slowTime = millisecondsSince(start);
+			CHECK(slow_vertices.size() == indexed_vertices.size());
+			printf(" %16.2f ms %8.1fx", slowTime, slowTime / fastTime);
+		}
+		printf("\n");
+	}
+	return testResult();
+}
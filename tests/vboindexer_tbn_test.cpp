@@ -0,0 +1,144 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <float.h>
+#include <vector>
+#include <chrono>
+
+#include <glm/glm.hpp>
+
+#include <common/vboindexer.hpp>
+
+#include "testing.hpp"
+
+// Checks that indexVBO_TBN gives exactly the same arrays as indexVBO_TBN_slow, the linear search it replaced,
+// on small random meshes : with vertices which are nearly the same (closer than the tolerance of is_near),
+// some which are just too far apart, on both sides of the grid cells, and huge, infinite or NaN positions.
+
+static unsigned int RandomState = 12345;
+static unsigned int nextRandom(){
+	RandomState = RandomState * 1664525u + 1013904223u;
+	return RandomState >> 8;
+}
+
+static float randomFloat(float range){
+	return ((float)(nextRandom() % 65536) / 32768.0f - 1.0f) * range;
+}
+
+struct TBNMesh{
+	std::vector<unsigned short> indices;
+	std::vector<glm::vec3> vertices;
+	std::vector<glm::vec2> uvs;
+	std::vector<glm::vec3> normals;
+	std::vector<glm::vec3> tangents;
+	std::vector<glm::vec3> bitangents;
+};
+
+// A position among a few : they get reused, moved a bit (less or more than the tolerance), or are special values
+static float randomCoordinate(const std::vector<float> & special){
+	static const float bases[8] = { 0.0f, 0.01f, 0.02f, -0.02f, 1.0f, 0.995f, 100.0f, -3.33f };
+	unsigned int kind = nextRandom() % 16;
+	if (kind == 0 && !special.empty())
+		return special[nextRandom() % special.size()];
+	float base = bases[nextRandom() % 8];
+	if (kind < 8)
+		return base;
+	return base + randomFloat(kind < 12 ? 0.009f : 0.03f);
+}
+
+static void makeRandomSoup(unsigned int count, const std::vector<float> & special, TBNMesh & soup){
+	for (unsigned int i=0; i<count; i++){
+		soup.vertices.push_back(glm::vec3(randomCoordinate(special), randomCoordinate(special), randomCoordinate(special)));
+		soup.uvs.push_back(glm::vec2(nextRandom() % 2 ? 0.5f : 0.5f + randomFloat(0.02f), nextRandom() % 3 * 0.25f));
+		soup.normals.push_back(glm::vec3(0.0f, nextRandom() % 4 ? 1.0f : 0.995f, 0.0f));
+		soup.tangents.push_back(glm::vec3(randomFloat(1.0f), randomFloat(1.0f), randomFloat(1.0f)));
+		soup.bitangents.push_back(glm::vec3(randomFloat(1.0f), randomFloat(1.0f), randomFloat(1.0f)));
+	}
+}
+
+template <typename T>
+static bool sameArray(const std::vector<T> & a, const std::vector<T> & b){
+	return a.size() == b.size() && (a.empty() || memcmp(&a[0], &b[0], a.size() * sizeof(T)) == 0);
+}
+
+static bool sameMeshes(const TBNMesh & a, const TBNMesh & b){
+	return sameArray(a.indices, b.indices) && sameArray(a.vertices, b.vertices) && sameArray(a.uvs, b.uvs) &&
+		sameArray(a.normals, b.normals) && sameArray(a.tangents, b.tangents) && sameArray(a.bitangents, b.bitangents);
+}
+
+// 'start' is what the outputs contain before the call : its vertices can be reused too
+static void checkSameAsSlow(const char * name, TBNMesh & soup, const TBNMesh & start){
+	TBNMesh slow = start, fast = start;
+	indexVBO_TBN_slow(soup.vertices, soup.uvs, soup.normals, soup.tangents, soup.bitangents,
+		slow.indices, slow.vertices, slow.uvs, slow.normals, slow.tangents, slow.bitangents);
+	CHECK(indexVBO_TBN(soup.vertices, soup.uvs, soup.normals, soup.tangents, soup.bitangents,
+		fast.indices, fast.vertices, fast.uvs, fast.normals, fast.tangents, fast.bitangents));
+	printf("%-24s : %5u vertices -> %5u\n", name, (unsigned int)soup.vertices.size(), (unsigned int)fast.vertices.size());
+	if (!CHECK(sameMeshes(slow, fast)))
+		printf("  different from indexVBO_TBN_slow\n");
+}
+
+int main(){
+	const unsigned int sizes[4] = { 3, 100, 1000, 6000 };
+	std::vector<float> noSpecial;
+	for (int s=0; s<4; s++){
+		TBNMesh soup, start;
+		makeRandomSoup(sizes[s], noSpecial, soup);
+		checkSameAsSlow("near vertices", soup, start);
+	}
+
+	// Out of the range of the grid cells, where floats are more than the tolerance apart, and non-finite values
+	std::vector<float> special;
+	special.push_back(2e7f);
+	special.push_back(2e7f + 2.0f);
+	special.push_back(-2e7f);
+	special.push_back(1e10f);
+	special.push_back(-1e20f);
+	special.push_back(3e38f);
+	special.push_back(-FLT_MAX);
+	special.push_back(131071.99f);
+	special.push_back(131072.0f);
+	special.push_back(INFINITY);
+	special.push_back(-INFINITY);
+	special.push_back(NAN);
+	for (int s=0; s<4; s++){
+		TBNMesh soup, start;
+		makeRandomSoup(sizes[s], special, soup);
+		checkSameAsSlow("huge and special values", soup, start);
+	}
+
+	// Outputs which already contain vertices
+	{
+		TBNMesh first, start;
+		makeRandomSoup(500, special, first);
+		indexVBO_TBN_slow(first.vertices, first.uvs, first.normals, first.tangents, first.bitangents,
+			start.indices, start.vertices, start.uvs, start.normals, start.tangents, start.bitangents);
+		TBNMesh soup;
+		makeRandomSoup(1000, special, soup);
+		checkSameAsSlow("appended", soup, start);
+	}
+
+	// Too many vertices for 16-bit indices : the outputs are given back as they were
+	{
+		TBNMesh soup, start;
+		makeRandomSoup(10, noSpecial, start);
+		start.indices.assign(10, 7);
+		for (unsigned int i=0; i<70000; i++){
+			soup.vertices.push_back(glm::vec3((float)i, 0.0f, 0.0f));
+			soup.uvs.push_back(glm::vec2(0.0f));
+			soup.normals.push_back(glm::vec3(0.0f));
+			soup.tangents.push_back(glm::vec3(1.0f));
+			soup.bitangents.push_back(glm::vec3(1.0f));
+		}
+		soup.vertices[0] = start.vertices[3]; // sums a tangent of a vertex which was there before
+		soup.uvs[0] = start.uvs[3];
+		soup.normals[0] = start.normals[3];
+		TBNMesh fast = start;
+		CHECK(!indexVBO_TBN(soup.vertices, soup.uvs, soup.normals, soup.tangents, soup.bitangents,
+			fast.indices, fast.vertices, fast.uvs, fast.normals, fast.tangents, fast.bitangents));
+		CHECK(sameMeshes(start, fast));
+	}
+
+	return testResult();
+}
@@ -0,0 +1,161 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <algorithm>
+#include <vector>
+#include <chrono>
+
+#include <glm/glm.hpp>
+
+#include <common/objloader.hpp>
+#include <common/vboindexer.hpp>
+#include <common/vertexcache.hpp>
+
+#include "testing.hpp"
+
+// "vertexcache_report [triangles] [file.obj...]" prints the ACMR and ATVR of meshes before and after
+// optimizeVertexCache and optimizeOverdraw, for a 16 and a 32 entries FIFO cache : suzanne.obj and room.obj
+// of the tutorials (or the given files), and synthetic grids of about 'triangles' triangles (200000 by default),
+// in scanline order and shuffled. The triangles must stay the same, only in another order.
+
+struct IndexedMesh{
+	std::vector<unsigned int> indices;
+	std::vector<glm::vec3> vertices;
+	std::vector<glm::vec2> uvs;
+	std::vector<glm::vec3> normals;
+};
+
+struct Triangle{
+	glm::vec3 corners[3];
+	bool operator<(const Triangle & that) const{
+		for (int k=0; k<3; k++)
+			for (int c=0; c<3; c++)
+				if (corners[k][c] != that.corners[k][c])
+					return corners[k][c] < that.corners[k][c];
+		return false;
+	}
+};
+
+// The triangles by their positions, each rotated to start with its smallest corner, sorted
+static std::vector<Triangle> sortedTriangles(const IndexedMesh & mesh){
+	std::vector<Triangle> triangles(mesh.indices.size() / 3);
+	for (size_t t=0; t<triangles.size(); t++){
+		Triangle corners;
+		for (int k=0; k<3; k++)
+			corners.corners[k] = mesh.vertices[mesh.indices[3*t + k]];
+		Triangle best = corners;
+		for (int r=1; r<3; r++){
+			Triangle rotated;
+			for (int k=0; k<3; k++)
+				rotated.corners[k] = corners.corners[(k + r) % 3];
+			if (rotated < best)
+				best = rotated;
+		}
+		triangles[t] = best;
+	}
+	std::sort(triangles.begin(), triangles.end());
+	return triangles;
+}
+
+static bool sameTriangles(const std::vector<Triangle> & a, const std::vector<Triangle> & b){
+	if (a.size() != b.size())
+		return false;
+	for (size_t t=0; t<a.size(); t++)
+		if (a[t] < b[t] || b[t] < a[t])
+			return false;
+	return true;
+}
+
+static void printStats(const char * step, const IndexedMesh & mesh, double milliseconds){
+	VertexCacheStats small = simulateVertexCache(mesh.indices, mesh.vertices.size(), 16);
+	VertexCacheStats big   = simulateVertexCache(mesh.indices, mesh.vertices.size(), 32);
+	printf("  %-22s ACMR %5.3f / %5.3f   ATVR %5.3f / %5.3f", step, small.acmr, big.acmr, small.atvr, big.atvr);
+	if (milliseconds > 0.0)
+		printf("   %8.2f ms", milliseconds);
+	printf("\n");
+}
+
+static void reportMesh(const char * name, IndexedMesh & mesh){
+	printf("%s : %u triangles, %u vertices (caches of 16 / 32 entries)\n", name,
+		(unsigned int)(mesh.indices.size() / 3), (unsigned int)mesh.vertices.size());
+	std::vector<Triangle> triangles = sortedTriangles(mesh);
+	VertexCacheStats before = simulateVertexCache(mesh.indices, mesh.vertices.size(), 32);
+	printStats("as loaded", mesh, 0.0);
+
+	std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+	optimizeVertexCache(mesh.indices, mesh.vertices.size());
+	printStats("optimizeVertexCache", mesh, millisecondsSince(start));
+	VertexCacheStats optimized = simulateVertexCache(mesh.indices, mesh.vertices.size(), 32);
+	CHECK(optimized.acmr <= before.acmr);
+
+	start = std::chrono::high_resolution_clock::now();
+	optimizeOverdraw(mesh.indices, mesh.vertices, 1.05f);
+	printStats("optimizeOverdraw 1.05", mesh, millisecondsSince(start));
+
+	start = std::chrono::high_resolution_clock::now();
+	optimizeVertexFetch(mesh.indices, mesh.vertices, mesh.uvs, mesh.normals, NULL, NULL);
+	printStats("optimizeVertexFetch", mesh, millisecondsSince(start));
+	CHECK(sameTriangles(triangles, sortedTriangles(mesh)));
+	printf("\n");
+}
+
+static bool loadIndexedOBJ(const char * path, IndexedMesh & mesh){
+	std::vector<glm::vec3> vertices, normals;
+	std::vector<glm::vec2> uvs;
+	return loadOBJ_fast(path, vertices, uvs, normals, 0) &&
+		indexVBO(vertices, uvs, normals, mesh.indices, mesh.vertices, mesh.uvs, mesh.normals);
+}
+
+// A bumpy grid, its triangles row after row, like many generated meshes
+static void makeGrid(unsigned int cells, IndexedMesh & mesh){
+	unsigned int side = cells + 1;
+	for (unsigned int y=0; y<side; y++){
+		for (unsigned int x=0; x<side; x++){
+			mesh.vertices.push_back(glm::vec3(x * 0.01f, 0.05f * ((x * 7 + y * 13) % 17), y * -0.01f));
+			mesh.uvs.push_back(glm::vec2((float)x / cells, (float)y / cells));
+			mesh.normals.push_back(glm::vec3(0.0f, 1.0f, 0.0f));
+		}
+	}
+	for (unsigned int y=0; y<cells; y++){
+		for (unsigned int x=0; x<cells; x++){
+			unsigned int a = y * side + x, b = a + 1, c = a + side, d = c + 1;
+			unsigned int corners[6] = { a, b, d, a, d, c };
+			mesh.indices.insert(mesh.indices.end(), corners, corners + 6);
+		}
+	}
+}
+
+// The worst case : no two consecutive triangles share anything
+static void shuffleTriangles(IndexedMesh & mesh){
+	unsigned int random = 12345;
+	size_t count = mesh.indices.size() / 3;
+	for (size_t t=count-1; t>0; t--){
+		random = random * 1664525u + 1013904223u;
+		size_t other = (random >> 8) % (t + 1);
+		for (int k=0; k<3; k++)
+			std::swap(mesh.indices[3*t + k], mesh.indices[3*other + k]);
+	}
+}
+
+int main(int argc, char * argv[]){
+	unsigned int triangles = argc > 1 ? (unsigned int)atoi(argv[1]) : 200000;
+
+	const char * defaultFiles[2] = { "tutorial09_vbo_indexing/suzanne.obj", "tutorial15_lightmaps/room.obj" };
+	const char ** files = argc > 2 ? (const char **)argv + 2 : defaultFiles;
+	int fileCount = argc > 2 ? argc - 2 : 2;
+	for (int f=0; f<fileCount; f++){
+		IndexedMesh mesh;
+		if (CHECK(loadIndexedOBJ(files[f], mesh)))
+			reportMesh(files[f], mesh);
+	}
+
+	IndexedMesh grid;
+	makeGrid(gridCells(triangles), grid);
+	reportMesh("grid, row by row", grid);
+
+	IndexedMesh shuffled;
+	makeGrid(gridCells(triangles), shuffled);
+	shuffleTriangles(shuffled);
+	reportMesh("grid, shuffled", shuffled);
+
+	return testResult();
+}
@@ -0,0 +1,69 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string>
+#include <vector>
+#include <chrono>
+
+#include <glm/glm.hpp>
+
+#include <common/objloader.hpp>
+#include <common/vboindexer.hpp>
+#include <common/tangentspace.hpp>
+#include <common/vertexlayout.hpp>
+
+#include "testing.hpp"
+
+// "vertexlayout_report file.obj..." packs each mesh (suzanne.obj and room.obj of the tutorials by default)
+// with several vertex layouts, and prints how much memory each one saves and how much precision it loses.
+
+struct NamedLayout{
+	const char * name;
+	VertexLayoutOptions options;
+};
+
+static const NamedLayout Layouts[] = {
+	{ "float32, separate arrays ",     { false, POSITION_FLOAT32, UV_FLOAT32, DIRECTION_FLOAT32,        DIRECTION_FLOAT32 } },
+	{ "float32, interleaved     ",     { true,  POSITION_FLOAT32, UV_FLOAT32, DIRECTION_FLOAT32,        DIRECTION_FLOAT32 } },
+	{ "half uv, 2_10_10_10      ",     { true,  POSITION_FLOAT32, UV_HALF,    DIRECTION_INT_2_10_10_10, DIRECTION_INT_2_10_10_10 } },
+	{ "unorm16, half uv, oct16  ",     { true,  POSITION_UNORM16, UV_HALF,    DIRECTION_OCT16,          DIRECTION_OCT16 } },
+};
+
+static void reportMesh(const char * path){
+	std::vector<glm::vec3> vertices, normals, tangents, bitangents;
+	std::vector<glm::vec2> uvs;
+	if (!CHECK(loadOBJ_fast(path, vertices, uvs, normals, 0)))
+		return;
+	computeTangentBasis(vertices, uvs, normals, tangents, bitangents);
+	std::vector<unsigned int> indices;
+	std::vector<glm::vec3> indexed_vertices, indexed_normals, indexed_tangents, indexed_bitangents;
+	std::vector<glm::vec2> indexed_uvs;
+	CHECK(indexVBO_TBN(vertices, uvs, normals, tangents, bitangents,
+		indices, indexed_vertices, indexed_uvs, indexed_normals, indexed_tangents, indexed_bitangents));
+	printf("%s : %u vertices\n", path, (unsigned int)indexed_vertices.size());
+
+	for (size_t l=0; l<sizeof(Layouts)/sizeof(Layouts[0]); l++){
+		PackedVertices packed;
+		packVertices(Layouts[l].options, indexed_vertices, indexed_uvs, indexed_normals, &indexed_tangents, &indexed_bitangents, packed);
+		VertexLayoutReport report;
+		compareVertexLayout(packed, indexed_vertices, indexed_uvs, indexed_normals, &indexed_tangents, &indexed_bitangents, report);
+		printVertexLayoutReport(Layouts[l].name, report);
+
+		// What the formats promise
+		float size = glm::max(packed.positionScale.x, glm::max(packed.positionScale.y, packed.positionScale.z));
+		CHECK(report.maxPositionError <= (Layouts[l].options.positionFormat == POSITION_UNORM16 ? size / 65535.0f : 0.0f));
+		CHECK(report.maxNormalError < 0.5f && report.maxTangentError < 0.5f);
+		CHECK(report.handednessErrors == 0);
+	}
+	printf("\n");
+}
+
+int main(int argc, char * argv[]){
+	if (argc > 1){
+		for (int i=1; i<argc; i++)
+			reportMesh(argv[i]);
+	}else{
+		reportMesh("tutorial09_vbo_indexing/suzanne.obj");
+		reportMesh("tutorial15_lightmaps/room.obj");
+	}
+	return testResult();
+}
@@ -0,0 +1,70 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+#include <string>
+#include <chrono>
+
+#include <glm/glm.hpp>
+
+#include <common/textureimage.hpp>
+#include <common/texturecompressor.hpp>
+#include <common/textureatlas.hpp>
+
+// "atlas_cooker [-bc1 | -bc3 | -bc7] [-page size] [-padding n] out.atlas image..."
+// packs .BMP, .TGA and .DDS files into the pages of a texture atlas (see cookTextureAtlas) :
+// out.atlas lists the pages, out.atlas.0.dds, out.atlas.1.dds, ..., and where each image is.
+// Pages of 2048 pixels, 8 pixels of padding and BC1 by default.
+
+static void printUsage(){
+	printf("usage : atlas_cooker [-bc1 | -bc3 | -bc7] [-page size] [-padding n] out.atlas image...\n");
+}
+
+int main(int argc, char * argv[]){
+	BlockFormat format = BLOCK_BC1;
+	AtlasOptions options = { 2048, 8 };
+	const char * atlaspath = NULL;
+	std::vector<std::string> images;
+	for (int i=1; i<argc; i++){
+		if (strcmp(argv[i], "-bc1") == 0)
+			format = BLOCK_BC1;
+		else if (strcmp(argv[i], "-bc3") == 0)
+			format = BLOCK_BC3;
+		else if (strcmp(argv[i], "-bc7") == 0)
+			format = BLOCK_BC7;
+		else if (strcmp(argv[i], "-page") == 0 && i+1 < argc)
+			options.pageSize = (unsigned int)atoi(argv[++i]);
+		else if (strcmp(argv[i], "-padding") == 0 && i+1 < argc)
+			options.padding = (unsigned int)atoi(argv[++i]);
+		else if (argv[i][0] == '-'){
+			printUsage();
+			return 1;
+		}else if (atlaspath == NULL)
+			atlaspath = argv[i];
+		else
+			images.push_back(argv[i]);
+	}
+	if (atlaspath == NULL || images.empty()){
+		printUsage();
+		return 1;
+	}
+
+	std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+	TextureAtlas atlas;
+	if (!cookTextureAtlas(images, options, format, atlaspath, atlas))
+		return 1;
+	double milliseconds = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+
+	// How much of the pages the images fill
+	double imagePixels = 0.0, pagePixels = 0.0;
+	for (size_t i=0; i<atlas.entries.size(); i++)
+		imagePixels += (double)atlas.entries[i].width * atlas.entries[i].height;
+	for (size_t p=0; p<atlas.pages.size(); p++){
+		printf("  %s : %ux%u\n", atlas.pages[p].path.c_str(), atlas.pages[p].width, atlas.pages[p].height);
+		pagePixels += (double)atlas.pages[p].width * atlas.pages[p].height;
+	}
+	printf("%u images in %u pages, %u mipmap levels, %.1f%% of the pages used, in %.1f ms\n",
+		(unsigned int)atlas.entries.size(), (unsigned int)atlas.pages.size(), atlas.levelCount,
+		100.0 * imagePixels / pagePixels, milliseconds);
+	return 0;
+}
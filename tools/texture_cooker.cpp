@@ -0,0 +1,70 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+#include <string>
+#include <chrono>
+
+#include <GL/glew.h>
+
+#include <common/textureimage.hpp>
+#include <common/texturecompressor.hpp>
+
+// "texture_cooker [-bc1 | -bc3 | -bc7] [-threads n] image.bmp... [-o out.dds]"
+// cooks .BMP and .TGA files into mipmapped, block-compressed .DDS files (see cookTexture).
+// Each image is written next to it as "image.bmp.dds", where loadTextureImage_cooked looks for it,
+// unless -o is given for a single image. BC1 is the default : use BC3 or BC7 for images with alpha.
+
+static void printUsage(){
+	printf("usage : texture_cooker [-bc1 | -bc3 | -bc7] [-threads n] image.bmp... [-o out.dds]\n");
+}
+
+int main(int argc, char * argv[]){
+	BlockFormat format = BLOCK_BC1;
+	unsigned int threadCount = 0;
+	const char * outputPath = NULL;
+	std::vector<const char *> images;
+	for (int i=1; i<argc; i++){
+		if (strcmp(argv[i], "-bc1") == 0)
+			format = BLOCK_BC1;
+		else if (strcmp(argv[i], "-bc3") == 0)
+			format = BLOCK_BC3;
+		else if (strcmp(argv[i], "-bc7") == 0)
+			format = BLOCK_BC7;
+		else if (strcmp(argv[i], "-threads") == 0 && i+1 < argc)
+			threadCount = (unsigned int)atoi(argv[++i]);
+		else if (strcmp(argv[i], "-o") == 0 && i+1 < argc)
+			outputPath = argv[++i];
+		else if (argv[i][0] == '-'){
+			printUsage();
+			return 1;
+		}else
+			images.push_back(argv[i]);
+	}
+	if (images.empty() || (outputPath && images.size() > 1)){
+		printUsage();
+		return 1;
+	}
+
+	int failures = 0;
+	for (size_t i=0; i<images.size(); i++){
+		std::string ddspath = outputPath ? outputPath : std::string(images[i]) + ".dds";
+		std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+		if (!cookTexture(images[i], ddspath.c_str(), format, threadCount)){
+			failures++;
+			continue;
+		}
+		double milliseconds = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+
+		// Read it back, like the tutorials will
+		TextureImage cooked;
+		if (!loadDDSImage(ddspath.c_str(), cooked)){
+			failures++;
+			continue;
+		}
+		printf("  %s : %ux%u, %u levels, %u bytes, in %.1f ms\n", ddspath.c_str(), cooked.width, cooked.height,
+			cooked.levelCount, (unsigned int)cooked.file.size, milliseconds);
+		unloadTextureImage(cooked);
+	}
+	return failures ? 1 : 0;
+}
@@ -20,6 +20,7 @@ using namespace glm;
 #include <common/controls.hpp>
 #include <common/objloader.hpp>
 #include <common/vboindexer.hpp>
+#include <common/vertexlayout.hpp>
 
 int main( void )
 {
@@ -81,7 +82,7 @@ int main( void )
 	glBindVertexArray(VertexArrayID);
 
 	// Create and compile our GLSL program from the shaders
-	GLuint programID = LoadShaders( "StandardShading.vertexshader", "StandardShading.fragmentshader" );
+	GLuint programID = LoadShaderVariant( "../common/StandardShading.vertexshader", "../common/StandardShading.fragmentshader", "" );
 
 	// Get a handle for our "MVP" uniform
 	GLuint MatrixID = glGetUniformLocation(programID, "MVP");
@@ -106,22 +107,20 @@ int main( void )
 	std::vector<glm::vec3> indexed_normals;
 	indexVBO(vertices, uvs, normals, indices, indexed_vertices, indexed_uvs, indexed_normals);
 
+	// Pack the vertices in a single interleaved buffer : 20 bytes per vertex instead of 32.
+	// The shader reads these formats as they are : half-float UVs, and normals in
+	// GL_INT_2_10_10_10_REV, normalized (the 4th component is ignored by the vec3 input).
+	VertexLayoutOptions layout = { true, POSITION_FLOAT32, UV_HALF, DIRECTION_INT_2_10_10_10, DIRECTION_INT_2_10_10_10 };
+	PackedVertices packed;
+	// How much precision this loses : tests/vertexlayout_report.cpp, on this mesh too.
+	packVertices(layout, indexed_vertices, indexed_uvs, indexed_normals, NULL, NULL, packed);
+
 	// Load it into a VBO
 
 	GLuint vertexbuffer;
 	glGenBuffers(1, &vertexbuffer);
 	glBindBuffer(GL_ARRAY_BUFFER, vertexbuffer);
-	glBufferData(GL_ARRAY_BUFFER, indexed_vertices.size() * sizeof(glm::vec3), &indexed_vertices[0], GL_STATIC_DRAW);
-
-	GLuint uvbuffer;
-	glGenBuffers(1, &uvbuffer);
-	glBindBuffer(GL_ARRAY_BUFFER, uvbuffer);
-	glBufferData(GL_ARRAY_BUFFER, indexed_uvs.size() * sizeof(glm::vec2), &indexed_uvs[0], GL_STATIC_DRAW);
-
-	GLuint normalbuffer;
-	glGenBuffers(1, &normalbuffer);
-	glBindBuffer(GL_ARRAY_BUFFER, normalbuffer);
-	glBufferData(GL_ARRAY_BUFFER, indexed_normals.size() * sizeof(glm::vec3), &indexed_normals[0], GL_STATIC_DRAW);
+	glBufferData(GL_ARRAY_BUFFER, packed.data.size(), &packed.data[0], GL_STATIC_DRAW);
 
 	// Generate a buffer for the indices as well
 	GLuint elementbuffer;
@@ -177,40 +176,40 @@ int main( void )
 		// Set our "myTextureSampler" sampler to use Texture Unit 0
 		glUniform1i(TextureID, 0);
 
-		// 1rst attribute buffer : vertices
-		glEnableVertexAttribArray(0);
+		// All the attributes are in the same buffer : packVertices tells where
 		glBindBuffer(GL_ARRAY_BUFFER, vertexbuffer);
+
+		// 1rst attribute : vertices
+		glEnableVertexAttribArray(0);
 		glVertexAttribPointer(
-			0,                  // attribute
-			3,                  // size
-			GL_FLOAT,           // type
-			GL_FALSE,           // normalized?
-			0,                  // stride
-			(void*)0            // array buffer offset
+			0,                                // attribute
+			packed.position.size,             // size
+			packed.position.type,             // type
+			packed.position.normalized,       // normalized?
+			packed.position.stride,           // stride
+			(void*)packed.position.offset     // array buffer offset
 		);
 
-		// 2nd attribute buffer : UVs
+		// 2nd attribute : UVs
 		glEnableVertexAttribArray(1);
-		glBindBuffer(GL_ARRAY_BUFFER, uvbuffer);
 		glVertexAttribPointer(
 			1,                                // attribute
-			2,                                // size
-			GL_FLOAT,                         // type
-			GL_FALSE,                         // normalized?
-			0,                                // stride
-			(void*)0                          // array buffer offset
+			packed.uv.size,                   // size
+			packed.uv.type,                   // type
+			packed.uv.normalized,             // normalized?
+			packed.uv.stride,                 // stride
+			(void*)packed.uv.offset           // array buffer offset
 		);
 
-		// 3rd attribute buffer : normals
+		// 3rd attribute : normals
 		glEnableVertexAttribArray(2);
-		glBindBuffer(GL_ARRAY_BUFFER, normalbuffer);
 		glVertexAttribPointer(
 			2,                                // attribute
-			3,                                // size
-			GL_FLOAT,                         // type
-			GL_FALSE,                         // normalized?
-			0,                                // stride
-			(void*)0                          // array buffer offset
+			packed.normal.size,               // size
+			packed.normal.type,               // type
+			packed.normal.normalized,         // normalized?
+			packed.normal.stride,             // stride
+			(void*)packed.normal.offset       // array buffer offset
 		);
 
 		// Index buffer
@@ -238,8 +237,6 @@ int main( void )
 
 	// Cleanup VBO and shader
 	glDeleteBuffers(1, &vertexbuffer);
-	glDeleteBuffers(1, &uvbuffer);
-	glDeleteBuffers(1, &normalbuffer);
 	glDeleteBuffers(1, &elementbuffer);
 	glDeleteProgram(programID);
 	glDeleteTextures(1, &Texture);
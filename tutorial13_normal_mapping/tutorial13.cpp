@@ -17,6 +17,7 @@ using namespace glm;
 
 #include <common/shader.hpp>
 #include <common/texture.hpp>
+#include <common/texturemanager.hpp>
 #include <common/controls.hpp>
 #include <common/objloader.hpp>
 #include <common/vboindexer.hpp>
@@ -91,10 +92,11 @@ int main( void )
 	GLuint ModelMatrixID = glGetUniformLocation(programID, "M");
 	GLuint ModelView3x3MatrixID = glGetUniformLocation(programID, "MV3x3");
 
-	// Load the texture
-	GLuint DiffuseTexture = loadDDS("diffuse.DDS");
-	GLuint NormalTexture = loadBMP_custom("normal.bmp");
-	GLuint SpecularTexture = loadDDS("specular.DDS");
+	// Load the textures in the background. They are grey until they are uploaded, in the main loop.
+	TextureManager * textureManager = createTextureManager(0, 4);
+	GLuint DiffuseTexture = loadTextureAsync(textureManager, "diffuse.DDS");
+	GLuint NormalTexture = loadTextureAsync(textureManager, "normal.bmp", true);
+	GLuint SpecularTexture = loadTextureAsync(textureManager, "specular.DDS");
 	
 	// Get a handle for our "myTextureSampler" uniform
 	GLuint DiffuseTextureID  = glGetUniformLocation(programID, "DiffuseTextureSampler");
@@ -178,6 +180,9 @@ int main( void )
 			lastTime += 1.0;
 		}
 
+		// Upload the textures which are ready, at most ~4 MB per frame
+		uploadDecodedTextures(textureManager, 4 << 20);
+
 		// Clear the screen
 		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
@@ -382,6 +387,7 @@ int main( void )
 	glDeleteTextures(1, &DiffuseTexture);
 	glDeleteTextures(1, &NormalTexture);
 	glDeleteTextures(1, &SpecularTexture);
+	destroyTextureManager(textureManager);
 	glDeleteVertexArrays(1, &VertexArrayID);
 
 	// Close OpenGL window and terminate GLFW
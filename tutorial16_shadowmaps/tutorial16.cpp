@@ -20,6 +20,11 @@ using namespace glm;
 #include <common/controls.hpp>
 #include <common/objloader.hpp>
 #include <common/vboindexer.hpp>
+#include <common/profiler.hpp>
+
+static void printShaderTime(const char * vertex_file_path, const char * fragment_file_path, double milliseconds, bool fromCache){
+	printf("%s + %s : %.1f ms%s\n", vertex_file_path, fragment_file_path, milliseconds, fromCache ? " (cached)" : "");
+}
 
 int main( void )
 {
@@ -87,11 +92,26 @@ int main( void )
 	glGenVertexArrays(1, &VertexArrayID);
 	glBindVertexArray(VertexArrayID);
 
-	// Create and compile our GLSL program from the shaders
-	GLuint depthProgramID = LoadShaders( "DepthRTT.vertexshader", "DepthRTT.fragmentshader" );
+	// With TUTORIAL_PROFILE=1 in the environment, time the loading and each frame.
+	// The summary and the trace are written when the window is closed
+	bool profiling = enableProfilerFromEnvironment();
+
+	// Create and compile our GLSL programs from the shaders, all at the same time :
+	// they are only checked when they are first used, with UseShaders()
+	setShaderTimingFunction(printShaderTime);
+	GLuint depthProgramID = LoadShadersAsync( "DepthRTT.vertexshader", "DepthRTT.fragmentshader" );
+	GLuint quad_programID = LoadShadersAsync( "Passthrough.vertexshader", "SimpleTexture.fragmentshader" );
+	GLuint programID = LoadShadersAsync( "ShadowMapping.vertexshader", "ShadowMapping.fragmentshader" );
 
-	// Get a handle for our "MVP" uniform
-	GLuint depthMatrixID = glGetUniformLocation(depthProgramID, "depthMVP");
+	// How long it took to submit the 3 programs. Much less the second time : they come from the program cache.
+	printShaderLoadStats();
+
+	// The handles of the uniforms are only asked for once each program is first used :
+	// glGetUniformLocation would wait here for the compilation
+	GLuint depthMatrixID = 0;
+	GLuint texID = 0;
+	GLuint TextureID = 0, MatrixID = 0, ViewMatrixID = 0, ModelMatrixID = 0, DepthBiasID = 0, ShadowMapID = 0, lightInvDirID = 0;
+	bool depthUniformsFound = false, quadUniformsFound = false, uniformsFound = false;
 
 	// Load the texture
 	GLuint Texture = loadDDS("uvmap.DDS");
@@ -178,32 +198,13 @@ int main( void )
 	glBindBuffer(GL_ARRAY_BUFFER, quad_vertexbuffer);
 	glBufferData(GL_ARRAY_BUFFER, sizeof(g_quad_vertex_buffer_data), g_quad_vertex_buffer_data, GL_STATIC_DRAW);
 
-	// Create and compile our GLSL program from the shaders
-	GLuint quad_programID = LoadShaders( "Passthrough.vertexshader", "SimpleTexture.fragmentshader" );
-	GLuint texID = glGetUniformLocation(quad_programID, "texture");
-
-
-	// Create and compile our GLSL program from the shaders
-	GLuint programID = LoadShaders( "ShadowMapping.vertexshader", "ShadowMapping.fragmentshader" );
-
-	// Get a handle for our "myTextureSampler" uniform
-	GLuint TextureID  = glGetUniformLocation(programID, "myTextureSampler");
-
-	// Get a handle for our "MVP" uniform
-	GLuint MatrixID = glGetUniformLocation(programID, "MVP");
-	GLuint ViewMatrixID = glGetUniformLocation(programID, "V");
-	GLuint ModelMatrixID = glGetUniformLocation(programID, "M");
-	GLuint DepthBiasID = glGetUniformLocation(programID, "DepthBiasMVP");
-	GLuint ShadowMapID = glGetUniformLocation(programID, "shadowMap");
-	
-	// Get a handle for our "LightPosition" uniform
-	GLuint lightInvDirID = glGetUniformLocation(programID, "LightInvDirection_worldspace");
-
 
 	
 	do{
 
 		// Render to our framebuffer
+		beginProfileScope("shadow pass");
+		beginGPUProfileScope("shadow pass");
 		glBindFramebuffer(GL_FRAMEBUFFER, FramebufferName);
 		glViewport(0,0,1024,1024); // Render on the whole framebuffer, complete from the lower left corner to the upper right
 
@@ -217,7 +218,12 @@ int main( void )
 		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
 		// Use our shader
-		glUseProgram(depthProgramID);
+		UseShaders(depthProgramID);
+		if (!depthUniformsFound){
+			// Get a handle for our "MVP" uniform
+			depthMatrixID = glGetUniformLocation(depthProgramID, "depthMVP");
+			depthUniformsFound = true;
+		}
 
 		glm::vec3 lightInvDir = glm::vec3(0.5f,2,2);
 
@@ -260,10 +266,14 @@ int main( void )
 		);
 
 		glDisableVertexAttribArray(0);
+		endGPUProfileScope();
+		endProfileScope();
 
 
 
 		// Render to the screen
+		beginProfileScope("scene pass");
+		beginGPUProfileScope("scene pass");
 		glBindFramebuffer(GL_FRAMEBUFFER, 0);
 		glViewport(0,0,windowWidth,windowHeight); // Render on the whole framebuffer, complete from the lower left corner to the upper right
 
@@ -274,7 +284,22 @@ int main( void )
 		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
 		// Use our shader
-		glUseProgram(programID);
+		UseShaders(programID);
+		if (!uniformsFound){
+			// Get a handle for our "myTextureSampler" uniform
+			TextureID  = glGetUniformLocation(programID, "myTextureSampler");
+
+			// Get a handle for our "MVP" uniform
+			MatrixID = glGetUniformLocation(programID, "MVP");
+			ViewMatrixID = glGetUniformLocation(programID, "V");
+			ModelMatrixID = glGetUniformLocation(programID, "M");
+			DepthBiasID = glGetUniformLocation(programID, "DepthBiasMVP");
+			ShadowMapID = glGetUniformLocation(programID, "shadowMap");
+
+			// Get a handle for our "LightPosition" uniform
+			lightInvDirID = glGetUniformLocation(programID, "LightInvDirection_worldspace");
+			uniformsFound = true;
+		}
 
 		// Compute the MVP matrix from keyboard and mouse input
 		computeMatricesFromInputs();
@@ -362,6 +387,8 @@ int main( void )
 		glDisableVertexAttribArray(0);
 		glDisableVertexAttribArray(1);
 		glDisableVertexAttribArray(2);
+		endGPUProfileScope();
+		endProfileScope();
 
 
 		// Optionally render the shadowmap (for debug only)
@@ -370,7 +397,11 @@ int main( void )
 		glViewport(0,0,512,512);
 
 		// Use our shader
-		glUseProgram(quad_programID);
+		UseShaders(quad_programID);
+		if (!quadUniformsFound){
+			texID = glGetUniformLocation(quad_programID, "texture");
+			quadUniformsFound = true;
+		}
 
 		// Bind our texture in Texture Unit 0
 		glActiveTexture(GL_TEXTURE0);
@@ -397,6 +428,7 @@ int main( void )
 
 
 		// Swap buffers
+		profileFrame();
 		glfwSwapBuffers(window);
 		glfwPollEvents();
 
@@ -404,6 +436,12 @@ int main( void )
 	while( glfwGetKey(window, GLFW_KEY_ESCAPE ) != GLFW_PRESS &&
 		   glfwWindowShouldClose(window) == 0 );
 
+	// Open it in chrome://tracing
+	if (profiling){
+		printProfileSummary();
+		writeProfileTrace("tutorial16.trace.json");
+	}
+
 	// Cleanup VBO and shader
 	glDeleteBuffers(1, &vertexbuffer);
 	glDeleteBuffers(1, &uvbuffer);
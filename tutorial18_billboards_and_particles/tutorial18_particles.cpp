@@ -18,50 +18,17 @@ using namespace glm;
 #include <common/shader.hpp>
 #include <common/texture.hpp>
 #include <common/controls.hpp>
-
-// CPU representation of a particle
-struct Particle{
-	glm::vec3 pos, speed;
-	unsigned char r,g,b,a; // Color
-	float size, angle, weight;
-	float life; // Remaining life of the particle. if <0 : dead and unused.
-	float cameradistance; // *Squared* distance to the camera. if dead : -1.0f
-
-	bool operator<(const Particle& that) const {
-		// Sort in reverse order : far particles drawn first.
-		return this->cameradistance > that.cameradistance;
-	}
-};
+#include <common/profiler.hpp>
+#include <common/particlesystem.hpp>
+#include <common/jobpool.hpp>
+#include <common/particleeffect.hpp>
+#include <common/streambuffer.hpp>
 
 const int MaxParticles = 100000;
-Particle ParticlesContainer[MaxParticles];
-int LastUsedParticle = 0;
-
-// Finds a Particle in ParticlesContainer which isn't used yet.
-// (i.e. life < 0);
-int FindUnusedParticle(){
-
-	for(int i=LastUsedParticle; i<MaxParticles; i++){
-		if (ParticlesContainer[i].life < 0){
-			LastUsedParticle = i;
-			return i;
-		}
-	}
-
-	for(int i=0; i<LastUsedParticle; i++){
-		if (ParticlesContainer[i].life < 0){
-			LastUsedParticle = i;
-			return i;
-		}
-	}
-
-	return 0; // All particles are taken, override the first one
-}
-
-void SortParticles(){
-	std::sort(&ParticlesContainer[0], &ParticlesContainer[MaxParticles]);
-}
+ParticleEffect Particles;
 
+// tests/particles_benchmark.cpp compares the particle update with the loop this tutorial used to have,
+// and tests/streambuffer_test.cpp the ways to stream the vertices.
 int main( void )
 {
 	// Initialize GLFW
@@ -120,6 +87,10 @@ int main( void )
 	glBindVertexArray(VertexArrayID);
 
 
+	// With TUTORIAL_PROFILE=1 in the environment, time the loading and each frame.
+	// The summary and the trace are written when the window is closed
+	bool profiling = enableProfilerFromEnvironment();
+
 	// Create and compile our GLSL program from the shaders
 	GLuint programID = LoadShaders( "Particle.vertexshader", "Particle.fragmentshader" );
 
@@ -132,13 +103,22 @@ int main( void )
 	GLuint TextureID  = glGetUniformLocation(programID, "myTextureSampler");
 
 	
-	static GLfloat* g_particule_position_size_data = new GLfloat[MaxParticles * 4];
-	static GLubyte* g_particule_color_data         = new GLubyte[MaxParticles * 4];
+	// The particles are simulated by worker threads, one frame ahead : while the GL thread draws a frame,
+	// the workers compute the next one. See common/particleeffect.cpp for the emission.
+	JobPool * jobPool = createJobPool(0);
+	initParticleEffect(Particles, jobPool, 0);
 
-	for(int i=0; i<MaxParticles; i++){
-		ParticlesContainer[i].life = -1.0f;
-		ParticlesContainer[i].cameradistance = -1.0f;
-	}
+	// Generate 10 new particle each millisecond, from a single fountain. They live 5 seconds.
+	ParticleEmitterSettings fountain;
+	fountain.position = glm::vec3(0,0,-20.0f);
+	fountain.direction = glm::vec3(0.0f, 10.0f, 0.0f);
+	fountain.spread = 1.5f;
+	fountain.particlesPerSecond = 10000.0f;
+	fountain.life = 5.0f;
+	fountain.minSize = 0.1f;
+	fountain.maxSize = 0.6f;
+	fountain.capacity = MaxParticles;
+	addParticleEmitter(Particles, fountain);
 
 
 
@@ -157,19 +137,21 @@ int main( void )
 	glBindBuffer(GL_ARRAY_BUFFER, billboard_vertex_buffer);
 	glBufferData(GL_ARRAY_BUFFER, sizeof(g_vertex_buffer_data), g_vertex_buffer_data, GL_STATIC_DRAW);
 
-	// The VBO containing the positions and sizes of the particles
-	GLuint particles_position_buffer;
-	glGenBuffers(1, &particles_position_buffer);
-	glBindBuffer(GL_ARRAY_BUFFER, particles_position_buffer);
-	// Initialize with empty (NULL) buffer : it will be updated later, each frame.
-	glBufferData(GL_ARRAY_BUFFER, MaxParticles * 4 * sizeof(GLfloat), NULL, GL_STREAM_DRAW);
+	// The positions and sizes of the particles, then their colors, in a buffer which the workers write directly,
+	// mapped : no copy by glBufferSubData. See common/streambuffer.hpp.
+	size_t particleCapacity = particleEffectCapacity(Particles);
+	size_t colorStart = particleCapacity * 4 * sizeof(GLfloat);
+	StreamBuffer particleStream;
+	initStreamBuffer(particleStream, colorStart + particleCapacity * 4 * sizeof(GLubyte), STREAM_PERSISTENT);
 
-	// The VBO containing the colors of the particles
-	GLuint particles_color_buffer;
-	glGenBuffers(1, &particles_color_buffer);
-	glBindBuffer(GL_ARRAY_BUFFER, particles_color_buffer);
-	// Initialize with empty (NULL) buffer : it will be updated later, each frame.
-	glBufferData(GL_ARRAY_BUFFER, MaxParticles * 4 * sizeof(GLubyte), NULL, GL_STREAM_DRAW);
+	// Where the particles being simulated are written. NULL if the buffer couldn't be mapped : then the workers
+	// write in the arrays of the effect, which glBufferSubData copies to the same place of the buffer.
+	size_t particleOffset;
+	unsigned char * particleVertices = (unsigned char *)beginStreamWrite(particleStream, colorStart + particleCapacity * 4 * sizeof(GLubyte), particleOffset);
+	if (particleVertices)
+		beginParticleFrameInto(Particles, 0.0f, glm::vec3(0.0f), (GLfloat*)particleVertices, particleVertices + colorStart);
+	else
+		beginParticleFrame(Particles, 0.0f, glm::vec3(0.0f));
 
 
 	
@@ -197,100 +179,23 @@ int main( void )
 		glm::mat4 ViewProjectionMatrix = ProjectionMatrix * ViewMatrix;
 
 
-		// Generate 10 new particle each millisecond,
-		// but limit this to 16 ms (60 fps), or if you have 1 long frame (1sec),
-		// new particles will be huge and the next frame even longer.
-		int newparticles = (int)(delta*10000.0);
-		if (newparticles > (int)(0.016f*10000.0))
-			newparticles = (int)(0.016f*10000.0);
-		
-		for(int i=0; i<newparticles; i++){
-			int particleIndex = FindUnusedParticle();
-			ParticlesContainer[particleIndex].life = 5.0f; // This particle will live 5 seconds.
-			ParticlesContainer[particleIndex].pos = glm::vec3(0,0,-20.0f);
-
-			float spread = 1.5f;
-			glm::vec3 maindir = glm::vec3(0.0f, 10.0f, 0.0f);
-			// Very bad way to generate a random direction; 
-			// See for instance http://stackoverflow.com/questions/5408276/python-uniform-spherical-distribution instead,
-			// combined with some user-controlled parameters (main direction, spread, etc)
-			glm::vec3 randomdir = glm::vec3(
-				(rand()%2000 - 1000.0f)/1000.0f,
-				(rand()%2000 - 1000.0f)/1000.0f,
-				(rand()%2000 - 1000.0f)/1000.0f
-			);
-			
-			ParticlesContainer[particleIndex].speed = maindir + randomdir*spread;
-
-
-			// Very bad way to generate a random color
-			ParticlesContainer[particleIndex].r = rand() % 256;
-			ParticlesContainer[particleIndex].g = rand() % 256;
-			ParticlesContainer[particleIndex].b = rand() % 256;
-			ParticlesContainer[particleIndex].a = (rand() % 256) / 3;
-
-			ParticlesContainer[particleIndex].size = (rand()%1000)/2000.0f + 0.1f;
-			
-		}
-
-
-
-		// Simulate all particles
-		int ParticlesCount = 0;
-		for(int i=0; i<MaxParticles; i++){
-
-			Particle& p = ParticlesContainer[i]; // shortcut
-
-			if(p.life > 0.0f){
-
-				// Decrease life
-				p.life -= delta;
-				if (p.life > 0.0f){
-
-					// Simulate simple physics : gravity only, no collisions
-					p.speed += glm::vec3(0.0f,-9.81f, 0.0f) * (float)delta * 0.5f;
-					p.pos += p.speed * (float)delta;
-					p.cameradistance = glm::length2( p.pos - CameraPosition );
-					//ParticlesContainer[i].pos += glm::vec3(0.0f,10.0f, 0.0f) * (float)delta;
-
-					// Fill the GPU buffer
-					g_particule_position_size_data[4*ParticlesCount+0] = p.pos.x;
-					g_particule_position_size_data[4*ParticlesCount+1] = p.pos.y;
-					g_particule_position_size_data[4*ParticlesCount+2] = p.pos.z;
-												   
-					g_particule_position_size_data[4*ParticlesCount+3] = p.size;
-												   
-					g_particule_color_data[4*ParticlesCount+0] = p.r;
-					g_particule_color_data[4*ParticlesCount+1] = p.g;
-					g_particule_color_data[4*ParticlesCount+2] = p.b;
-					g_particule_color_data[4*ParticlesCount+3] = p.a;
-
-				}else{
-					// Particles that just died will be put at the end of the buffer in SortParticles();
-					p.cameradistance = -1.0f;
-				}
-
-				ParticlesCount++;
-
-			}
-		}
-
-		SortParticles();
+		// Take the particles which the workers computed during the previous frame : they are already in particleStream,
+		// unless it couldn't be mapped. What's drawn is one frame late : it was sorted with the camera of the previous frame.
+		const GLfloat * particlePositionSize;
+		const GLubyte * particleColor;
+		int ParticlesCount = finishParticleFrame(Particles, &particlePositionSize, &particleColor);
 
 		//printf("%d ",ParticlesCount);
 
-		// Update the buffers that OpenGL uses for rendering.
-		// There are much more sophisticated means to stream data from the CPU to the GPU, 
-		// but this is outside the scope of this tutorial.
-		// http://www.opengl.org/wiki/Buffer_Object_Streaming
-
-		glBindBuffer(GL_ARRAY_BUFFER, particles_position_buffer);
-		glBufferData(GL_ARRAY_BUFFER, MaxParticles * 4 * sizeof(GLfloat), NULL, GL_STREAM_DRAW); // Buffer orphaning, a common way to improve streaming perf. See above link for details.
-		glBufferSubData(GL_ARRAY_BUFFER, 0, ParticlesCount * sizeof(GLfloat) * 4, g_particule_position_size_data);
-
-		glBindBuffer(GL_ARRAY_BUFFER, particles_color_buffer);
-		glBufferData(GL_ARRAY_BUFFER, MaxParticles * 4 * sizeof(GLubyte), NULL, GL_STREAM_DRAW); // Buffer orphaning, a common way to improve streaming perf. See above link for details.
-		glBufferSubData(GL_ARRAY_BUFFER, 0, ParticlesCount * sizeof(GLubyte) * 4, g_particule_color_data);
+		beginProfileScope("draw particles");
+		beginGPUProfileScope("draw particles");
+		if (particleVertices){
+			endStreamWrite(particleStream);
+		}else{
+			glBindBuffer(GL_ARRAY_BUFFER, particleStream.buffer);
+			glBufferSubData(GL_ARRAY_BUFFER, particleOffset, ParticlesCount * 4 * sizeof(GLfloat), particlePositionSize);
+			glBufferSubData(GL_ARRAY_BUFFER, particleOffset + colorStart, ParticlesCount * 4 * sizeof(GLubyte), particleColor);
+		}
 
 
 		glEnable(GL_BLEND);
@@ -325,26 +230,26 @@ int main( void )
 		
 		// 2nd attribute buffer : positions of particles' centers
 		glEnableVertexAttribArray(1);
-		glBindBuffer(GL_ARRAY_BUFFER, particles_position_buffer);
+		glBindBuffer(GL_ARRAY_BUFFER, particleStream.buffer);
 		glVertexAttribPointer(
 			1,                                // attribute. No particular reason for 1, but must match the layout in the shader.
 			4,                                // size : x + y + z + size => 4
 			GL_FLOAT,                         // type
 			GL_FALSE,                         // normalized?
 			0,                                // stride
-			(void*)0                          // array buffer offset
+			(void*)particleOffset             // array buffer offset
 		);
 
 		// 3rd attribute buffer : particles' colors
 		glEnableVertexAttribArray(2);
-		glBindBuffer(GL_ARRAY_BUFFER, particles_color_buffer);
+		glBindBuffer(GL_ARRAY_BUFFER, particleStream.buffer);
 		glVertexAttribPointer(
 			2,                                // attribute. No particular reason for 1, but must match the layout in the shader.
 			4,                                // size : r + g + b + a => 4
 			GL_UNSIGNED_BYTE,                 // type
 			GL_TRUE,                          // normalized?    *** YES, this means that the unsigned char[4] will be accessible with a vec4 (floats) in the shader ***
 			0,                                // stride
-			(void*)0                          // array buffer offset
+			(void*)(particleOffset + colorStart) // array buffer offset
 		);
 
 		// These functions are specific to glDrawArrays*Instanced*.
@@ -366,7 +271,18 @@ int main( void )
 		glDisableVertexAttribArray(1);
 		glDisableVertexAttribArray(2);
 
+		// Start the next frame, in the next part of the buffer
+		endStreamFrame(particleStream);
+		particleVertices = (unsigned char *)beginStreamWrite(particleStream, colorStart + particleCapacity * 4 * sizeof(GLubyte), particleOffset);
+		if (particleVertices)
+			beginParticleFrameInto(Particles, (float)delta, CameraPosition, (GLfloat*)particleVertices, particleVertices + colorStart);
+		else
+			beginParticleFrame(Particles, (float)delta, CameraPosition);
+		endGPUProfileScope();
+		endProfileScope();
+
 		// Swap buffers
+		profileFrame();
 		glfwSwapBuffers(window);
 		glfwPollEvents();
 
@@ -374,12 +290,20 @@ int main( void )
 	while( glfwGetKey(window, GLFW_KEY_ESCAPE ) != GLFW_PRESS &&
 		   glfwWindowShouldClose(window) == 0 );
 
+	// Open it in chrome://tracing
+	if (profiling){
+		printProfileSummary();
+		writeProfileTrace("tutorial18_particles.trace.json");
+	}
+
 
-	delete[] g_particule_position_size_data;
+	finishParticleFrame(Particles, NULL, NULL);
+	destroyJobPool(jobPool);
 
 	// Cleanup VBO and shader
-	glDeleteBuffers(1, &particles_color_buffer);
-	glDeleteBuffers(1, &particles_position_buffer);
+	if (particleVertices)
+		endStreamWrite(particleStream);
+	deleteStreamBuffer(particleStream);
 	glDeleteBuffers(1, &billboard_vertex_buffer);
 	glDeleteProgram(programID);
 	glDeleteTextures(1, &Texture);